@@ -0,0 +1,44 @@
+#ifndef __RV_ALLOC_H
+#define __RV_ALLOC_H
+
+#include <stddef.h>
+
+#include "rv-dec.h"
+
+typedef struct
+{
+    void *(*alloc)(void *ctx, size_t size);
+    void *(*resize)(void *ctx, void *p, size_t size); // p may be null
+    void (*release)(void *ctx, void *p);
+    void *ctx;
+} rv_allocator_t;
+
+// every allocation the library makes goes through the calling thread's
+// allocator, else the process one, else malloc. Set the process one before
+// any other call. Memory is released through whichever is current, so free
+// what a thread allocated before changing its allocator. Worker threads the
+// library starts take over the allocator current in the thread that started
+// them, and use it concurrently: it has to be thread-safe. Null restores the
+// default.
+extern void rv_dis_set_allocator(const rv_allocator_t *a);
+extern void rv_dis_set_thread_allocator(const rv_allocator_t *a);
+// the calling thread's override, null when it has none.
+extern const rv_allocator_t *rv_dis_thread_allocator(void);
+
+// releases arrays and objects the library returned.
+extern void rv_dis_free(void *p);
+
+typedef struct rv_arena rv_arena_t;
+
+// bump allocator: release is a no-op and a reset drops every allocation at
+// once, keeping the blocks. limit bounds the bytes the arena holds, 0 for
+// none; allocations beyond it fail. Allocation is locked, so library worker
+// threads can share an arena; reset and free it only while no thread uses
+// it.
+extern rv_arena_t *rv_arena_new(size_t block, size_t limit);
+extern void rv_arena_free(rv_arena_t *a);
+extern void rv_arena_reset(rv_arena_t *a);
+extern size_t rv_arena_used(const rv_arena_t *a);
+extern rv_allocator_t rv_arena_allocator(rv_arena_t *a);
+
+#endif // __RV_ALLOC_H
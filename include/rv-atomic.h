@@ -0,0 +1,62 @@
+#ifndef __RV_ATOMIC_H
+#define __RV_ATOMIC_H
+
+#include "rv-func.h"
+
+enum
+{
+    RV_ATOMIC_LR,
+    RV_ATOMIC_SC,
+    RV_ATOMIC_AMO,
+    RV_ATOMIC_FENCE,
+    RV_ATOMIC_FENCE_TSO,
+    RV_ATOMIC_FENCE_I,
+};
+
+// ordering bits of lr, sc and amo, as in inst_t mod
+enum
+{
+    RV_ATOMIC_RL = 1 << 0,
+    RV_ATOMIC_AQ = 1 << 1,
+};
+
+// fence sets, as in the pred and succ fields
+enum
+{
+    RV_ATOMIC_SET_W = 1 << 0,
+    RV_ATOMIC_SET_R = 1 << 1,
+    RV_ATOMIC_SET_O = 1 << 2,
+    RV_ATOMIC_SET_I = 1 << 3,
+};
+
+enum
+{
+    RV_ATOMIC_LOOP = 1 << 0,  // inside a loop, loop is its head
+    RV_ATOMIC_HEAVY = 1 << 1, // .aqrl, or a fence ordering rw before rw
+    RV_ATOMIC_HOT = 1 << 2,   // heavy and in a loop
+};
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint64_t func; // start of the enclosing function
+    rv_uint64_t loop; // head of the innermost loop
+    rv_uint8_t kind;
+    rv_uint8_t order; // RV_ATOMIC_AQ | RV_ATOMIC_RL
+    rv_uint8_t pred;  // fences only
+    rv_uint8_t succ;
+    rv_uint8_t width; // bytes, lr, sc and amo only
+    rv_uint8_t flags;
+    rv_uint16_t pad;
+} rv_atomic_t;
+
+extern int rv_atomic_decode(const inst_t *ir, rv_atomic_t *a);
+
+// "relaxed", "acquire", "release" or "seq_cst" for lr, sc and amo, the
+// pred,succ sets for fences.
+extern const char *rv_atomic_order(const rv_atomic_t *a, char *buf, size_t size);
+
+// every atomic and fence of every function, in address order.
+extern rv_atomic_t *rv_atomic_scan(const rv_image_t *img, const rv_func_t *funcs, size_t nfuncs, int nthreads, size_t *count);
+
+#endif // __RV_ATOMIC_H
@@ -0,0 +1,63 @@
+#ifndef __RV_CACHE_H
+#define __RV_CACHE_H
+
+#include "rv-index.h"
+
+#define RV_CACHE_VERSION 2
+#define RV_CACHE_ORDER 0x01020304 // order as the writer stored it
+
+// on-disk layout, in the writer's byte order and 8-byte aligned:
+//   rv_cache_hdr_t | rv_cache_cp_t[ncp] | rv_cache_rec_t[nrec] | string pool
+// A file from a host of the other byte order fails the order check and is
+// treated as stale.
+typedef struct
+{
+    char magic[4];
+    rv_uint32_t version;
+    rv_uint64_t hash; // content hash of the code bytes, seeded by the isa profile and plug-ins
+    rv_uint64_t base;
+    rv_uint64_t size;
+    rv_uint64_t bytes; // rv_format_line() listing size
+    rv_uint64_t ncp;
+    rv_uint64_t cp_off;
+    rv_uint64_t nrec;
+    rv_uint64_t rec_off;
+    rv_uint64_t pool_off;
+    rv_uint64_t pool_size;
+    rv_uint32_t step;
+    rv_uint32_t order; // RV_CACHE_ORDER
+} rv_cache_hdr_t;
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint64_t offset;
+    rv_uint64_t rec; // first record at or after pc
+} rv_cache_cp_t;
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint32_t raw;
+    rv_uint32_t text; // offset in the string pool, NUL terminated
+    rv_uint16_t tlen;
+    rv_uint16_t op;
+    rv_uint8_t len;
+    rv_uint8_t nargs;
+    rv_uint8_t pad[2];
+} rv_cache_rec_t;
+
+typedef struct rv_cache rv_cache_t;
+
+extern int rv_cache_build(const char *path, rv_uint64_t base, const rv_uint8_t *code, size_t size, int nthreads);
+
+// the returned handle is usable even when the file is missing or stale: it
+// then renders lines live from code.
+extern rv_cache_t *rv_cache_open(const char *path, rv_uint64_t base, const rv_uint8_t *code, size_t size);
+extern void rv_cache_close(rv_cache_t *c);
+extern int rv_cache_valid(const rv_cache_t *c);
+extern const rv_cache_rec_t *rv_cache_find(const rv_cache_t *c, rv_uint64_t pc);
+extern const char *rv_cache_text(const rv_cache_t *c, const rv_cache_rec_t *rec);
+extern int rv_cache_line(const rv_cache_t *c, rv_uint64_t pc, rv_line_t *line, char *buf, size_t size);
+
+#endif // __RV_CACHE_H
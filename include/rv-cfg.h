@@ -0,0 +1,65 @@
+#ifndef __RV_CFG_H
+#define __RV_CFG_H
+
+#include "rv-image.h"
+
+enum
+{
+    RV_FLOW_NONE,   // falls through
+    RV_FLOW_BRANCH, // conditional, target and fall through
+    RV_FLOW_JUMP,   // direct jump
+    RV_FLOW_CALL,   // direct call, returns to the next instruction
+    RV_FLOW_IJUMP,  // indirect jump (jr, switch dispatch, tail call)
+    RV_FLOW_ICALL,  // indirect call
+    RV_FLOW_RET,    // ret, mret, sret...
+    RV_FLOW_STOP,   // ebreak, unimp: no successor
+};
+
+enum
+{
+    RV_EDGE_FALL,
+    RV_EDGE_BRANCH,
+    RV_EDGE_JUMP,
+    RV_EDGE_CALL,
+};
+
+#define RV_CFG_NONE 0xffffffffu
+
+typedef struct
+{
+    rv_uint64_t start;
+    rv_uint32_t size;
+    rv_uint32_t ninsn;
+    rv_uint32_t edge; // first outgoing edge
+    rv_uint16_t nedges;
+    rv_uint8_t flow;  // RV_FLOW_* of the last instruction
+    rv_uint8_t pad;
+} rv_block_t;
+
+typedef struct
+{
+    rv_uint64_t target;
+    rv_uint32_t from;
+    rv_uint32_t to; // block index, RV_CFG_NONE when outside the recovered code
+    rv_uint8_t kind;
+    rv_uint8_t pad[7];
+} rv_edge_t;
+
+// blocks are sorted by address, edges grouped by source block.
+typedef struct
+{
+    rv_block_t *blocks;
+    size_t nblocks;
+    rv_edge_t *edges;
+    size_t nedges;
+} rv_cfg_t;
+
+extern int rv_flow(const inst_t *ir, rv_uint64_t *target);
+
+// traverses from entries, or from the image entry and function symbols when
+// entries is 0.
+extern rv_cfg_t *rv_cfg_build(const rv_image_t *img, const rv_uint64_t *entries, size_t nentries, int nthreads);
+extern void rv_cfg_free(rv_cfg_t *cfg);
+extern rv_uint32_t rv_cfg_find(const rv_cfg_t *cfg, rv_uint64_t pc);
+
+#endif // __RV_CFG_H
@@ -0,0 +1,55 @@
+#ifndef __RV_COST_H
+#define __RV_COST_H
+
+#include "rv-dis.h"
+
+#define RV_COST_PORTS 16
+#define RV_COST_ITERS 16 // simulated iterations, the second half is measured
+
+// instruction classes used when a mnemonic has no entry of its own
+enum
+{
+    RV_COST_ALU,
+    RV_COST_LOAD,
+    RV_COST_STORE,
+    RV_COST_BRANCH,
+    RV_COST_FP,
+    RV_COST_NCLASS,
+};
+
+// what limits the steady state
+enum
+{
+    RV_COST_DEPS,  // dependency chains, including loop carried ones
+    RV_COST_WIDTH, // issue width
+    RV_COST_PORT,  // a saturated port
+};
+
+typedef struct rv_model rv_model_t;
+
+typedef struct
+{
+    double cycles; // per iteration in steady state
+    double ipc;
+    rv_uint32_t latency; // one iteration, first issue to last result
+    rv_uint32_t ninsn;
+    int bound;
+    int port; // saturated port when bound is RV_COST_PORT
+} rv_cost_t;
+
+// model files are line based, '#' starts a comment:
+//   width 2
+//   port alu0
+//   class alu|load|store|branch|fp <latency> <rthroughput> <port>...
+//   op <mnemonic> <latency> <rthroughput> <port>...
+// ports must be declared before use.
+extern rv_model_t *rv_model_load(const char *path);
+extern rv_model_t *rv_model_default(void);
+extern void rv_model_free(rv_model_t *model);
+extern const char *rv_model_port(const rv_model_t *model, int port);
+
+// treats ins as a loop body executed back to back.
+extern int rv_cost_block(const rv_model_t *model, const inst_t *ins, size_t n, rv_cost_t *cost);
+extern int rv_cost_range(const rv_model_t *model, rv_uint64_t base, const rv_uint8_t *code, size_t size, rv_uint64_t lo, rv_uint64_t hi, rv_cost_t *cost);
+
+#endif // __RV_COST_H
@@ -0,0 +1,38 @@
+#ifndef __RV_CSR_H
+#define __RV_CSR_H
+
+#include "rv-dis.h"
+
+enum
+{
+    RV_PRIV_U,
+    RV_PRIV_S,
+    RV_PRIV_H, // hypervisor and virtual supervisor
+    RV_PRIV_M,
+    RV_PRIV_D, // debug mode only
+};
+
+// flags; RW and ANY only name the absence of the others in rv-csr.def
+enum
+{
+    RV_CSR_RW = 0,
+    RV_CSR_RO = 1 << 0,
+    RV_CSR_ANY = 0,
+    RV_CSR_RV32 = 1 << 1, // upper half of a 64 bit register, rv32 only
+};
+
+typedef struct
+{
+    const char *name;
+    rv_uint8_t priv;
+    rv_uint8_t flags;
+} rv_csr_t;
+
+// one table lookup; null for csrs the database does not know, and for
+// rv32 only ones when the selected profile is not rv32.
+extern const rv_csr_t *rv_csr_info(rv_uint64_t csr);
+// the same for an explicit xlen.
+extern const rv_csr_t *rv_csr_info_xlen(rv_uint64_t csr, int xlen);
+extern const char *rv_priv_name(int priv);
+
+#endif // __RV_CSR_H
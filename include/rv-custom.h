@@ -0,0 +1,34 @@
+#ifndef __RV_CUSTOM_H
+#define __RV_CUSTOM_H
+
+#include "rv-op.h"
+
+// fills op and up to 5 typed args, returns their count or -1 to leave the
+// encoding undefined. Text is rendered from the args.
+typedef int (*rv_custom_fmt)(void *arg, rv_uint32_t raw, const char **op, rv_arg_t *args);
+
+// an encoding e is claimed when (e & mask) == match. With fmt null, name and
+// layout describe it instead: layout is a comma separated operand list out
+// of rd, rs1, rs2, rs3, fd, fs1, fs2, fs3, vd, vs1, vs2 (register fields),
+// imm, uimm, simm, shamt (I, unsigned I, S and rs2 field immediates), mem
+// and smem (I and S offsets from rs1).
+typedef struct
+{
+    rv_uint32_t match;
+    rv_uint32_t mask;
+    const char *name;
+    const char *layout;
+    rv_custom_fmt fmt;
+    void *arg;
+} rv_custom_t;
+
+// plug-ins claim only encodings the built-in decoder and the op table leave
+// undefined, so they cannot shadow a ratified instruction; the isa profile
+// does not apply to them. What they claim decodes as RV_UNDEF with ir->uimm
+// RV_OP_CUSTOM and the encoding in ir->imm.u.
+// Register before decoding starts; the more specific mask wins on overlap,
+// then the earlier registration. name is kept, not copied.
+extern int rv_custom_register(const rv_custom_t *c);
+extern void rv_custom_clear(void);
+
+#endif // __RV_CUSTOM_H
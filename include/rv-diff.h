@@ -0,0 +1,40 @@
+#ifndef __RV_DIFF_H
+#define __RV_DIFF_H
+
+#include "rv-func.h"
+#include "rv-sink.h"
+
+enum
+{
+    RV_DIFF_SAME,    // same name, same hash
+    RV_DIFF_CHANGED, // same name or position, different hash
+    RV_DIFF_MOVED,   // same hash under another name, or both unnamed
+    RV_DIFF_REMOVED, // only in a
+    RV_DIFF_ADDED,   // only in b
+};
+
+#define RV_DIFF_NONE ((size_t)-1)
+
+typedef struct
+{
+    size_t a; // function indexes, RV_DIFF_NONE when absent
+    size_t b;
+    int kind;
+} rv_match_t;
+
+// hashes each function over its opcodes and operands; pc relative targets
+// are symbolized (offset in the function, or symbol and offset) so that code
+// moved by a relink hashes the same.
+extern rv_uint64_t *rv_diff_hash(const rv_image_t *img, const rv_func_t *funcs, size_t count, int nthreads);
+
+// pairs functions by name first, then the rest by hash, then unnamed ones
+// by position between matched neighbours. a functions come first in a
+// order, then the added ones.
+extern rv_match_t *rv_diff_match(const rv_image_t *a, const rv_func_t *fa, const rv_uint64_t *ha, size_t na, const rv_image_t *b,
+                                 const rv_func_t *fb, const rv_uint64_t *hb, size_t nb, size_t *count);
+
+// instruction level diff of two functions as "-" and "+" lines of
+// symbolized text, common lines omitted.
+extern int rv_diff_func(rv_sink_t *sink, const rv_image_t *a, const rv_func_t *fa, const rv_image_t *b, const rv_func_t *fb);
+
+#endif // __RV_DIFF_H
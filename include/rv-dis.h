@@ -1,15 +1,50 @@
 #ifndef __RV_DIS_H
 #define __RV_DIS_H
 
+#include <stddef.h>
+
 #include "rv-dec.h"
 
+enum
+{
+    RV_ARG_NONE,
+    RV_ARG_REG,   // reg
+    RV_ARG_FREG,  // reg
+    RV_ARG_IMM,   // imm
+    RV_ARG_MEM,   // imm(reg)
+    RV_ARG_CSR,   // imm is the csr number
+    RV_ARG_RND,   // imm is the rounding mode
+    RV_ARG_VREG,  // reg
+    RV_ARG_VTYPE, // imm is the vsetvli vtype
+};
+
+typedef struct
+{
+    rv_uint8_t kind;
+    rv_uint8_t reg;
+    rv_int64_t imm;
+} rv_arg_t;
+
+// args[] is the rendered text, arg[] the same operands typed.
 typedef struct
 {
     char *op;
     char *args[5];
+    rv_arg_t arg[5];
 } mnemonic_t;
 
+// rv_format() text of any built-in instruction, nul included, fits in
+// RV_TEXT_MAX bytes, as rv-sweep checks over the whole encoding space; the
+// address, encoding and newline of an rv_format_line() take 32 more at most.
+// Plug-in text can be longer and is still counted in the return value.
+#define RV_TEXT_MAX 128
+#define RV_LINE_MAX (RV_TEXT_MAX + 32)
+
 extern int rv_disasm(inst_t *ir, mnemonic_t *m);
+extern void rv_mnemonic_free(mnemonic_t *m);
+extern int rv_format(const mnemonic_t *m, char *buf, size_t size);
+extern int rv_format_line(rv_uint64_t pc, rv_uint32_t raw, int len, const mnemonic_t *m, char *buf, size_t size);
+extern int rv_dis_decode(rv_uint64_t pc, const rv_uint8_t *code, size_t size, inst_t *ir, rv_uint32_t *raw);
 extern const char *rv_reg2name(rv_uint8_t reg);
 extern const char *rv_freg2name(rv_uint8_t reg);
 extern const char *rv_csr2name(rv_uint64_t csr);
@@ -0,0 +1,325 @@
+#ifndef __RV_DIS_HPP
+#define __RV_DIS_HPP
+
+// header only C++20 layer over the C API. Views returned here point into
+// storage the library or an arena owns; nothing is copied into std::string.
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+
+extern "C"
+{
+#include "rv-alloc.h"
+#include "rv-csr.h"
+#include "rv-dis.h"
+}
+
+namespace rv
+{
+
+// abi names, as the library prints them.
+inline constexpr std::array<std::string_view, 32> reg_names = {
+    "zero", "ra", "sp", "gp", "tp",  "t0",  "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6",   "a7", "s2", "s3", "s4",  "s5",  "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+};
+
+inline constexpr std::array<std::string_view, 32> freg_names = {
+    "ft0", "ft1", "ft2", "ft3", "ft4", "ft5", "ft6",  "ft7",  "fs0", "fs1",  "fa0",  "fa1",  "fa2",  "fa3",  "fa4",  "fa5",
+    "fa6", "fa7", "fs2", "fs3", "fs4", "fs5", "fs6",  "fs7",  "fs8", "fs9",  "fs10", "fs11", "ft8",  "ft9",  "ft10", "ft11",
+};
+
+// 7 is dynamic, which the library leaves out of the operands.
+inline constexpr std::array<std::string_view, 8> rounding_modes = {
+    "rne", "rtz", "rdn", "rup", "rmm", "inv1", "inv2", "",
+};
+
+struct csr
+{
+    std::string_view name;
+    rv_uint8_t priv;
+    rv_uint8_t flags;
+};
+
+// built from rv-csr.def like the C table, so it cannot drift from it.
+inline constexpr std::array<csr, 4096> csr_table = [] {
+    std::array<csr, 4096> t{};
+#define CSR(num, name, priv, access, xlen) t[num] = {#name, RV_PRIV_##priv, RV_CSR_##access | RV_CSR_##xlen};
+#include "rv-csr.def"
+#undef CSR
+    return t;
+}();
+
+// null like rv_csr_info(), but for an explicit xlen rather than the
+// selected profile.
+constexpr const csr *csr_info(rv_uint64_t num, int xlen = 64)
+{
+    if (num >= csr_table.size() || csr_table[num].name.empty())
+        return nullptr;
+    if ((csr_table[num].flags & RV_CSR_RV32) && xlen != 32)
+        return nullptr;
+    return &csr_table[num];
+}
+
+class operand
+{
+  public:
+    constexpr operand(const rv_arg_t &arg, const char *text) : arg_(&arg), text_(text) {}
+
+    constexpr int kind() const { return arg_->kind; }
+    constexpr rv_uint8_t reg() const { return arg_->reg; }
+    constexpr rv_int64_t imm() const { return arg_->imm; }
+    constexpr const rv_arg_t &arg() const { return *arg_; }
+    constexpr std::string_view text() const { return text_; }
+
+  private:
+    const rv_arg_t *arg_;
+    const char *text_;
+};
+
+// the rendered operands of one mnemonic, as a random access range.
+class operands
+{
+  public:
+    class iterator
+    {
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = operand;
+        using difference_type = std::ptrdiff_t;
+        using reference = operand;
+
+        constexpr iterator() = default;
+        constexpr iterator(const mnemonic_t *m, int i) : m_(m), i_(i) {}
+
+        constexpr operand operator*() const { return {m_->arg[i_], m_->args[i_]}; }
+        constexpr operand operator[](difference_type n) const { return *(*this + n); }
+        constexpr iterator &operator++() { ++i_; return *this; }
+        constexpr iterator operator++(int) { iterator t = *this; ++i_; return t; }
+        constexpr iterator &operator--() { --i_; return *this; }
+        constexpr iterator operator--(int) { iterator t = *this; --i_; return t; }
+        constexpr iterator &operator+=(difference_type n) { i_ += n; return *this; }
+        constexpr iterator &operator-=(difference_type n) { i_ -= n; return *this; }
+        friend constexpr iterator operator+(iterator a, difference_type n) { return a += n; }
+        friend constexpr iterator operator+(difference_type n, iterator a) { return a += n; }
+        friend constexpr iterator operator-(iterator a, difference_type n) { return a -= n; }
+        friend constexpr difference_type operator-(const iterator &a, const iterator &b) { return a.i_ - b.i_; }
+        friend constexpr bool operator==(const iterator &a, const iterator &b) { return a.i_ == b.i_; }
+        friend constexpr auto operator<=>(const iterator &a, const iterator &b) { return a.i_ <=> b.i_; }
+
+      private:
+        const mnemonic_t *m_ = nullptr;
+        int i_ = 0;
+    };
+
+    constexpr explicit operands(const mnemonic_t &m) : m_(&m)
+    {
+        while (n_ < 5 && m.args[n_])
+            n_++;
+    }
+
+    constexpr iterator begin() const { return {m_, 0}; }
+    constexpr iterator end() const { return {m_, n_}; }
+    constexpr std::size_t size() const { return n_; }
+    constexpr bool empty() const { return n_ == 0; }
+    constexpr operand operator[](std::size_t i) const { return {m_->arg[i], m_->args[i]}; }
+
+  private:
+    const mnemonic_t *m_;
+    int n_ = 0;
+};
+
+// non-owning; valid while the mnemonic, or the arena it was made in, is.
+class mnemonic_view
+{
+  public:
+    constexpr explicit mnemonic_view(const mnemonic_t &m) : m_(&m) {}
+
+    constexpr std::string_view op() const { return m_->op ? m_->op : ""; }
+    constexpr rv::operands operands() const { return rv::operands(*m_); }
+    constexpr const mnemonic_t &c() const { return *m_; }
+
+  private:
+    const mnemonic_t *m_;
+};
+
+// bump allocator; see rv_arena_new().
+class arena
+{
+  public:
+    explicit arena(std::size_t block = 0, std::size_t limit = 0) : a_(rv_arena_new(block, limit))
+    {
+        if (a_ == nullptr)
+            throw std::bad_alloc();
+        alloc_ = rv_arena_allocator(a_);
+    }
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+    ~arena() { rv_arena_free(a_); }
+
+    void reset() { rv_arena_reset(a_); }
+    std::size_t used() const { return rv_arena_used(a_); }
+    const rv_allocator_t &allocator() const { return alloc_; }
+    rv_arena_t *get() const { return a_; }
+
+  private:
+    rv_arena_t *a_;
+    rv_allocator_t alloc_;
+};
+
+// the calling thread's allocator override, empty when it has none.
+inline std::optional<rv_allocator_t> thread_allocator()
+{
+    const rv_allocator_t *a = rv_dis_thread_allocator();
+    return a ? std::optional<rv_allocator_t>(*a) : std::nullopt;
+}
+
+// routes the calling thread's library allocations to a for its lifetime,
+// then puts back whatever override was there before. An empty a drops the
+// override.
+class allocator_scope
+{
+  public:
+    explicit allocator_scope(const std::optional<rv_allocator_t> &a) : prev_(thread_allocator())
+    {
+        rv_dis_set_thread_allocator(a ? &*a : nullptr);
+    }
+    explicit allocator_scope(const rv_allocator_t &a) : allocator_scope(std::optional<rv_allocator_t>(a)) {}
+    explicit allocator_scope(const arena &a) : allocator_scope(a.allocator()) {}
+    allocator_scope(const allocator_scope &) = delete;
+    allocator_scope &operator=(const allocator_scope &) = delete;
+    ~allocator_scope() { rv_dis_set_thread_allocator(prev_ ? &*prev_ : nullptr); }
+
+  private:
+    std::optional<rv_allocator_t> prev_;
+};
+
+// owns what rv_disasm() allocated; move only. The allocator current at
+// construction is the one the strings are freed through, wherever the
+// mnemonic ends up being destroyed.
+class mnemonic
+{
+  public:
+    mnemonic() : alloc_(thread_allocator()) { std::memset(&m_, 0, sizeof m_); }
+    mnemonic(const mnemonic &) = delete;
+    mnemonic &operator=(const mnemonic &) = delete;
+    mnemonic(mnemonic &&o) noexcept : m_(o.m_), alloc_(o.alloc_) { std::memset(&o.m_, 0, sizeof o.m_); }
+    mnemonic &operator=(mnemonic &&o) noexcept
+    {
+        if (this != &o)
+        {
+            release();
+            m_ = o.m_;
+            alloc_ = o.alloc_;
+            std::memset(&o.m_, 0, sizeof o.m_);
+        }
+        return *this;
+    }
+    ~mnemonic() { release(); }
+
+    std::string_view op() const { return view().op(); }
+    rv::operands operands() const { return rv::operands(m_); }
+    mnemonic_view view() const { return mnemonic_view(m_); }
+    operator mnemonic_view() const { return view(); }
+    const mnemonic_t &c() const { return m_; }
+    mnemonic_t *get() { return &m_; }
+
+  private:
+    void release()
+    {
+        allocator_scope s(alloc_);
+        rv_mnemonic_free(&m_);
+    }
+
+    mnemonic_t m_;
+    std::optional<rv_allocator_t> alloc_;
+};
+
+struct decoded
+{
+    inst_t ir;
+    rv_uint32_t raw;
+    int len; // bytes, 0 when code is too short
+};
+
+inline decoded decode(rv_uint64_t pc, std::span<const rv_uint8_t> code)
+{
+    decoded d;
+    d.len = rv_dis_decode(pc, code.data(), code.size(), &d.ir, &d.raw);
+    return d;
+}
+
+// rv_disasm() takes the instruction mutable; the copy keeps callers' const.
+inline mnemonic disasm(inst_t ir)
+{
+    mnemonic m;
+    rv_disasm(&ir, m.get());
+    return m;
+}
+
+// same, with the strings in a, which must outlive the view.
+inline mnemonic_view disasm(inst_t ir, arena &a, mnemonic_t &storage)
+{
+    allocator_scope s(a);
+    rv_disasm(&ir, &storage);
+    return mnemonic_view(storage);
+}
+
+// the formatted line in buf, truncated to fit.
+inline std::string_view format(mnemonic_view m, std::span<char> buf)
+{
+    int n = buf.empty() ? 0 : rv_format(&m.c(), buf.data(), buf.size());
+    if (n < 0)
+        n = 0;
+    if (!buf.empty() && static_cast<std::size_t>(n) >= buf.size())
+        n = buf.size() - 1;
+    return {buf.data(), static_cast<std::size_t>(n)};
+}
+
+// calls fn(const inst_t &, mnemonic_view) for each instruction. The strings
+// live in a, reset every batch instructions, so fn must not keep the views
+// past its return; fn itself runs with the caller's allocator.
+template <class F>
+void disasm(std::span<const inst_t> insts, arena &a, F &&fn, std::size_t batch = 4096)
+{
+    std::optional<rv_allocator_t> caller = thread_allocator();
+    allocator_scope s(a);
+    std::size_t n = 0;
+
+    a.reset();
+    for (const inst_t &ir : insts)
+    {
+        inst_t copy = ir;
+        mnemonic_t m;
+
+        if (n++ == batch)
+        {
+            a.reset();
+            n = 1;
+        }
+        rv_disasm(&copy, &m);
+        allocator_scope c(caller);
+        fn(ir, mnemonic_view(m));
+    }
+}
+
+// without an arena; each mnemonic is freed once fn returns.
+template <class F>
+void disasm(std::span<const inst_t> insts, F &&fn)
+{
+    for (const inst_t &ir : insts)
+    {
+        mnemonic m = disasm(ir);
+        fn(ir, m.view());
+    }
+}
+
+} // namespace rv
+
+#endif // __RV_DIS_HPP
@@ -0,0 +1,82 @@
+#ifndef __RV_FPRINT_H
+#define __RV_FPRINT_H
+
+#include "rv-func.h"
+
+#define RV_FPRINT_WINDOW 8 // instructions per shingle
+#define RV_FPRINT_K 32     // minhash bins
+#define RV_FPRINT_BANDS 8  // lsh bands of RV_FPRINT_K / RV_FPRINT_BANDS bins
+#define RV_FPDB_VERSION 2
+#define RV_FPDB_ORDER 0x01020304 // order as the writer stored it
+
+// one permutation minhash over the rolling hashes of every window of
+// instruction tokens; empty bins are filled from their right neighbour.
+typedef struct
+{
+    rv_uint64_t start;
+    rv_uint32_t ninsn;
+    rv_uint32_t nwin; // 0 when the function is shorter than a window
+    rv_uint32_t min[RV_FPRINT_K];
+} rv_fprint_t;
+
+// token of an instruction: the rv_disasm mnemonic and the kind of each of
+// its operands, registers and immediates abstracted away.
+extern rv_uint64_t rv_fprint_token(inst_t *ir);
+extern void rv_fprint_sketch(const rv_uint64_t *tokens, size_t n, rv_fprint_t *fp);
+extern double rv_fprint_similarity(const rv_fprint_t *a, const rv_fprint_t *b);
+
+// sketches every function in parallel.
+extern rv_fprint_t *rv_fprint_image(const rv_image_t *img, const rv_func_t *funcs, size_t count, int nthreads);
+
+// on-disk index, in the writer's byte order and 8-byte aligned:
+//   rv_fpdb_hdr_t | rv_fpdb_func_t[nfuncs] | rv_fpdb_key_t[nkeys] | pool
+// keys are sorted band hashes, the pool holds the image names. An index
+// from a host of the other byte order fails to open.
+typedef struct
+{
+    char magic[4];
+    rv_uint32_t version;
+    rv_uint64_t nfuncs;
+    rv_uint64_t func_off;
+    rv_uint64_t nkeys;
+    rv_uint64_t key_off;
+    rv_uint64_t pool_off;
+    rv_uint64_t pool_size;
+    rv_uint32_t order; // RV_FPDB_ORDER
+    rv_uint32_t pad;
+} rv_fpdb_hdr_t;
+
+typedef struct
+{
+    rv_uint64_t start;
+    rv_uint32_t image; // name offset in the pool
+    rv_uint32_t ninsn;
+    rv_uint32_t min[RV_FPRINT_K];
+} rv_fpdb_func_t;
+
+typedef struct
+{
+    rv_uint64_t key;
+    rv_uint64_t func;
+} rv_fpdb_key_t;
+
+typedef struct
+{
+    size_t func;
+    double similarity;
+} rv_fpdb_hit_t;
+
+typedef struct rv_fpdb rv_fpdb_t;
+
+extern rv_fpdb_t *rv_fpdb_new(void);
+extern rv_fpdb_t *rv_fpdb_open(const char *path);
+extern void rv_fpdb_close(rv_fpdb_t *db);
+extern int rv_fpdb_add(rv_fpdb_t *db, const char *image, const rv_fprint_t *fps, size_t count);
+extern int rv_fpdb_save(rv_fpdb_t *db, const char *path);
+
+// functions sharing a band with fp and at least min similar, best first.
+extern size_t rv_fpdb_query(rv_fpdb_t *db, const rv_fprint_t *fp, double min, rv_fpdb_hit_t *hits, size_t max);
+extern const rv_fpdb_func_t *rv_fpdb_func(const rv_fpdb_t *db, size_t func);
+extern const char *rv_fpdb_image(const rv_fpdb_t *db, size_t func);
+
+#endif // __RV_FPRINT_H
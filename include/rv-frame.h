@@ -0,0 +1,39 @@
+#ifndef __RV_FRAME_H
+#define __RV_FRAME_H
+
+#include "rv-func.h"
+
+enum
+{
+    RV_FRAME_DYNAMIC = 1 << 0,   // sp moved by a register amount (alloca, large frame)
+    RV_FRAME_ICALL = 1 << 1,     // makes indirect calls, depth is a lower bound
+    RV_FRAME_RECURSIVE = 1 << 2, // on a call graph cycle, depth ignores the back edge
+};
+
+typedef struct
+{
+    rv_uint64_t start;
+    rv_uint64_t depth;  // frame plus the deepest callee chain
+    rv_uint32_t frame;  // bytes below the caller's sp
+    rv_uint16_t spills; // callee-saved registers stored sp-relative
+    rv_uint16_t reloads;
+    rv_uint32_t callee; // first entry in rv_frames_t.callees
+    rv_uint32_t ncallees;
+    rv_uint32_t flags;
+    rv_uint32_t pad;
+} rv_frame_t;
+
+// one frame per function, in the order of the function table. callees
+// holds frame indexes, direct calls and tail calls alike.
+typedef struct
+{
+    rv_frame_t *frames;
+    size_t count;
+    rv_uint32_t *callees;
+    size_t ncallees;
+} rv_frames_t;
+
+extern rv_frames_t *rv_frame_analyze(const rv_image_t *img, const rv_func_t *funcs, size_t count, int nthreads);
+extern void rv_frames_free(rv_frames_t *f);
+
+#endif // __RV_FRAME_H
@@ -0,0 +1,30 @@
+#ifndef __RV_FUNC_H
+#define __RV_FUNC_H
+
+#include "rv-image.h"
+
+// evidence that a function starts at an address
+enum
+{
+    RV_FUNC_SYMBOL = 1 << 0,   // elf function symbol
+    RV_FUNC_ENTRY = 1 << 1,    // image entry point
+    RV_FUNC_CALLED = 1 << 2,   // target of jal ra, auipc+jalr or a tail call
+    RV_FUNC_BOUNDARY = 1 << 3, // first instruction after ret, jump or stop
+    RV_FUNC_PROLOGUE = 1 << 4, // allocates a frame or saves ra
+    RV_FUNC_PADDED = 1 << 5,   // alignment padding before it
+};
+
+typedef struct
+{
+    rv_uint64_t start;
+    rv_uint64_t end; // next function or end of section
+    rv_uint32_t flags;
+    rv_uint32_t pad;
+} rv_func_t;
+
+// sweeps the executable sections in parallel and returns the function starts
+// sorted by address.
+extern rv_func_t *rv_func_detect(const rv_image_t *img, int nthreads, size_t *count);
+extern const rv_func_t *rv_func_find(const rv_func_t *funcs, size_t count, rv_uint64_t pc);
+
+#endif // __RV_FUNC_H
@@ -0,0 +1,44 @@
+#ifndef __RV_IMAGE_H
+#define __RV_IMAGE_H
+
+#include "rv-dis.h"
+
+typedef struct
+{
+    const char *name;
+    rv_uint64_t addr;
+    rv_uint64_t size;
+    const rv_uint8_t *data;
+    int exec;
+} rv_section_t;
+
+typedef struct
+{
+    const char *name;
+    rv_uint64_t addr;
+    rv_uint64_t size;
+} rv_symbol_t;
+
+// sections and function symbols are sorted by address.
+typedef struct
+{
+    int xlen;
+    rv_uint64_t entry;
+    rv_section_t *sections;
+    size_t nsections;
+    rv_symbol_t *symbols;
+    size_t nsymbols;
+
+    void *map;
+    size_t map_size;
+} rv_image_t;
+
+extern rv_image_t *rv_image_open(const char *path, rv_uint64_t base);
+extern rv_image_t *rv_image_raw(rv_uint64_t base, const rv_uint8_t *code, size_t size);
+extern void rv_image_close(rv_image_t *img);
+
+extern const rv_section_t *rv_image_section(const rv_image_t *img, rv_uint64_t addr);
+extern const rv_symbol_t *rv_image_symbol(const rv_image_t *img, rv_uint64_t addr);
+extern int rv_image_read(const rv_image_t *img, rv_uint64_t addr, void *buf, size_t size);
+
+#endif // __RV_IMAGE_H
@@ -0,0 +1,33 @@
+#ifndef __RV_INDEX_H
+#define __RV_INDEX_H
+
+#include <stdio.h>
+
+#include "rv-list.h"
+
+typedef struct
+{
+    rv_uint64_t pc;     // first instruction boundary at or after the checkpoint address
+    rv_uint64_t offset; // byte offset of that line in the rv_format_line() listing
+} rv_checkpoint_t;
+
+// checkpoint i covers address base + i * step.
+typedef struct
+{
+    rv_uint64_t base;
+    rv_uint64_t size;
+    rv_uint64_t bytes; // total listing size
+    rv_uint32_t step;
+    size_t count;
+    rv_checkpoint_t *cp;
+} rv_index_t;
+
+extern rv_index_t *rv_index_build(rv_uint64_t base, const rv_uint8_t *code, size_t size, rv_uint32_t step, int nthreads);
+extern void rv_index_free(rv_index_t *idx);
+extern int rv_index_save(const rv_index_t *idx, FILE *f);
+extern rv_index_t *rv_index_load(FILE *f);
+
+extern const rv_checkpoint_t *rv_index_lookup(const rv_index_t *idx, rv_uint64_t pc);
+extern int rv_index_window(const rv_index_t *idx, const rv_uint8_t *code, rv_uint64_t lo, rv_uint64_t hi, rv_line_cb cb, void *arg);
+
+#endif // __RV_INDEX_H
@@ -0,0 +1,67 @@
+#ifndef __RV_ISA_H
+#define __RV_ISA_H
+
+#include "rv-dis.h"
+
+enum
+{
+    RV_EXT_I,
+    RV_EXT_M,
+    RV_EXT_A,
+    RV_EXT_F,
+    RV_EXT_D,
+    RV_EXT_Q,
+    RV_EXT_ZFH,
+    RV_EXT_C,
+    RV_EXT_B,      // zba, zbb, zbc, zbs
+    RV_EXT_K,      // scalar crypto
+    RV_EXT_V,
+    RV_EXT_ZICSR,
+    RV_EXT_CUSTOM, // custom and reserved major opcodes
+    RV_EXT_COUNT,
+};
+
+#define RV_ISA_KEYS 288     // 16 bit quadrant and funct3, then 32 bit major opcode and funct3
+
+typedef struct
+{
+    rv_uint32_t ext; // 1 << RV_EXT_*
+    rv_uint8_t xlen; // 32, 64 or 128
+    rv_uint8_t dispatch[RV_ISA_KEYS];
+} rv_isa_t;
+
+// dispatch key of an encoding: quadrant and funct3, or major opcode and funct3.
+extern int rv_isa_key(rv_uint32_t raw);
+
+// extension of an encoding, from its major opcode and function fields.
+extern int rv_ext_class(rv_uint32_t raw);
+extern const char *rv_ext_name(int ext);
+
+// integer register an encoding writes under xlen; 0 when it writes none or
+// an fp or vector register.
+extern int rv_int_def(rv_uint32_t raw, int xlen);
+
+// "rv32imac_zicsr", "rv64gc", ... implied extensions are added and the
+// dispatch table compiled.
+extern int rv_isa_parse(const char *s, rv_isa_t *isa);
+extern void rv_isa_compile(rv_isa_t *isa);
+
+// profile rv_dis_decode() and rv_disasm() apply on the calling thread from
+// now on, null for everything the decoder knows. Threads the library starts
+// take the profile of the thread that started them. It is not copied.
+extern void rv_isa_select(const rv_isa_t *isa);
+extern const rv_isa_t *rv_isa_current(void);
+extern int rv_isa_xlen(void);
+
+// 0 without a profile; keys what was rendered under the current one.
+extern rv_uint64_t rv_isa_seed(void);
+
+// turns ir into a plain RV_UNDEF when isa lacks it, returns 0 then.
+extern int rv_isa_apply(const rv_isa_t *isa, rv_uint32_t raw, inst_t *ir);
+
+// rv_dis_decode() and rv_disasm() under isa rather than the selected
+// profile, for callers juggling several at once.
+extern int rv_dis_decode_isa(const rv_isa_t *isa, rv_uint64_t pc, const rv_uint8_t *code, size_t size, inst_t *ir, rv_uint32_t *raw);
+extern int rv_disasm_isa(const rv_isa_t *isa, inst_t *ir, mnemonic_t *m);
+
+#endif // __RV_ISA_H
@@ -0,0 +1,34 @@
+#ifndef __RV_JTAB_H
+#define __RV_JTAB_H
+
+#include "rv-cfg.h"
+
+#define RV_JTAB_MAX 4096 // larger bounds are assumed to be misresolved
+
+typedef struct
+{
+    rv_uint64_t pc;    // the indirect jump
+    rv_uint64_t table; // address of entry 0
+    rv_uint64_t *targets;
+    rv_uint32_t count;
+    rv_uint8_t esize;  // entry size in bytes, 0 when the jump lands in the table itself
+    rv_uint8_t stride; // log2 of the distance between entries
+    rv_uint8_t rel;    // entries are added to a base address
+    rv_uint8_t pad;
+} rv_jtab_t;
+
+// resolves the indirect jump ending block b. returns 0 when resolved, -1
+// when the dispatch sequence or its bound is not recognized.
+extern int rv_jtab_resolve(const rv_image_t *img, const rv_cfg_t *cfg, rv_uint32_t b, rv_jtab_t *jt);
+
+// resolves every indirect jump of cfg. the array is sorted by jump address
+// and holds only resolved tables.
+extern rv_jtab_t *rv_jtab_scan(const rv_image_t *img, const rv_cfg_t *cfg, int nthreads, size_t *count);
+extern void rv_jtab_free(rv_jtab_t *tabs, size_t count);
+
+// rv_cfg_build from the image entry and symbols, extended from the case
+// targets of each newly resolved table until no new one is resolved. Only
+// the code a round adds is walked and only its jumps are scanned.
+extern rv_cfg_t *rv_jtab_cfg(const rv_image_t *img, int nthreads, rv_jtab_t **tabs, size_t *count);
+
+#endif // __RV_JTAB_H
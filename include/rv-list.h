@@ -0,0 +1,31 @@
+#ifndef __RV_LIST_H
+#define __RV_LIST_H
+
+#include "rv-dis.h"
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint32_t raw;
+    rv_uint16_t len;  // instruction length in bytes
+    rv_uint16_t tlen; // strlen(text)
+    rv_uint32_t gen;  // listing generation that last rendered this line
+    char *text;
+} rv_line_t;
+
+typedef struct rv_listing rv_listing_t;
+
+typedef void (*rv_line_cb)(void *arg, const rv_line_t *line);
+
+// the listing keeps a pointer to code: the caller patches the buffer in
+// place and then reports the modified bytes with rv_listing_patch().
+extern rv_listing_t *rv_listing_new(rv_uint64_t base, const rv_uint8_t *code, size_t size);
+extern void rv_listing_free(rv_listing_t *l);
+extern int rv_listing_patch(rv_listing_t *l, rv_uint64_t pc, size_t size);
+
+extern const rv_line_t *rv_listing_lines(const rv_listing_t *l, size_t *count);
+extern const rv_line_t *rv_listing_find(const rv_listing_t *l, rv_uint64_t pc);
+extern int rv_listing_dirty(const rv_listing_t *l, rv_uint64_t *lo, rv_uint64_t *hi);
+extern size_t rv_listing_changes(rv_listing_t *l, rv_line_cb cb, void *arg);
+
+#endif // __RV_LIST_H
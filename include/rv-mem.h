@@ -0,0 +1,50 @@
+#ifndef __RV_MEM_H
+#define __RV_MEM_H
+
+#include "rv-sink.h"
+
+enum
+{
+    RV_MEM_LOAD = 1 << 0,
+    RV_MEM_STORE = 1 << 1, // amos are both
+    RV_MEM_FP = 1 << 2,    // reg is a float register
+    RV_MEM_SIGNED = 1 << 3,
+    RV_MEM_ATOMIC = 1 << 4,
+    RV_MEM_LOOP = 1 << 5,   // inside a loop, loop is its head
+    RV_MEM_STRIDE = 1 << 6, // base changes by stride per iteration (0: invariant)
+};
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_int64_t disp;
+    rv_int64_t stride;
+    rv_uint64_t loop; // head of the innermost loop
+    rv_uint8_t base;  // address register
+    rv_uint8_t reg;   // data register
+    rv_uint8_t width; // bytes
+    rv_uint8_t flags;
+    rv_uint32_t pad;
+} rv_mem_t;
+
+#define RV_MEM_MAGIC "RVMA"
+#define RV_MEM_VERSION 1
+
+// binary table: the header then count rv_mem_t records.
+typedef struct
+{
+    char magic[4];
+    rv_uint32_t version;
+    rv_uint64_t count;
+    rv_uint64_t lo;
+    rv_uint64_t hi;
+} rv_mem_hdr_t;
+
+// fills m when ir reads or writes memory, returns 0 otherwise.
+extern int rv_mem_access(const inst_t *ir, rv_mem_t *m);
+
+// every access in [lo, hi) of the code mapped at base, in address order.
+extern rv_mem_t *rv_mem_extract(rv_uint64_t base, const rv_uint8_t *code, size_t size, rv_uint64_t lo, rv_uint64_t hi, size_t *count);
+extern int rv_mem_write(rv_sink_t *sink, const rv_mem_t *m, size_t count, rv_uint64_t lo, rv_uint64_t hi);
+
+#endif // __RV_MEM_H
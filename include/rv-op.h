@@ -0,0 +1,49 @@
+#ifndef __RV_OP_H
+#define __RV_OP_H
+
+#include "rv-dis.h"
+
+// ops rv-libdec does not have. rv_dis_decode() returns them as RV_UNDEF
+// with the op in ir->uimm and the encoding in ir->imm.u; other RV_UNDEF
+// have uimm 0. Those after RV_OP_CUSTOM are the entries of rv-op.def.
+enum
+{
+    RV_OP_NONE,   // decoded by rv-libdec, or undefined
+    RV_OP_CUSTOM, // claimed by a plug-in, see rv-custom.h
+#define OP(id, name, match, mask, operands, xlen, form) RV_OP_##id,
+#include "rv-op.def"
+#undef OP
+    RV_OP_COUNT,
+};
+
+// flags; ANY and PLAIN only name the absence of the others in rv-op.def
+enum
+{
+    RV_OPF_ANY = 0,
+    RV_OPF_RV32 = 1 << 0,
+    RV_OPF_RV64 = 1 << 1,
+    RV_OPF_PLAIN = 0,
+    RV_OPF_VM = 1 << 2,
+    RV_OPF_SEG2 = RV_OPF_VM | 2 << 3,
+    RV_OPF_SEG3 = RV_OPF_VM | 3 << 3,
+    RV_OPF_SEG4 = RV_OPF_VM | 4 << 3,
+};
+
+#define RV_OPF_SEG(flags) ((flags) >> 3 & 7) // letters before "seg<nf+1>", 0 without
+
+typedef struct
+{
+    const char *name;
+    rv_uint32_t match;
+    rv_uint32_t mask;
+    const char *operands;
+    rv_uint8_t flags;
+} rv_op_t;
+
+// null for RV_OP_NONE, RV_OP_CUSTOM and numbers past the table.
+extern const rv_op_t *rv_op_info(int op);
+
+// the RV_OP_* of a decoded instruction, RV_OP_NONE when ir->op says it all.
+extern int rv_dis_op(const inst_t *ir);
+
+#endif // __RV_OP_H
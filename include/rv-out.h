@@ -0,0 +1,31 @@
+#ifndef __RV_OUT_H
+#define __RV_OUT_H
+
+#include "rv-sink.h"
+
+enum
+{
+    RV_OUT_TEXT,    // rv_format_line() listing
+    RV_OUT_JSONL,   // one json object per instruction
+    RV_OUT_COLUMNS, // columnar binary, see below
+};
+
+// RV_OUT_COLUMNS layout, native byte order, every section 8-byte aligned:
+//   header  "RVCL", u32 version
+//   blocks  u32 count, u32 pad, then count entries per column:
+//             u64 pc, u32 raw, u16 opcode (ir->op), u32 name, u8 len, u8 nargs,
+//             u8 kind[5], u8 reg[5], i64 imm[5], u32 text[5]
+//   dict    u32 count, u32 pad, u32 offs[count], NUL terminated strings
+//   trailer u64 dict_off, u64 ninst, u64 nblocks, "RVCL", u32 version
+// name and text are ids in the dictionary, RV_OUT_NOSTR when absent.
+#define RV_OUT_VERSION 1
+#define RV_OUT_BLOCK 65536
+#define RV_OUT_NOSTR 0xffffffffu
+
+typedef struct rv_out rv_out_t;
+
+extern rv_out_t *rv_out_new(rv_sink_t *sink, int format);
+extern int rv_out_put(rv_out_t *o, const inst_t *ir, rv_uint32_t raw, int len, const mnemonic_t *m);
+extern int rv_out_close(rv_out_t *o);
+
+#endif // __RV_OUT_H
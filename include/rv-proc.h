@@ -0,0 +1,32 @@
+#ifndef __RV_PROC_H
+#define __RV_PROC_H
+
+#include "rv-image.h"
+
+#define RV_PROC_CHUNK (1 << 20) // bytes per remote iovec
+#define RV_PROC_IOV 64          // iovecs per process_vm_readv call
+
+typedef struct
+{
+    rv_uint64_t addr;
+    rv_uint64_t size;
+} rv_proc_range_t;
+
+typedef struct rv_proc rv_proc_t;
+
+// snapshots the executable mappings of a live process, listed by
+// /proc/<pid>/maps and copied with batched process_vm_readv. Needs ptrace
+// access to pid; pages that cannot be read come back as zeros.
+extern rv_proc_t *rv_proc_open(int pid);
+extern void rv_proc_close(rv_proc_t *p);
+
+// one executable section per mapping, named after the mapped file. The
+// image belongs to p and changes with every refresh.
+extern const rv_image_t *rv_proc_image(const rv_proc_t *p);
+
+// rereads the mappings and returns the page ranges whose bytes differ from
+// the previous snapshot, sorted and merged; new mappings are changed as a
+// whole. Free the array with rv_dis_free(). Null when the process is gone.
+extern rv_proc_range_t *rv_proc_refresh(rv_proc_t *p, size_t *count);
+
+#endif // __RV_PROC_H
@@ -0,0 +1,43 @@
+#ifndef __RV_PROF_H
+#define __RV_PROF_H
+
+#include "rv-cfg.h"
+#include "rv-func.h"
+#include "rv-sink.h"
+
+#define RV_PROF_MAGIC "RVPS"
+#define RV_PROF_VERSION 1
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint64_t count;
+} rv_sample_t;
+
+// binary sample files are the magic, the version as a 32 bit word, then
+// rv_sample_t records.
+typedef struct
+{
+    rv_sample_t *s;
+    size_t count;
+    size_t cap;
+    rv_uint64_t total; // sum of the counts
+    int sorted;
+} rv_profile_t;
+
+extern rv_profile_t *rv_profile_new(void);
+extern void rv_profile_free(rv_profile_t *p);
+extern int rv_profile_add(rv_profile_t *p, rv_uint64_t pc, rv_uint64_t count);
+
+// binary, or text with one "pc [count]" per line, pc in hex.
+extern rv_profile_t *rv_profile_load(const char *path);
+
+// sorts by pc in parallel and merges samples of the same pc.
+extern int rv_profile_sort(rv_profile_t *p, int nthreads);
+
+// lists every function holding at least min percent of the samples, with
+// per-instruction, per-block and per-function shares. p must be sorted.
+extern int rv_profile_annotate(rv_sink_t *sink, const rv_profile_t *p, const rv_image_t *img, const rv_func_t *funcs, size_t nfuncs,
+                               const rv_cfg_t *cfg, double min);
+
+#endif // __RV_PROF_H
@@ -0,0 +1,26 @@
+#ifndef __RV_SINK_H
+#define __RV_SINK_H
+
+#include "rv-dis.h"
+
+#define RV_SINK_BUFSIZE (4 << 20)
+#define RV_SINK_NBUF 4
+
+#define RV_SINK_ASYNC 1    // write full buffers from a background thread
+#define RV_SINK_PREALLOC 2 // preallocate expect bytes, trimmed on close
+
+typedef struct rv_sink rv_sink_t;
+
+// bufsize is rounded up to the page size, 0 picks RV_SINK_BUFSIZE.
+extern rv_sink_t *rv_sink_open(int fd, size_t bufsize, int flags, rv_uint64_t expect);
+extern int rv_sink_close(rv_sink_t *s);
+
+// reserve returns room for at least n bytes (n <= bufsize); commit then
+// appends the first n bytes actually used.
+extern char *rv_sink_reserve(rv_sink_t *s, size_t n);
+extern void rv_sink_commit(rv_sink_t *s, size_t n);
+extern int rv_sink_write(rv_sink_t *s, const void *data, size_t n);
+extern int rv_sink_flush(rv_sink_t *s);
+extern rv_uint64_t rv_sink_offset(const rv_sink_t *s);
+
+#endif // __RV_SINK_H
@@ -0,0 +1,27 @@
+#ifndef __RV_STATS_H
+#define __RV_STATS_H
+
+#include "rv-func.h"
+#include "rv-isa.h"
+#include "rv-op.h"
+
+#define RV_STATS_DEC 1024                         // decoder ops at or above share the last of these slots
+#define RV_STATS_OPS (RV_STATS_DEC + RV_OP_COUNT) // then one per rv_dis_op()
+
+typedef struct
+{
+    rv_uint64_t ops[RV_STATS_OPS];
+    rv_uint32_t raw[RV_STATS_OPS]; // first encoding of every op seen, to name it
+    rv_uint64_t ext[RV_EXT_COUNT];
+    rv_uint64_t *func; // nfuncs rows of RV_EXT_COUNT counts
+    size_t nfuncs;
+    rv_uint64_t insns;
+    rv_uint64_t bytes;
+} rv_stats_t;
+
+// decodes every executable section in parallel without formatting. funcs
+// split the work and get a row each; they may be null.
+extern rv_stats_t *rv_stats_image(const rv_image_t *img, const rv_func_t *funcs, size_t nfuncs, int nthreads);
+extern void rv_stats_free(rv_stats_t *s);
+
+#endif // __RV_STATS_H
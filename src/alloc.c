@@ -0,0 +1,264 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_HDR ARENA_ALIGN // each allocation is preceded by its size
+
+typedef struct block
+{
+    struct block *next;
+    size_t size; // usable bytes
+    size_t used;
+    _Alignas(ARENA_ALIGN) char data[];
+} block_t;
+
+struct rv_arena
+{
+    pthread_mutex_t lock; // held by alloc and resize
+    block_t *head;
+    block_t *cur;
+    size_t block;
+    size_t limit;
+    size_t held; // bytes of all blocks
+};
+
+static rv_allocator_t global;
+static int has_global;
+static _Thread_local rv_allocator_t local;
+static _Thread_local int has_local;
+
+void rv_dis_set_allocator(const rv_allocator_t *a)
+{
+    if (a)
+        global = *a;
+    has_global = a != 0;
+}
+
+void rv_dis_set_thread_allocator(const rv_allocator_t *a)
+{
+    if (a)
+        local = *a;
+    has_local = a != 0;
+}
+
+const rv_allocator_t *rv_dis_thread_allocator(void)
+{
+    return has_local ? &local : 0;
+}
+
+static const rv_allocator_t *current(void)
+{
+    return has_local ? &local : has_global ? &global : 0;
+}
+
+int rv_alloc_current(rv_allocator_t *a)
+{
+    const rv_allocator_t *c = current();
+
+    if (c)
+        *a = *c;
+    return c != 0;
+}
+
+void *rv_malloc(size_t size)
+{
+    const rv_allocator_t *a = current();
+    return a ? a->alloc(a->ctx, size) : malloc(size);
+}
+
+void *rv_calloc(size_t n, size_t size)
+{
+    const rv_allocator_t *a = current();
+    void *p;
+
+    if (a == 0)
+        return calloc(n, size);
+    if (size && n > SIZE_MAX / size)
+        return 0;
+    if ((p = a->alloc(a->ctx, n * size)) != 0)
+        memset(p, 0, n * size);
+    return p;
+}
+
+void *rv_realloc(void *p, size_t size)
+{
+    const rv_allocator_t *a = current();
+    return a ? a->resize(a->ctx, p, size) : realloc(p, size);
+}
+
+void rv_free(void *p)
+{
+    const rv_allocator_t *a = current();
+
+    if (a == 0)
+        free(p);
+    else if (p)
+        a->release(a->ctx, p);
+}
+
+char *rv_strdup(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *p = rv_malloc(n);
+
+    if (p)
+        memcpy(p, s, n);
+    return p;
+}
+
+void rv_dis_free(void *p)
+{
+    rv_free(p);
+}
+
+rv_arena_t *rv_arena_new(size_t block, size_t limit)
+{
+    rv_arena_t *a = calloc(1, sizeof *a);
+
+    if (a == 0)
+        return 0;
+    a->block = block ? block : 1 << 20;
+    a->limit = limit;
+    pthread_mutex_init(&a->lock, 0);
+    return a;
+}
+
+void rv_arena_free(rv_arena_t *a)
+{
+    block_t *b, *next;
+
+    if (a == 0)
+        return;
+    for (b = a->head; b; b = next)
+    {
+        next = b->next;
+        free(b);
+    }
+    pthread_mutex_destroy(&a->lock);
+    free(a);
+}
+
+void rv_arena_reset(rv_arena_t *a)
+{
+    block_t *b;
+
+    for (b = a->head; b; b = b->next)
+        b->used = 0;
+    a->cur = a->head;
+}
+
+size_t rv_arena_used(const rv_arena_t *a)
+{
+    const block_t *b;
+    size_t n = 0;
+
+    for (b = a->head; b; b = b->next)
+        n += b->used;
+    return n;
+}
+
+static size_t arena_round(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// the next block after a reset, or a new one after the current; blocks are
+// only ever appended to, so a reset walks them again in the same order.
+static block_t *arena_block(rv_arena_t *a, size_t need)
+{
+    block_t *b = a->cur ? a->cur->next : a->head;
+    size_t size = need > a->block ? need : a->block;
+
+    while (b && b->size < need)
+        b = b->next;
+    if (b)
+        return a->cur = b;
+    if (a->limit && a->held + size > a->limit)
+        return 0;
+    b = malloc(sizeof *b + size);
+    if (b == 0)
+        return 0;
+    b->size = size;
+    b->used = 0;
+    b->next = 0;
+    if (a->head == 0)
+        a->head = b;
+    else
+    {
+        block_t *t = a->cur ? a->cur : a->head;
+        while (t->next)
+            t = t->next;
+        t->next = b;
+    }
+    a->held += size;
+    return a->cur = b;
+}
+
+static void *arena_take(rv_arena_t *a, size_t size)
+{
+    size_t need = ARENA_HDR + arena_round(size);
+    block_t *b = a->cur;
+    char *p;
+
+    if (size > SIZE_MAX / 2)
+        return 0;
+    if ((b == 0 || b->size - b->used < need) && (b = arena_block(a, need)) == 0)
+        return 0;
+    p = b->data + b->used;
+    b->used += need;
+    *(size_t *)p = size;
+    return p + ARENA_HDR;
+}
+
+static void *arena_alloc(void *ctx, size_t size)
+{
+    rv_arena_t *a = ctx;
+    void *p;
+
+    pthread_mutex_lock(&a->lock);
+    p = arena_take(a, size);
+    pthread_mutex_unlock(&a->lock);
+    return p;
+}
+
+static void *arena_resize(void *ctx, void *p, size_t size)
+{
+    rv_arena_t *a = ctx;
+    size_t old;
+    block_t *b;
+    void *n;
+
+    if (p == 0)
+        return arena_alloc(ctx, size);
+    old = *(size_t *)((char *)p - ARENA_HDR);
+    pthread_mutex_lock(&a->lock);
+    b = a->cur;
+    // the last allocation grows in place
+    if (b && size >= old && size <= SIZE_MAX / 2 && (char *)p + arena_round(old) == b->data + b->used &&
+        b->size - b->used >= arena_round(size) - arena_round(old))
+    {
+        b->used += arena_round(size) - arena_round(old);
+        *(size_t *)((char *)p - ARENA_HDR) = size;
+        pthread_mutex_unlock(&a->lock);
+        return p;
+    }
+    n = arena_take(a, size);
+    pthread_mutex_unlock(&a->lock);
+    // p is this caller's, and its bytes stay put until a reset
+    if (n)
+        memcpy(n, p, old < size ? old : size);
+    return n;
+}
+
+static void arena_release(void *ctx, void *p)
+{
+}
+
+rv_allocator_t rv_arena_allocator(rv_arena_t *a)
+{
+    return (rv_allocator_t){arena_alloc, arena_resize, arena_release, a};
+}
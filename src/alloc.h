@@ -0,0 +1,15 @@
+#ifndef __RV_ALLOC_INT_H
+#define __RV_ALLOC_INT_H
+
+#include "rv-alloc.h"
+
+extern void *rv_malloc(size_t size);
+extern void *rv_calloc(size_t n, size_t size);
+extern void *rv_realloc(void *p, size_t size);
+extern void rv_free(void *p);
+extern char *rv_strdup(const char *s);
+
+// the calling thread's effective allocator into a, 0 when that is malloc.
+extern int rv_alloc_current(rv_allocator_t *a);
+
+#endif // __RV_ALLOC_INT_H
@@ -0,0 +1,228 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-atomic.h"
+#include "rv-cfg.h"
+#include "rv-mem.h"
+#include "alloc.h"
+#include "par.h"
+
+#define ATOMIC_RW (RV_ATOMIC_SET_R | RV_ATOMIC_SET_W)
+
+typedef struct
+{
+    rv_uint64_t head;
+    rv_uint64_t tail;
+} loop_t;
+
+typedef struct
+{
+    rv_atomic_t *a;
+    size_t count;
+} list_t;
+
+typedef struct
+{
+    const rv_image_t *img;
+    const rv_func_t *funcs;
+    size_t nfuncs;
+    list_t *lists; // one per function
+    int failed;
+    atomic_size_t next;
+} job_t;
+
+int rv_atomic_decode(const inst_t *ir, rv_atomic_t *a)
+{
+    rv_mem_t m;
+
+    bzero(a, sizeof *a);
+    a->pc = ir->pc;
+    switch (ir->op)
+    {
+    case RV_FENCE:
+        a->pred = ir->imm.u >> 4 & 15;
+        a->succ = ir->imm.u & 15;
+        a->kind = (ir->imm.u >> 8 & 15) == 8 ? RV_ATOMIC_FENCE_TSO : RV_ATOMIC_FENCE;
+        if (a->kind == RV_ATOMIC_FENCE && (a->pred & ATOMIC_RW) == ATOMIC_RW && (a->succ & ATOMIC_RW) == ATOMIC_RW)
+            a->flags |= RV_ATOMIC_HEAVY;
+        return 1;
+
+    case RV_FENCE_I:
+        a->kind = RV_ATOMIC_FENCE_I;
+        return 1;
+    }
+    if (!rv_mem_access(ir, &m) || !(m.flags & RV_MEM_ATOMIC))
+        return 0;
+    if ((m.flags & (RV_MEM_LOAD | RV_MEM_STORE)) == (RV_MEM_LOAD | RV_MEM_STORE))
+        a->kind = RV_ATOMIC_AMO;
+    else
+        a->kind = m.flags & RV_MEM_LOAD ? RV_ATOMIC_LR : RV_ATOMIC_SC;
+    a->order = ir->mod & 3;
+    a->width = m.width;
+    if (a->order == (RV_ATOMIC_AQ | RV_ATOMIC_RL))
+        a->flags |= RV_ATOMIC_HEAVY;
+    return 1;
+}
+
+static int fence_set(rv_uint8_t set, char *p)
+{
+    static const char letters[] = "iorw";
+    int i, n = 0;
+
+    for (i = 0; i < 4; i++)
+        if (set & (8 >> i))
+            p[n++] = letters[i];
+    if (n == 0)
+        p[n++] = '0';
+    return n;
+}
+
+const char *rv_atomic_order(const rv_atomic_t *a, char *buf, size_t size)
+{
+    static const char *orders[4] = {"relaxed", "release", "acquire", "seq_cst"};
+    char tmp[12];
+    int n;
+
+    switch (a->kind)
+    {
+    case RV_ATOMIC_FENCE:
+        n = fence_set(a->pred, tmp);
+        tmp[n++] = ',';
+        n += fence_set(a->succ, tmp + n);
+        snprintf(buf, size, "%.*s", n, tmp);
+        return buf;
+    case RV_ATOMIC_FENCE_TSO:
+        return "tso";
+    case RV_ATOMIC_FENCE_I:
+        return "fetch";
+    }
+    return orders[a->order & 3];
+}
+
+static int push(list_t *l, size_t *cap, const rv_atomic_t *a)
+{
+    if (l->count == *cap)
+    {
+        size_t ncap = *cap ? *cap * 2 : 16;
+        rv_atomic_t *n = rv_realloc(l->a, ncap * sizeof *n);
+        if (n == 0)
+            return -1;
+        l->a = n;
+        *cap = ncap;
+    }
+    l->a[l->count++] = *a;
+    return 0;
+}
+
+// a back edge to a head inside the function closes a loop; the smallest
+// loop around an atomic is its innermost one.
+static void place(list_t *l, const loop_t *loops, size_t nloops)
+{
+    size_t i, k;
+
+    for (i = 0; i < l->count; i++)
+    {
+        rv_atomic_t *a = &l->a[i];
+        rv_uint64_t best = ~0ull;
+
+        for (k = 0; k < nloops; k++)
+        {
+            if (a->pc < loops[k].head || a->pc > loops[k].tail || loops[k].tail - loops[k].head >= best)
+                continue;
+            best = loops[k].tail - loops[k].head;
+            a->loop = loops[k].head;
+            a->flags |= RV_ATOMIC_LOOP;
+        }
+        if ((a->flags & RV_ATOMIC_LOOP) && (a->flags & RV_ATOMIC_HEAVY))
+            a->flags |= RV_ATOMIC_HOT;
+    }
+}
+
+static void task(void *arg, int id, int nthreads)
+{
+    job_t *j = arg;
+    loop_t *loops = 0;
+    size_t lcap = 0, k;
+
+    while ((k = atomic_fetch_add(&j->next, 1)) < j->nfuncs)
+    {
+        const rv_func_t *f = &j->funcs[k];
+        const rv_section_t *s = rv_image_section(j->img, f->start);
+        list_t *l = &j->lists[k];
+        rv_uint64_t pc = f->start;
+        size_t cap = 0, nloops = 0;
+
+        while (s && s->data && pc < f->end && pc < s->addr + s->size)
+        {
+            rv_uint64_t target;
+            rv_atomic_t a;
+            inst_t ir;
+            int flow, len = rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), &ir, 0);
+
+            if (len == 0)
+                break;
+            flow = rv_flow(&ir, &target);
+            if ((flow == RV_FLOW_BRANCH || flow == RV_FLOW_JUMP) && target <= pc && target >= f->start)
+            {
+                if (nloops == lcap)
+                {
+                    size_t ncap = lcap ? lcap * 2 : 16;
+                    loop_t *n = rv_realloc(loops, ncap * sizeof *n);
+                    if (n == 0)
+                        break;
+                    loops = n;
+                    lcap = ncap;
+                }
+                loops[nloops++] = (loop_t){target, pc};
+            }
+            if (rv_atomic_decode(&ir, &a))
+            {
+                a.func = f->start;
+                if (push(l, &cap, &a) < 0)
+                    j->failed = 1;
+            }
+            pc += len;
+        }
+        place(l, loops, nloops);
+    }
+    rv_free(loops);
+}
+
+rv_atomic_t *rv_atomic_scan(const rv_image_t *img, const rv_func_t *funcs, size_t nfuncs, int nthreads, size_t *count)
+{
+    rv_atomic_t *all = 0;
+    size_t i, n = 0;
+    job_t j;
+
+    *count = 0;
+    bzero(&j, sizeof j);
+    j.img = img;
+    j.funcs = funcs;
+    j.nfuncs = nfuncs;
+    j.lists = rv_calloc(nfuncs ? nfuncs : 1, sizeof *j.lists);
+    if (j.lists == 0)
+        return 0;
+    rv_parallel(rv_nthreads(nthreads), task, &j);
+
+    for (i = 0; i < nfuncs; i++)
+        n += j.lists[i].count;
+    if (!j.failed)
+        all = rv_malloc((n ? n : 1) * sizeof *all);
+    if (all)
+    {
+        n = 0;
+        for (i = 0; i < nfuncs; i++)
+        {
+            if (j.lists[i].count)
+                memcpy(all + n, j.lists[i].a, j.lists[i].count * sizeof *all);
+            n += j.lists[i].count;
+        }
+        *count = n;
+    }
+    for (i = 0; i < nfuncs; i++)
+        rv_free(j.lists[i].a);
+    rv_free(j.lists);
+    return all;
+}
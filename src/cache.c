@@ -0,0 +1,413 @@
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rv-cache.h"
+#include "rv-isa.h"
+#include "alloc.h"
+#include "custom.h"
+#include "hash.h"
+#include "par.h"
+#include "pool.h"
+
+#define CACHE_MAGIC "RVDC"
+#define CACHE_STEP 4096
+#define CACHE_GROUP 64 // checkpoints decoded per task
+
+struct rv_cache
+{
+    rv_uint64_t base;
+    const rv_uint8_t *code;
+    size_t size;
+
+    void *map;
+    size_t map_size;
+    const rv_cache_hdr_t *hdr;
+    const rv_cache_cp_t *cp;
+    const rv_cache_rec_t *rec;
+    const char *pool;
+};
+
+typedef struct
+{
+    rv_cache_rec_t *recs;
+    size_t nrec;
+    size_t cap;
+    char *text;
+    size_t tsize;
+    size_t tcap;
+    int failed;
+} part_t;
+
+typedef struct
+{
+    const rv_index_t *idx;
+    const rv_uint8_t *code;
+    part_t *parts;
+    size_t first; // first group of the batch
+    size_t nparts;
+    atomic_size_t next;
+} batch_t;
+
+// ---------------------------------------------------------------- build
+
+static int part_push(part_t *p, const rv_cache_rec_t *rec, const char *text, size_t n)
+{
+    if (p->nrec == p->cap)
+    {
+        size_t ncap = p->cap ? p->cap * 2 : 1024;
+        rv_cache_rec_t *r = rv_realloc(p->recs, ncap * sizeof *r);
+        if (r == 0)
+            return -1;
+        p->recs = r;
+        p->cap = ncap;
+    }
+    if (p->tsize + n + 1 > p->tcap)
+    {
+        size_t ncap = p->tcap ? p->tcap * 2 : 16384;
+        char *t;
+        while (ncap < p->tsize + n + 1)
+            ncap *= 2;
+        t = rv_realloc(p->text, ncap);
+        if (t == 0)
+            return -1;
+        p->text = t;
+        p->tcap = ncap;
+    }
+    p->recs[p->nrec] = *rec;
+    p->recs[p->nrec].text = p->tsize;
+    p->nrec++;
+    memcpy(p->text + p->tsize, text, n + 1);
+    p->tsize += n + 1;
+    return 0;
+}
+
+static void decode_group(batch_t *b, size_t g, part_t *p)
+{
+    const rv_index_t *idx = b->idx;
+    size_t first = g * CACHE_GROUP;
+    size_t last = first + CACHE_GROUP < idx->count ? first + CACHE_GROUP : idx->count;
+    rv_uint64_t pc = idx->cp[first].pc;
+    rv_uint64_t end = last < idx->count ? idx->cp[last].pc : idx->base + idx->size;
+
+    while (pc < end)
+    {
+        rv_cache_rec_t rec;
+        inst_t ir;
+        mnemonic_t m;
+        char tmp[RV_TEXT_MAX];
+        int len, n;
+
+        len = rv_dis_decode(pc, b->code + (pc - idx->base), idx->size - (pc - idx->base), &ir, &rec.raw);
+        if (len == 0)
+            break;
+        bzero(rec.pad, sizeof rec.pad);
+        rec.pc = pc;
+        rec.len = len;
+        rec.op = ir.op;
+        rec.nargs = rv_disasm(&ir, &m);
+        n = rv_format(&m, tmp, sizeof tmp);
+        rv_mnemonic_free(&m);
+        if (n >= (int)sizeof tmp)
+            n = sizeof tmp - 1;
+        rec.tlen = n;
+        if (part_push(p, &rec, tmp, n) < 0)
+        {
+            p->failed = 1;
+            return;
+        }
+        pc += len;
+    }
+}
+
+static void build_task(void *arg, int id, int n)
+{
+    batch_t *b = arg;
+    size_t k;
+
+    while ((k = atomic_fetch_add(&b->next, 1)) < b->nparts)
+        decode_group(b, b->first + k, &b->parts[k]);
+}
+
+// decodes the image in parallel batches and streams the records in address
+// order, the checkpoint table and header being rewritten at the end.
+int rv_cache_build(const char *path, rv_uint64_t base, const rv_uint8_t *code, size_t size, int nthreads)
+{
+    rv_cache_hdr_t h;
+    rv_cache_cp_t *cps = 0;
+    rv_index_t *idx = 0;
+    rv_pool_t pool;
+    batch_t b;
+    size_t ngroups, g, i, ci = 0;
+    char *tmp_path = 0;
+    FILE *f = 0;
+    int ret = -1;
+
+    bzero(&pool, sizeof pool);
+    bzero(&h, sizeof h);
+    bzero(&b, sizeof b);
+    nthreads = rv_nthreads(nthreads);
+
+    idx = rv_index_build(base, code, size, CACHE_STEP, nthreads);
+    if (idx == 0)
+        goto out;
+    cps = rv_calloc(idx->count ? idx->count : 1, sizeof *cps);
+    b.parts = rv_calloc(nthreads * 4, sizeof *b.parts);
+    tmp_path = rv_malloc(strlen(path) + 5);
+    if (cps == 0 || b.parts == 0 || tmp_path == 0)
+        goto out;
+    for (i = 0; i < idx->count; i++)
+    {
+        cps[i].pc = idx->cp[i].pc;
+        cps[i].offset = idx->cp[i].offset;
+    }
+
+    sprintf(tmp_path, "%s.tmp", path);
+    f = fopen(tmp_path, "wb");
+    if (f == 0)
+        goto out;
+
+    memcpy(h.magic, CACHE_MAGIC, 4);
+    h.version = RV_CACHE_VERSION;
+    h.order = RV_CACHE_ORDER;
+    h.hash = rv_hash64(code, size, rv_isa_seed() ^ rv_custom_seed());
+    h.base = base;
+    h.size = size;
+    h.bytes = idx->bytes;
+    h.step = idx->step;
+    h.ncp = idx->count;
+    h.cp_off = sizeof h;
+    h.rec_off = h.cp_off + h.ncp * sizeof *cps;
+    if (fwrite(&h, sizeof h, 1, f) != 1 || (h.ncp && fwrite(cps, sizeof *cps, h.ncp, f) != h.ncp))
+        goto out;
+
+    b.idx = idx;
+    b.code = code;
+    ngroups = (idx->count + CACHE_GROUP - 1) / CACHE_GROUP;
+    for (g = 0; g < ngroups; g += b.nparts)
+    {
+        size_t k;
+
+        b.first = g;
+        b.nparts = ngroups - g < (size_t)nthreads * 4 ? ngroups - g : (size_t)nthreads * 4;
+        atomic_init(&b.next, 0);
+        rv_parallel(nthreads, build_task, &b);
+
+        for (k = 0; k < b.nparts; k++)
+        {
+            part_t *p = &b.parts[k];
+            if (p->failed)
+                goto out;
+            for (i = 0; i < p->nrec; i++)
+            {
+                rv_cache_rec_t *rec = &p->recs[i];
+                rv_int64_t id = rv_pool_add(&pool, p->text + rec->text, rec->tlen);
+                if (id < 0)
+                    goto out;
+                rec->text = pool.offs[id];
+                while (ci < h.ncp && cps[ci].pc <= rec->pc)
+                    cps[ci++].rec = h.nrec;
+                h.nrec++;
+            }
+            if (p->nrec && fwrite(p->recs, sizeof *p->recs, p->nrec, f) != p->nrec)
+                goto out;
+            p->nrec = 0;
+            p->tsize = 0;
+        }
+    }
+    for (; ci < h.ncp; ci++)
+        cps[ci].rec = h.nrec;
+
+    h.pool_off = h.rec_off + h.nrec * sizeof(rv_cache_rec_t);
+    h.pool_size = pool.size;
+    if (pool.size && fwrite(pool.data, 1, pool.size, f) != pool.size)
+        goto out;
+    if (fseek(f, 0, SEEK_SET) != 0 || fwrite(&h, sizeof h, 1, f) != 1)
+        goto out;
+    if (h.ncp && fwrite(cps, sizeof *cps, h.ncp, f) != h.ncp)
+        goto out;
+    if (fclose(f) != 0)
+    {
+        f = 0;
+        goto out;
+    }
+    f = 0;
+    if (rename(tmp_path, path) == 0)
+        ret = 0;
+
+out:
+    if (f)
+        fclose(f);
+    if (ret < 0 && tmp_path)
+        unlink(tmp_path);
+    for (i = 0; b.parts && i < (size_t)nthreads * 4; i++)
+    {
+        rv_free(b.parts[i].recs);
+        rv_free(b.parts[i].text);
+    }
+    rv_free(b.parts);
+    rv_pool_free(&pool);
+    rv_free(cps);
+    rv_free(tmp_path);
+    rv_index_free(idx);
+    return ret;
+}
+
+// ---------------------------------------------------------------- read
+
+// the counts are bounded by the map size before any offset is computed from
+// them, so a crafted header cannot wrap around to a consistent layout.
+static int cache_check(rv_cache_t *c)
+{
+    const rv_cache_hdr_t *h = c->map;
+    const rv_cache_cp_t *cp;
+    rv_uint64_t i;
+
+    if (c->map_size < sizeof *h || memcmp(h->magic, CACHE_MAGIC, 4) != 0)
+        return -1;
+    if (h->version != RV_CACHE_VERSION || h->order != RV_CACHE_ORDER)
+        return -1;
+    if (h->base != c->base || h->size != c->size || h->step == 0)
+        return -1;
+    if (h->ncp != (h->size + h->step - 1) / h->step)
+        return -1;
+    if (h->ncp > c->map_size / sizeof(rv_cache_cp_t) || h->nrec > c->map_size / sizeof(rv_cache_rec_t) ||
+        h->pool_size > c->map_size)
+        return -1;
+    if (h->cp_off != sizeof *h || h->rec_off != h->cp_off + h->ncp * sizeof(rv_cache_cp_t))
+        return -1;
+    if (h->pool_off != h->rec_off + h->nrec * sizeof(rv_cache_rec_t) || h->pool_off + h->pool_size != c->map_size)
+        return -1;
+    if (h->pool_size && ((const char *)c->map)[c->map_size - 1] != 0)
+        return -1;
+    cp = (const rv_cache_cp_t *)((const char *)c->map + h->cp_off);
+    for (i = 0; i < h->ncp; i++)
+    {
+        if (cp[i].rec > h->nrec || (i && cp[i].rec < cp[i - 1].rec))
+            return -1;
+    }
+    if (h->hash != rv_hash64(c->code, c->size, rv_isa_seed() ^ rv_custom_seed()))
+        return -1;
+
+    c->hdr = h;
+    c->cp = cp;
+    c->rec = (const rv_cache_rec_t *)((const char *)c->map + h->rec_off);
+    c->pool = (const char *)c->map + h->pool_off;
+    return 0;
+}
+
+rv_cache_t *rv_cache_open(const char *path, rv_uint64_t base, const rv_uint8_t *code, size_t size)
+{
+    rv_cache_t *c = rv_calloc(1, sizeof *c);
+    struct stat st;
+    int fd;
+
+    if (c == 0)
+        return 0;
+    c->base = base;
+    c->code = code;
+    c->size = size;
+
+    fd = path ? open(path, O_RDONLY) : -1;
+    if (fd < 0)
+        return c;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        c->map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (c->map == MAP_FAILED)
+            c->map = 0;
+        else
+            c->map_size = st.st_size;
+    }
+    close(fd);
+
+    if (c->map && cache_check(c) < 0)
+    {
+        // stale or foreign: fall back to live disassembly
+        munmap(c->map, c->map_size);
+        c->map = 0;
+        c->map_size = 0;
+    }
+    return c;
+}
+
+void rv_cache_close(rv_cache_t *c)
+{
+    if (c == 0)
+        return;
+    if (c->map)
+        munmap(c->map, c->map_size);
+    rv_free(c);
+}
+
+int rv_cache_valid(const rv_cache_t *c)
+{
+    return c->map != 0;
+}
+
+const rv_cache_rec_t *rv_cache_find(const rv_cache_t *c, rv_uint64_t pc)
+{
+    const rv_cache_hdr_t *h = c->hdr;
+    rv_uint64_t i, r;
+
+    if (c->map == 0 || h->ncp == 0 || pc < h->base || pc >= h->base + h->size)
+        return 0;
+    i = (pc - h->base) / h->step;
+    while (i > 0 && c->cp[i].pc > pc)
+        i--;
+    for (r = c->cp[i].rec; r < h->nrec && c->rec[r].pc + c->rec[r].len <= pc; r++)
+        ;
+    // a record whose text runs past the pool is rendered live instead
+    if (r < h->nrec && c->rec[r].pc <= pc && (rv_uint64_t)c->rec[r].text + c->rec[r].tlen < h->pool_size)
+        return &c->rec[r];
+    return 0;
+}
+
+const char *rv_cache_text(const rv_cache_t *c, const rv_cache_rec_t *rec)
+{
+    if (rec->text >= c->hdr->pool_size)
+        return "";
+    return c->pool + rec->text;
+}
+
+// fills line for the instruction holding pc from the mapped file when valid,
+// line->text then pointing into the map. otherwise the instruction starting
+// at pc is rendered live into buf. returns the instruction length, 0 when pc
+// is outside the image.
+int rv_cache_line(const rv_cache_t *c, rv_uint64_t pc, rv_line_t *line, char *buf, size_t size)
+{
+    const rv_cache_rec_t *rec = rv_cache_find(c, pc);
+    inst_t ir;
+    mnemonic_t m;
+    int len, n;
+
+    bzero(line, sizeof *line);
+    if (rec)
+    {
+        line->pc = rec->pc;
+        line->raw = rec->raw;
+        line->len = rec->len;
+        line->tlen = rec->tlen;
+        line->text = (char *)rv_cache_text(c, rec);
+        return rec->len;
+    }
+
+    if (pc < c->base || pc >= c->base + c->size)
+        return 0;
+    len = rv_dis_decode(pc, c->code + (pc - c->base), c->size - (pc - c->base), &ir, &line->raw);
+    if (len == 0)
+        return 0;
+    rv_disasm(&ir, &m);
+    n = rv_format(&m, buf, size);
+    rv_mnemonic_free(&m);
+    line->pc = pc;
+    line->len = len;
+    line->tlen = n < (int)size ? n : (int)size - 1;
+    line->text = buf;
+    return len;
+}
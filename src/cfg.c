@@ -0,0 +1,683 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-op.h"
+#include "alloc.h"
+#include "cfg.h"
+#include "par.h"
+
+#define CFG_TASK_WORDS 4096 // bitmap words per block-forming task
+
+typedef _Atomic rv_uint64_t abits_t;
+
+// one bit per halfword of an executable section
+typedef struct
+{
+    const rv_section_t *s;
+    abits_t *seen;   // an instruction was decoded here
+    abits_t *lead;   // a block starts here
+    abits_t *queued; // already pushed to a worklist
+    abits_t *fresh;  // a block starts here since the last rv_walk_cfg()
+    size_t nwords;
+} secmap_t;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    rv_uint64_t *items;
+    size_t top;
+    size_t bottom;
+    size_t cap;
+} deque_t;
+
+typedef struct rv_walk
+{
+    const rv_image_t *img;
+    secmap_t *maps;
+    size_t nmaps;
+    deque_t *dq;
+    int nthreads;
+    atomic_size_t pending;
+    atomic_int failed;
+} walk_t;
+
+typedef struct
+{
+    secmap_t *m;
+    size_t w0;
+    size_t w1;
+    rv_block_t *blocks;
+    size_t nblocks;
+    size_t bcap;
+    rv_edge_t *edges;
+    size_t nedges;
+    size_t ecap;
+    int failed;
+} task_t;
+
+typedef struct
+{
+    walk_t *w;
+    task_t *tasks;
+    size_t ntasks;
+    atomic_size_t next;
+} form_t;
+
+typedef struct
+{
+    const rv_block_t *b;
+    const rv_edge_t *e; // its edges
+} ref_t;
+
+// ---------------------------------------------------------------- bitmaps
+
+static int test_and_set(abits_t *bits, size_t i)
+{
+    rv_uint64_t mask = 1ull << (i & 63);
+    return (atomic_fetch_or_explicit(&bits[i >> 6], mask, memory_order_relaxed) & mask) != 0;
+}
+
+static int test(abits_t *bits, size_t i)
+{
+    return (atomic_load_explicit(&bits[i >> 6], memory_order_relaxed) >> (i & 63)) & 1;
+}
+
+static void mark_lead(secmap_t *m, size_t i)
+{
+    if (!test_and_set(m->lead, i))
+        test_and_set(m->fresh, i);
+}
+
+static secmap_t *find_map(const walk_t *w, rv_uint64_t pc)
+{
+    size_t lo = 0, hi = w->nmaps;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        const rv_section_t *s = w->maps[mid].s;
+        if (pc < s->addr)
+            hi = mid;
+        else if (pc >= s->addr + s->size)
+            lo = mid + 1;
+        else
+            return &w->maps[mid];
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------- worklists
+
+static int dq_push(deque_t *d, rv_uint64_t a)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom == d->cap)
+    {
+        if (d->top > 0)
+        {
+            memmove(d->items, d->items + d->top, (d->bottom - d->top) * sizeof *d->items);
+            d->bottom -= d->top;
+            d->top = 0;
+        }
+        else
+        {
+            size_t ncap = d->cap ? d->cap * 2 : 256;
+            rv_uint64_t *n = rv_realloc(d->items, ncap * sizeof *n);
+            if (n == 0)
+                ret = -1;
+            else
+            {
+                d->items = n;
+                d->cap = ncap;
+            }
+        }
+    }
+    if (ret == 0)
+        d->items[d->bottom++] = a;
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+// the owner works depth first from the bottom, thieves take the oldest
+// entries from the top.
+static int dq_take(deque_t *d, rv_uint64_t *a, int steal)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top)
+    {
+        *a = steal ? d->items[d->top++] : d->items[--d->bottom];
+        found = 1;
+        if (d->top == d->bottom)
+            d->top = d->bottom = 0;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static void push(walk_t *w, int id, rv_uint64_t a)
+{
+    secmap_t *m = find_map(w, a);
+    size_t bit;
+
+    if (m == 0 || (a & 1))
+        return;
+    bit = (a - m->s->addr) >> 1;
+    mark_lead(m, bit);
+    if (test_and_set(m->queued, bit))
+        return;
+    atomic_fetch_add(&w->pending, 1);
+    if (dq_push(&w->dq[id], a) < 0)
+    {
+        atomic_store(&w->failed, 1);
+        atomic_fetch_sub(&w->pending, 1);
+    }
+}
+
+// a word nothing decodes is data: the walk does not run past it.
+static int walk_flow(const inst_t *ir, rv_uint64_t *target)
+{
+    if (ir->op == RV_UNDEF && rv_dis_op(ir) == RV_OP_NONE)
+        return RV_FLOW_STOP;
+    return rv_flow(ir, target);
+}
+
+// decodes linearly from a until control flow leaves, claiming instructions
+// so that no two workers decode the same bytes. Running into an instruction
+// another trace claimed makes it a block start.
+static void trace(walk_t *w, int id, rv_uint64_t pc)
+{
+    secmap_t *m = 0;
+
+    for (;;)
+    {
+        const rv_section_t *s;
+        rv_uint64_t target = 0;
+        inst_t ir;
+        int len;
+
+        if (m == 0 || pc >= m->s->addr + m->s->size)
+            m = find_map(w, pc);
+        if (m == 0)
+            return;
+        s = m->s;
+        if (test_and_set(m->seen, (pc - s->addr) >> 1))
+        {
+            mark_lead(m, (pc - s->addr) >> 1);
+            return;
+        }
+        len = rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), &ir, 0);
+        if (len == 0)
+            return;
+
+        switch (walk_flow(&ir, &target))
+        {
+        case RV_FLOW_NONE:
+            pc += len;
+            continue;
+
+        case RV_FLOW_BRANCH:
+        case RV_FLOW_CALL:
+            push(w, id, target);
+            push(w, id, pc + len);
+            return;
+
+        case RV_FLOW_JUMP:
+            push(w, id, target);
+            return;
+
+        case RV_FLOW_ICALL:
+            push(w, id, pc + len);
+            return;
+
+        default:
+            return;
+        }
+    }
+}
+
+static void walk_task(void *arg, int id, int n)
+{
+    walk_t *w = arg;
+    rv_uint64_t a;
+    int k;
+
+    for (;;)
+    {
+        int found = dq_take(&w->dq[id], &a, 0);
+
+        for (k = 1; !found && k < n; k++)
+            found = dq_take(&w->dq[(id + k) % n], &a, 1);
+        if (!found)
+        {
+            if (atomic_load(&w->pending) == 0)
+                return;
+            sched_yield();
+            continue;
+        }
+        trace(w, id, a);
+        atomic_fetch_sub(&w->pending, 1);
+    }
+}
+
+// ---------------------------------------------------------------- blocks
+
+static int add_block(task_t *t, const rv_block_t *b)
+{
+    if (t->nblocks == t->bcap)
+    {
+        size_t ncap = t->bcap ? t->bcap * 2 : 256;
+        rv_block_t *n = rv_realloc(t->blocks, ncap * sizeof *n);
+        if (n == 0)
+            return -1;
+        t->blocks = n;
+        t->bcap = ncap;
+    }
+    t->blocks[t->nblocks++] = *b;
+    return 0;
+}
+
+static int add_edge(task_t *t, rv_block_t *b, rv_uint64_t target, int kind)
+{
+    if (t->nedges == t->ecap)
+    {
+        size_t ncap = t->ecap ? t->ecap * 2 : 512;
+        rv_edge_t *n = rv_realloc(t->edges, ncap * sizeof *n);
+        if (n == 0)
+            return -1;
+        t->edges = n;
+        t->ecap = ncap;
+    }
+    bzero(&t->edges[t->nedges], sizeof *t->edges);
+    t->edges[t->nedges].target = target;
+    t->edges[t->nedges].from = t->nblocks;
+    t->edges[t->nedges].to = RV_CFG_NONE;
+    t->edges[t->nedges].kind = kind;
+    t->nedges++;
+    b->nedges++;
+    return 0;
+}
+
+static int form_block(task_t *t, rv_uint64_t start)
+{
+    secmap_t *m = t->m;
+    const rv_section_t *s = m->s;
+    rv_uint64_t pc = start, target = 0;
+    rv_block_t b;
+    int err = 0;
+
+    bzero(&b, sizeof b);
+    b.start = start;
+    b.edge = t->nedges;
+
+    for (;;)
+    {
+        inst_t ir;
+        rv_uint64_t next;
+        int len = rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), &ir, 0);
+
+        if (len == 0)
+            break;
+        b.ninsn++;
+        next = pc + len;
+        b.flow = walk_flow(&ir, &target);
+        switch (b.flow)
+        {
+        case RV_FLOW_BRANCH:
+            err |= add_edge(t, &b, target, RV_EDGE_BRANCH);
+            err |= add_edge(t, &b, next, RV_EDGE_FALL);
+            break;
+
+        case RV_FLOW_JUMP:
+            err |= add_edge(t, &b, target, RV_EDGE_JUMP);
+            break;
+
+        case RV_FLOW_CALL:
+            err |= add_edge(t, &b, target, RV_EDGE_CALL);
+            err |= add_edge(t, &b, next, RV_EDGE_FALL);
+            break;
+
+        case RV_FLOW_ICALL:
+            err |= add_edge(t, &b, next, RV_EDGE_FALL);
+            break;
+        }
+        if (b.flow != RV_FLOW_NONE)
+        {
+            pc = next;
+            break;
+        }
+
+        pc = next;
+        if (pc >= s->addr + s->size || !test(m->seen, (pc - s->addr) >> 1))
+            break;
+        if (test(m->lead, (pc - s->addr) >> 1))
+        {
+            err |= add_edge(t, &b, pc, RV_EDGE_FALL);
+            break;
+        }
+    }
+    if (b.ninsn == 0)
+        return 0;
+    b.size = pc - start;
+    return err | add_block(t, &b);
+}
+
+static void form_task(void *arg, int id, int n)
+{
+    form_t *f = arg;
+    size_t k;
+
+    while ((k = atomic_fetch_add(&f->next, 1)) < f->ntasks)
+    {
+        task_t *t = &f->tasks[k];
+        size_t wi;
+
+        for (wi = t->w0; wi < t->w1 && !t->failed; wi++)
+        {
+            rv_uint64_t bits = atomic_load_explicit(&t->m->fresh[wi], memory_order_relaxed);
+            while (bits)
+            {
+                size_t bit = wi * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                if (form_block(t, t->m->s->addr + bit * 2) < 0)
+                {
+                    t->failed = 1;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------- api
+
+void rv_walk_free(walk_t *w)
+{
+    size_t i;
+
+    if (w == 0)
+        return;
+    for (i = 0; w->maps && i < w->nmaps; i++)
+    {
+        rv_free(w->maps[i].seen);
+        rv_free(w->maps[i].lead);
+        rv_free(w->maps[i].queued);
+        rv_free(w->maps[i].fresh);
+    }
+    for (i = 0; w->dq && i < (size_t)w->nthreads; i++)
+    {
+        pthread_mutex_destroy(&w->dq[i].lock);
+        rv_free(w->dq[i].items);
+    }
+    rv_free(w->maps);
+    rv_free(w->dq);
+    rv_free(w);
+}
+
+walk_t *rv_walk_new(const rv_image_t *img, int nthreads)
+{
+    walk_t *w = rv_calloc(1, sizeof *w);
+    size_t i;
+
+    if (w == 0)
+        return 0;
+    w->img = img;
+    w->nthreads = rv_nthreads(nthreads);
+    atomic_init(&w->pending, 0);
+    atomic_init(&w->failed, 0);
+    w->maps = rv_calloc(img->nsections ? img->nsections : 1, sizeof *w->maps);
+    w->dq = rv_calloc(w->nthreads, sizeof *w->dq);
+    if (w->maps == 0 || w->dq == 0)
+    {
+        rv_free(w->maps);
+        rv_free(w->dq);
+        rv_free(w);
+        return 0;
+    }
+    for (i = 0; i < (size_t)w->nthreads; i++)
+        pthread_mutex_init(&w->dq[i].lock, 0);
+
+    for (i = 0; i < img->nsections; i++)
+    {
+        secmap_t *m = &w->maps[w->nmaps];
+        if (!img->sections[i].exec || img->sections[i].size == 0)
+            continue;
+        m->s = &img->sections[i];
+        m->nwords = ((m->s->size + 1) / 2 + 63) / 64;
+        m->seen = rv_calloc(m->nwords, sizeof *m->seen);
+        m->lead = rv_calloc(m->nwords, sizeof *m->lead);
+        m->queued = rv_calloc(m->nwords, sizeof *m->queued);
+        m->fresh = rv_calloc(m->nwords, sizeof *m->fresh);
+        w->nmaps++;
+        if (!m->seen || !m->lead || !m->queued || !m->fresh)
+        {
+            rv_walk_free(w);
+            return 0;
+        }
+    }
+    return w;
+}
+
+int rv_walk_add(walk_t *w, const rv_uint64_t *entries, size_t nentries)
+{
+    const rv_image_t *img = w->img;
+    size_t i;
+
+    // seed the worklists round robin
+    if (entries == 0)
+    {
+        push(w, 0, img->entry);
+        for (i = 0; i < img->nsymbols; i++)
+            push(w, i % w->nthreads, img->symbols[i].addr);
+    }
+    for (i = 0; i < nentries; i++)
+        push(w, i % w->nthreads, entries[i]);
+    rv_parallel(w->nthreads, walk_task, w);
+    return atomic_load(&w->failed) ? -1 : 0;
+}
+
+static int cmp_target(const void *a, const void *b)
+{
+    rv_uint64_t x = *(const rv_uint64_t *)a;
+    const rv_block_t *y = b;
+    return x < y->start ? -1 : x > y->start;
+}
+
+static int cmp_ref(const void *a, const void *b)
+{
+    const ref_t *x = a, *y = b;
+    return x->b->start < y->b->start ? -1 : x->b->start > y->b->start;
+}
+
+static void resolve_task(void *arg, int id, int n)
+{
+    rv_cfg_t *cfg = arg;
+    size_t i;
+
+    for (i = id; i < cfg->nedges; i += n)
+    {
+        rv_edge_t *e = &cfg->edges[i];
+        const rv_block_t *b = bsearch(&e->target, cfg->blocks, cfg->nblocks, sizeof *b, cmp_target);
+        e->to = b ? b - cfg->blocks : RV_CFG_NONE;
+    }
+}
+
+// a block start found since the last forming lies inside b.
+static int split(const walk_t *w, const rv_block_t *b)
+{
+    secmap_t *m = find_map(w, b->start);
+    size_t i, end = (b->start + b->size - m->s->addr) >> 1;
+
+    for (i = ((b->start - m->s->addr) >> 1) + 1; i < end; i++)
+    {
+        if (test(m->fresh, i))
+            return 1;
+    }
+    return 0;
+}
+
+int rv_walk_cfg(walk_t *w, rv_cfg_t *cfg)
+{
+    rv_block_t *blocks = 0;
+    rv_edge_t *edges = 0;
+    ref_t *refs = 0;
+    task_t redo;
+    form_t f;
+    size_t i, j, nb = 0, ne = 0, nrefs = 0;
+    int ret = -1;
+
+    bzero(&f, sizeof f);
+    bzero(&redo, sizeof redo);
+    for (i = 0; i < w->nmaps; i++)
+        f.ntasks += (w->maps[i].nwords + CFG_TASK_WORDS - 1) / CFG_TASK_WORDS;
+    f.tasks = rv_calloc(f.ntasks ? f.ntasks : 1, sizeof *f.tasks);
+    if (f.tasks == 0)
+        goto out;
+    for (i = 0, j = 0; i < w->nmaps; i++)
+    {
+        size_t wi;
+        for (wi = 0; wi < w->maps[i].nwords; wi += CFG_TASK_WORDS, j++)
+        {
+            f.tasks[j].m = &w->maps[i];
+            f.tasks[j].w0 = wi;
+            f.tasks[j].w1 = wi + CFG_TASK_WORDS < w->maps[i].nwords ? wi + CFG_TASK_WORDS : w->maps[i].nwords;
+        }
+    }
+    f.w = w;
+    atomic_init(&f.next, 0);
+    rv_parallel(w->nthreads, form_task, &f);
+
+    for (i = 0; i < f.ntasks; i++)
+    {
+        if (f.tasks[i].failed)
+            goto out;
+        nb += f.tasks[i].nblocks;
+    }
+    refs = rv_malloc((cfg->nblocks + nb ? cfg->nblocks + nb : 1) * sizeof *refs);
+    if (refs == 0)
+        goto out;
+
+    // old blocks stay unless a new block start splits them
+    for (i = 0; i < cfg->nblocks; i++)
+    {
+        const rv_block_t *b = &cfg->blocks[i];
+        if (split(w, b))
+        {
+            redo.m = find_map(w, b->start);
+            if (form_block(&redo, b->start) < 0)
+                goto out;
+            continue;
+        }
+        refs[nrefs].b = b;
+        refs[nrefs++].e = cfg->edges + b->edge;
+    }
+    for (i = 0; i < redo.nblocks; i++)
+    {
+        refs[nrefs].b = &redo.blocks[i];
+        refs[nrefs++].e = redo.edges + redo.blocks[i].edge;
+    }
+    for (i = 0; i < f.ntasks; i++)
+    {
+        task_t *t = &f.tasks[i];
+        for (j = 0; j < t->nblocks; j++)
+        {
+            refs[nrefs].b = &t->blocks[j];
+            refs[nrefs++].e = t->edges + t->blocks[j].edge;
+        }
+    }
+    // the tasks alone are already in address order
+    if (cfg->nblocks)
+        qsort(refs, nrefs, sizeof *refs, cmp_ref);
+
+    for (i = 0, ne = 0; i < nrefs; i++)
+        ne += refs[i].b->nedges;
+    blocks = rv_malloc((nrefs ? nrefs : 1) * sizeof *blocks);
+    edges = rv_malloc((ne ? ne : 1) * sizeof *edges);
+    if (blocks == 0 || edges == 0)
+        goto out;
+    for (i = 0, ne = 0; i < nrefs; i++)
+    {
+        blocks[i] = *refs[i].b;
+        blocks[i].edge = ne;
+        for (j = 0; j < blocks[i].nedges; j++, ne++)
+        {
+            edges[ne] = refs[i].e[j];
+            edges[ne].from = i;
+        }
+    }
+    rv_free(cfg->blocks);
+    rv_free(cfg->edges);
+    cfg->blocks = blocks;
+    cfg->nblocks = nrefs;
+    cfg->edges = edges;
+    cfg->nedges = ne;
+    blocks = 0;
+    edges = 0;
+    rv_parallel(w->nthreads, resolve_task, cfg);
+
+    for (i = 0; i < w->nmaps; i++)
+        bzero(w->maps[i].fresh, w->maps[i].nwords * sizeof *w->maps[i].fresh);
+    ret = 0;
+
+out:
+    for (i = 0; f.tasks && i < f.ntasks; i++)
+    {
+        rv_free(f.tasks[i].blocks);
+        rv_free(f.tasks[i].edges);
+    }
+    rv_free(f.tasks);
+    rv_free(redo.blocks);
+    rv_free(redo.edges);
+    rv_free(refs);
+    rv_free(blocks);
+    rv_free(edges);
+    return ret;
+}
+
+rv_cfg_t *rv_cfg_build(const rv_image_t *img, const rv_uint64_t *entries, size_t nentries, int nthreads)
+{
+    rv_walk_t *w = rv_walk_new(img, nthreads);
+    rv_cfg_t *cfg = rv_calloc(1, sizeof *cfg);
+
+    if (w == 0 || cfg == 0 || rv_walk_add(w, entries, nentries) < 0 || rv_walk_cfg(w, cfg) < 0)
+    {
+        rv_cfg_free(cfg);
+        cfg = 0;
+    }
+    rv_walk_free(w);
+    return cfg;
+}
+
+void rv_cfg_free(rv_cfg_t *cfg)
+{
+    if (cfg == 0)
+        return;
+    rv_free(cfg->blocks);
+    rv_free(cfg->edges);
+    rv_free(cfg);
+}
+
+// index of the block holding pc, RV_CFG_NONE if none.
+rv_uint32_t rv_cfg_find(const rv_cfg_t *cfg, rv_uint64_t pc)
+{
+    size_t lo = 0, hi = cfg->nblocks;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        const rv_block_t *b = &cfg->blocks[mid];
+        if (pc < b->start)
+            hi = mid;
+        else if (pc >= b->start + b->size)
+            lo = mid + 1;
+        else
+            return mid;
+    }
+    return RV_CFG_NONE;
+}
@@ -0,0 +1,18 @@
+#ifndef __RV_CFG_INT_H
+#define __RV_CFG_INT_H
+
+#include "rv-cfg.h"
+
+// a traversal that can be resumed from more entries. Each rv_walk_cfg()
+// extends cfg with what the walk found since the previous call, forming
+// only the new blocks and the old ones a new block start splits.
+typedef struct rv_walk rv_walk_t;
+
+extern rv_walk_t *rv_walk_new(const rv_image_t *img, int nthreads);
+extern void rv_walk_free(rv_walk_t *w);
+
+// entries as for rv_cfg_build().
+extern int rv_walk_add(rv_walk_t *w, const rv_uint64_t *entries, size_t nentries);
+extern int rv_walk_cfg(rv_walk_t *w, rv_cfg_t *cfg);
+
+#endif // __RV_CFG_INT_H
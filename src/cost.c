@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-cfg.h"
+#include "rv-cost.h"
+#include "rv-mem.h"
+#include "rv-op.h"
+#include "alloc.h"
+#include "hash.h"
+
+#define COST_NSRC 4
+#define COST_NREGS 96 // x0-x31, f0-f31 then v0-v31
+
+typedef struct
+{
+    rv_uint16_t lat;
+    rv_uint16_t rthru;
+    rv_uint32_t ports;
+} entry_t;
+
+typedef struct
+{
+    char *name;
+    entry_t e;
+} op_t;
+
+struct rv_model
+{
+    int width;
+    int nports;
+    char *ports[RV_COST_PORTS];
+    entry_t cls[RV_COST_NCLASS];
+    op_t *ops; // open addressing on the mnemonic
+    size_t mask;
+    size_t nops;
+};
+
+typedef struct
+{
+    entry_t e;
+    int dst; // -1 for none
+    int src[COST_NSRC];
+    int nsrc;
+} uop_t;
+
+static const char *class_names[RV_COST_NCLASS] = {"alu", "load", "store", "branch", "fp"};
+
+// ---------------------------------------------------------------- model
+
+static op_t *op_slot(const rv_model_t *model, const char *name)
+{
+    size_t i = rv_hash64(name, strlen(name), 0) & model->mask;
+
+    while (model->ops[i].name && strcmp(model->ops[i].name, name) != 0)
+        i = (i + 1) & model->mask;
+    return &model->ops[i];
+}
+
+static int op_add(rv_model_t *model, const char *name, const entry_t *e)
+{
+    op_t *slot;
+
+    if ((model->nops + 1) * 2 > model->mask + 1)
+    {
+        op_t *old = model->ops;
+        size_t i, n = model->mask + 1;
+
+        model->ops = rv_calloc(n * 2, sizeof *model->ops);
+        if (model->ops == 0)
+        {
+            model->ops = old;
+            return -1;
+        }
+        model->mask = n * 2 - 1;
+        for (i = 0; i < n; i++)
+        {
+            if (old[i].name)
+                *op_slot(model, old[i].name) = old[i];
+        }
+        rv_free(old);
+    }
+    slot = op_slot(model, name);
+    if (slot->name == 0)
+    {
+        slot->name = rv_strdup(name);
+        if (slot->name == 0)
+            return -1;
+        model->nops++;
+    }
+    slot->e = *e;
+    return 0;
+}
+
+static rv_model_t *model_new(void)
+{
+    rv_model_t *model = rv_calloc(1, sizeof *model);
+    int i;
+
+    if (model == 0)
+        return 0;
+    model->mask = 63;
+    model->ops = rv_calloc(model->mask + 1, sizeof *model->ops);
+    if (model->ops == 0)
+    {
+        rv_free(model);
+        return 0;
+    }
+    model->width = 1;
+    for (i = 0; i < RV_COST_NCLASS; i++)
+    {
+        model->cls[i].lat = 1;
+        model->cls[i].rthru = 1;
+        model->cls[i].ports = 1;
+    }
+    return model;
+}
+
+void rv_model_free(rv_model_t *model)
+{
+    size_t i;
+
+    if (model == 0)
+        return;
+    for (i = 0; i <= model->mask; i++)
+        rv_free(model->ops[i].name);
+    for (i = 0; i < (size_t)model->nports; i++)
+        rv_free(model->ports[i]);
+    rv_free(model->ops);
+    rv_free(model);
+}
+
+static int find_port(const rv_model_t *model, const char *name)
+{
+    int i;
+
+    for (i = 0; i < model->nports; i++)
+    {
+        if (strcmp(model->ports[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// "<latency> <rthroughput> <port>..." from the strtok_r state.
+static int parse_entry(const rv_model_t *model, entry_t *e, char **save)
+{
+    char *lat = strtok_r(0, " \t", save), *thr = strtok_r(0, " \t", save), *p;
+
+    if (lat == 0 || thr == 0)
+        return -1;
+    e->lat = atoi(lat);
+    e->rthru = atoi(thr);
+    e->ports = 0;
+    while ((p = strtok_r(0, " \t", save)) != 0)
+    {
+        int i = find_port(model, p);
+        if (i < 0)
+            return -1;
+        e->ports |= 1u << i;
+    }
+    if (e->ports == 0 || e->rthru == 0)
+        return -1;
+    return 0;
+}
+
+rv_model_t *rv_model_load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    rv_model_t *model;
+    char line[256];
+
+    if (f == 0)
+        return 0;
+    model = model_new();
+    while (model && fgets(line, sizeof line, f))
+    {
+        char *key, *name, *save;
+        entry_t e;
+        int i, err = 0;
+
+        line[strcspn(line, "#\r\n")] = 0;
+        key = strtok_r(line, " \t", &save);
+        if (key == 0)
+            continue;
+        name = strtok_r(0, " \t", &save);
+        if (name == 0)
+            err = 1;
+        else if (strcmp(key, "width") == 0)
+            err = (model->width = atoi(name)) <= 0;
+        else if (strcmp(key, "port") == 0)
+        {
+            err = model->nports == RV_COST_PORTS || find_port(model, name) >= 0;
+            if (!err)
+                err = (model->ports[model->nports++] = rv_strdup(name)) == 0;
+        }
+        else if (strcmp(key, "class") == 0)
+        {
+            for (i = 0; i < RV_COST_NCLASS && strcmp(class_names[i], name) != 0; i++)
+                ;
+            err = i == RV_COST_NCLASS || parse_entry(model, &model->cls[i], &save) < 0;
+        }
+        else if (strcmp(key, "op") == 0)
+            err = parse_entry(model, &e, &save) < 0 || op_add(model, name, &e) < 0;
+        else
+            err = 1;
+
+        if (err)
+        {
+            rv_model_free(model);
+            model = 0;
+        }
+    }
+    fclose(f);
+    if (model && model->nports == 0)
+    {
+        rv_model_free(model);
+        model = 0;
+    }
+    return model;
+}
+
+// a single issue in-order core, one cycle for everything but memory and
+// multiply/divide.
+rv_model_t *rv_model_default(void)
+{
+    static const struct
+    {
+        const char *name;
+        rv_uint16_t lat, rthru;
+    } ops[] = {
+        {"mul", 3, 1}, {"mulh", 3, 1}, {"mulhu", 3, 1}, {"mulhsu", 3, 1}, {"mulw", 3, 1},
+        {"div", 20, 20}, {"divu", 20, 20}, {"rem", 20, 20}, {"remu", 20, 20},
+        {"divw", 20, 20}, {"divuw", 20, 20}, {"remw", 20, 20}, {"remuw", 20, 20},
+    };
+    rv_model_t *model = model_new();
+    size_t i;
+
+    if (model == 0)
+        return 0;
+    model->ports[0] = rv_strdup("pipe");
+    if (model->ports[0] == 0)
+    {
+        rv_model_free(model);
+        return 0;
+    }
+    model->nports = 1;
+    model->cls[RV_COST_LOAD].lat = 3;
+    model->cls[RV_COST_FP].lat = 4;
+    for (i = 0; i < sizeof ops / sizeof *ops; i++)
+    {
+        entry_t e = {ops[i].lat, ops[i].rthru, 1};
+        if (op_add(model, ops[i].name, &e) < 0)
+        {
+            rv_model_free(model);
+            return 0;
+        }
+    }
+    return model;
+}
+
+const char *rv_model_port(const rv_model_t *model, int port)
+{
+    return port >= 0 && port < model->nports ? model->ports[port] : 0;
+}
+
+// ---------------------------------------------------------------- uops
+
+static int reg_index(const rv_arg_t *a)
+{
+    if (a->kind == RV_ARG_FREG)
+        return 32 + a->reg;
+    if (a->kind == RV_ARG_VREG)
+        return 64 + a->reg;
+    if ((a->kind == RV_ARG_REG || a->kind == RV_ARG_MEM) && a->reg != 0)
+        return a->reg;
+    return -1;
+}
+
+// the typed operands give def/use: the first register is written unless the
+// instruction stores or branches. sc writes its status to rd.
+static void make_uop(const rv_model_t *model, const inst_t *in, uop_t *u)
+{
+    inst_t ir = *in;
+    rv_uint64_t target;
+    mnemonic_t m;
+    rv_mem_t mem;
+    const op_t *op;
+    int cls = RV_COST_ALU, i, defs = 1;
+
+    rv_disasm(&ir, &m);
+    if (rv_mem_access(&ir, &mem))
+    {
+        cls = mem.flags & RV_MEM_LOAD ? RV_COST_LOAD : RV_COST_STORE;
+        defs = cls == RV_COST_LOAD || (mem.flags & RV_MEM_ATOMIC);
+    }
+    else if (rv_dis_op(&ir) > RV_OP_CUSTOM && ((ir.imm.u & 0x7f) == 0x07 || (ir.imm.u & 0x7f) == 0x27))
+    {
+        // vector loads and stores
+        cls = (ir.imm.u & 0x7f) == 0x07 ? RV_COST_LOAD : RV_COST_STORE;
+        defs = cls == RV_COST_LOAD;
+    }
+    else if (rv_flow(&ir, &target) != RV_FLOW_NONE)
+    {
+        cls = RV_COST_BRANCH;
+        defs = ir.op == RV_JAL || ir.op == RV_JALR;
+    }
+
+    u->dst = -1;
+    u->nsrc = 0;
+    for (i = 0; i < 5; i++)
+    {
+        int r = reg_index(&m.arg[i]);
+        if (m.arg[i].kind == RV_ARG_FREG && cls == RV_COST_ALU)
+            cls = RV_COST_FP;
+        if (r < 0)
+            continue;
+        if (defs && u->dst < 0 && m.arg[i].kind != RV_ARG_MEM && i == 0)
+            u->dst = r;
+        else if (u->nsrc < COST_NSRC)
+            u->src[u->nsrc++] = r;
+    }
+
+    op = m.op ? op_slot(model, m.op) : 0;
+    u->e = op && op->name ? op->e : model->cls[cls];
+    rv_mnemonic_free(&m);
+}
+
+// ---------------------------------------------------------------- simulation
+
+int rv_cost_block(const rv_model_t *model, const inst_t *ins, size_t n, rv_cost_t *cost)
+{
+    rv_uint64_t ready[COST_NREGS], port_free[RV_COST_PORTS], last[RV_COST_ITERS];
+    double pressure[RV_COST_PORTS], width_bound, port_bound = 0;
+    rv_uint64_t cycle = 0, end = 0;
+    uop_t *u;
+    size_t i, k;
+    int used = 0, p;
+
+    bzero(cost, sizeof *cost);
+    if (n == 0)
+        return 0;
+    u = rv_malloc(n * sizeof *u);
+    if (u == 0)
+        return -1;
+    bzero(pressure, sizeof pressure);
+    for (i = 0; i < n; i++)
+    {
+        make_uop(model, &ins[i], &u[i]);
+        for (p = 0; p < model->nports; p++)
+        {
+            if (u[i].e.ports & (1u << p))
+                pressure[p] += (double)u[i].e.rthru / __builtin_popcount(u[i].e.ports);
+        }
+    }
+
+    bzero(ready, sizeof ready);
+    bzero(port_free, sizeof port_free);
+    for (k = 0; k < RV_COST_ITERS; k++)
+    {
+        for (i = 0; i < n; i++)
+        {
+            const uop_t *x = &u[i];
+            rv_uint64_t t = cycle, best = ~0ull;
+            int j, port = 0;
+
+            // in order, width per cycle, operands ready, then a free port
+            if (used == model->width)
+                t = cycle + 1;
+            for (j = 0; j < x->nsrc; j++)
+            {
+                if (ready[x->src[j]] > t)
+                    t = ready[x->src[j]];
+            }
+            for (p = 0; p < model->nports; p++)
+            {
+                rv_uint64_t f = port_free[p] > t ? port_free[p] : t;
+                if ((x->e.ports & (1u << p)) && f < best)
+                {
+                    best = f;
+                    port = p;
+                }
+            }
+            t = best;
+            port_free[port] = t + x->e.rthru;
+            used = t == cycle ? used + 1 : 1;
+            cycle = t;
+            if (x->dst >= 0)
+                ready[x->dst] = t + x->e.lat;
+            if (t + x->e.lat > end)
+                end = t + x->e.lat;
+        }
+        last[k] = cycle;
+        if (k == 0)
+            cost->latency = end;
+    }
+
+    cost->ninsn = n;
+    cost->cycles = (double)(last[RV_COST_ITERS - 1] - last[RV_COST_ITERS / 2 - 1]) / (RV_COST_ITERS / 2);
+    if (cost->cycles < (double)n / model->width)
+        cost->cycles = (double)n / model->width;
+    cost->ipc = n / cost->cycles;
+
+    width_bound = (double)n / model->width;
+    cost->bound = RV_COST_DEPS;
+    for (p = 0; p < model->nports; p++)
+    {
+        if (pressure[p] > port_bound)
+        {
+            port_bound = pressure[p];
+            cost->port = p;
+        }
+    }
+    if (port_bound >= cost->cycles * 0.95 && port_bound >= width_bound)
+        cost->bound = RV_COST_PORT;
+    else if (width_bound >= cost->cycles * 0.95)
+        cost->bound = RV_COST_WIDTH;
+    rv_free(u);
+    return 0;
+}
+
+int rv_cost_range(const rv_model_t *model, rv_uint64_t base, const rv_uint8_t *code, size_t size, rv_uint64_t lo, rv_uint64_t hi, rv_cost_t *cost)
+{
+    inst_t *ins = 0;
+    size_t n = 0, cap = 0;
+    rv_uint64_t pc;
+    int ret;
+
+    if (lo < base)
+        lo = base;
+    if (hi > base + size)
+        hi = base + size;
+    for (pc = lo; pc < hi;)
+    {
+        int len;
+        if (n == cap)
+        {
+            size_t ncap = cap ? cap * 2 : 64;
+            inst_t *t = rv_realloc(ins, ncap * sizeof *t);
+            if (t == 0)
+            {
+                rv_free(ins);
+                return -1;
+            }
+            ins = t;
+            cap = ncap;
+        }
+        len = rv_dis_decode(pc, code + (pc - base), size - (pc - base), &ins[n], 0);
+        if (len == 0)
+            break;
+        n++;
+        pc += len;
+    }
+    ret = rv_cost_block(model, ins, n, cost);
+    rv_free(ins);
+    return ret;
+}
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-isa.h"
+#include "alloc.h"
+#include "custom.h"
+#include "hash.h"
+
+enum
+{
+    FIELD_RD,
+    FIELD_RS1,
+    FIELD_RS2,
+    FIELD_RS3,
+    FIELD_FD,
+    FIELD_FS1,
+    FIELD_FS2,
+    FIELD_FS3,
+    FIELD_VD,
+    FIELD_VS1,
+    FIELD_VS2,
+    FIELD_IMM,
+    FIELD_UIMM,
+    FIELD_SIMM,
+    FIELD_SHAMT,
+    FIELD_MEM,
+    FIELD_SMEM,
+    FIELD_COUNT,
+};
+
+typedef struct
+{
+    rv_custom_t c;
+    rv_uint8_t fields[5];
+    int nfields;
+    int bits; // set bits of the mask
+} entry_t;
+
+static const char *field_names[FIELD_COUNT] = {
+    "rd", "rs1", "rs2", "rs3", "fd", "fs1", "fs2", "fs3", "vd", "vs1", "vs2", "imm", "uimm", "simm", "shamt", "mem", "smem",
+};
+
+static entry_t *entries;
+static size_t cap;
+static rv_uint32_t *slots;                // entry indices grouped by dispatch key
+static rv_uint32_t first[RV_ISA_KEYS + 1]; // slots of key k are [first[k], first[k + 1])
+
+size_t rv_custom_count;
+
+static int parse_layout(const char *s, entry_t *e)
+{
+    while (s && *s)
+    {
+        size_t n = strcspn(s, ","), k;
+
+        for (k = 0; k < FIELD_COUNT; k++)
+            if (strlen(field_names[k]) == n && strncmp(s, field_names[k], n) == 0)
+                break;
+        if (k == FIELD_COUNT || e->nfields == 5)
+            return -1;
+        e->fields[e->nfields++] = k;
+        s += n + (s[n] == ',');
+    }
+    return 0;
+}
+
+// the bits every encoding under key shares, and their value.
+static rv_uint32_t key_bits(int key, rv_uint32_t *value)
+{
+    if (key < 32)
+    {
+        *value = key >> 3 | (key & 7) << 13;
+        return 0xe003;
+    }
+    *value = (key - 32) >> 3 << 2 | 3 | (key & 7) << 12;
+    return 0x707f;
+}
+
+static int cmp_slot(const void *a, const void *b)
+{
+    rv_uint32_t x = *(const rv_uint32_t *)a, y = *(const rv_uint32_t *)b;
+
+    if (entries[x].bits != entries[y].bits)
+        return entries[x].bits > entries[y].bits ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+// an entry goes in the bucket of every key its pattern is compatible with;
+// most have all key bits in their mask and land in exactly one.
+static int rebuild(size_t count)
+{
+    rv_uint32_t *s, value, bits;
+    size_t n = 0, i;
+    int k;
+
+    for (k = 0; k < RV_ISA_KEYS; k++)
+    {
+        bits = key_bits(k, &value);
+        for (i = 0; i < count; i++)
+            n += ((value ^ entries[i].c.match) & entries[i].c.mask & bits) == 0;
+    }
+    s = rv_malloc((n ? n : 1) * sizeof *s);
+    if (s == 0)
+        return -1;
+    for (k = 0, n = 0; k < RV_ISA_KEYS; k++)
+    {
+        first[k] = n;
+        bits = key_bits(k, &value);
+        for (i = 0; i < count; i++)
+            if (((value ^ entries[i].c.match) & entries[i].c.mask & bits) == 0)
+                s[n++] = i;
+        qsort(s + first[k], n - first[k], sizeof *s, cmp_slot);
+    }
+    first[k] = n;
+    rv_free(slots);
+    slots = s;
+    rv_custom_count = count;
+    return 0;
+}
+
+int rv_custom_register(const rv_custom_t *c)
+{
+    entry_t e;
+
+    bzero(&e, sizeof e);
+    e.c = *c;
+    e.c.match &= c->mask;
+    e.bits = __builtin_popcount(c->mask);
+    if (c->fmt == 0 && (c->name == 0 || parse_layout(c->layout, &e) < 0))
+        return -1;
+    if (rv_custom_count == cap)
+    {
+        size_t ncap = cap ? cap * 2 : 16;
+        entry_t *n = rv_realloc(entries, ncap * sizeof *n);
+        if (n == 0)
+            return -1;
+        entries = n;
+        cap = ncap;
+    }
+    entries[rv_custom_count] = e;
+    return rebuild(rv_custom_count + 1);
+}
+
+void rv_custom_clear(void)
+{
+    rv_custom_count = 0;
+    rv_free(slots);
+    rv_free(entries);
+    slots = 0;
+    entries = 0;
+    cap = 0;
+}
+
+rv_uint64_t rv_custom_seed(void)
+{
+    rv_uint64_t h = 0;
+    size_t i;
+
+    for (i = 0; i < rv_custom_count; i++)
+    {
+        const rv_custom_t *c = &entries[i].c;
+
+        h = rv_hash_mix(h, (rv_uint64_t)c->match << 32 | c->mask);
+        h = rv_hash_mix(h, c->name ? rv_hash64(c->name, strlen(c->name), 0) : 0);
+        h = rv_hash_mix(h, c->layout ? rv_hash64(c->layout, strlen(c->layout), 0) : 0);
+    }
+    return h;
+}
+
+static const entry_t *lookup(rv_uint32_t raw)
+{
+    int k = rv_isa_key(raw);
+    rv_uint32_t i;
+
+    for (i = first[k]; i < first[k + 1]; i++)
+        if ((raw & entries[slots[i]].c.mask) == entries[slots[i]].c.match)
+            return &entries[slots[i]];
+    return 0;
+}
+
+int rv_custom_decode(rv_uint32_t raw, inst_t *ir)
+{
+    if (lookup(raw) == 0)
+        return 0;
+    ir->op = RV_UNDEF;
+    ir->uimm = RV_OP_CUSTOM;
+    ir->imm.u = raw;
+    ir->rd = raw >> 7 & 31;
+    ir->rs1 = raw >> 15 & 31;
+    ir->rs2 = raw >> 20 & 31;
+    ir->rs3 = raw >> 27;
+    return 1;
+}
+
+static rv_arg_t field_arg(int field, rv_uint32_t raw)
+{
+    rv_int64_t i = ((rv_int64_t)(raw ^ 0x80000000u) - 0x80000000) >> 20;
+    rv_int64_t s = (i & ~31ll) | (raw >> 7 & 31);
+
+    switch (field)
+    {
+    case FIELD_RD:
+    case FIELD_RS1:
+    case FIELD_RS2:
+    case FIELD_RS3:
+    case FIELD_FD:
+    case FIELD_FS1:
+    case FIELD_FS2:
+    case FIELD_FS3:
+    case FIELD_VD:
+    case FIELD_VS1:
+    case FIELD_VS2:
+    {
+        static const rv_uint8_t kinds[3] = {RV_ARG_REG, RV_ARG_FREG, RV_ARG_VREG};
+        static const rv_uint8_t shifts[4] = {7, 15, 20, 27};
+        int k = field - FIELD_RD, kind = k < 4 ? 0 : k < 8 ? 1 : 2, pos = k < 8 ? k & 3 : k - 8;
+        return (rv_arg_t){kinds[kind], raw >> shifts[pos] & 31, 0};
+    }
+    case FIELD_IMM:
+        return (rv_arg_t){RV_ARG_IMM, 0, i};
+    case FIELD_UIMM:
+        return (rv_arg_t){RV_ARG_IMM, 0, raw >> 20};
+    case FIELD_SIMM:
+        return (rv_arg_t){RV_ARG_IMM, 0, s};
+    case FIELD_SHAMT:
+        return (rv_arg_t){RV_ARG_IMM, 0, raw >> 20 & 31};
+    case FIELD_MEM:
+        return (rv_arg_t){RV_ARG_MEM, raw >> 15 & 31, i};
+    }
+    return (rv_arg_t){RV_ARG_MEM, raw >> 15 & 31, s};
+}
+
+static char *render(const rv_arg_t *a)
+{
+    char tmp[64];
+
+    switch (a->kind)
+    {
+    case RV_ARG_REG:
+        return rv_strdup(rv_reg2name(a->reg));
+    case RV_ARG_FREG:
+        return rv_strdup(rv_freg2name(a->reg));
+    case RV_ARG_VREG:
+        snprintf(tmp, sizeof tmp, "v%d", a->reg & 31);
+        break;
+    case RV_ARG_MEM:
+        snprintf(tmp, sizeof tmp, "%lld(%s)", a->imm, rv_reg2name(a->reg));
+        break;
+    case RV_ARG_CSR:
+        return rv_strdup(rv_csr2name(a->imm));
+    default:
+        snprintf(tmp, sizeof tmp, "%lld", a->imm);
+    }
+    return rv_strdup(tmp);
+}
+
+int rv_custom_disasm(const inst_t *ir, mnemonic_t *m)
+{
+    const entry_t *e = lookup(ir->imm.u);
+    const char *op = e ? e->c.name : 0;
+    rv_arg_t args[5];
+    int i, n = -1;
+
+    bzero(m, sizeof *m);
+    bzero(args, sizeof args);
+    if (e && e->c.fmt)
+        n = e->c.fmt(e->c.arg, ir->imm.u, &op, args);
+    else if (e)
+        for (n = 0; n < e->nfields; n++)
+            args[n] = field_arg(e->fields[n], ir->imm.u);
+    if (n < 0 || n > 5 || op == 0)
+    {
+        m->op = rv_strdup("undef");
+        return 0;
+    }
+    m->op = rv_strdup(op);
+    for (i = 0; i < n; i++)
+    {
+        m->arg[i] = args[i];
+        m->args[i] = render(&args[i]);
+    }
+    return n;
+}
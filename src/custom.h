@@ -0,0 +1,13 @@
+#ifndef __RV_CUSTOM_INT_H
+#define __RV_CUSTOM_INT_H
+
+#include "rv-custom.h"
+
+extern size_t rv_custom_count; // registered plug-ins, 0 keeps decoding on the built-in path
+
+// 0 without plug-ins; keys listings rendered with them, like rv_isa_seed().
+extern rv_uint64_t rv_custom_seed(void);
+extern int rv_custom_decode(rv_uint32_t raw, inst_t *ir);
+extern int rv_custom_disasm(const inst_t *ir, mnemonic_t *m);
+
+#endif // __RV_CUSTOM_INT_H
@@ -0,0 +1,51 @@
+#include <string.h>
+
+#include "rv-isa.h"
+#include "custom.h"
+#include "op.h"
+
+// decodes the instruction found at code and returns its length in bytes,
+// or 0 when size is too short to hold it. Instructions outside the isa
+// profile decode as RV_UNDEF, as do, tagged in ir->uimm, those of the op
+// table and those a plug-in claimed. rv-op.def is looked up before the
+// decoder and holds every ratified bitmanip and crypto encoding; the
+// decoder's other ops in that space are drafts and decode as RV_UNDEF.
+// Plug-ins only see what both leave undefined.
+int rv_dis_decode_isa(const rv_isa_t *isa, rv_uint64_t pc, const rv_uint8_t *code, size_t size, inst_t *ir, rv_uint32_t *raw)
+{
+    rv_uint32_t w;
+    int len = 2;
+
+    if (size < 2)
+        return 0;
+    w = code[0] | (rv_uint32_t)code[1] << 8;
+    if ((w & 3) == 3)
+    {
+        if (size < 4)
+            return 0;
+        w |= (rv_uint32_t)code[2] << 16 | (rv_uint32_t)code[3] << 24;
+        len = 4;
+    }
+
+    bzero(ir, sizeof *ir);
+    if (len == 2 || !rv_op_decode(pc, w, isa ? isa->xlen : 64, ir))
+    {
+        rv_decode(pc, w, ir);
+        if (len == 4 && (rv_ext_class(w) == RV_EXT_B || rv_ext_class(w) == RV_EXT_K))
+            ir->op = RV_UNDEF;
+        if (ir->op == RV_UNDEF)
+            ir->uimm = 0;
+    }
+    if (rv_custom_count && ir->op == RV_UNDEF && ir->uimm == 0 && rv_custom_decode(w, ir))
+        isa = 0; // plug-ins are not subject to the profile
+    if (isa)
+        rv_isa_apply(isa, w, ir);
+    if (raw)
+        *raw = w;
+    return len;
+}
+
+int rv_dis_decode(rv_uint64_t pc, const rv_uint8_t *code, size_t size, inst_t *ir, rv_uint32_t *raw)
+{
+    return rv_dis_decode_isa(rv_isa_current(), pc, code, size, ir, raw);
+}
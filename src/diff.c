@@ -0,0 +1,418 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-cfg.h"
+#include "rv-diff.h"
+#include "alloc.h"
+#include "hash.h"
+#include "par.h"
+
+#define DIFF_CELLS (1 << 22) // larger lcs tables fall back to replacing it all
+#define DIFF_TEXT 96
+
+typedef struct
+{
+    const rv_image_t *img;
+    const rv_func_t *funcs;
+    size_t count;
+    rv_uint64_t *hash;
+    atomic_size_t next;
+} job_t;
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint64_t hash;
+    char text[DIFF_TEXT];
+} line_t;
+
+typedef struct
+{
+    const rv_image_t *img;
+    const rv_func_t *f;
+    const char *name;
+    size_t i;
+} name_key_t;
+
+static const char *func_name(const rv_image_t *img, const rv_func_t *f)
+{
+    const rv_symbol_t *sym = rv_image_symbol(img, f->start);
+    return sym && sym->addr == f->start ? sym->name : 0;
+}
+
+// pc relative target as text: an offset from the function start when it is
+// inside, a symbol when there is one, else nothing that depends on layout.
+static int symbolize(const rv_image_t *img, const rv_func_t *f, rv_uint64_t target, char *buf, size_t size)
+{
+    const rv_symbol_t *sym;
+
+    if (target >= f->start && target < f->end)
+        return snprintf(buf, size, ".+0x%llx", target - f->start);
+    sym = rv_image_symbol(img, target);
+    if (sym == 0)
+        return snprintf(buf, size, "?");
+    if (sym->addr == target)
+        return snprintf(buf, size, "<%.64s>", sym->name);
+    return snprintf(buf, size, "<%.64s+0x%llx>", sym->name, target - sym->addr);
+}
+
+// address formed by auipc and the instruction using it as a base.
+static int pcrel(const inst_t *prev, const inst_t *ir, rv_uint64_t *target)
+{
+    if (prev == 0 || prev->op != RV_AUIPC || prev->rd == 0 || prev->rd != ir->rs1)
+        return 0;
+    *target = prev->pc + prev->imm.i + ir->imm.i;
+    return 1;
+}
+
+static int relative(const inst_t *prev, const inst_t *ir, rv_uint64_t *target)
+{
+    int flow = rv_flow(ir, target);
+    if (flow == RV_FLOW_BRANCH || flow == RV_FLOW_JUMP || flow == RV_FLOW_CALL)
+        return 1;
+    return pcrel(prev, ir, target);
+}
+
+static void norm_line(const rv_image_t *img, const rv_func_t *f, const inst_t *prev, inst_t *ir, line_t *l)
+{
+    rv_uint64_t target;
+    int rel = relative(prev, ir, &target);
+    size_t n;
+    mnemonic_t m;
+    int i;
+
+    rv_disasm(ir, &m);
+    n = snprintf(l->text, sizeof l->text, "%s", m.op);
+    for (i = 0; i < 5 && m.args[i] && n < sizeof l->text; i++)
+    {
+        const rv_arg_t *arg = &m.arg[i];
+        const char *sep = i ? "," : "\t";
+        char sym[96];
+
+        if (ir->op == RV_AUIPC && arg->kind == RV_ARG_IMM)
+            n += snprintf(l->text + n, sizeof l->text - n, "%s%%pcrel", sep);
+        else if (rel && arg->kind == RV_ARG_IMM)
+        {
+            symbolize(img, f, target, sym, sizeof sym);
+            n += snprintf(l->text + n, sizeof l->text - n, "%s%s", sep, sym);
+            rel = 0;
+        }
+        else if (rel && arg->kind == RV_ARG_MEM)
+        {
+            symbolize(img, f, target, sym, sizeof sym);
+            n += snprintf(l->text + n, sizeof l->text - n, "%s%s(%s)", sep, sym, rv_reg2name(arg->reg));
+            rel = 0;
+        }
+        else
+            n += snprintf(l->text + n, sizeof l->text - n, "%s%s", sep, m.args[i]);
+    }
+    rv_mnemonic_free(&m);
+    l->pc = ir->pc;
+    l->hash = rv_hash64(l->text, strnlen(l->text, sizeof l->text), 0);
+}
+
+// register fields a form does not use carry immediate bits, so pc relative
+// instructions hash as their symbolized text.
+static rv_uint64_t inst_hash(const rv_image_t *img, const rv_func_t *f, const inst_t *prev, const inst_t *ir)
+{
+    rv_uint64_t regs = ir->rd | ir->rs1 << 8 | ir->rs2 << 16 | (rv_uint64_t)ir->rs3 << 24 | (rv_uint64_t)ir->mod << 32;
+    rv_uint64_t target;
+    inst_t copy = *ir;
+    line_t l;
+
+    if (ir->op != RV_AUIPC && !relative(prev, ir, &target))
+        return rv_hash_mix(rv_hash_mix(rv_hash_mix(ir->op, regs), ir->imm.u), ir->uimm);
+    norm_line(img, f, prev, &copy, &l);
+    return rv_hash_mix(ir->op, l.hash);
+}
+
+static size_t decode(const rv_image_t *img, const rv_func_t *f, inst_t **ins, size_t *cap)
+{
+    const rv_section_t *s = rv_image_section(img, f->start);
+    rv_uint64_t pc = f->start;
+    size_t n = 0;
+
+    if (s == 0 || s->data == 0)
+        return 0;
+    while (pc < f->end && pc < s->addr + s->size)
+    {
+        int len;
+        if (n == *cap)
+        {
+            size_t ncap = *cap ? *cap * 2 : 256;
+            inst_t *t = rv_realloc(*ins, ncap * sizeof *t);
+            if (t == 0)
+                break;
+            *ins = t;
+            *cap = ncap;
+        }
+        len = rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), &(*ins)[n], 0);
+        if (len == 0)
+            break;
+        n++;
+        pc += len;
+    }
+    return n;
+}
+
+static void hash_task(void *arg, int id, int nthreads)
+{
+    job_t *j = arg;
+    inst_t *ins = 0;
+    size_t cap = 0, k, i, n;
+
+    while ((k = atomic_fetch_add(&j->next, 1)) < j->count)
+    {
+        const rv_func_t *f = &j->funcs[k];
+        rv_uint64_t h;
+
+        n = decode(j->img, f, &ins, &cap);
+        h = n;
+        for (i = 0; i < n; i++)
+            h = rv_hash_mix(h, inst_hash(j->img, f, i ? &ins[i - 1] : 0, &ins[i]));
+        j->hash[k] = rv_hash64(&h, sizeof h, n);
+    }
+    rv_free(ins);
+}
+
+rv_uint64_t *rv_diff_hash(const rv_image_t *img, const rv_func_t *funcs, size_t count, int nthreads)
+{
+    job_t j;
+
+    bzero(&j, sizeof j);
+    j.img = img;
+    j.funcs = funcs;
+    j.count = count;
+    j.hash = rv_malloc((count ? count : 1) * sizeof *j.hash);
+    if (j.hash == 0)
+        return 0;
+    rv_parallel(rv_nthreads(nthreads), hash_task, &j);
+    return j.hash;
+}
+
+// ---------------------------------------------------------------- match
+
+static int cmp_name(const void *x, const void *y)
+{
+    const name_key_t *a = x, *b = y;
+    return strcmp(a->name, b->name);
+}
+
+static int cmp_hash(const void *x, const void *y)
+{
+    rv_uint64_t a = *(const rv_uint64_t *)x, b = *(const rv_uint64_t *)y;
+    return a < b ? -1 : a > b;
+}
+
+// first unused entry equal to key among the sorted ones.
+static size_t pick(const void *base, size_t n, size_t size, const void *key, int (*cmp)(const void *, const void *), const char *used,
+                   size_t (*index)(const void *))
+{
+    const char *p = bsearch(key, base, n, size, cmp);
+
+    if (p == 0)
+        return RV_DIFF_NONE;
+    while (p > (const char *)base && cmp(p - size, key) == 0)
+        p -= size;
+    for (; p < (const char *)base + n * size && cmp(p, key) == 0; p += size)
+        if (!used[index(p)])
+            return index(p);
+    return RV_DIFF_NONE;
+}
+
+static size_t key_index(const void *p)
+{
+    return ((const name_key_t *)p)->i;
+}
+
+// hash keys are (hash, index) pairs compared on the hash only.
+static size_t hash_index(const void *p)
+{
+    return ((const rv_uint64_t *)p)[1];
+}
+
+// true when no function of [lo, hi) has a name or, with used, is matched.
+static int unnamed(const rv_image_t *img, const rv_func_t *funcs, size_t lo, size_t hi, const char *used)
+{
+    for (; lo < hi; lo++)
+        if (func_name(img, &funcs[lo]) || (used && used[lo]))
+            return 0;
+    return 1;
+}
+
+rv_match_t *rv_diff_match(const rv_image_t *a, const rv_func_t *fa, const rv_uint64_t *ha, size_t na, const rv_image_t *b,
+                          const rv_func_t *fb, const rv_uint64_t *hb, size_t nb, size_t *count)
+{
+    rv_match_t *m = rv_malloc((na + nb + 1) * sizeof *m);
+    name_key_t *names = rv_malloc((nb + 1) * sizeof *names);
+    rv_uint64_t *hashes = rv_malloc((nb + 1) * 2 * sizeof *hashes);
+    char *used = rv_calloc(nb + 1, 1);
+    size_t i, k, ga, gb, nnames = 0, nhashes = 0, n = 0;
+
+    *count = 0;
+    if (m == 0 || names == 0 || hashes == 0 || used == 0)
+    {
+        rv_free(m);
+        m = 0;
+        goto out;
+    }
+    for (i = 0; i < nb; i++)
+    {
+        const char *name = func_name(b, &fb[i]);
+        if (name)
+            names[nnames++] = (name_key_t){b, &fb[i], name, i};
+    }
+    qsort(names, nnames, sizeof *names, cmp_name);
+
+    for (i = 0; i < na; i++)
+    {
+        name_key_t key = {a, &fa[i], func_name(a, &fa[i]), i};
+
+        m[i] = (rv_match_t){i, RV_DIFF_NONE, RV_DIFF_REMOVED};
+        if (key.name == 0 || (k = pick(names, nnames, sizeof *names, &key, cmp_name, used, key_index)) == RV_DIFF_NONE)
+            continue;
+        used[k] = 1;
+        m[i].b = k;
+        m[i].kind = ha[i] == hb[k] ? RV_DIFF_SAME : RV_DIFF_CHANGED;
+    }
+
+    // what is left pairs by hash
+    for (i = 0; i < nb; i++)
+    {
+        if (used[i])
+            continue;
+        hashes[nhashes * 2] = hb[i];
+        hashes[nhashes * 2 + 1] = i;
+        nhashes++;
+    }
+    qsort(hashes, nhashes, 2 * sizeof *hashes, cmp_hash);
+    for (i = 0; i < na; i++)
+    {
+        if (m[i].kind != RV_DIFF_REMOVED)
+            continue;
+        k = pick(hashes, nhashes, 2 * sizeof *hashes, &ha[i], cmp_hash, used, hash_index);
+        if (k == RV_DIFF_NONE)
+            continue;
+        used[k] = 1;
+        m[i].b = k;
+        m[i].kind = RV_DIFF_MOVED;
+    }
+
+    // unnamed runs left between the same two matched neighbours in both
+    // images pair up in order when they are as long, which is how edited
+    // functions of a stripped image are found.
+    for (i = 0, ga = 0, gb = 0; i <= na; i++)
+    {
+        size_t bi;
+
+        if (i < na && m[i].kind == RV_DIFF_REMOVED)
+            continue;
+        bi = i < na ? m[i].b : nb;
+        if (i > ga && bi >= gb && i - ga == bi - gb && unnamed(a, fa, ga, i, 0) && unnamed(b, fb, gb, bi, used))
+            for (k = 0; k < i - ga; k++)
+            {
+                used[gb + k] = 1;
+                m[ga + k].b = gb + k;
+                m[ga + k].kind = RV_DIFF_CHANGED;
+            }
+        ga = i + 1;
+        gb = bi + 1;
+    }
+
+    n = na;
+    for (i = 0; i < nb; i++)
+        if (!used[i])
+            m[n++] = (rv_match_t){RV_DIFF_NONE, i, RV_DIFF_ADDED};
+    *count = n;
+
+out:
+    rv_free(names);
+    rv_free(hashes);
+    rv_free(used);
+    return m;
+}
+
+// ---------------------------------------------------------------- diff
+
+static line_t *lines(const rv_image_t *img, const rv_func_t *f, size_t *count)
+{
+    inst_t *ins = 0;
+    size_t cap = 0, i, n = decode(img, f, &ins, &cap);
+    line_t *l = rv_malloc((n ? n : 1) * sizeof *l);
+
+    *count = 0;
+    if (l)
+    {
+        for (i = 0; i < n; i++)
+            norm_line(img, f, i ? &ins[i - 1] : 0, &ins[i], &l[i]);
+        *count = n;
+    }
+    rv_free(ins);
+    return l;
+}
+
+static int put(rv_sink_t *sink, char sign, const line_t *l)
+{
+    char *p = rv_sink_reserve(sink, DIFF_TEXT + 32);
+
+    if (p == 0)
+        return -1;
+    rv_sink_commit(sink, sprintf(p, "%c\t%llx\t%.*s\n", sign, l->pc, DIFF_TEXT, l->text));
+    return 0;
+}
+
+// longest common subsequence over the lines left once the common prefix
+// and suffix are trimmed.
+static int lcs(rv_sink_t *sink, const line_t *a, size_t na, const line_t *b, size_t nb)
+{
+    rv_uint32_t *t;
+    size_t i, j, w = nb + 1;
+    int ret = 0;
+
+    if ((na + 1) * w > DIFF_CELLS || (t = rv_calloc((na + 1) * w, sizeof *t)) == 0)
+    {
+        for (i = 0; i < na && ret == 0; i++)
+            ret = put(sink, '-', &a[i]);
+        for (j = 0; j < nb && ret == 0; j++)
+            ret = put(sink, '+', &b[j]);
+        return ret;
+    }
+    for (i = na; i-- > 0;)
+        for (j = nb; j-- > 0;)
+        {
+            rv_uint32_t x = t[(i + 1) * w + j], y = t[i * w + j + 1];
+            t[i * w + j] = a[i].hash == b[j].hash ? t[(i + 1) * w + j + 1] + 1 : x > y ? x : y;
+        }
+    for (i = 0, j = 0; (i < na || j < nb) && ret == 0;)
+    {
+        if (i < na && j < nb && a[i].hash == b[j].hash)
+            i++, j++;
+        else if (j == nb || (i < na && t[(i + 1) * w + j] >= t[i * w + j + 1]))
+            ret = put(sink, '-', &a[i++]);
+        else
+            ret = put(sink, '+', &b[j++]);
+    }
+    rv_free(t);
+    return ret;
+}
+
+int rv_diff_func(rv_sink_t *sink, const rv_image_t *a, const rv_func_t *fa, const rv_image_t *b, const rv_func_t *fb)
+{
+    size_t na, nb, lo = 0;
+    line_t *la = lines(a, fa, &na), *lb = lines(b, fb, &nb);
+    int ret = -1;
+
+    if (la && lb)
+    {
+        while (lo < na && lo < nb && la[lo].hash == lb[lo].hash)
+            lo++;
+        while (na > lo && nb > lo && la[na - 1].hash == lb[nb - 1].hash)
+            na--, nb--;
+        ret = lcs(sink, la + lo, na - lo, lb + lo, nb - lo);
+    }
+    rv_free(la);
+    rv_free(lb);
+    return ret;
+}
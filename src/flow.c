@@ -0,0 +1,59 @@
+#include "rv-cfg.h"
+
+static int is_link(rv_uint8_t r)
+{
+    return r == 1 || r == 5;
+}
+
+// classifies ir by its effect on control flow; target is set for direct
+// transfers.
+int rv_flow(const inst_t *ir, rv_uint64_t *target)
+{
+    switch (ir->op)
+    {
+    default:
+        return RV_FLOW_NONE;
+
+    case RV_JAL:
+    case RV_C_JAL:
+        *target = ir->pc + ir->imm.i;
+        return ir->rd == 0 && ir->op == RV_JAL ? RV_FLOW_JUMP : RV_FLOW_CALL;
+
+    case RV_C_J:
+        *target = ir->pc + ir->imm.i;
+        return RV_FLOW_JUMP;
+
+    case RV_JALR:
+        if (ir->rd == 0 && ir->imm.i == 0 && is_link(ir->rs1))
+            return RV_FLOW_RET;
+        return ir->rd == 0 ? RV_FLOW_IJUMP : RV_FLOW_ICALL;
+
+    case RV_C_JR:
+        return is_link(ir->rs1) ? RV_FLOW_RET : RV_FLOW_IJUMP;
+
+    case RV_C_JALR:
+        return RV_FLOW_ICALL;
+
+    case RV_BEQ:
+    case RV_BNE:
+    case RV_BLT:
+    case RV_BGE:
+    case RV_BLTU:
+    case RV_BGEU:
+    case RV_C_BEQZ:
+    case RV_C_BNEZ:
+        *target = ir->pc + ir->imm.i;
+        return RV_FLOW_BRANCH;
+
+    case RV_MRET:
+    case RV_SRET:
+    case RV_URET:
+    case RV_DRET:
+        return RV_FLOW_RET;
+
+    case RV_EBREAK:
+    case RV_C_EBREAK:
+    case RV_C_UNIMP:
+        return RV_FLOW_STOP;
+    }
+}
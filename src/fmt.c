@@ -1,8 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 
-#include "rv-dis.h"
+#include "rv-csr.h"
+#include "rv-isa.h"
+#include "alloc.h"
+#include "custom.h"
+#include "rv-op.h"
 
 const char *rounding_mods[] = {
     "rne",
@@ -15,44 +20,83 @@ const char *rounding_mods[] = {
     0,
 };
 
+// addresses and upper immediates wrap at xlen
+static rv_int64_t xlen_imm(int xlen, rv_int64_t imm)
+{
+    return xlen == 32 ? (rv_int64_t)(rv_uint32_t)imm : imm;
+}
+
+// rv_csr2name() for an explicit xlen; unknown numbers go to tmp.
+static const char *csr_name(int xlen, rv_uint64_t csr, char *tmp, size_t size)
+{
+    const rv_csr_t *c = rv_csr_info_xlen(csr, xlen);
+
+    if (c)
+        return c->name;
+    snprintf(tmp, size, "0x%llx", csr);
+    return tmp;
+}
+
 static int emit_op(mnemonic_t *m, const char *op, ...)
 {
     va_list ap;
     int i;
 
     bzero(m, sizeof *m);
-    m->op = strdup(op);
+    m->op = rv_strdup(op);
     va_start(ap, op);
-    for (i = 0; i < 6; i++)
+    for (i = 0; i < 5; i++)
     {
         char *arg = va_arg(ap, char *);
         if (arg == 0)
             break;
-        m->args[i] = strdup(arg);
+        m->args[i] = rv_strdup(arg);
     }
     va_end(ap);
     return i;
 }
 
+static void set_arg(mnemonic_t *m, int i, rv_uint8_t kind, rv_uint8_t reg, rv_int64_t imm)
+{
+    m->arg[i].kind = kind;
+    m->arg[i].reg = reg;
+    m->arg[i].imm = imm;
+}
+
 static int emit_op_i(mnemonic_t *m, const char *name, rv_int64_t imm)
 {
     char tmp_imm[64];
     snprintf(tmp_imm, sizeof tmp_imm, "%lld", imm);
-    return emit_op(m, name, tmp_imm, 0);
+    int n = emit_op(m, name, tmp_imm, 0);
+    set_arg(m, 0, RV_ARG_IMM, 0, imm);
+    return n;
 }
 
-static int emit_op_x(mnemonic_t *m, const char *name, rv_int64_t imm)
+static int emit_op_x(mnemonic_t *m, int xlen, const char *name, rv_int64_t imm)
 {
+    imm = xlen_imm(xlen, imm);
     char tmp_imm[64];
     snprintf(tmp_imm, sizeof tmp_imm, "0x%llx", imm);
-    return emit_op(m, name, tmp_imm, 0);
+    int n = emit_op(m, name, tmp_imm, 0);
+    set_arg(m, 0, RV_ARG_IMM, 0, imm);
+    return n;
+}
+
+static int emit_op_r(mnemonic_t *m, const char *name, rv_uint8_t r)
+{
+    int n = emit_op(m, name, rv_reg2name(r), 0);
+    set_arg(m, 0, RV_ARG_REG, r, 0);
+    return n;
 }
 
 static int emit_op_rr(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2)
 {
     const char *tmp_r1 = rv_reg2name(r1);
     const char *tmp_r2 = rv_reg2name(r2);
-    return emit_op(m, name, tmp_r1, tmp_r2, 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, 0);
+    set_arg(m, 0, RV_ARG_REG, r1, 0);
+    set_arg(m, 1, RV_ARG_REG, r2, 0);
+    return n;
 }
 
 static int emit_op_ri(mnemonic_t *m, const char *name, rv_uint8_t r, rv_int64_t imm)
@@ -60,15 +104,22 @@ static int emit_op_ri(mnemonic_t *m, const char *name, rv_uint8_t r, rv_int64_t
     const char *tmp_r = rv_reg2name(r);
     char tmp_imm[64];
     snprintf(tmp_imm, sizeof tmp_imm, "%lld", imm);
-    return emit_op(m, name, tmp_r, tmp_imm, 0);
+    int n = emit_op(m, name, tmp_r, tmp_imm, 0);
+    set_arg(m, 0, RV_ARG_REG, r, 0);
+    set_arg(m, 1, RV_ARG_IMM, 0, imm);
+    return n;
 }
 
-static int emit_op_rx(mnemonic_t *m, const char *name, rv_uint8_t r, rv_int64_t imm)
+static int emit_op_rx(mnemonic_t *m, int xlen, const char *name, rv_uint8_t r, rv_int64_t imm)
 {
+    imm = xlen_imm(xlen, imm);
     const char *tmp_r = rv_reg2name(r);
     char tmp_imm[64];
     snprintf(tmp_imm, sizeof tmp_imm, "0x%llx", imm);
-    return emit_op(m, name, tmp_r, tmp_imm, 0);
+    int n = emit_op(m, name, tmp_r, tmp_imm, 0);
+    set_arg(m, 0, RV_ARG_REG, r, 0);
+    set_arg(m, 1, RV_ARG_IMM, 0, imm);
+    return n;
 }
 
 static int emit_op_rrr(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t r3)
@@ -76,35 +127,54 @@ static int emit_op_rrr(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_
     const char *tmp_r1 = rv_reg2name(r1);
     const char *tmp_r2 = rv_reg2name(r2);
     const char *tmp_r3 = rv_reg2name(r3);
-    return emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, 0);
+    set_arg(m, 0, RV_ARG_REG, r1, 0);
+    set_arg(m, 1, RV_ARG_REG, r2, 0);
+    set_arg(m, 2, RV_ARG_REG, r3, 0);
+    return n;
 }
 
 static int emit_op_ff(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2)
 {
     const char *tmp_r1 = rv_freg2name(r1);
     const char *tmp_r2 = rv_freg2name(r2);
-    return emit_op(m, name, tmp_r1, tmp_r2, 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, 0);
+    set_arg(m, 0, RV_ARG_FREG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    return n;
 }
 
 static int emit_op_ff_rnd(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t rnd)
 {
     const char *tmp_r1 = rv_freg2name(r1);
     const char *tmp_r2 = rv_freg2name(r2);
-    return emit_op(m, name, tmp_r1, tmp_r2, rounding_mods[rnd & 7], 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, rounding_mods[rnd & 7], 0);
+    set_arg(m, 0, RV_ARG_FREG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    set_arg(m, 2, RV_ARG_RND, 0, rnd & 7);
+    return n;
 }
 
 static int emit_op_rf_rnd(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t rnd)
 {
     const char *tmp_r1 = rv_reg2name(r1);
     const char *tmp_r2 = rv_freg2name(r2);
-    return emit_op(m, name, tmp_r1, tmp_r2, rounding_mods[rnd & 7], 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, rounding_mods[rnd & 7], 0);
+    set_arg(m, 0, RV_ARG_REG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    set_arg(m, 2, RV_ARG_RND, 0, rnd & 7);
+    return n;
 }
 
 static int emit_op_fr_rnd(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t rnd)
 {
     const char *tmp_r1 = rv_freg2name(r1);
     const char *tmp_r2 = rv_reg2name(r2);
-    return emit_op(m, name, tmp_r1, tmp_r2, rounding_mods[rnd & 7], 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, rounding_mods[rnd & 7], 0);
+    set_arg(m, 0, RV_ARG_FREG, r1, 0);
+    set_arg(m, 1, RV_ARG_REG, r2, 0);
+    set_arg(m, 2, RV_ARG_RND, 0, rnd & 7);
+    return n;
 }
 
 static int emit_op_rff(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t r3)
@@ -112,7 +182,11 @@ static int emit_op_rff(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_
     const char *tmp_r1 = rv_reg2name(r1);
     const char *tmp_r2 = rv_freg2name(r2);
     const char *tmp_r3 = rv_freg2name(r3);
-    return emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, 0);
+    set_arg(m, 0, RV_ARG_REG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    set_arg(m, 2, RV_ARG_FREG, r3, 0);
+    return n;
 }
 
 static int emit_op_fff(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t r3)
@@ -120,21 +194,31 @@ static int emit_op_fff(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_
     const char *tmp_r1 = rv_freg2name(r1);
     const char *tmp_r2 = rv_freg2name(r2);
     const char *tmp_r3 = rv_freg2name(r3);
-    return emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, 0);
+    set_arg(m, 0, RV_ARG_FREG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    set_arg(m, 2, RV_ARG_FREG, r3, 0);
+    return n;
 }
 
 static int emit_op_rf(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2)
 {
     const char *tmp_r1 = rv_reg2name(r1);
     const char *tmp_r2 = rv_freg2name(r2);
-    return emit_op(m, name, tmp_r1, tmp_r2, 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, 0);
+    set_arg(m, 0, RV_ARG_REG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    return n;
 }
 
 static int emit_op_fr(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2)
 {
     const char *tmp_r1 = rv_freg2name(r1);
     const char *tmp_r2 = rv_reg2name(r2);
-    return emit_op(m, name, tmp_r1, tmp_r2, 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, 0);
+    set_arg(m, 0, RV_ARG_FREG, r1, 0);
+    set_arg(m, 1, RV_ARG_REG, r2, 0);
+    return n;
 }
 
 static int emit_op_fff_rnd(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t r3, rv_uint8_t rnd)
@@ -142,7 +226,12 @@ static int emit_op_fff_rnd(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_ui
     const char *tmp_r1 = rv_freg2name(r1);
     const char *tmp_r2 = rv_freg2name(r2);
     const char *tmp_r3 = rv_freg2name(r3);
-    return emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, rounding_mods[rnd & 7], 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, rounding_mods[rnd & 7], 0);
+    set_arg(m, 0, RV_ARG_FREG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    set_arg(m, 2, RV_ARG_FREG, r3, 0);
+    set_arg(m, 3, RV_ARG_RND, 0, rnd & 7);
+    return n;
 }
 
 static int emit_op_ffff_rnd(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t r3, rv_uint8_t r4, rv_uint8_t rnd)
@@ -151,7 +240,42 @@ static int emit_op_ffff_rnd(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_u
     const char *tmp_r2 = rv_freg2name(r2);
     const char *tmp_r3 = rv_freg2name(r3);
     const char *tmp_r4 = rv_freg2name(r4);
-    return emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, tmp_r4, rounding_mods[rnd & 7], 0);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, tmp_r4, rounding_mods[rnd & 7], 0);
+    set_arg(m, 0, RV_ARG_FREG, r1, 0);
+    set_arg(m, 1, RV_ARG_FREG, r2, 0);
+    set_arg(m, 2, RV_ARG_FREG, r3, 0);
+    set_arg(m, 3, RV_ARG_FREG, r4, 0);
+    set_arg(m, 4, RV_ARG_RND, 0, rnd & 7);
+    return n;
+}
+
+static int emit_op_rrrr(mnemonic_t *m, const char *name, rv_uint8_t r1, rv_uint8_t r2, rv_uint8_t r3, rv_uint8_t r4)
+{
+    const char *tmp_r1 = rv_reg2name(r1);
+    const char *tmp_r2 = rv_reg2name(r2);
+    const char *tmp_r3 = rv_reg2name(r3);
+    const char *tmp_r4 = rv_reg2name(r4);
+    int n = emit_op(m, name, tmp_r1, tmp_r2, tmp_r3, tmp_r4, 0);
+    set_arg(m, 0, RV_ARG_REG, r1, 0);
+    set_arg(m, 1, RV_ARG_REG, r2, 0);
+    set_arg(m, 2, RV_ARG_REG, r3, 0);
+    set_arg(m, 3, RV_ARG_REG, r4, 0);
+    return n;
+}
+
+static int emit_op_rrri(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_t r1, rv_uint8_t r2, rv_int64_t imm)
+{
+    const char *tmp_r0 = rv_reg2name(r0);
+    const char *tmp_r1 = rv_reg2name(r1);
+    const char *tmp_r2 = rv_reg2name(r2);
+    char tmp_imm[64];
+    snprintf(tmp_imm, sizeof tmp_imm, "%lld", imm);
+    int n = emit_op(m, name, tmp_r0, tmp_r1, tmp_r2, tmp_imm, 0);
+    set_arg(m, 0, RV_ARG_REG, r0, 0);
+    set_arg(m, 1, RV_ARG_REG, r1, 0);
+    set_arg(m, 2, RV_ARG_REG, r2, 0);
+    set_arg(m, 3, RV_ARG_IMM, 0, imm);
+    return n;
 }
 
 static int emit_op_rri(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_t r1, rv_int64_t imm)
@@ -160,16 +284,25 @@ static int emit_op_rri(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_
     const char *tmp_r1 = rv_reg2name(r1);
     char tmp_imm[64];
     snprintf(tmp_imm, sizeof tmp_imm, "%lld", imm);
-    return emit_op(m, name, tmp_r0, tmp_r1, tmp_imm, 0);
+    int n = emit_op(m, name, tmp_r0, tmp_r1, tmp_imm, 0);
+    set_arg(m, 0, RV_ARG_REG, r0, 0);
+    set_arg(m, 1, RV_ARG_REG, r1, 0);
+    set_arg(m, 2, RV_ARG_IMM, 0, imm);
+    return n;
 }
 
-static int emit_op_rrx(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_t r1, rv_int64_t imm)
+static int emit_op_rrx(mnemonic_t *m, int xlen, const char *name, rv_uint8_t r0, rv_uint8_t r1, rv_int64_t imm)
 {
+    imm = xlen_imm(xlen, imm);
     const char *tmp_r0 = rv_reg2name(r0);
     const char *tmp_r1 = rv_reg2name(r1);
     char tmp_imm[64];
     snprintf(tmp_imm, sizeof tmp_imm, "0x%llx", imm);
-    return emit_op(m, name, tmp_r0, tmp_r1, tmp_imm, 0);
+    int n = emit_op(m, name, tmp_r0, tmp_r1, tmp_imm, 0);
+    set_arg(m, 0, RV_ARG_REG, r0, 0);
+    set_arg(m, 1, RV_ARG_REG, r1, 0);
+    set_arg(m, 2, RV_ARG_IMM, 0, imm);
+    return n;
 }
 
 static int emit_op_m(mnemonic_t *m, const char *name, rv_uint8_t r, rv_int64_t imm)
@@ -177,7 +310,9 @@ static int emit_op_m(mnemonic_t *m, const char *name, rv_uint8_t r, rv_int64_t i
     const char *tmp_r = rv_reg2name(r);
     char tmp_mem[64];
     snprintf(tmp_mem, sizeof tmp_mem, "%lld(%s)", imm, tmp_r);
-    return emit_op(m, name, tmp_mem, 0);
+    int n = emit_op(m, name, tmp_mem, 0);
+    set_arg(m, 0, RV_ARG_MEM, r, imm);
+    return n;
 }
 
 static int emit_op_rm(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_t r1, rv_int64_t imm)
@@ -186,7 +321,10 @@ static int emit_op_rm(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_t
     char tmp_mem[64];
     snprintf(tmp_mem, sizeof tmp_mem, "%lld(%s)", imm, tmp_r1);
     const char *tmp_r0 = rv_reg2name(r0);
-    return emit_op(m, name, tmp_r0, tmp_mem, 0);
+    int n = emit_op(m, name, tmp_r0, tmp_mem, 0);
+    set_arg(m, 0, RV_ARG_REG, r0, 0);
+    set_arg(m, 1, RV_ARG_MEM, r1, imm);
+    return n;
 }
 
 static int emit_op_mr(mnemonic_t *m, const char *name, rv_uint8_t rs1, rv_int64_t imm, rv_uint8_t rs2)
@@ -195,7 +333,10 @@ static int emit_op_mr(mnemonic_t *m, const char *name, rv_uint8_t rs1, rv_int64_
     char tmp_mem[64];
     snprintf(tmp_mem, sizeof tmp_mem, "%lld(%s)", imm, tmp_rs1);
     const char *tmp_rs2 = rv_reg2name(rs2);
-    return emit_op(m, name, tmp_rs2, tmp_mem, 0);
+    int n = emit_op(m, name, tmp_rs2, tmp_mem, 0);
+    set_arg(m, 0, RV_ARG_REG, rs2, 0);
+    set_arg(m, 1, RV_ARG_MEM, rs1, imm);
+    return n;
 }
 
 static int emit_op_fm(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_t r1, rv_int64_t imm)
@@ -204,7 +345,10 @@ static int emit_op_fm(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint8_t
     char tmp_mem[64];
     snprintf(tmp_mem, sizeof tmp_mem, "%lld(%s)", imm, tmp_r1);
     const char *tmp_r0 = rv_freg2name(r0);
-    return emit_op(m, name, tmp_r0, tmp_mem, 0);
+    int n = emit_op(m, name, tmp_r0, tmp_mem, 0);
+    set_arg(m, 0, RV_ARG_FREG, r0, 0);
+    set_arg(m, 1, RV_ARG_MEM, r1, imm);
+    return n;
 }
 
 static int emit_op_mf(mnemonic_t *m, const char *name, rv_uint8_t rs1, rv_int64_t imm, rv_uint8_t rs2)
@@ -213,87 +357,219 @@ static int emit_op_mf(mnemonic_t *m, const char *name, rv_uint8_t rs1, rv_int64_
     char tmp_mem[64];
     snprintf(tmp_mem, sizeof tmp_mem, "%lld(%s)", imm, tmp_rs1);
     const char *tmp_rs2 = rv_freg2name(rs2);
-    return emit_op(m, name, tmp_mem, tmp_rs2, 0);
+    int n = emit_op(m, name, tmp_mem, tmp_rs2, 0);
+    set_arg(m, 0, RV_ARG_MEM, rs1, imm);
+    set_arg(m, 1, RV_ARG_FREG, rs2, 0);
+    return n;
 }
 
-static int emit_op_cr(mnemonic_t *m, const char *name, rv_uint64_t csr, rv_uint8_t r0)
+static int emit_op_cr(mnemonic_t *m, int xlen, const char *name, rv_uint64_t csr, rv_uint8_t r0)
 {
+    char tmp_csr[32];
     const char *tmp_r0 = rv_reg2name(r0);
-    return emit_op(m, name, rv_csr2name(csr), tmp_r0, 0);
+    int n = emit_op(m, name, csr_name(xlen, csr, tmp_csr, sizeof tmp_csr), tmp_r0, 0);
+    set_arg(m, 0, RV_ARG_CSR, 0, csr);
+    set_arg(m, 1, RV_ARG_REG, r0, 0);
+    return n;
 }
 
-static int emit_op_rc(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint64_t csr)
+static int emit_op_rc(mnemonic_t *m, int xlen, const char *name, rv_uint8_t r0, rv_uint64_t csr)
 {
+    char tmp_csr[32];
     const char *tmp_r0 = rv_reg2name(r0);
-    return emit_op(m, name, tmp_r0, rv_csr2name(csr), 0);
+    int n = emit_op(m, name, tmp_r0, csr_name(xlen, csr, tmp_csr, sizeof tmp_csr), 0);
+    set_arg(m, 0, RV_ARG_REG, r0, 0);
+    set_arg(m, 1, RV_ARG_CSR, 0, csr);
+    return n;
 }
 
-static int emit_op_rcr(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint64_t csr, rv_uint8_t r1)
+static int emit_op_rcr(mnemonic_t *m, int xlen, const char *name, rv_uint8_t r0, rv_uint64_t csr, rv_uint8_t r1)
 {
+    char tmp_csr[32];
     const char *tmp_r0 = rv_reg2name(r0);
     const char *tmp_r1 = rv_reg2name(r1);
-    return emit_op(m, name, tmp_r0, rv_csr2name(csr), tmp_r1, 0);
+    int n = emit_op(m, name, tmp_r0, csr_name(xlen, csr, tmp_csr, sizeof tmp_csr), tmp_r1, 0);
+    set_arg(m, 0, RV_ARG_REG, r0, 0);
+    set_arg(m, 1, RV_ARG_CSR, 0, csr);
+    set_arg(m, 2, RV_ARG_REG, r1, 0);
+    return n;
 }
 
-static int emit_op_rcu(mnemonic_t *m, const char *name, rv_uint8_t r0, rv_uint64_t csr, rv_uint64_t uimm)
+static int emit_op_rcu(mnemonic_t *m, int xlen, const char *name, rv_uint8_t r0, rv_uint64_t csr, rv_uint64_t uimm)
 {
+    char tmp_csr[32];
     const char *tmp_r0 = rv_reg2name(r0);
     char tmp_uimm[64];
     snprintf(tmp_uimm, sizeof tmp_uimm, "0x%llx", uimm);
-    return emit_op(m, name, tmp_r0, rv_csr2name(csr), tmp_uimm, 0);
+    int n = emit_op(m, name, tmp_r0, csr_name(xlen, csr, tmp_csr, sizeof tmp_csr), tmp_uimm, 0);
+    set_arg(m, 0, RV_ARG_REG, r0, 0);
+    set_arg(m, 1, RV_ARG_CSR, 0, csr);
+    set_arg(m, 2, RV_ARG_IMM, 0, uimm);
+    return n;
 }
 
+// lr, sc and amo names carry the ordering bits: mod bit 1 is aq, bit 0 rl.
+static const char *amo_suffix[4] = {"", ".rl", ".aq", ".aqrl"};
+
 static int emit_lr(mnemonic_t *m, const char *name, rv_uint8_t rd, rv_uint8_t rs1, rv_uint8_t mod)
 {
     const char *tmp_rd = rv_reg2name(rd);
-    const char *tmp_rs1 = rv_reg2name(rs1);
     char tmp_mem[32];
-    snprintf(tmp_mem, sizeof tmp_mem, "(%s)", tmp_rs1);
     char tmp_name[64];
-    switch (mod & 3)
-    {
-    case 0:
-        return emit_op(m, name, tmp_rd, tmp_mem, 0);
-    case 1:
-        snprintf(tmp_name, sizeof tmp_name, "%s.rl", name);
-        break;
-    case 2:
-        snprintf(tmp_name, sizeof tmp_name, "%s.aq", name);
-        break;
-    case 3:
-        snprintf(tmp_name, sizeof tmp_name, "%s.aq.rl", name);
-        break;
-    }
-    return emit_op(m, name, tmp_rd, tmp_mem, 0);
+    int n;
+    snprintf(tmp_mem, sizeof tmp_mem, "(%s)", rv_reg2name(rs1));
+    snprintf(tmp_name, sizeof tmp_name, "%s%s", name, amo_suffix[mod & 3]);
+    n = emit_op(m, tmp_name, tmp_rd, tmp_mem, 0);
+    set_arg(m, 0, RV_ARG_REG, rd, 0);
+    set_arg(m, 1, RV_ARG_MEM, rs1, 0);
+    return n;
 }
 
+// rd, rs2, (rs1) for sc and every amo.
 static int emit_amo(mnemonic_t *m, const char *name, rv_uint8_t rd, rv_uint8_t rs1, rv_uint8_t rs2, rv_uint8_t mod)
 {
     const char *tmp_rd = rv_reg2name(rd);
-    const char *tmp_rs1 = rv_reg2name(rs1);
     const char *tmp_rs2 = rv_reg2name(rs2);
     char tmp_mem[32];
     char tmp_name[64];
-    snprintf(tmp_mem, sizeof tmp_mem, "(%s)", tmp_rs1);
-    switch (mod & 3)
+    int n;
+    snprintf(tmp_mem, sizeof tmp_mem, "(%s)", rv_reg2name(rs1));
+    snprintf(tmp_name, sizeof tmp_name, "%s%s", name, amo_suffix[mod & 3]);
+    n = emit_op(m, tmp_name, tmp_rd, tmp_rs2, tmp_mem, 0);
+    set_arg(m, 0, RV_ARG_REG, rd, 0);
+    set_arg(m, 1, RV_ARG_REG, rs2, 0);
+    set_arg(m, 2, RV_ARG_MEM, rs1, 0);
+    return n;
+}
+
+// imm holds fm, pred and succ as encoded in bits 31:20.
+static int emit_fence(mnemonic_t *m, rv_uint64_t imm)
+{
+    static const char *sets[16] = {"0", "w", "r", "rw", "o", "ow", "or", "orw", "i", "iw", "ir", "irw", "io", "iow", "ior", "iorw"};
+    rv_uint8_t pred = imm >> 4 & 15, succ = imm & 15;
+    int n;
+
+    if ((imm >> 8 & 15) == 8 && pred == 3 && succ == 3)
+        return emit_op(m, "fence.tso", 0);
+    n = emit_op(m, "fence", sets[pred], sets[succ], 0);
+    set_arg(m, 0, RV_ARG_IMM, 0, pred);
+    set_arg(m, 1, RV_ARG_IMM, 0, succ);
+    return n;
+}
+
+// ---------------------------------------------------------------- op table
+//
+// rv-op.def ops are formatted from the encoding itself, see the operand
+// letters there.
+
+#define VT_LMUL(e, t) e ",m1," t, e ",m2," t, e ",m4," t, e ",m8," t, 0, e ",mf8," t, e ",mf4," t, e ",mf2," t
+#define VT_RESERVED 0, 0, 0, 0, 0, 0, 0, 0
+#define VT_SEW(t) VT_LMUL("e8", t), VT_LMUL("e16", t), VT_LMUL("e32", t), VT_LMUL("e64", t), VT_RESERVED, VT_RESERVED, VT_RESERVED, VT_RESERVED
+
+// vtype[7:0] is vma, vta, vsew[2:0], vlmul[2:0]; reserved encodings are 0.
+static const char *const vtype_names[256] = {
+    VT_SEW("tu,mu"),
+    VT_SEW("ta,mu"),
+    VT_SEW("tu,ma"),
+    VT_SEW("ta,ma"),
+};
+
+static const char *vreg_names[32] = {
+    "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+    "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31",
+};
+
+// the typed operand of letter c and its text, in buf when it is not a name.
+static const char *table_arg(char c, rv_uint32_t raw, rv_arg_t *a, char *buf, size_t size)
+{
+    rv_uint8_t rd = raw >> 7 & 31, rs1 = raw >> 15 & 31, rs2 = raw >> 20 & 31;
+
+    switch (c)
     {
-    case 0:
-        return emit_op(m, name, tmp_rd, tmp_rs2, tmp_mem, 0);
-    case 1:
-        snprintf(tmp_name, sizeof tmp_name, "%s.rl", name);
+    case 'X':
+        *a = (rv_arg_t){RV_ARG_REG, rd, 0};
+        return rv_reg2name(rd);
+    case 'x':
+        *a = (rv_arg_t){RV_ARG_REG, rs1, 0};
+        return rv_reg2name(rs1);
+    case 'y':
+        *a = (rv_arg_t){RV_ARG_REG, rs2, 0};
+        return rv_reg2name(rs2);
+    case 'F':
+        *a = (rv_arg_t){RV_ARG_FREG, rd, 0};
+        return rv_freg2name(rd);
+    case 'f':
+        *a = (rv_arg_t){RV_ARG_FREG, rs1, 0};
+        return rv_freg2name(rs1);
+    case 'd':
+        *a = (rv_arg_t){RV_ARG_VREG, rd, 0};
+        return vreg_names[rd];
+    case 's':
+        *a = (rv_arg_t){RV_ARG_VREG, rs2, 0};
+        return vreg_names[rs2];
+    case 't':
+        *a = (rv_arg_t){RV_ARG_VREG, rs1, 0};
+        return vreg_names[rs1];
+    case '0':
+        *a = (rv_arg_t){RV_ARG_VREG, 0, 0};
+        return vreg_names[0];
+    case 'm':
+        *a = (rv_arg_t){RV_ARG_MEM, rs1, 0};
+        snprintf(buf, size, "(%s)", rv_reg2name(rs1));
+        return buf;
+    case 'v':
+        *a = (rv_arg_t){RV_ARG_VTYPE, 0, raw >> 20 & (raw >> 31 ? 0x3ff : 0x7ff)};
+        if (a->imm < 256 && vtype_names[a->imm])
+            return vtype_names[a->imm];
+        break;
+    case 'i':
+        *a = (rv_arg_t){RV_ARG_IMM, 0, (rs1 ^ 16) - 16};
+        break;
+    case 'u':
+        *a = (rv_arg_t){RV_ARG_IMM, 0, rs1};
+        break;
+    case 'k':
+        *a = (rv_arg_t){RV_ARG_IMM, 0, raw >> 20 & 63};
         break;
-    case 2:
-        snprintf(tmp_name, sizeof tmp_name, "%s.aq", name);
+    case 'b':
+        *a = (rv_arg_t){RV_ARG_IMM, 0, raw >> 30};
         break;
-    case 3:
-        snprintf(tmp_name, sizeof tmp_name, "%s.aq.rl", name);
+    case 'n':
+        *a = (rv_arg_t){RV_ARG_IMM, 0, raw >> 20 & 15};
         break;
     }
-    return emit_op(m, name, tmp_rd, tmp_mem, tmp_rs2, 0);
+    snprintf(buf, size, "%lld", a->imm);
+    return buf;
 }
 
-int rv_disasm(inst_t *ir, mnemonic_t *m)
+static int emit_table(mnemonic_t *m, rv_uint32_t raw, const rv_op_t *o)
 {
+    const char *args[5] = {0};
+    char name[32], tmp[5][24];
+    rv_arg_t a[5];
+    int i, seg = RV_OPF_SEG(o->flags);
+
+    if (seg && raw >> 29)
+        snprintf(name, sizeof name, "%.*sseg%d%s", seg, o->name, (int)(raw >> 29) + 1, o->name + seg);
+    else
+        snprintf(name, sizeof name, "%s", o->name);
+    for (i = 0; o->operands[i]; i++)
+        args[i] = table_arg(o->operands[i], raw, &a[i], tmp[i], sizeof tmp[i]);
+    if ((o->flags & RV_OPF_VM) && !(raw >> 25 & 1))
+    {
+        a[i] = (rv_arg_t){RV_ARG_VREG, 0, 0};
+        args[i++] = "v0.t";
+    }
+
+    emit_op(m, name, args[0], args[1], args[2], args[3], args[4], 0);
+    memcpy(m->arg, a, i * sizeof *a);
+    return i;
+}
+
+int rv_disasm_isa(const rv_isa_t *isa, inst_t *ir, mnemonic_t *m)
+{
+    int xlen = isa ? isa->xlen : 64, op;
+
     switch (ir->op)
     {
     default:
@@ -339,22 +615,22 @@ int rv_disasm(inst_t *ir, mnemonic_t *m)
         // -------------- auipc, lui
 
     case RV_LUI:
-        return emit_op_rx(m, "lui", ir->rd, ir->imm.i);
+        return emit_op_rx(m, xlen, "lui", ir->rd, ir->imm.i);
 
     case RV_AUIPC:
-        return emit_op_rx(m, "auipc", ir->rd, ir->imm.i);
+        return emit_op_rx(m, xlen, "auipc", ir->rd, ir->imm.i);
 
         // -------------- jump
 
     case RV_JAL:
         if (ir->rd == 0)
-            return emit_op_x(m, "j", ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_x(m, xlen, "j", ir->imm.i + (rv_int64_t)ir->pc);
         if (ir->rd == 1)
-            return emit_op_x(m, "jal", ir->imm.i + (rv_int64_t)ir->pc);
-        return emit_op_rx(m, "jal", ir->rd, ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_x(m, xlen, "jal", ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_rx(m, xlen, "jal", ir->rd, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_JALR:
-        if (ir->rd == 0 || ir->rs1 == 1 || ir->imm.i == 0)
+        if (ir->rd == 0 && ir->rs1 == 1 && ir->imm.i == 0)
             return emit_op(m, "ret", 0);
         if (ir->rd == 0)
             return emit_op_m(m, "jr", ir->rs1, ir->imm.i);
@@ -366,33 +642,33 @@ int rv_disasm(inst_t *ir, mnemonic_t *m)
 
     case RV_BEQ:
         if (ir->rs2 == 0)
-            return emit_op_rx(m, "beqz", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
-        return emit_op_rrx(m, "beq", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_rx(m, xlen, "beqz", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_rrx(m, xlen, "beq", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_BGE:
         if (ir->rs1 == 0)
-            return emit_op_rx(m, "blez", ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_rx(m, xlen, "blez", ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
         if (ir->rs2 == 0)
-            return emit_op_rx(m, "bgez", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
-        return emit_op_rrx(m, "bge", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_rx(m, xlen, "bgez", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_rrx(m, xlen, "bge", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_BLT:
         if (ir->rs2 == 0)
-            return emit_op_rx(m, "bltz", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_rx(m, xlen, "bltz", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
         if (ir->rs1 == 0)
-            return emit_op_rx(m, "bgtz", ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
-        return emit_op_rrx(m, "blt", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_rx(m, xlen, "bgtz", ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_rrx(m, xlen, "blt", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_BNE:
         if (ir->rs2 == 0)
-            return emit_op_rx(m, "bnez", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
-        return emit_op_rrx(m, "bne", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+            return emit_op_rx(m, xlen, "bnez", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_rrx(m, xlen, "bne", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_BGEU:
-        return emit_op_rrx(m, "bgeu", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_rrx(m, xlen, "bgeu", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_BLTU:
-        return emit_op_rrx(m, "bltu", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_rrx(m, xlen, "bltu", ir->rs1, ir->rs2, ir->imm.i + (rv_int64_t)ir->pc);
 
         // -------------- op
 
@@ -503,29 +779,29 @@ int rv_disasm(inst_t *ir, mnemonic_t *m)
 
     case RV_CSRRC:
         if (ir->rd == 0)
-            return emit_op_cr(m, "csrc", ir->imm.u, ir->rs1);
-        return emit_op_rcr(m, "csrrc", ir->rd, ir->imm.u, ir->rs1);
+            return emit_op_cr(m, xlen, "csrc", ir->imm.u, ir->rs1);
+        return emit_op_rcr(m, xlen, "csrrc", ir->rd, ir->imm.u, ir->rs1);
 
     case RV_CSRRS:
         if (ir->rs1 == 0)
-            return emit_op_rc(m, "csrr", ir->rd, ir->imm.u);
+            return emit_op_rc(m, xlen, "csrr", ir->rd, ir->imm.u);
         if (ir->rd == 0)
-            return emit_op_cr(m, "csrs", ir->imm.u, ir->rs1);
-        return emit_op_rcr(m, "csrrs", ir->rd, ir->imm.u, ir->rs1);
+            return emit_op_cr(m, xlen, "csrs", ir->imm.u, ir->rs1);
+        return emit_op_rcr(m, xlen, "csrrs", ir->rd, ir->imm.u, ir->rs1);
 
     case RV_CSRRW:
         if (ir->rd == 0)
-            return emit_op_cr(m, "csrw", ir->imm.u, ir->rs1);
-        return emit_op_rcr(m, "csrrw", ir->rd, ir->imm.u, ir->rs1);
+            return emit_op_cr(m, xlen, "csrw", ir->imm.u, ir->rs1);
+        return emit_op_rcr(m, xlen, "csrrw", ir->rd, ir->imm.u, ir->rs1);
 
     case RV_CSRRCI:
-        return emit_op_rcu(m, "csrrci", ir->rd, ir->imm.u, ir->uimm);
+        return emit_op_rcu(m, xlen, "csrrci", ir->rd, ir->imm.u, ir->uimm);
 
     case RV_CSRRSI:
-        return emit_op_rcu(m, "csrrsi", ir->rd, ir->imm.u, ir->uimm);
+        return emit_op_rcu(m, xlen, "csrrsi", ir->rd, ir->imm.u, ir->uimm);
 
     case RV_CSRRWI:
-        return emit_op_rcu(m, "csrrwi", ir->rd, ir->imm.u, ir->uimm);
+        return emit_op_rcu(m, xlen, "csrrwi", ir->rd, ir->imm.u, ir->uimm);
 
         // -------------- 64 bits
 
@@ -608,112 +884,112 @@ int rv_disasm(inst_t *ir, mnemonic_t *m)
         return emit_op_rri(m, "c.addi", ir->rd, ir->rd, ir->imm.i);
 
     case RV_C_JAL:
-        return emit_op_x(m, "c_jal", ir->imm.i + (rv_int64_t)ir->pc);
+        return emit_op_x(m, xlen, "c.jal", ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_C_ADDIW:
-        return emit_op(m, "c_addiw", 0); // TODO
+        return emit_op_ri(m, "c.addiw", ir->rd, ir->imm.i);
 
     case RV_C_LI:
-        return emit_op_ri(m, "c_li", ir->rd, ir->imm.i);
+        return emit_op_ri(m, "c.li", ir->rd, ir->imm.i);
 
     case RV_C_ADDI16SP:
-        return emit_op(m, "c_addi16sp", 0);
+        return emit_op_ri(m, "c.addi16sp", ir->rd, ir->imm.i);
 
     case RV_C_LUI:
-        return emit_op(m, "c_lui", 0);
+        return emit_op_rx(m, xlen, "c.lui", ir->rd, ir->imm.i);
 
     case RV_C_SRLI:
-        return emit_op(m, "c_srli", 0);
+        return emit_op_ri(m, "c.srli", ir->rd, ir->imm.i);
 
     case RV_C_SRLI64:
-        return emit_op(m, "c_srli64", 0);
+        return emit_op_r(m, "c.srli64", ir->rd);
 
     case RV_C_SRAI:
-        return emit_op(m, "c_srai", 0);
+        return emit_op_ri(m, "c.srai", ir->rd, ir->imm.i);
 
     case RV_C_SRAI64:
-        return emit_op(m, "c_srai64", 0);
+        return emit_op_r(m, "c.srai64", ir->rd);
 
     case RV_C_ANDI:
-        return emit_op(m, "c_andi", 0);
+        return emit_op_ri(m, "c.andi", ir->rd, ir->imm.i);
 
     case RV_C_SUB:
-        return emit_op(m, "c_sub", 0);
+        return emit_op_rr(m, "c.sub", ir->rd, ir->rs2);
 
     case RV_C_XOR:
-        return emit_op(m, "c_xor", 0);
+        return emit_op_rr(m, "c.xor", ir->rd, ir->rs2);
 
     case RV_C_OR:
-        return emit_op(m, "c_or", 0);
+        return emit_op_rr(m, "c.or", ir->rd, ir->rs2);
 
     case RV_C_AND:
-        return emit_op(m, "c_and", 0);
+        return emit_op_rr(m, "c.and", ir->rd, ir->rs2);
 
     case RV_C_SUBW:
-        return emit_op(m, "c_subw", 0);
+        return emit_op_rr(m, "c.subw", ir->rd, ir->rs2);
 
     case RV_C_ADDW:
-        return emit_op(m, "c_addw", 0);
+        return emit_op_rr(m, "c.addw", ir->rd, ir->rs2);
 
     case RV_C_J:
-        return emit_op(m, "c_j", 0);
+        return emit_op_x(m, xlen, "c.j", ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_C_BEQZ:
-        return emit_op(m, "c_beqz", 0);
+        return emit_op_rx(m, xlen, "c.beqz", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_C_BNEZ:
-        return emit_op(m, "c_bnez", 0);
+        return emit_op_rx(m, xlen, "c.bnez", ir->rs1, ir->imm.i + (rv_int64_t)ir->pc);
 
     case RV_C_SLLI:
-        return emit_op(m, "c_slli", 0);
+        return emit_op_ri(m, "c.slli", ir->rd, ir->imm.i);
 
     case RV_C_SLLI64:
-        return emit_op(m, "c_slli64", 0);
+        return emit_op_r(m, "c.slli64", ir->rd);
 
     case RV_C_FLDSP:
-        return emit_op(m, "c_fldsp", 0);
+        return emit_op_fm(m, "c.fldsp", ir->rd, ir->rs1, ir->imm.i);
 
     case RV_C_LQSP:
-        return emit_op(m, "c_lqsp", 0);
+        return emit_op_rm(m, "c.lqsp", ir->rd, ir->rs1, ir->imm.i);
 
     case RV_C_LWSP:
-        return emit_op(m, "c_lwsp", 0);
+        return emit_op_rm(m, "c.lwsp", ir->rd, ir->rs1, ir->imm.i);
 
     case RV_C_FLWSP:
-        return emit_op(m, "c_flwsp", 0);
+        return emit_op_fm(m, "c.flwsp", ir->rd, ir->rs1, ir->imm.i);
 
     case RV_C_LDSP:
-        return emit_op(m, "c_ldsp", 0);
+        return emit_op_rm(m, "c.ldsp", ir->rd, ir->rs1, ir->imm.i);
 
     case RV_C_JR:
-        return emit_op(m, "c_jr", 0);
+        return emit_op_r(m, "c.jr", ir->rs1);
 
     case RV_C_MV:
-        return emit_op(m, "c_mv", 0);
+        return emit_op_rr(m, "c.mv", ir->rd, ir->rs2);
 
     case RV_C_EBREAK:
-        return emit_op(m, "c_ebreak", 0);
+        return emit_op(m, "c.ebreak", 0);
 
     case RV_C_JALR:
-        return emit_op(m, "c_jalr", 0);
+        return emit_op_r(m, "c.jalr", ir->rs1);
 
     case RV_C_ADD:
-        return emit_op(m, "c_add", 0);
+        return emit_op_rr(m, "c.add", ir->rd, ir->rs2);
 
     case RV_C_FSDSP:
-        return emit_op(m, "c_fsdsp", 0);
+        return emit_op_fm(m, "c.fsdsp", ir->rs2, ir->rs1, ir->imm.i);
 
     case RV_C_SQSP:
-        return emit_op(m, "c_sqsp", 0);
+        return emit_op_rm(m, "c.sqsp", ir->rs2, ir->rs1, ir->imm.i);
 
     case RV_C_SWSP:
-        return emit_op(m, "c_swsp", 0);
+        return emit_op_rm(m, "c.swsp", ir->rs2, ir->rs1, ir->imm.i);
 
     case RV_C_FSWSP:
-        return emit_op(m, "c_fswsp", 0);
+        return emit_op_fm(m, "c.fswsp", ir->rs2, ir->rs1, ir->imm.i);
 
     case RV_C_SDSP:
-        return emit_op(m, "c_sdsp", 0);
+        return emit_op_rm(m, "c.sdsp", ir->rs2, ir->rs1, ir->imm.i);
 
         // -------------- Atomic/LR-SC
 
@@ -788,10 +1064,10 @@ int rv_disasm(inst_t *ir, mnemonic_t *m)
         // system
 
     case RV_FENCE:
-        return emit_op_fff(m, "fence", ir->rd, ir->rs1, ir->rs2);
+        return emit_fence(m, ir->imm.u & 0xfff);
 
     case RV_FENCE_I:
-        return emit_op_fff(m, "fence.i", ir->rd, ir->rs1, ir->rs2);
+        return emit_op(m, "fence.i", 0);
 
     case RV_EBREAK:
         return emit_op(m, "ebreak", 0);
@@ -938,16 +1214,16 @@ int rv_disasm(inst_t *ir, mnemonic_t *m)
         return emit_op_fff_rnd(m, "fdiv.q", ir->rd, ir->rs1, ir->rs2, ir->mod);
 
     case RV_FSQRT_S:
-        return emit_op_fff_rnd(m, "fsqrt.s", ir->rd, ir->rs1, ir->rs2, ir->mod);
+        return emit_op_ff_rnd(m, "fsqrt.s", ir->rd, ir->rs1, ir->mod);
 
     case RV_FSQRT_D:
-        return emit_op_fff_rnd(m, "fsqrt.d", ir->rd, ir->rs1, ir->rs2, ir->mod);
+        return emit_op_ff_rnd(m, "fsqrt.d", ir->rd, ir->rs1, ir->mod);
 
     case RV_FSQRT_H:
-        return emit_op_fff_rnd(m, "fsqrt.h", ir->rd, ir->rs1, ir->rs2, ir->mod);
+        return emit_op_ff_rnd(m, "fsqrt.h", ir->rd, ir->rs1, ir->mod);
 
     case RV_FSQRT_Q:
-        return emit_op_fff_rnd(m, "fsqrt.q", ir->rd, ir->rs1, ir->rs2, ir->mod);
+        return emit_op_ff_rnd(m, "fsqrt.q", ir->rd, ir->rs1, ir->mod);
 
     case RV_FMIN_S:
         return emit_op_fff_rnd(m, "fmin.s", ir->rd, ir->rs1, ir->rs2, ir->mod);
@@ -1222,179 +1498,52 @@ int rv_disasm(inst_t *ir, mnemonic_t *m)
 
     case RV_FEQ_Q:
         return emit_op_rff(m, "feq.q", ir->rd, ir->rs1, ir->rs2);
+    }
 
-        // --------------------- bit
-
-    case RV_BMATFLIP:
-        // ['rd', 'rs1']
-        break;
-
-    case RV_CRC32_D:
-        // ['rd', 'rs1']
-        break;
-
-    case RV_CRC32C_D:
-        // ['rd', 'rs1']
-        break;
-
-    case RV_BMATOR:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_BMATXOR:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SLLI_UW:
-        // ['rd', 'rs1', 'shamt']
-        break;
-
-    case RV_ADD_UW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SLOW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SROW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_ROLW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_RORW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SBCLRW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SBSETW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SBINVW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SBEXTW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_GORCW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_GREVW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SLOIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_SROIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_RORIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_SBCLRIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_SBSETIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_SBINVIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_GORCIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_GREVIW:
-        // ['rd', 'rs1', 'shamtw']
-        break;
-
-    case RV_FSLW:
-        // ['rd', 'rs1', 'rs2', 'rs3']
-        break;
-
-    case RV_FSRW:
-        // ['rd', 'rs1', 'rs2', 'rs3']
-        break;
-
-    case RV_FSRIW:
-        // ['rd', 'rs1', 'shamtw', 'rs3']
-        break;
-
-    case RV_CLZW:
-        // ['rd', 'rs1']
-        break;
-
-    case RV_CTZW:
-        // ['rd', 'rs1']
-        break;
-
-    case RV_CPOPW:
-        // ['rd', 'rs1']
-        break;
-
-    case RV_SH1ADD_UW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SH2ADD_UW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SH3ADD_UW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_SHFLW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_UNSHFLW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_BCOMPRESSW:
-        // ['rd', 'rs1', 'rs2']
-        break;
-
-    case RV_BDECOMPRESSW:
-        // ['rd', 'rs1', 'rs2']
-        break;
+    // rv_dis_op() checks a table tag against the encoding
+    op = rv_dis_op(ir);
+    if (op == RV_OP_CUSTOM)
+        return rv_custom_disasm(ir, m);
+    if (op != RV_OP_NONE)
+        return emit_table(m, ir->imm.u, rv_op_info(op));
+    return emit_op(m, "undef", 0);
+}
 
-    case RV_PACKW:
-        // ['rd', 'rs1', 'rs2']
-        break;
+int rv_disasm(inst_t *ir, mnemonic_t *m)
+{
+    return rv_disasm_isa(rv_isa_current(), ir, m);
+}
 
-    case RV_PACKUW:
-        // ['rd', 'rs1', 'rs2']
-        break;
+void rv_mnemonic_free(mnemonic_t *m)
+{
+    int i;
 
-    case RV_BFPW:
-        // ['rd', 'rs1', 'rs2']
-        break;
+    rv_free(m->op);
+    for (i = 0; i < 5; i++)
+        rv_free(m->args[i]);
+    bzero(m, sizeof *m);
+}
 
-    case RV_XPERM_W:
-        // ['rd', 'rs1', 'rs2']
-        break;
+int rv_format(const mnemonic_t *m, char *buf, size_t size)
+{
+    size_t n = 0;
+    int i;
 
-        // --------------------- vector: TODO
-    }
+    n += snprintf(buf, size, "%s", m->op ? m->op : "undef");
+    for (i = 0; i < 5 && m->args[i]; i++)
+        n += snprintf(buf + (n < size ? n : size), n < size ? size - n : 0, "%c%s", i ? ',' : '\t', m->args[i]);
+    return n;
+}
 
-    return emit_op(m, "undef", 0);
+int rv_format_line(rv_uint64_t pc, rv_uint32_t raw, int len, const mnemonic_t *m, char *buf, size_t size)
+{
+    size_t n;
+
+    if (len == 2)
+        n = snprintf(buf, size, "%8llx:\t%04x    \t", pc, raw & 0xffff);
+    else
+        n = snprintf(buf, size, "%8llx:\t%08x\t", pc, raw);
+    n += rv_format(m, buf + (n < size ? n : size), n < size ? size - n : 0);
+    n += snprintf(buf + (n < size ? n : size), n < size ? size - n : 0, "\n");
+    return n;
 }
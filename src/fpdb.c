@@ -0,0 +1,343 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rv-fprint.h"
+#include "alloc.h"
+#include "hash.h"
+
+#define FPDB_MAGIC "RVFX"
+#define FPDB_ROWS (RV_FPRINT_K / RV_FPRINT_BANDS)
+
+struct rv_fpdb
+{
+    void *map; // while the tables still point into the file
+    size_t map_size;
+
+    rv_fpdb_func_t *funcs;
+    size_t nfuncs;
+    size_t fcap;
+    rv_fpdb_key_t *keys;
+    size_t nkeys;
+    size_t kcap;
+    char *pool;
+    size_t pool_size;
+    size_t pcap;
+    int sorted;
+};
+
+static rv_uint64_t band_key(const rv_uint32_t *min, int band)
+{
+    return rv_hash64(min + band * FPDB_ROWS, FPDB_ROWS * sizeof *min, band);
+}
+
+static int cmp_key(const void *a, const void *b)
+{
+    const rv_fpdb_key_t *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return x->func < y->func ? -1 : x->func > y->func;
+}
+
+static int cmp_hit(const void *a, const void *b)
+{
+    const rv_fpdb_hit_t *x = a, *y = b;
+    if (x->similarity != y->similarity)
+        return x->similarity > y->similarity ? -1 : 1;
+    return x->func < y->func ? -1 : x->func > y->func;
+}
+
+static int cmp_size(const void *a, const void *b)
+{
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+rv_fpdb_t *rv_fpdb_new(void)
+{
+    rv_fpdb_t *db = rv_calloc(1, sizeof *db);
+    if (db)
+        db->sorted = 1;
+    return db;
+}
+
+static int fpdb_check(const rv_fpdb_hdr_t *h, size_t size)
+{
+    if (size < sizeof *h || memcmp(h->magic, FPDB_MAGIC, 4) != 0 || h->version != RV_FPDB_VERSION)
+        return -1;
+    if (h->order != RV_FPDB_ORDER)
+        return -1;
+    // bounded before the offsets are computed, so they cannot wrap
+    if (h->nfuncs > size / sizeof(rv_fpdb_func_t) || h->nkeys > size / sizeof(rv_fpdb_key_t) || h->pool_size > size)
+        return -1;
+    if (h->func_off != sizeof *h || h->key_off != h->func_off + h->nfuncs * sizeof(rv_fpdb_func_t))
+        return -1;
+    if (h->pool_off != h->key_off + h->nkeys * sizeof(rv_fpdb_key_t) || h->pool_off + h->pool_size != size)
+        return -1;
+    if (h->pool_size && ((const char *)h)[size - 1] != 0)
+        return -1;
+    return 0;
+}
+
+rv_fpdb_t *rv_fpdb_open(const char *path)
+{
+    rv_fpdb_t *db;
+    const rv_fpdb_hdr_t *h;
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof *h)
+    {
+        close(fd);
+        return 0;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+    h = map;
+    if (fpdb_check(h, st.st_size) < 0 || (db = rv_fpdb_new()) == 0)
+    {
+        munmap(map, st.st_size);
+        return 0;
+    }
+    db->map = map;
+    db->map_size = st.st_size;
+    db->funcs = (rv_fpdb_func_t *)((char *)map + h->func_off);
+    db->nfuncs = h->nfuncs;
+    db->keys = (rv_fpdb_key_t *)((char *)map + h->key_off);
+    db->nkeys = h->nkeys;
+    db->pool = (char *)map + h->pool_off;
+    db->pool_size = h->pool_size;
+    return db;
+}
+
+void rv_fpdb_close(rv_fpdb_t *db)
+{
+    if (db == 0)
+        return;
+    if (db->map)
+        munmap(db->map, db->map_size);
+    else
+    {
+        rv_free(db->funcs);
+        rv_free(db->keys);
+        rv_free(db->pool);
+    }
+    rv_free(db);
+}
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size)
+{
+    size_t ncap = *cap ? *cap : 1024;
+    void *n;
+
+    if (need <= *cap && p)
+        return p;
+    while (ncap < need)
+        ncap *= 2;
+    n = rv_realloc(p, ncap * size);
+    if (n)
+        *cap = ncap;
+    return n;
+}
+
+// moves the tables out of the mapped file before the first change.
+static int own(rv_fpdb_t *db)
+{
+    rv_fpdb_func_t *funcs;
+    rv_fpdb_key_t *keys;
+    char *pool;
+
+    if (db->map == 0)
+        return 0;
+    funcs = rv_malloc((db->nfuncs ? db->nfuncs : 1) * sizeof *funcs);
+    keys = rv_malloc((db->nkeys ? db->nkeys : 1) * sizeof *keys);
+    pool = rv_malloc(db->pool_size ? db->pool_size : 1);
+    if (funcs == 0 || keys == 0 || pool == 0)
+    {
+        rv_free(funcs);
+        rv_free(keys);
+        rv_free(pool);
+        return -1;
+    }
+    memcpy(funcs, db->funcs, db->nfuncs * sizeof *funcs);
+    memcpy(keys, db->keys, db->nkeys * sizeof *keys);
+    memcpy(pool, db->pool, db->pool_size);
+    munmap(db->map, db->map_size);
+    db->map = 0;
+    db->funcs = funcs;
+    db->fcap = db->nfuncs;
+    db->keys = keys;
+    db->kcap = db->nkeys;
+    db->pool = pool;
+    db->pcap = db->pool_size;
+    return 0;
+}
+
+int rv_fpdb_add(rv_fpdb_t *db, const char *image, const rv_fprint_t *fps, size_t count)
+{
+    size_t len = strlen(image) + 1, i, n = 0;
+    rv_uint32_t name = db->pool_size;
+    void *p;
+    int b;
+
+    if (own(db) < 0 || db->pool_size + len > 0xffffffffu)
+        return -1;
+    for (i = 0; i < count; i++)
+        n += fps[i].nwin != 0;
+    if ((p = grow(db->funcs, &db->fcap, db->nfuncs + n, sizeof *db->funcs)) == 0)
+        return -1;
+    db->funcs = p;
+    if ((p = grow(db->keys, &db->kcap, db->nkeys + n * RV_FPRINT_BANDS, sizeof *db->keys)) == 0)
+        return -1;
+    db->keys = p;
+    if ((p = grow(db->pool, &db->pcap, db->pool_size + len, 1)) == 0)
+        return -1;
+    db->pool = p;
+    memcpy(db->pool + db->pool_size, image, len);
+    db->pool_size += len;
+
+    for (i = 0; i < count; i++)
+    {
+        rv_fpdb_func_t *f = &db->funcs[db->nfuncs];
+
+        if (fps[i].nwin == 0)
+            continue;
+        f->start = fps[i].start;
+        f->image = name;
+        f->ninsn = fps[i].ninsn;
+        memcpy(f->min, fps[i].min, sizeof f->min);
+        for (b = 0; b < RV_FPRINT_BANDS; b++)
+            db->keys[db->nkeys++] = (rv_fpdb_key_t){band_key(f->min, b), db->nfuncs};
+        db->nfuncs++;
+    }
+    db->sorted = 0;
+    return 0;
+}
+
+static void sort_keys(rv_fpdb_t *db)
+{
+    if (db->sorted)
+        return;
+    qsort(db->keys, db->nkeys, sizeof *db->keys, cmp_key);
+    db->sorted = 1;
+}
+
+int rv_fpdb_save(rv_fpdb_t *db, const char *path)
+{
+    char *tmp_path = rv_malloc(strlen(path) + 5);
+    rv_fpdb_hdr_t h;
+    FILE *f = 0;
+    int ret = -1;
+
+    if (tmp_path == 0)
+        return -1;
+    sort_keys(db);
+    bzero(&h, sizeof h);
+    memcpy(h.magic, FPDB_MAGIC, 4);
+    h.version = RV_FPDB_VERSION;
+    h.order = RV_FPDB_ORDER;
+    h.nfuncs = db->nfuncs;
+    h.func_off = sizeof h;
+    h.nkeys = db->nkeys;
+    h.key_off = h.func_off + h.nfuncs * sizeof *db->funcs;
+    h.pool_off = h.key_off + h.nkeys * sizeof *db->keys;
+    h.pool_size = db->pool_size;
+
+    sprintf(tmp_path, "%s.tmp", path);
+    f = fopen(tmp_path, "wb");
+    if (f == 0)
+        goto out;
+    if (fwrite(&h, sizeof h, 1, f) != 1 || (h.nfuncs && fwrite(db->funcs, sizeof *db->funcs, h.nfuncs, f) != h.nfuncs))
+        goto out;
+    if (h.nkeys && fwrite(db->keys, sizeof *db->keys, h.nkeys, f) != h.nkeys)
+        goto out;
+    if (h.pool_size && fwrite(db->pool, 1, h.pool_size, f) != h.pool_size)
+        goto out;
+    if (fclose(f) != 0)
+    {
+        f = 0;
+        goto out;
+    }
+    f = 0;
+    if (rename(tmp_path, path) == 0)
+        ret = 0;
+
+out:
+    if (f)
+        fclose(f);
+    if (ret < 0)
+        unlink(tmp_path);
+    rv_free(tmp_path);
+    return ret;
+}
+
+size_t rv_fpdb_query(rv_fpdb_t *db, const rv_fprint_t *fp, double min, rv_fpdb_hit_t *hits, size_t max)
+{
+    size_t cand[RV_FPRINT_BANDS * 64], ncand = 0, i, n = 0;
+    rv_fpdb_hit_t *all;
+    int b;
+
+    if (fp->nwin == 0 || max == 0)
+        return 0;
+    sort_keys(db);
+    for (b = 0; b < RV_FPRINT_BANDS; b++)
+    {
+        rv_fpdb_key_t key = {band_key(fp->min, b), 0};
+        size_t lo = 0, hi = db->nkeys, k;
+
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (cmp_key(&db->keys[mid], &key) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        // buckets of boilerplate can be huge; 64 candidates per band is plenty
+        for (k = lo; k < db->nkeys && db->keys[k].key == key.key && k - lo < 64; k++)
+            cand[ncand++] = db->keys[k].func;
+    }
+    qsort(cand, ncand, sizeof *cand, cmp_size);
+
+    all = rv_malloc((ncand ? ncand : 1) * sizeof *all);
+    if (all == 0)
+        return 0;
+    for (i = 0; i < ncand; i++)
+    {
+        const rv_fpdb_func_t *f;
+        int k, same = 0;
+
+        if ((i && cand[i] == cand[i - 1]) || cand[i] >= db->nfuncs)
+            continue;
+        f = &db->funcs[cand[i]];
+        for (k = 0; k < RV_FPRINT_K; k++)
+            same += f->min[k] == fp->min[k];
+        if ((double)same / RV_FPRINT_K >= min)
+            all[n++] = (rv_fpdb_hit_t){cand[i], (double)same / RV_FPRINT_K};
+    }
+    qsort(all, n, sizeof *all, cmp_hit);
+    if (n > max)
+        n = max;
+    memcpy(hits, all, n * sizeof *hits);
+    rv_free(all);
+    return n;
+}
+
+const rv_fpdb_func_t *rv_fpdb_func(const rv_fpdb_t *db, size_t func)
+{
+    return func < db->nfuncs ? &db->funcs[func] : 0;
+}
+
+const char *rv_fpdb_image(const rv_fpdb_t *db, size_t func)
+{
+    return func < db->nfuncs && db->funcs[func].image < db->pool_size ? db->pool + db->funcs[func].image : 0;
+}
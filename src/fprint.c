@@ -0,0 +1,160 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-fprint.h"
+#include "alloc.h"
+#include "hash.h"
+#include "par.h"
+
+#define FPRINT_BASE 0x100000001b3ull // rolling hash multiplier
+#define FPRINT_CACHE 4096            // direct mapped raw encoding -> token slots
+
+typedef struct
+{
+    rv_uint32_t raw;
+    rv_uint32_t valid;
+    rv_uint64_t token;
+} slot_t;
+
+typedef struct
+{
+    const rv_image_t *img;
+    const rv_func_t *funcs;
+    size_t count;
+    rv_fprint_t *fps;
+    atomic_size_t next;
+} job_t;
+
+rv_uint64_t rv_fprint_token(inst_t *ir)
+{
+    rv_uint64_t h;
+    mnemonic_t m;
+    int i;
+
+    rv_disasm(ir, &m);
+    h = rv_hash64(m.op, strlen(m.op), 0);
+    for (i = 0; i < 5 && m.args[i]; i++)
+        h = rv_hash_mix(h, m.arg[i].kind + 1);
+    rv_mnemonic_free(&m);
+    return h;
+}
+
+void rv_fprint_sketch(const rv_uint64_t *tokens, size_t n, rv_fprint_t *fp)
+{
+    rv_uint64_t roll = 0, top = 1;
+    size_t i;
+    int k, j;
+
+    memset(fp->min, 0xff, sizeof fp->min);
+    fp->ninsn = n;
+    fp->nwin = n >= RV_FPRINT_WINDOW ? n - RV_FPRINT_WINDOW + 1 : 0;
+    if (fp->nwin == 0)
+        return;
+
+    for (k = 1; k < RV_FPRINT_WINDOW; k++)
+        top *= FPRINT_BASE;
+    for (i = 0; i < n; i++)
+    {
+        rv_uint64_t h;
+
+        if (i >= RV_FPRINT_WINDOW)
+            roll -= tokens[i - RV_FPRINT_WINDOW] * top;
+        roll = roll * FPRINT_BASE + tokens[i];
+        if (i + 1 < RV_FPRINT_WINDOW)
+            continue;
+        h = rv_hash64(&roll, sizeof roll, 0);
+        k = h >> 59;
+        if ((rv_uint32_t)h < fp->min[k])
+            fp->min[k] = h;
+    }
+
+    // densify: an empty bin takes the next filled one, rehashed with the
+    // distance so that two empty bins do not agree by construction.
+    for (k = 0; k < RV_FPRINT_K; k++)
+    {
+        if (fp->min[k] != 0xffffffffu)
+            continue;
+        for (j = 1; j < RV_FPRINT_K && fp->min[(k + j) % RV_FPRINT_K] == 0xffffffffu; j++)
+            ;
+        if (j < RV_FPRINT_K)
+            fp->min[k] = rv_hash_mix(fp->min[(k + j) % RV_FPRINT_K], j) >> 32 | 0x80000000u;
+    }
+}
+
+double rv_fprint_similarity(const rv_fprint_t *a, const rv_fprint_t *b)
+{
+    int k, same = 0;
+
+    if (a->nwin == 0 || b->nwin == 0)
+        return 0;
+    for (k = 0; k < RV_FPRINT_K; k++)
+        same += a->min[k] == b->min[k];
+    return (double)same / RV_FPRINT_K;
+}
+
+static void task(void *arg, int id, int nthreads)
+{
+    job_t *j = arg;
+    slot_t *cache = rv_calloc(FPRINT_CACHE, sizeof *cache);
+    rv_uint64_t *tokens = 0;
+    size_t cap = 0, k;
+
+    if (cache == 0)
+        return;
+    while ((k = atomic_fetch_add(&j->next, 1)) < j->count)
+    {
+        const rv_func_t *f = &j->funcs[k];
+        const rv_section_t *s = rv_image_section(j->img, f->start);
+        rv_uint64_t pc = f->start;
+        size_t n = 0;
+
+        j->fps[k].start = f->start;
+        while (s && s->data && pc < f->end && pc < s->addr + s->size)
+        {
+            rv_uint32_t raw;
+            slot_t *slot;
+            inst_t ir;
+            int len = rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), &ir, &raw);
+
+            if (len == 0)
+                break;
+            if (n == cap)
+            {
+                size_t ncap = cap ? cap * 2 : 1024;
+                rv_uint64_t *t = rv_realloc(tokens, ncap * sizeof *t);
+                if (t == 0)
+                    break;
+                tokens = t;
+                cap = ncap;
+            }
+            slot = &cache[rv_hash_mix(0, raw) % FPRINT_CACHE];
+            if (!slot->valid || slot->raw != raw)
+            {
+                slot->raw = raw;
+                slot->valid = 1;
+                slot->token = rv_fprint_token(&ir);
+            }
+            tokens[n++] = slot->token;
+            pc += len;
+        }
+        rv_fprint_sketch(tokens, n, &j->fps[k]);
+    }
+    rv_free(tokens);
+    rv_free(cache);
+}
+
+rv_fprint_t *rv_fprint_image(const rv_image_t *img, const rv_func_t *funcs, size_t count, int nthreads)
+{
+    job_t j;
+
+    bzero(&j, sizeof j);
+    j.img = img;
+    j.funcs = funcs;
+    j.count = count;
+    j.fps = rv_calloc(count ? count : 1, sizeof *j.fps);
+    if (j.fps == 0)
+        return 0;
+    rv_parallel(rv_nthreads(nthreads), task, &j);
+    return j.fps;
+}
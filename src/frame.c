@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-cfg.h"
+#include "rv-frame.h"
+#include "alloc.h"
+#include "par.h"
+
+typedef struct
+{
+    rv_uint32_t *items;
+    size_t n;
+    size_t cap;
+    int failed;
+} list_t;
+
+typedef struct
+{
+    const rv_image_t *img;
+    const rv_func_t *funcs;
+    rv_frames_t *out;
+    list_t *lists; // callees per thread
+    rv_uint8_t *owner;
+} scan_t;
+
+static int saved(rv_uint8_t r)
+{
+    return r == 1 || r == 8 || r == 9 || (r >= 18 && r <= 27);
+}
+
+static void push(list_t *l, rv_uint32_t v)
+{
+    if (l->n == l->cap)
+    {
+        size_t ncap = l->cap ? l->cap * 2 : 256;
+        rv_uint32_t *n = rv_realloc(l->items, ncap * sizeof *n);
+        if (n == 0)
+        {
+            l->failed = 1;
+            return;
+        }
+        l->items = n;
+        l->cap = ncap;
+    }
+    l->items[l->n++] = v;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    rv_uint32_t x = *(const rv_uint32_t *)a, y = *(const rv_uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void callee(scan_t *s, list_t *l, size_t count, rv_uint64_t target)
+{
+    const rv_func_t *f = rv_func_find(s->funcs, count, target);
+    if (f && f->start == target)
+        push(l, f - s->funcs);
+}
+
+// one linear pass over the function, tracking how far sp is below its
+// value on entry.
+static void scan(scan_t *s, size_t count, size_t i, list_t *l)
+{
+    const rv_func_t *fn = &s->funcs[i];
+    rv_frame_t *fr = &s->out->frames[i];
+    const rv_section_t *sec = rv_image_section(s->img, fn->start);
+    rv_uint64_t pc = fn->start, target;
+    rv_int64_t cur = 0;
+    size_t first = l->n;
+    inst_t ir, prev;
+    int len;
+
+    fr->start = fn->start;
+    fr->callee = first;
+    bzero(&prev, sizeof prev);
+    while (sec && pc < fn->end && pc < sec->addr + sec->size)
+    {
+        rv_int64_t adj = 0;
+
+        len = rv_dis_decode(pc, sec->data + (pc - sec->addr), sec->size - (pc - sec->addr), &ir, 0);
+        if (len == 0)
+            break;
+
+        switch (ir.op)
+        {
+        case RV_ADDI:
+            if (ir.rd == 2 && ir.rs1 == 2)
+                adj = ir.imm.i;
+            break;
+
+        case RV_C_ADDI:
+        case RV_C_ADDI16SP:
+            if (ir.rd == 2)
+                adj = ir.imm.i;
+            break;
+
+        case RV_ADD:
+        case RV_SUB:
+        case RV_C_ADD:
+        case RV_C_SUB:
+        case RV_C_MV:
+            if (ir.rd == 2)
+                fr->flags |= RV_FRAME_DYNAMIC;
+            break;
+
+        case RV_SD:
+        case RV_SW:
+            if (ir.rs1 == 2 && saved(ir.rs2))
+                fr->spills++;
+            break;
+
+        case RV_C_SDSP:
+        case RV_C_SWSP:
+            if (saved(ir.rs2))
+                fr->spills++;
+            break;
+
+        case RV_LD:
+        case RV_LW:
+            if (ir.rs1 == 2 && saved(ir.rd))
+                fr->reloads++;
+            break;
+
+        case RV_C_LDSP:
+        case RV_C_LWSP:
+            if (saved(ir.rd))
+                fr->reloads++;
+            break;
+        }
+
+        // epilogues give the frame back, keep the deepest point
+        cur -= adj;
+        if (cur < 0)
+            cur = 0;
+        if (cur > fr->frame)
+            fr->frame = cur;
+
+        switch (rv_flow(&ir, &target))
+        {
+        case RV_FLOW_CALL:
+            callee(s, l, count, target);
+            break;
+
+        case RV_FLOW_JUMP:
+            if (target < fn->start || target >= fn->end)
+                callee(s, l, count, target);
+            break;
+
+        case RV_FLOW_ICALL:
+        case RV_FLOW_IJUMP:
+            if (prev.op == RV_AUIPC && prev.rd == ir.rs1 && ir.op == RV_JALR)
+                callee(s, l, count, prev.pc + prev.imm.i + ir.imm.i);
+            else if (ir.op == RV_C_JALR || (ir.op == RV_JALR && ir.rd != 0))
+                fr->flags |= RV_FRAME_ICALL;
+            break;
+        }
+        prev = ir;
+        pc += len;
+    }
+
+    if (l->n > first)
+        qsort(l->items + first, l->n - first, sizeof *l->items, cmp_u32);
+    fr->ncallees = 0;
+    for (len = 0; first + len < l->n; len++)
+    {
+        if (fr->ncallees == 0 || l->items[first + fr->ncallees - 1] != l->items[first + len])
+            l->items[first + fr->ncallees++] = l->items[first + len];
+    }
+    l->n = first + fr->ncallees;
+}
+
+static void scan_task(void *arg, int id, int n)
+{
+    scan_t *s = arg;
+    size_t i;
+
+    for (i = id; i < s->out->count; i += n)
+    {
+        s->owner[i] = id;
+        scan(s, s->out->count, i, &s->lists[id]);
+    }
+}
+
+// deepest static chain below each frame, iteratively so that long call
+// chains do not exhaust the stack.
+static int depths(rv_frames_t *out)
+{
+    rv_uint8_t *state = rv_calloc(out->count ? out->count : 1, 1);
+    rv_uint32_t *stack = rv_malloc((out->count ? out->count : 1) * sizeof *stack);
+    rv_uint32_t *next = rv_calloc(out->count ? out->count : 1, sizeof *next);
+    size_t i, sp;
+
+    if (state == 0 || stack == 0 || next == 0)
+    {
+        rv_free(state);
+        rv_free(stack);
+        rv_free(next);
+        return -1;
+    }
+    for (i = 0; i < out->count; i++)
+    {
+        if (state[i])
+            continue;
+        sp = 0;
+        stack[sp++] = i;
+        state[i] = 1;
+        out->frames[i].depth = out->frames[i].frame;
+        while (sp)
+        {
+            rv_uint32_t f = stack[sp - 1];
+            rv_frame_t *fr = &out->frames[f];
+
+            if (next[f] < fr->ncallees)
+            {
+                rv_uint32_t c = out->callees[fr->callee + next[f]++];
+                if (state[c] == 0)
+                {
+                    state[c] = 1;
+                    out->frames[c].depth = out->frames[c].frame;
+                    stack[sp++] = c;
+                }
+                else if (state[c] == 1)
+                    fr->flags |= RV_FRAME_RECURSIVE;
+                else
+                {
+                    if (fr->frame + out->frames[c].depth > fr->depth)
+                        fr->depth = fr->frame + out->frames[c].depth;
+                    fr->flags |= out->frames[c].flags & RV_FRAME_ICALL;
+                }
+                continue;
+            }
+
+            state[f] = 2;
+            sp--;
+            if (sp)
+            {
+                rv_frame_t *caller = &out->frames[stack[sp - 1]];
+                if (caller->frame + fr->depth > caller->depth)
+                    caller->depth = caller->frame + fr->depth;
+                caller->flags |= fr->flags & RV_FRAME_ICALL;
+            }
+        }
+    }
+    rv_free(state);
+    rv_free(stack);
+    rv_free(next);
+    return 0;
+}
+
+rv_frames_t *rv_frame_analyze(const rv_image_t *img, const rv_func_t *funcs, size_t count, int nthreads)
+{
+    rv_frames_t *out = rv_calloc(1, sizeof *out);
+    scan_t s;
+    size_t i, total = 0;
+    int n = rv_nthreads(nthreads), k;
+
+    if (n > 255)
+        n = 255;
+    bzero(&s, sizeof s);
+    if (out == 0)
+        return 0;
+    out->count = count;
+    out->frames = rv_calloc(count ? count : 1, sizeof *out->frames);
+    s.lists = rv_calloc(n, sizeof *s.lists);
+    s.owner = rv_malloc(count ? count : 1);
+    if (out->frames == 0 || s.lists == 0 || s.owner == 0)
+        goto fail;
+    s.img = img;
+    s.funcs = funcs;
+    s.out = out;
+    n = rv_parallel(n, scan_task, &s);
+
+    for (k = 0; k < n; k++)
+    {
+        if (s.lists[k].failed)
+            goto fail;
+        total += s.lists[k].n;
+    }
+    out->callees = rv_malloc((total ? total : 1) * sizeof *out->callees);
+    if (out->callees == 0)
+        goto fail;
+    for (i = 0; i < count; i++)
+    {
+        rv_frame_t *fr = &out->frames[i];
+        if (fr->ncallees)
+            memcpy(out->callees + out->ncallees, s.lists[s.owner[i]].items + fr->callee, fr->ncallees * sizeof *out->callees);
+        fr->callee = out->ncallees;
+        out->ncallees += fr->ncallees;
+    }
+    if (depths(out) < 0)
+        goto fail;
+
+    for (k = 0; k < n; k++)
+        rv_free(s.lists[k].items);
+    rv_free(s.lists);
+    rv_free(s.owner);
+    return out;
+
+fail:
+    for (k = 0; s.lists && k < n; k++)
+        rv_free(s.lists[k].items);
+    rv_free(s.lists);
+    rv_free(s.owner);
+    rv_frames_free(out);
+    return 0;
+}
+
+void rv_frames_free(rv_frames_t *f)
+{
+    if (f == 0)
+        return;
+    rv_free(f->frames);
+    rv_free(f->callees);
+    rv_free(f);
+}
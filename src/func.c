@@ -0,0 +1,356 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-cfg.h"
+#include "rv-func.h"
+#include "alloc.h"
+#include "par.h"
+
+#define FN_CHUNK 65536 // bytes swept per task
+#define FN_HEAD 64     // instruction starts recorded at the head of each chunk
+#define FN_LOOK 4      // instructions searched for a prologue
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint64_t site; // where the sweep saw the evidence
+    rv_uint32_t flags;
+} cand_t;
+
+typedef struct
+{
+    const rv_section_t *s;
+    rv_uint64_t lo;
+    rv_uint64_t hi;
+    rv_uint64_t head[FN_HEAD];
+    int nhead;
+    int last; // last chunk of its section
+    rv_uint64_t stop; // where the sweep joined the next chunk's stream
+    cand_t *c;
+    size_t n;
+    size_t cap;
+    int failed;
+} chunk_t;
+
+typedef struct
+{
+    const rv_image_t *img;
+    chunk_t *chunks;
+    size_t count;
+    atomic_size_t next;
+} sweep_t;
+
+static int decode(const rv_section_t *s, rv_uint64_t pc, inst_t *ir)
+{
+    if (pc >= s->addr + s->size)
+        return 0;
+    return rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), ir, 0);
+}
+
+static int is_pad(const inst_t *ir)
+{
+    switch (ir->op)
+    {
+    case RV_ADDI:
+        return ir->rd == 0 && ir->rs1 == 0 && ir->imm.i == 0;
+    case RV_C_NOP:
+    case RV_C_UNIMP:
+        return 1;
+    }
+    return 0;
+}
+
+static int is_prologue(const inst_t *ir)
+{
+    switch (ir->op)
+    {
+    case RV_ADDI:
+        return ir->rd == 2 && ir->rs1 == 2 && ir->imm.i < 0;
+    case RV_C_ADDI:
+    case RV_C_ADDI16SP:
+        return ir->rd == 2 && ir->imm.i < 0;
+    case RV_SD:
+    case RV_SW:
+        return ir->rs1 == 2 && ir->rs2 == 1;
+    case RV_C_SDSP:
+    case RV_C_SWSP:
+        return ir->rs2 == 1;
+    }
+    return 0;
+}
+
+// looks for a frame allocation or an ra save before any control transfer.
+static int prologue(const rv_section_t *s, rv_uint64_t pc)
+{
+    rv_uint64_t target;
+    inst_t ir;
+    int k, len;
+
+    for (k = 0; k < FN_LOOK && (len = decode(s, pc, &ir)) != 0; k++, pc += len)
+    {
+        if (is_prologue(&ir))
+            return 1;
+        if (rv_flow(&ir, &target) != RV_FLOW_NONE)
+            break;
+    }
+    return 0;
+}
+
+static int add(chunk_t *c, rv_uint64_t pc, rv_uint64_t site, rv_uint32_t flags)
+{
+    if (c->n == c->cap)
+    {
+        size_t ncap = c->cap ? c->cap * 2 : 256;
+        cand_t *n = rv_realloc(c->c, ncap * sizeof *n);
+        if (n == 0)
+            return -1;
+        c->c = n;
+        c->cap = ncap;
+    }
+    c->c[c->n].pc = pc;
+    c->c[c->n].site = site;
+    c->c[c->n].flags = flags;
+    c->n++;
+    return 0;
+}
+
+static int in_head(const chunk_t *c, rv_uint64_t pc)
+{
+    int lo = 0, hi = c->nhead;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (c->head[mid] < pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < c->nhead && c->head[lo] == pc;
+}
+
+// target of auipc x, imm; jalr rd, off(x) when it is a call or a tail call
+// through t1.
+static int far_call(const inst_t *prev, const inst_t *ir, rv_uint64_t *target)
+{
+    if (prev->op != RV_AUIPC || ir->op != RV_JALR || prev->rd != ir->rs1)
+        return 0;
+    if (ir->rd != 1 && ir->rd != 5 && !(ir->rd == 0 && ir->rs1 == 6))
+        return 0;
+    *target = prev->pc + prev->imm.i + ir->imm.i;
+    return 1;
+}
+
+static void head_task(void *arg, int id, int n)
+{
+    sweep_t *w = arg;
+    size_t i;
+
+    for (i = id; i < w->count; i += n)
+    {
+        chunk_t *c = &w->chunks[i];
+        rv_uint64_t pc = c->lo;
+        inst_t ir;
+        int len;
+
+        while (c->nhead < FN_HEAD && (len = decode(c->s, pc, &ir)) != 0)
+        {
+            c->head[c->nhead++] = pc;
+            pc += len;
+        }
+    }
+}
+
+// sweeps [lo, hi) and on until the decode joins the stream of the next
+// chunk, so that instructions straddling the boundary are seen once.
+static void sweep(const rv_image_t *img, chunk_t *c, const chunk_t *next)
+{
+    const rv_section_t *s = c->s;
+    rv_uint64_t pc = c->lo, target;
+    rv_uint32_t after = c->lo == s->addr ? RV_FUNC_BOUNDARY : 0;
+    inst_t ir, prev;
+    int len, err = 0;
+
+    bzero(&prev, sizeof prev);
+    for (;;)
+    {
+        int flow;
+
+        if (pc >= c->hi && !after && (c->last || in_head(next, pc) || next->nhead == 0 || pc > next->head[next->nhead - 1]))
+            break;
+        if ((len = decode(s, pc, &ir)) == 0)
+            break;
+
+        if (is_pad(&ir))
+        {
+            if (after)
+                after |= RV_FUNC_PADDED;
+            prev = ir;
+            pc += len;
+            continue;
+        }
+        if (after)
+            err |= add(c, pc, pc, after | (prologue(s, pc) ? RV_FUNC_PROLOGUE : 0));
+        after = 0;
+
+        flow = rv_flow(&ir, &target);
+        if (flow == RV_FLOW_CALL || far_call(&prev, &ir, &target))
+        {
+            if (!(target & 1) && rv_image_section(img, target))
+                err |= add(c, target, pc, RV_FUNC_CALLED);
+        }
+        if (flow == RV_FLOW_RET || flow == RV_FLOW_JUMP || flow == RV_FLOW_IJUMP || flow == RV_FLOW_STOP)
+            after = RV_FUNC_BOUNDARY;
+        prev = ir;
+        pc += len;
+    }
+    c->stop = pc;
+    c->failed = err;
+}
+
+static void sweep_task(void *arg, int id, int n)
+{
+    sweep_t *w = arg;
+    size_t i;
+
+    while ((i = atomic_fetch_add(&w->next, 1)) < w->count)
+        sweep(w->img, &w->chunks[i], w->chunks[i].last ? 0 : &w->chunks[i + 1]);
+}
+
+static int cmp_cand(const void *a, const void *b)
+{
+    const cand_t *x = a, *y = b;
+    return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+static int accept(rv_uint32_t flags)
+{
+    if (flags & (RV_FUNC_SYMBOL | RV_FUNC_ENTRY | RV_FUNC_CALLED))
+        return 1;
+    return (flags & RV_FUNC_BOUNDARY) && (flags & (RV_FUNC_PROLOGUE | RV_FUNC_PADDED));
+}
+
+rv_func_t *rv_func_detect(const rv_image_t *img, int nthreads, size_t *count)
+{
+    sweep_t w;
+    cand_t *all = 0;
+    rv_func_t *f = 0;
+    size_t i, j, n = 0, nf = 0;
+
+    *count = 0;
+    bzero(&w, sizeof w);
+    w.img = img;
+    atomic_init(&w.next, 0);
+    for (i = 0; i < img->nsections; i++)
+    {
+        if (img->sections[i].exec)
+            w.count += (img->sections[i].size + FN_CHUNK - 1) / FN_CHUNK;
+    }
+    w.chunks = rv_calloc(w.count ? w.count : 1, sizeof *w.chunks);
+    if (w.chunks == 0)
+        return 0;
+    for (i = 0, j = 0; i < img->nsections; i++)
+    {
+        const rv_section_t *s = &img->sections[i];
+        rv_uint64_t lo;
+        if (!s->exec)
+            continue;
+        for (lo = s->addr; lo < s->addr + s->size; lo += FN_CHUNK, j++)
+        {
+            w.chunks[j].s = s;
+            w.chunks[j].lo = lo;
+            w.chunks[j].hi = lo + FN_CHUNK < s->addr + s->size ? lo + FN_CHUNK : s->addr + s->size;
+            w.chunks[j].last = w.chunks[j].hi == s->addr + s->size;
+        }
+    }
+
+    nthreads = rv_nthreads(nthreads);
+    rv_parallel(nthreads, head_task, &w);
+    rv_parallel(nthreads, sweep_task, &w);
+
+    n = 1 + img->nsymbols;
+    for (i = 0; i < w.count; i++)
+    {
+        if (w.chunks[i].failed)
+            goto out;
+        n += w.chunks[i].n;
+    }
+    all = rv_malloc(n * sizeof *all);
+    if (all == 0)
+        goto out;
+    n = 0;
+    all[n].pc = img->entry;
+    all[n++].flags = RV_FUNC_ENTRY;
+    for (i = 0; i < img->nsymbols; i++)
+    {
+        all[n].pc = img->symbols[i].addr;
+        all[n++].flags = RV_FUNC_SYMBOL;
+    }
+    // evidence seen below the previous chunk's stop was seen by it in step;
+    // this chunk may have decoded that stretch out of step
+    for (i = 0; i < w.count; i++)
+    {
+        const chunk_t *c = &w.chunks[i];
+        rv_uint64_t floor = i > 0 && !w.chunks[i - 1].last ? w.chunks[i - 1].stop : 0;
+        for (j = 0; j < c->n; j++)
+        {
+            if (c->c[j].site >= floor)
+                all[n++] = c->c[j];
+        }
+    }
+    qsort(all, n, sizeof *all, cmp_cand);
+
+    // merge the evidence per address
+    for (i = 0, j = 0; i < n; i++)
+    {
+        if (j > 0 && all[j - 1].pc == all[i].pc)
+            all[j - 1].flags |= all[i].flags;
+        else
+            all[j++] = all[i];
+    }
+    n = j;
+
+    f = rv_malloc((n ? n : 1) * sizeof *f);
+    if (f == 0)
+        goto out;
+    for (i = 0; i < n; i++)
+    {
+        const rv_section_t *s = rv_image_section(img, all[i].pc);
+        if (s == 0 || !accept(all[i].flags))
+            continue;
+        if (nf > 0 && f[nf - 1].end > all[i].pc)
+            f[nf - 1].end = all[i].pc;
+        f[nf].start = all[i].pc;
+        f[nf].end = s->addr + s->size;
+        f[nf].flags = all[i].flags;
+        f[nf].pad = 0;
+        nf++;
+    }
+    *count = nf;
+
+out:
+    for (i = 0; i < w.count; i++)
+        rv_free(w.chunks[i].c);
+    rv_free(w.chunks);
+    rv_free(all);
+    return f;
+}
+
+// function holding pc, 0 if none.
+const rv_func_t *rv_func_find(const rv_func_t *funcs, size_t count, rv_uint64_t pc)
+{
+    size_t lo = 0, hi = count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (funcs[mid].start <= pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0 || pc >= funcs[lo - 1].end)
+        return 0;
+    return &funcs[lo - 1];
+}
@@ -0,0 +1,46 @@
+#include <string.h>
+
+#include "hash.h"
+
+#define HASH_K0 0x9e3779b97f4a7c15ull
+#define HASH_K1 0xbf58476d1ce4e5b9ull
+#define HASH_K2 0x94d049bb133111ebull
+
+static rv_uint64_t fmix(rv_uint64_t h)
+{
+    h ^= h >> 30;
+    h *= HASH_K1;
+    h ^= h >> 27;
+    h *= HASH_K2;
+    h ^= h >> 31;
+    return h;
+}
+
+rv_uint64_t rv_hash_mix(rv_uint64_t h, rv_uint64_t v)
+{
+    v *= HASH_K0;
+    v ^= v >> 32;
+    return (h ^ v) * HASH_K1 + HASH_K2;
+}
+
+// word at a time hash, not cryptographic. Words are read in host order, so
+// values differ between little and big-endian hosts.
+rv_uint64_t rv_hash64(const void *data, size_t size, rv_uint64_t seed)
+{
+    const rv_uint8_t *p = data;
+    rv_uint64_t h = seed ^ (size * HASH_K0);
+    rv_uint64_t w;
+
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        memcpy(&w, p, 8);
+        h = rv_hash_mix(h, w);
+    }
+    if (size)
+    {
+        w = 0;
+        memcpy(&w, p, size);
+        h = rv_hash_mix(h, w);
+    }
+    return fmix(h);
+}
@@ -0,0 +1,11 @@
+#ifndef __RV_HASH_H
+#define __RV_HASH_H
+
+#include <stddef.h>
+
+#include "rv-dec.h"
+
+extern rv_uint64_t rv_hash64(const void *data, size_t size, rv_uint64_t seed);
+extern rv_uint64_t rv_hash_mix(rv_uint64_t h, rv_uint64_t v);
+
+#endif // __RV_HASH_H
@@ -0,0 +1,327 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rv-image.h"
+#include "alloc.h"
+
+#define EM_RISCV 243
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_DYNSYM 11
+#define SHF_ALLOC 2
+#define SHF_EXECINSTR 4
+#define STT_FUNC 2
+
+typedef struct
+{
+    rv_uint32_t name;
+    rv_uint32_t type;
+    rv_uint64_t flags;
+    rv_uint64_t addr;
+    rv_uint64_t offset;
+    rv_uint64_t size;
+    rv_uint32_t link;
+    rv_uint64_t entsize;
+} shdr_t;
+
+static rv_uint64_t rd(const rv_uint8_t *p, int n)
+{
+    rv_uint64_t v = 0;
+    int i;
+
+    for (i = n - 1; i >= 0; i--)
+        v = v << 8 | p[i];
+    return v;
+}
+
+// reads section header i into sh, in either elf class.
+static int read_shdr(const rv_uint8_t *map, size_t size, int is64, rv_uint64_t shoff, rv_uint32_t shentsize, size_t i, shdr_t *sh)
+{
+    const rv_uint8_t *p;
+
+    if (shoff + (i + 1) * shentsize > size)
+        return -1;
+    p = map + shoff + i * shentsize;
+    sh->name = rd(p, 4);
+    sh->type = rd(p + 4, 4);
+    if (is64)
+    {
+        sh->flags = rd(p + 8, 8);
+        sh->addr = rd(p + 16, 8);
+        sh->offset = rd(p + 24, 8);
+        sh->size = rd(p + 32, 8);
+        sh->link = rd(p + 40, 4);
+        sh->entsize = rd(p + 56, 8);
+    }
+    else
+    {
+        sh->flags = rd(p + 8, 4);
+        sh->addr = rd(p + 12, 4);
+        sh->offset = rd(p + 16, 4);
+        sh->size = rd(p + 20, 4);
+        sh->link = rd(p + 24, 4);
+        sh->entsize = rd(p + 36, 4);
+    }
+    return 0;
+}
+
+static int cmp_section(const void *a, const void *b)
+{
+    const rv_section_t *x = a, *y = b;
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static int cmp_symbol(const void *a, const void *b)
+{
+    const rv_symbol_t *x = a, *y = b;
+    if (x->addr != y->addr)
+        return x->addr < y->addr ? -1 : 1;
+    return x->size > y->size ? -1 : x->size < y->size;
+}
+
+static const char *strtab_at(const rv_uint8_t *map, size_t size, const shdr_t *strtab, rv_uint32_t off)
+{
+    if (strtab == 0 || off >= strtab->size || strtab->offset + strtab->size > size)
+        return "";
+    if (memchr(map + strtab->offset + off, 0, strtab->size - off) == 0)
+        return "";
+    return (const char *)map + strtab->offset + off;
+}
+
+static int load_symbols(rv_image_t *img, const rv_uint8_t *map, size_t size, int is64, const shdr_t *symtab, const shdr_t *strtab)
+{
+    size_t entsize = is64 ? 24 : 16;
+    size_t i, n;
+    rv_symbol_t *syms;
+
+    if (symtab->offset + symtab->size > size)
+        return -1;
+    n = symtab->size / entsize;
+    syms = rv_realloc(img->symbols, (img->nsymbols + n) * sizeof *syms);
+    if (syms == 0)
+        return -1;
+    img->symbols = syms;
+
+    for (i = 1; i < n; i++)
+    {
+        const rv_uint8_t *p = map + symtab->offset + i * entsize;
+        rv_symbol_t *s = &img->symbols[img->nsymbols];
+        int info = is64 ? p[4] : p[12];
+        rv_uint16_t shndx = is64 ? rd(p + 6, 2) : rd(p + 14, 2);
+
+        if ((info & 0xf) != STT_FUNC || shndx == 0)
+            continue;
+        s->name = strtab_at(map, size, strtab, rd(p, 4));
+        s->addr = is64 ? rd(p + 8, 8) : rd(p + 4, 4);
+        s->size = is64 ? rd(p + 16, 8) : rd(p + 8, 4);
+        img->nsymbols++;
+    }
+    return 0;
+}
+
+static int load_elf(rv_image_t *img, const rv_uint8_t *map, size_t size)
+{
+    int is64 = map[4] == 2;
+    rv_uint64_t shoff;
+    rv_uint32_t shentsize, shnum, shstrndx;
+    shdr_t shstr, sh;
+    size_t i;
+
+    if (size < 52 || map[5] != 1 || rd(map + 18, 2) != EM_RISCV)
+        return -1;
+    img->xlen = is64 ? 64 : 32;
+    img->entry = is64 ? rd(map + 24, 8) : rd(map + 24, 4);
+    shoff = is64 ? rd(map + 40, 8) : rd(map + 32, 4);
+    shentsize = rd(map + (is64 ? 58 : 46), 2);
+    shnum = rd(map + (is64 ? 60 : 48), 2);
+    shstrndx = rd(map + (is64 ? 62 : 50), 2);
+    if (shentsize < (is64 ? 64u : 40u) || read_shdr(map, size, is64, shoff, shentsize, shstrndx, &shstr) < 0)
+        return -1;
+
+    img->sections = rv_calloc(shnum ? shnum : 1, sizeof *img->sections);
+    if (img->sections == 0)
+        return -1;
+    for (i = 0; i < shnum; i++)
+    {
+        rv_section_t *s;
+
+        if (read_shdr(map, size, is64, shoff, shentsize, i, &sh) < 0)
+            return -1;
+        if (sh.type == SHT_SYMTAB || sh.type == SHT_DYNSYM)
+        {
+            shdr_t strtab;
+            if (read_shdr(map, size, is64, shoff, shentsize, sh.link, &strtab) < 0 ||
+                load_symbols(img, map, size, is64, &sh, &strtab) < 0)
+                return -1;
+            continue;
+        }
+        if (sh.type != SHT_PROGBITS || !(sh.flags & SHF_ALLOC) || sh.offset + sh.size > size)
+            continue;
+        s = &img->sections[img->nsections++];
+        s->name = strtab_at(map, size, &shstr, sh.name);
+        s->addr = sh.addr;
+        s->size = sh.size;
+        s->data = map + sh.offset;
+        s->exec = (sh.flags & SHF_EXECINSTR) != 0;
+    }
+    return 0;
+}
+
+static void image_sort(rv_image_t *img)
+{
+    size_t i, n = 0;
+
+    qsort(img->sections, img->nsections, sizeof *img->sections, cmp_section);
+    qsort(img->symbols, img->nsymbols, sizeof *img->symbols, cmp_symbol);
+
+    // one symbol per address, the largest one wins
+    for (i = 0; i < img->nsymbols; i++)
+    {
+        if (n && img->symbols[n - 1].addr == img->symbols[i].addr)
+            continue;
+        img->symbols[n++] = img->symbols[i];
+    }
+    img->nsymbols = n;
+}
+
+// maps an elf file, or a raw image loaded at base.
+rv_image_t *rv_image_open(const char *path, rv_uint64_t base)
+{
+    rv_image_t *img;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    if (st.st_size >= 4 && memcmp(map, "\177ELF", 4) == 0)
+    {
+        img = rv_calloc(1, sizeof *img);
+        if (img == 0 || load_elf(img, map, st.st_size) < 0)
+        {
+            if (img)
+                rv_image_close(img);
+            munmap(map, st.st_size);
+            return 0;
+        }
+        image_sort(img);
+    }
+    else
+    {
+        img = rv_image_raw(base, map, st.st_size);
+        if (img == 0)
+        {
+            munmap(map, st.st_size);
+            return 0;
+        }
+    }
+    img->map = map;
+    img->map_size = st.st_size;
+    return img;
+}
+
+// wraps a caller-owned buffer as one executable section.
+rv_image_t *rv_image_raw(rv_uint64_t base, const rv_uint8_t *code, size_t size)
+{
+    rv_image_t *img = rv_calloc(1, sizeof *img);
+
+    if (img == 0)
+        return 0;
+    img->sections = rv_calloc(1, sizeof *img->sections);
+    if (img->sections == 0)
+    {
+        rv_free(img);
+        return 0;
+    }
+    img->xlen = 64;
+    img->entry = base;
+    img->nsections = 1;
+    img->sections[0].name = ".text";
+    img->sections[0].addr = base;
+    img->sections[0].size = size;
+    img->sections[0].data = code;
+    img->sections[0].exec = 1;
+    return img;
+}
+
+void rv_image_close(rv_image_t *img)
+{
+    if (img == 0)
+        return;
+    if (img->map)
+        munmap(img->map, img->map_size);
+    rv_free(img->sections);
+    rv_free(img->symbols);
+    rv_free(img);
+}
+
+static const rv_section_t *find_section(const rv_image_t *img, rv_uint64_t addr)
+{
+    size_t lo = 0, hi = img->nsections;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        const rv_section_t *s = &img->sections[mid];
+        if (addr < s->addr)
+            hi = mid;
+        else if (addr >= s->addr + s->size)
+            lo = mid + 1;
+        else
+            return s;
+    }
+    return 0;
+}
+
+// executable section holding addr.
+const rv_section_t *rv_image_section(const rv_image_t *img, rv_uint64_t addr)
+{
+    const rv_section_t *s = find_section(img, addr);
+    return s && s->exec ? s : 0;
+}
+
+// function symbol starting at, or covering, addr.
+const rv_symbol_t *rv_image_symbol(const rv_image_t *img, rv_uint64_t addr)
+{
+    size_t lo = 0, hi = img->nsymbols;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (img->symbols[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return 0;
+    if (img->symbols[lo - 1].addr == addr || addr < img->symbols[lo - 1].addr + img->symbols[lo - 1].size)
+        return &img->symbols[lo - 1];
+    return 0;
+}
+
+// copies size bytes at addr from any loaded section.
+int rv_image_read(const rv_image_t *img, rv_uint64_t addr, void *buf, size_t size)
+{
+    const rv_section_t *s = find_section(img, addr);
+
+    if (s == 0 || addr + size > s->addr + s->size)
+        return -1;
+    memcpy(buf, s->data + (addr - s->addr), size);
+    return 0;
+}
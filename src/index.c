@@ -0,0 +1,339 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-index.h"
+#include "alloc.h"
+#include "par.h"
+
+#define INDEX_MAGIC "RVIX"
+#define INDEX_VERSION 1
+
+typedef struct
+{
+    char magic[4];
+    rv_uint32_t version;
+    rv_uint64_t base;
+    rv_uint64_t size;
+    rv_uint64_t bytes;
+    rv_uint64_t count;
+    rv_uint32_t step;
+    rv_uint32_t pad;
+} index_hdr_t;
+
+typedef struct
+{
+    rv_uint64_t pc;
+    rv_uint64_t off;
+} cursor_t;
+
+typedef struct
+{
+    rv_uint64_t start; // first boundary, assumed to be the chunk address until fixed up
+    rv_uint64_t end;   // first boundary at or after the chunk end
+    rv_uint64_t bytes; // listing bytes from start to end
+    size_t first;      // checkpoints [first, last) live in this chunk
+    size_t last;
+} chunk_t;
+
+typedef struct
+{
+    rv_index_t *idx;
+    const rv_uint8_t *code;
+    chunk_t *chunks;
+    size_t nchunks;
+    atomic_size_t next;
+} build_t;
+
+// renders the line at pc into buf and fills line with it; returns the full
+// listing line length, or 0 at end of code. A line longer than buf is cut
+// short in line but still counted in full.
+static int render(const rv_uint8_t *code, rv_uint64_t base, rv_uint64_t size, rv_uint64_t pc, rv_line_t *line, char *buf, size_t bufsize)
+{
+    inst_t ir;
+    mnemonic_t m;
+    int len, n;
+
+    if (pc < base || pc >= base + size)
+        return 0;
+    len = rv_dis_decode(pc, code + (pc - base), size - (pc - base), &ir, &line->raw);
+    if (len == 0)
+        return 0;
+    rv_disasm(&ir, &m);
+    n = rv_format_line(pc, line->raw, len, &m, buf, bufsize);
+    rv_mnemonic_free(&m);
+
+    line->pc = pc;
+    line->len = len;
+    line->gen = 0;
+    line->text = strchr(strchr(buf, '\t') + 1, '\t') + 1;
+    line->tlen = (n < (int)bufsize ? n : (int)bufsize) - (line->text - buf) - 1;
+    line->text[line->tlen] = 0; // newline
+    return n;
+}
+
+static int step_line(const build_t *b, cursor_t *c)
+{
+    rv_line_t line;
+    char buf[RV_LINE_MAX];
+    int n = render(b->code, b->idx->base, b->idx->size, c->pc, &line, buf, sizeof buf);
+
+    if (n == 0)
+        return 0;
+    c->pc += line.len;
+    c->off += n;
+    return 1;
+}
+
+// walks from c until c->pc >= stop, recording checkpoints [*next, last) as
+// soon as a boundary reaches their address.
+static void walk(const build_t *b, cursor_t *c, rv_uint64_t stop, size_t *next, size_t last)
+{
+    rv_index_t *idx = b->idx;
+
+    for (;;)
+    {
+        while (*next < last && idx->base + (rv_uint64_t)*next * idx->step <= c->pc)
+        {
+            idx->cp[*next].pc = c->pc;
+            idx->cp[*next].offset = c->off;
+            (*next)++;
+        }
+        if (c->pc >= stop || !step_line(b, c))
+            break;
+    }
+    for (; *next < last; (*next)++)
+    {
+        idx->cp[*next].pc = c->pc;
+        idx->cp[*next].offset = c->off;
+    }
+}
+
+// each chunk is decoded as if its first byte started an instruction, with
+// offsets relative to that start.
+static void build_task(void *arg, int id, int n)
+{
+    build_t *b = arg;
+    size_t k;
+
+    while ((k = atomic_fetch_add(&b->next, 1)) < b->nchunks)
+    {
+        chunk_t *ch = &b->chunks[k];
+        rv_uint64_t stop = b->idx->base + (rv_uint64_t)ch->last * b->idx->step;
+        cursor_t c = {.pc = ch->start, .off = 0};
+        size_t next = ch->first;
+
+        walk(b, &c, stop, &next, ch->last);
+        ch->end = c.pc;
+        ch->bytes = c.off;
+    }
+}
+
+// rebases chunk k on the real boundary where chunk k-1 ended. a misaligned
+// start converges after a few instructions: only the checkpoints up to the
+// meeting point are recomputed, the others are shifted.
+static void fixup(build_t *b, size_t k, cursor_t at)
+{
+    rv_index_t *idx = b->idx;
+    chunk_t *ch = &b->chunks[k];
+    cursor_t a = {.pc = at.pc, .off = 0};
+    cursor_t c = {.pc = ch->start, .off = 0};
+    cursor_t r = at;
+    size_t i, next = ch->first, last = ch->first;
+
+    while (a.pc != c.pc && a.pc < ch->end)
+    {
+        if (!step_line(b, a.pc < c.pc ? &a : &c))
+            break;
+    }
+
+    if (a.pc != c.pc)
+    {
+        // never re-synchronized inside the chunk
+        walk(b, &r, idx->base + (rv_uint64_t)ch->last * idx->step, &next, ch->last);
+        ch->start = at.pc;
+        ch->end = r.pc;
+        ch->bytes = r.off - at.off;
+        return;
+    }
+
+    for (i = ch->first; i < ch->last; i++)
+    {
+        if (idx->base + (rv_uint64_t)i * idx->step <= a.pc)
+            last = i + 1;
+        else
+            idx->cp[i].offset = idx->cp[i].offset - c.off + at.off + a.off;
+    }
+    walk(b, &r, a.pc, &next, last);
+    ch->bytes = ch->bytes - c.off + a.off;
+    ch->start = at.pc;
+}
+
+rv_index_t *rv_index_build(rv_uint64_t base, const rv_uint8_t *code, size_t size, rv_uint32_t step, int nthreads)
+{
+    rv_index_t *idx = rv_calloc(1, sizeof *idx);
+    build_t b;
+    size_t per, k;
+    cursor_t at = {.pc = base, .off = 0};
+
+    if (idx == 0)
+        return 0;
+    if (step < 16)
+        step = 16;
+    step = (step + 1) & ~1u;
+    idx->base = base;
+    idx->size = size;
+    idx->step = step;
+    idx->count = (size + step - 1) / step;
+    idx->cp = rv_calloc(idx->count ? idx->count : 1, sizeof *idx->cp);
+    if (idx->cp == 0)
+    {
+        rv_free(idx);
+        return 0;
+    }
+
+    nthreads = rv_nthreads(nthreads);
+    b.idx = idx;
+    b.code = code;
+    b.nchunks = idx->count < (size_t)nthreads * 8 ? idx->count : (size_t)nthreads * 8;
+    b.chunks = rv_calloc(b.nchunks ? b.nchunks : 1, sizeof *b.chunks);
+    atomic_init(&b.next, 0);
+    if (b.chunks == 0)
+    {
+        rv_index_free(idx);
+        return 0;
+    }
+    per = b.nchunks ? (idx->count + b.nchunks - 1) / b.nchunks : 0;
+    for (k = 0; k < b.nchunks; k++)
+    {
+        b.chunks[k].first = k * per < idx->count ? k * per : idx->count;
+        b.chunks[k].last = (k + 1) * per < idx->count ? (k + 1) * per : idx->count;
+        b.chunks[k].start = base + (rv_uint64_t)b.chunks[k].first * step;
+    }
+
+    rv_parallel(nthreads, build_task, &b);
+
+    for (k = 0; k < b.nchunks; k++)
+    {
+        chunk_t *ch = &b.chunks[k];
+        size_t i;
+
+        if (ch->first == ch->last)
+            continue;
+        if (ch->start != at.pc)
+            fixup(&b, k, at);
+        else
+        {
+            for (i = ch->first; i < ch->last; i++)
+                idx->cp[i].offset += at.off;
+        }
+        at.pc = ch->end;
+        at.off += ch->bytes;
+    }
+    idx->bytes = at.off;
+
+    rv_free(b.chunks);
+    return idx;
+}
+
+void rv_index_free(rv_index_t *idx)
+{
+    if (idx == 0)
+        return;
+    rv_free(idx->cp);
+    rv_free(idx);
+}
+
+int rv_index_save(const rv_index_t *idx, FILE *f)
+{
+    index_hdr_t h;
+
+    bzero(&h, sizeof h);
+    memcpy(h.magic, INDEX_MAGIC, 4);
+    h.version = INDEX_VERSION;
+    h.base = idx->base;
+    h.size = idx->size;
+    h.bytes = idx->bytes;
+    h.count = idx->count;
+    h.step = idx->step;
+    if (fwrite(&h, sizeof h, 1, f) != 1)
+        return -1;
+    if (idx->count && fwrite(idx->cp, sizeof *idx->cp, idx->count, f) != idx->count)
+        return -1;
+    return 0;
+}
+
+rv_index_t *rv_index_load(FILE *f)
+{
+    index_hdr_t h;
+    rv_index_t *idx;
+
+    if (fread(&h, sizeof h, 1, f) != 1)
+        return 0;
+    if (memcmp(h.magic, INDEX_MAGIC, 4) != 0 || h.version != INDEX_VERSION || h.step == 0)
+        return 0;
+    if (h.count != (h.size + h.step - 1) / h.step)
+        return 0;
+
+    idx = rv_calloc(1, sizeof *idx);
+    if (idx == 0)
+        return 0;
+    idx->base = h.base;
+    idx->size = h.size;
+    idx->bytes = h.bytes;
+    idx->step = h.step;
+    idx->count = h.count;
+    idx->cp = rv_malloc((h.count ? h.count : 1) * sizeof *idx->cp);
+    if (idx->cp == 0 || (h.count && fread(idx->cp, sizeof *idx->cp, h.count, f) != h.count))
+    {
+        rv_index_free(idx);
+        return 0;
+    }
+    return idx;
+}
+
+// nearest checkpoint at or before pc, in O(1).
+const rv_checkpoint_t *rv_index_lookup(const rv_index_t *idx, rv_uint64_t pc)
+{
+    size_t i;
+
+    if (idx->count == 0 || pc < idx->base)
+        return 0;
+    i = (pc - idx->base) / idx->step;
+    if (i >= idx->count)
+        i = idx->count - 1;
+    while (i > 0 && idx->cp[i].pc > pc)
+        i--;
+    return &idx->cp[i];
+}
+
+// calls cb for each line overlapping [lo, hi), decoding from the nearest
+// checkpoint. line->gen is unused here; the line text only lives during the
+// callback. returns the number of lines or -1 if lo is out of range.
+int rv_index_window(const rv_index_t *idx, const rv_uint8_t *code, rv_uint64_t lo, rv_uint64_t hi, rv_line_cb cb, void *arg)
+{
+    const rv_checkpoint_t *cp = rv_index_lookup(idx, lo);
+    rv_uint64_t pc;
+    rv_line_t line;
+    char buf[RV_LINE_MAX], *big;
+    int n = 0, len;
+
+    if (cp == 0)
+        return -1;
+    for (pc = cp->pc; pc < hi; pc += line.len)
+    {
+        if ((len = render(code, idx->base, idx->size, pc, &line, buf, sizeof buf)) == 0)
+            break;
+        if (pc + line.len <= lo)
+            continue;
+        // the callback gets the whole line even past RV_LINE_MAX
+        big = len < (int)sizeof buf ? 0 : rv_malloc(len + 1);
+        if (big)
+            render(code, idx->base, idx->size, pc, &line, big, len + 1);
+        if (cb)
+            cb(arg, &line);
+        rv_free(big);
+        n++;
+    }
+    return n;
+}
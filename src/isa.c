@@ -0,0 +1,525 @@
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include "rv-isa.h"
+
+#define ISA_OK 1
+#define ISA_CHECK 2 // extension or xlen also depend on fields below funct3
+#define ISA_REMAP 4 // compressed encoding whose meaning depends on xlen
+
+typedef struct
+{
+    const char *name;
+    int ext; // RV_EXT_COUNT: no instructions of its own
+} ext_name_t;
+
+static _Thread_local const rv_isa_t *current;
+
+static const char *ext_names[RV_EXT_COUNT] = {
+    "i", "m", "a", "f", "d", "q", "zfh", "c", "b", "k", "v", "zicsr", "custom",
+};
+
+const char *rv_ext_name(int ext)
+{
+    return ext >= 0 && ext < RV_EXT_COUNT ? ext_names[ext] : "?";
+}
+
+static int fp_fmt(rv_uint32_t fmt)
+{
+    static const int ext[4] = {RV_EXT_F, RV_EXT_D, RV_EXT_ZFH, RV_EXT_Q};
+    return ext[fmt & 3];
+}
+
+static int op_class(rv_uint32_t f3, rv_uint32_t f7)
+{
+    switch (f7)
+    {
+    case 0x00:
+        return RV_EXT_I;
+    case 0x01:
+        return RV_EXT_M;
+    case 0x20:
+        return f3 == 0 || f3 == 5 ? RV_EXT_I : RV_EXT_B; // sub, sra; andn, orn, xnor
+    case 0x04: // pack, zext.h
+    case 0x05: // min, max, clmul
+    case 0x10: // shNadd
+    case 0x24: // bclr, bext
+    case 0x30: // rol, ror
+    case 0x34: // binv
+        return RV_EXT_B;
+    case 0x14:
+        return f3 == 1 ? RV_EXT_B : RV_EXT_K; // bset; xperm
+    }
+    return RV_EXT_K; // aes, sha, sm3, sm4
+}
+
+int rv_ext_class(rv_uint32_t raw)
+{
+    rv_uint32_t f3 = raw >> 12 & 7, f7 = raw >> 25, f6 = raw >> 26;
+
+    if ((raw & 3) != 3)
+        return RV_EXT_C;
+    switch (raw & 0x7f)
+    {
+    case 0x03: // load
+    case 0x0f: // misc-mem
+    case 0x17: // auipc
+    case 0x23: // store
+    case 0x37: // lui
+    case 0x63: // branch
+    case 0x67: // jalr
+    case 0x6f: // jal
+        return RV_EXT_I;
+
+    case 0x13: // op-imm
+        if (f3 == 1)
+        {
+            if (f6 == 0)
+                return RV_EXT_I;
+            if (f7 == 0x08 || raw >> 20 == 0x300 || raw >> 24 == 0x31)
+                return RV_EXT_K; // sha, sm3, aes64im, aes64ks1i
+            return RV_EXT_B;
+        }
+        if (f3 == 5)
+            return f6 == 0 || f6 == 0x10 ? RV_EXT_I : RV_EXT_B;
+        return RV_EXT_I;
+
+    case 0x1b: // op-imm-32
+        if (f3 == 0)
+            return RV_EXT_I;
+        return f7 == 0 || f7 == 0x20 ? RV_EXT_I : RV_EXT_B;
+
+    case 0x33: // op
+    case 0x3b: // op-32
+        return op_class(f3, f7);
+
+    case 0x2f:
+        return RV_EXT_A;
+
+    case 0x07: // load-fp
+    case 0x27: // store-fp
+        switch (f3)
+        {
+        case 1:
+            return RV_EXT_ZFH;
+        case 2:
+            return RV_EXT_F;
+        case 3:
+            return RV_EXT_D;
+        case 4:
+            return RV_EXT_Q;
+        }
+        return RV_EXT_V;
+
+    case 0x43: // fmadd
+    case 0x47: // fmsub
+    case 0x4b: // fnmsub
+    case 0x4f: // fnmadd
+    case 0x53: // op-fp
+        return fp_fmt(f7);
+
+    case 0x57:
+        return RV_EXT_V;
+
+    case 0x73: // system
+        return f3 == 0 || f3 == 4 ? RV_EXT_I : RV_EXT_ZICSR;
+    }
+    return RV_EXT_CUSTOM;
+}
+
+static int c_def(rv_uint32_t raw, int xlen)
+{
+    rv_uint8_t rd = raw >> 7 & 31, rdp = 8 + (raw >> 2 & 7), rs1p = 8 + (raw >> 7 & 7), rs2 = raw >> 2 & 31;
+
+    switch (rv_isa_key(raw))
+    {
+    case 0: // c.addi4spn
+        return (raw & 0xffff) ? rdp : 0;
+    case 1: // c.fld; c.lq
+        return xlen == 128 ? rdp : 0;
+    case 2: // c.lw
+        return rdp;
+    case 3: // c.flw; c.ld
+        return xlen == 32 ? 0 : rdp;
+    case 4: // zcb: c.lbu, c.lhu, c.lh; c.sb, c.sh
+        return (raw >> 10 & 7) < 2 ? rdp : 0;
+    case 8:  // c.addi
+    case 10: // c.li
+    case 11: // c.lui, c.addi16sp
+    case 16: // c.slli
+    case 18: // c.lwsp
+        return rd;
+    case 9: // c.jal; c.addiw
+        return xlen == 32 ? 1 : rd;
+    case 12: // c.srli, c.srai, c.andi, c.sub...
+        return rs1p;
+    case 17: // c.fldsp; c.lqsp
+        return xlen == 128 ? rd : 0;
+    case 19: // c.flwsp; c.ldsp
+        return xlen == 32 ? 0 : rd;
+    case 20: // c.jr, c.mv; c.ebreak, c.jalr, c.add
+        if (rs2)
+            return rd;
+        return raw >> 12 & 1 && rd ? 1 : 0;
+    }
+    return 0; // stores, c.j, c.beqz, c.bnez
+}
+
+int rv_int_def(rv_uint32_t raw, int xlen)
+{
+    rv_uint32_t f3 = raw >> 12 & 7, f7 = raw >> 25, rd = raw >> 7 & 31;
+
+    if ((raw & 3) != 3)
+        return c_def(raw, xlen);
+    switch (raw & 0x7f)
+    {
+    case 0x07: // load-fp, vector loads
+    case 0x0f: // fence, cbo
+    case 0x23: // store
+    case 0x27: // store-fp, vector stores
+    case 0x43: // fmadd
+    case 0x47: // fmsub
+    case 0x4b: // fnmsub
+    case 0x4f: // fnmadd
+    case 0x63: // branch
+        return 0;
+
+    case 0x53: // compares, fcvt.w*, fmv.x.*, fclass
+        return f7 >> 2 == 0x14 || f7 >> 2 == 0x18 || f7 >> 2 == 0x1c ? rd : 0;
+
+    case 0x57: // vset*, vmv.x.s, vcpop.m, vfirst.m
+        return f3 == 7 || (f3 == 2 && raw >> 26 == 0x10) ? rd : 0;
+
+    case 0x73: // csr*, hlv*
+        return f3 ? rd : 0;
+    }
+    return rd;
+}
+
+int rv_isa_key(rv_uint32_t raw)
+{
+    if ((raw & 3) != 3)
+        return (raw & 3) << 3 | (raw >> 13 & 7);
+    return 32 + ((raw >> 2 & 31) << 3 | (raw >> 12 & 7));
+}
+
+// extension of every encoding under key, -1 when the fields below funct3
+// decide, and the smallest xlen having them.
+static int key_class(int key, int xlen, int *min)
+{
+    rv_uint32_t raw;
+
+    *min = 32;
+    switch (key)
+    {
+    case 1:  // c.fld, c.lq
+    case 5:  // c.fsd, c.sq
+    case 17: // c.fldsp, c.lqsp
+    case 21: // c.fsdsp, c.sqsp
+        return xlen == 128 ? RV_EXT_C : RV_EXT_D;
+    case 3:  // c.flw, c.ld
+    case 7:  // c.fsw, c.sd
+    case 19: // c.flwsp, c.ldsp
+    case 23: // c.fswsp, c.sdsp
+        return xlen == 32 ? RV_EXT_F : RV_EXT_C;
+    case 12: // c.srli, c.srai, c.subw, c.addw
+    case 16: // c.slli
+        return xlen == 32 ? -1 : RV_EXT_C;
+    }
+    if (key < 32)
+        return RV_EXT_C;
+
+    raw = (key - 32) >> 3 << 2 | 3 | (key & 7) << 12;
+
+    switch (raw & 0x7f)
+    {
+    case 0x03: // ld, lwu; ldu
+        *min = (key & 7) == 3 || (key & 7) == 6 ? 64 : (key & 7) == 7 ? 128 : 32;
+        break;
+    case 0x23: // sd; sq
+    case 0x2f: // .d; .q
+        *min = (key & 7) == 3 ? 64 : (key & 7) == 4 ? 128 : 32;
+        break;
+    case 0x1b:
+    case 0x3b:
+        *min = 64;
+        return -1;
+    case 0x13:
+        if ((key & 7) == 1 || (key & 7) == 5)
+            return -1;
+        break;
+    case 0x33:
+    case 0x43:
+    case 0x47:
+    case 0x4b:
+    case 0x4f:
+    case 0x53:
+        return -1;
+    }
+    return rv_ext_class(raw);
+}
+
+static int key_remaps(int key, int xlen)
+{
+    switch (key)
+    {
+    case 1:
+    case 5:
+    case 17:
+    case 21:
+        return xlen < 128;
+    case 3:
+    case 7:
+    case 9: // c.jal, c.addiw
+    case 19:
+    case 23:
+        return xlen == 32;
+    }
+    return 0;
+}
+
+void rv_isa_compile(rv_isa_t *isa)
+{
+    int k, ext, min;
+
+    for (k = 0; k < RV_ISA_KEYS; k++)
+    {
+        rv_uint8_t v = 0;
+
+        ext = key_class(k, isa->xlen, &min);
+        if (isa->xlen >= min && (k >= 32 || (isa->ext & 1u << RV_EXT_C)))
+            v = ext < 0 ? ISA_CHECK : isa->ext & 1u << ext ? ISA_OK : 0;
+        if (v && key_remaps(k, isa->xlen))
+            v |= ISA_REMAP;
+        isa->dispatch[k] = v;
+    }
+}
+
+static const ext_name_t ext_names_long[] = {
+    {"zicsr", RV_EXT_ZICSR}, {"zifencei", RV_EXT_COUNT}, {"zicntr", RV_EXT_COUNT}, {"zihpm", RV_EXT_COUNT},
+    {"zihintpause", RV_EXT_COUNT}, {"zihintntl", RV_EXT_COUNT}, {"zicbom", RV_EXT_COUNT}, {"zicboz", RV_EXT_COUNT},
+    {"zicbop", RV_EXT_COUNT}, {"zmmul", RV_EXT_M}, {"zaamo", RV_EXT_A}, {"zalrsc", RV_EXT_A},
+    {"zfh", RV_EXT_ZFH}, {"zfhmin", RV_EXT_ZFH}, {"zca", RV_EXT_C}, {"zcf", RV_EXT_C},
+    {"zcd", RV_EXT_C}, {"zcb", RV_EXT_C}, {"zba", RV_EXT_B}, {"zbb", RV_EXT_B},
+    {"zbc", RV_EXT_B}, {"zbs", RV_EXT_B}, {"zbkb", RV_EXT_B}, {"zbkc", RV_EXT_B},
+    {"zbkx", RV_EXT_K}, {"zk", RV_EXT_K}, {"zkn", RV_EXT_K}, {"zknd", RV_EXT_K},
+    {"zkne", RV_EXT_K}, {"zknh", RV_EXT_K}, {"zks", RV_EXT_K}, {"zksed", RV_EXT_K},
+    {"zksh", RV_EXT_K}, {"zkr", RV_EXT_COUNT}, {"zkt", RV_EXT_COUNT}, {"zve32x", RV_EXT_V},
+    {"zve32f", RV_EXT_V}, {"zve64x", RV_EXT_V}, {"zve64f", RV_EXT_V}, {"zve64d", RV_EXT_V},
+    {0, 0},
+};
+
+// skips a version suffix: 2, 2p1
+static const char *skip_version(const char *s)
+{
+    while (isdigit((unsigned char)*s))
+        s++;
+    if (*s == 'p' && isdigit((unsigned char)s[1]))
+        for (s++; isdigit((unsigned char)*s); s++)
+            ;
+    return s;
+}
+
+static int parse_long(const char *s, size_t n)
+{
+    const ext_name_t *e;
+    const char *v;
+
+    // drops a version suffix; a trailing p not followed by digits is the name's
+    for (v = s + n; v > s && (isdigit((unsigned char)v[-1]) || v[-1] == 'p'); v--)
+        ;
+    if (v < s + n && *v == 'p')
+        v++;
+    n = v - s;
+    if (tolower((unsigned char)*s) == 'x')
+        return RV_EXT_CUSTOM;
+    if (tolower((unsigned char)*s) == 's')
+        return RV_EXT_COUNT;
+    if (strncasecmp(s, "zvl", 3) == 0)
+        return RV_EXT_COUNT;
+    for (e = ext_names_long; e->name; e++)
+        if (strlen(e->name) == n && strncasecmp(s, e->name, n) == 0)
+            return e->ext;
+    return -1;
+}
+
+int rv_isa_parse(const char *s, rv_isa_t *isa)
+{
+    static const char letters[] = "imafdqcbkv";
+    static const int exts[] = {RV_EXT_I, RV_EXT_M, RV_EXT_A, RV_EXT_F, RV_EXT_D, RV_EXT_Q, RV_EXT_C, RV_EXT_B, RV_EXT_K, RV_EXT_V};
+    rv_uint32_t ext = 0;
+    const char *p;
+    int xlen;
+
+    bzero(isa, sizeof *isa);
+    if (strncasecmp(s, "rv", 2) != 0)
+        return -1;
+    for (s += 2, xlen = 0; isdigit((unsigned char)*s); s++)
+        xlen = xlen * 10 + *s - '0';
+    if (xlen != 32 && xlen != 64 && xlen != 128)
+        return -1;
+
+    while (*s && *s != '_')
+    {
+        int c = tolower((unsigned char)*s);
+
+        if (c == 'z' || c == 's' || c == 'x')
+            break;
+        s++;
+        if (c == 'g')
+            ext |= 1u << RV_EXT_I | 1u << RV_EXT_M | 1u << RV_EXT_A | 1u << RV_EXT_F | 1u << RV_EXT_D | 1u << RV_EXT_ZICSR;
+        else if (c == 'e')
+            ext |= 1u << RV_EXT_I;
+        else if ((p = strchr(letters, c)) != 0)
+            ext |= 1u << exts[p - letters];
+        else if (c != 'h' && c != 'u' && c != 'n' && c != 'p' && c != 'j' && c != 't')
+            return -1;
+        s = skip_version(s);
+    }
+    while (*s)
+    {
+        size_t n;
+        int e;
+
+        if (*s == '_')
+        {
+            s++;
+            continue;
+        }
+        n = strcspn(s, "_");
+        if ((e = parse_long(s, n)) < 0)
+            return -1;
+        if (e < RV_EXT_COUNT)
+            ext |= 1u << e;
+        s += n;
+    }
+    if (!(ext & 1u << RV_EXT_I))
+        return -1;
+
+    if (ext & 1u << RV_EXT_Q)
+        ext |= 1u << RV_EXT_D;
+    if (ext & (1u << RV_EXT_D | 1u << RV_EXT_ZFH))
+        ext |= 1u << RV_EXT_F;
+    if (ext & (1u << RV_EXT_F | 1u << RV_EXT_V))
+        ext |= 1u << RV_EXT_ZICSR;
+    isa->ext = ext;
+    isa->xlen = xlen;
+    rv_isa_compile(isa);
+    return 0;
+}
+
+void rv_isa_select(const rv_isa_t *isa)
+{
+    current = isa;
+}
+
+const rv_isa_t *rv_isa_current(void)
+{
+    return current;
+}
+
+int rv_isa_xlen(void)
+{
+    return current ? current->xlen : 64;
+}
+
+rv_uint64_t rv_isa_seed(void)
+{
+    return current ? (rv_uint64_t)current->xlen << 32 | current->ext : 0;
+}
+
+static int refine(const rv_isa_t *isa, rv_uint32_t raw)
+{
+    rv_uint32_t f3 = raw >> 12 & 7, f7 = raw >> 25, rs2 = raw >> 20 & 31;
+
+    if (!(isa->ext & 1u << rv_ext_class(raw)))
+        return 0;
+    if (isa->xlen != 32)
+        return 1;
+
+    // what rv32 lacks: shift amounts above 31, the w forms, aes64 and the
+    // conversions to and from 64 bit integers
+    if ((raw & 3) != 3)
+        return !(raw >> 12 & 1) || ((raw & 3) == 1 && (raw >> 10 & 3) == 2); // c.andi
+    switch (raw & 0x7f)
+    {
+    case 0x13:
+        if (raw >> 20 == 0x300 || raw >> 24 == 0x31) // aes64im, aes64ks1i
+            return 0;
+        return !(raw >> 25 & 1); // also rev8, whose rv64 encoding sets it
+    case 0x33:
+        return f7 != 0x19 && f7 != 0x1b && f7 != 0x1d && f7 != 0x1f && f7 != 0x3f;
+    case 0x53:
+        if ((f7 >> 2 == 0x18 || f7 >> 2 == 0x1a) && (rs2 == 2 || rs2 == 3))
+            return 0;
+        return !((f7 == 0x71 || f7 == 0x79) && f3 == 0); // fmv.x.d, fmv.d.x
+    }
+    return 1;
+}
+
+static void set_c(inst_t *ir, int op, rv_uint8_t rd, rv_uint8_t rs1, rv_uint8_t rs2, rv_int64_t imm)
+{
+    ir->op = op;
+    ir->rd = rd;
+    ir->rs1 = rs1;
+    ir->rs2 = rs2;
+    ir->imm.i = imm;
+}
+
+// the decoder reads compressed encodings as rv64 does.
+static void remap(rv_uint32_t raw, inst_t *ir)
+{
+    rv_uint8_t r = 8 + (raw >> 2 & 7), rs1 = 8 + (raw >> 7 & 7), rd = raw >> 7 & 31, rs2 = raw >> 2 & 31;
+    rv_uint32_t off;
+
+    switch (rv_isa_key(raw))
+    {
+    case 1:
+        set_c(ir, RV_C_FLD, r, rs1, 0, (raw >> 10 & 7) << 3 | (raw >> 5 & 3) << 6);
+        break;
+    case 3:
+        set_c(ir, RV_C_FLW, r, rs1, 0, (raw >> 10 & 7) << 3 | (raw >> 6 & 1) << 2 | (raw >> 5 & 1) << 6);
+        break;
+    case 5:
+        set_c(ir, RV_C_FSD, 0, rs1, r, (raw >> 10 & 7) << 3 | (raw >> 5 & 3) << 6);
+        break;
+    case 7:
+        set_c(ir, RV_C_FSW, 0, rs1, r, (raw >> 10 & 7) << 3 | (raw >> 6 & 1) << 2 | (raw >> 5 & 1) << 6);
+        break;
+    case 9:
+        off = (raw >> 12 & 1) << 11 | (raw >> 11 & 1) << 4 | (raw >> 9 & 3) << 8 | (raw >> 8 & 1) << 10 | (raw >> 7 & 1) << 6 |
+              (raw >> 6 & 1) << 7 | (raw >> 3 & 7) << 1 | (raw >> 2 & 1) << 5;
+        set_c(ir, RV_C_JAL, 1, 0, 0, (rv_int64_t)(off ^ 0x800) - 0x800);
+        break;
+    case 17:
+        set_c(ir, RV_C_FLDSP, rd, 2, 0, (raw >> 12 & 1) << 5 | (raw >> 5 & 3) << 3 | (raw >> 2 & 7) << 6);
+        break;
+    case 19:
+        set_c(ir, RV_C_FLWSP, rd, 2, 0, (raw >> 12 & 1) << 5 | (raw >> 4 & 7) << 2 | (raw >> 2 & 3) << 6);
+        break;
+    case 21:
+        set_c(ir, RV_C_FSDSP, 0, 2, rs2, (raw >> 10 & 7) << 3 | (raw >> 7 & 7) << 6);
+        break;
+    case 23:
+        set_c(ir, RV_C_FSWSP, 0, 2, rs2, (raw >> 9 & 15) << 2 | (raw >> 7 & 3) << 6);
+        break;
+    }
+}
+
+int rv_isa_apply(const rv_isa_t *isa, rv_uint32_t raw, inst_t *ir)
+{
+    rv_uint8_t v = isa->dispatch[rv_isa_key(raw)];
+
+    if (v == ISA_OK)
+        return 1;
+    if (v == 0 || ((v & ISA_CHECK) && !refine(isa, raw)))
+    {
+        ir->op = RV_UNDEF;
+        ir->uimm = 0;
+        return 0;
+    }
+    if (v & ISA_REMAP)
+        remap(raw, ir);
+    return 1;
+}
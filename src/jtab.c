@@ -0,0 +1,557 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-isa.h"
+#include "rv-jtab.h"
+#include "alloc.h"
+#include "cfg.h"
+#include "par.h"
+
+#define JT_WINDOW 48 // instructions kept before the jump
+#define JT_BLOCKS 4  // fall-through blocks walked back looking for the bound
+#define JT_DEPTH 16
+
+enum
+{
+    V_CONST, // off
+    V_INDEX, // (index << shift) + off
+    V_LOAD,  // load(base + (index << shift)) + off
+};
+
+typedef struct
+{
+    int kind;
+    int shift;
+    int size;
+    int sign;
+    rv_int64_t off;
+    rv_int64_t base;
+} val_t;
+
+// straight-line code ending with the jump, with the compare-and-branch that
+// bounds the index when one was found.
+typedef struct
+{
+    inst_t ir[JT_WINDOW];
+    rv_uint32_t raw[JT_WINDOW];
+    int n;
+    int xlen;
+    int bpos;
+    rv_uint8_t idx;
+} slice_t;
+
+typedef struct
+{
+    const rv_image_t *img;
+    const rv_cfg_t *cfg;
+    rv_uint32_t *jumps;
+    rv_jtab_t *tabs;
+    size_t count;
+} scan_t;
+
+// ---------------------------------------------------------------- slice
+
+static int find_def(const slice_t *s, rv_uint8_t r, int p)
+{
+    while (--p >= 0)
+    {
+        if (rv_int_def(s->raw[p], s->xlen) == r)
+            return p;
+    }
+    return -1;
+}
+
+static int add(val_t *v, const val_t *a, const val_t *b)
+{
+    if (a->kind != V_CONST)
+    {
+        const val_t *t = a;
+        a = b;
+        b = t;
+    }
+    if (a->kind != V_CONST)
+        return -1;
+    *v = *b;
+    v->off += a->off;
+    return 0;
+}
+
+static int shift(val_t *v, int n)
+{
+    if (v->kind == V_LOAD || n < 0 || n > 63)
+        return -1;
+    if (v->kind == V_INDEX)
+        v->shift += n;
+    v->off = (rv_int64_t)((rv_uint64_t)v->off << n);
+    return 0;
+}
+
+static int eval(const slice_t *s, rv_uint8_t r, int p, int depth, val_t *v);
+
+static int eval_imm(const slice_t *s, rv_uint8_t r, int p, int depth, rv_int64_t imm, val_t *v)
+{
+    if (eval(s, r, p, depth, v) < 0)
+        return -1;
+    v->off += imm;
+    return 0;
+}
+
+static int eval_add(const slice_t *s, rv_uint8_t r1, rv_uint8_t r2, int p, int depth, val_t *v)
+{
+    val_t a, b;
+
+    if (eval(s, r1, p, depth, &a) < 0 || eval(s, r2, p, depth, &b) < 0)
+        return -1;
+    return add(v, &a, &b);
+}
+
+static int eval_load(const slice_t *s, const inst_t *ir, int p, int depth, int size, int sign, val_t *v)
+{
+    if (eval_imm(s, ir->rs1, p, depth, ir->imm.i, v) < 0 || v->kind != V_INDEX)
+        return -1;
+    v->kind = V_LOAD;
+    v->base = v->off;
+    v->off = 0;
+    v->size = size;
+    v->sign = sign;
+    return 0;
+}
+
+// value of register r just before instruction p.
+static int eval(const slice_t *s, rv_uint8_t r, int p, int depth, val_t *v)
+{
+    const inst_t *ir;
+    int d;
+
+    bzero(v, sizeof *v);
+    if (r == 0)
+        return 0;
+    d = find_def(s, r, p);
+    if (s->bpos >= 0 && r == s->idx && p > s->bpos && d < s->bpos)
+    {
+        v->kind = V_INDEX;
+        return 0;
+    }
+    if (d < 0 || depth == JT_DEPTH)
+        return -1;
+
+    ir = &s->ir[d];
+    depth++;
+    switch (ir->op)
+    {
+    case RV_LUI:
+    case RV_C_LUI:
+    case RV_C_LI:
+        v->off = ir->imm.i;
+        return 0;
+
+    case RV_AUIPC:
+        v->off = ir->pc + ir->imm.i;
+        return 0;
+
+    case RV_ADDI:
+    case RV_ADDIW:
+        if (eval_imm(s, ir->rs1, d, depth, ir->imm.i, v) < 0)
+            return -1;
+        break;
+
+    case RV_C_ADDI:
+    case RV_C_ADDIW:
+        if (eval_imm(s, ir->rd, d, depth, ir->imm.i, v) < 0)
+            return -1;
+        break;
+
+    case RV_C_MV:
+        return eval(s, ir->rs2, d, depth, v);
+
+    case RV_ADD:
+    case RV_ADDW:
+        if (eval_add(s, ir->rs1, ir->rs2, d, depth, v) < 0)
+            return -1;
+        break;
+
+    case RV_C_ADD:
+        return eval_add(s, ir->rd, ir->rs2, d, depth, v);
+
+    case RV_SLLI:
+    case RV_SLLIW:
+        if (eval(s, ir->rs1, d, depth, v) < 0 || shift(v, ir->imm.i) < 0)
+            return -1;
+        break;
+
+    case RV_C_SLLI:
+        return eval(s, ir->rd, d, depth, v) < 0 ? -1 : shift(v, ir->imm.i);
+
+    case RV_LB:
+        return eval_load(s, ir, d, depth, 1, 1, v);
+    case RV_LBU:
+        return eval_load(s, ir, d, depth, 1, 0, v);
+    case RV_LH:
+        return eval_load(s, ir, d, depth, 2, 1, v);
+    case RV_LHU:
+        return eval_load(s, ir, d, depth, 2, 0, v);
+    case RV_LW:
+    case RV_C_LW:
+        return eval_load(s, ir, d, depth, 4, 1, v);
+    case RV_LWU:
+        return eval_load(s, ir, d, depth, 4, 0, v);
+    case RV_LD:
+    case RV_C_LD:
+        return eval_load(s, ir, d, depth, 8, 0, v);
+
+    default:
+        return -1;
+    }
+
+    // the w forms wrap to 32 bits, only constants can be folded exactly
+    if (v->kind == V_CONST && (ir->op == RV_ADDIW || ir->op == RV_C_ADDIW || ir->op == RV_ADDW || ir->op == RV_SLLIW))
+        v->off = (rv_int64_t)((rv_uint64_t)v->off << 32) >> 32;
+    return 0;
+}
+
+// ---------------------------------------------------------------- resolve
+
+// the decoded straight-line code of block b, preceded by the fall-through
+// blocks leading to it up to the first conditional branch.
+static int build_slice(const rv_image_t *img, const rv_cfg_t *cfg, rv_uint32_t b, slice_t *s)
+{
+    const rv_section_t *sec = rv_image_section(img, cfg->blocks[b].start);
+    rv_uint32_t first = b;
+    rv_uint64_t pc, end;
+    int k;
+
+    if (sec == 0)
+        return -1;
+    for (k = 1; k < JT_BLOCKS && first > 0; k++)
+    {
+        const rv_block_t *p = &cfg->blocks[first - 1];
+        if (p->start + p->size != cfg->blocks[first].start || p->start < sec->addr)
+            break;
+        if (p->flow != RV_FLOW_NONE && p->flow != RV_FLOW_BRANCH)
+            break;
+        first--;
+        if (p->flow == RV_FLOW_BRANCH)
+            break;
+    }
+
+    s->n = 0;
+    s->bpos = -1;
+    s->xlen = rv_isa_xlen();
+    pc = cfg->blocks[first].start;
+    end = cfg->blocks[b].start + cfg->blocks[b].size;
+    while (pc < end)
+    {
+        int len;
+
+        if (s->n == JT_WINDOW)
+        {
+            memmove(s->ir, s->ir + JT_WINDOW / 2, (JT_WINDOW - JT_WINDOW / 2) * sizeof *s->ir);
+            memmove(s->raw, s->raw + JT_WINDOW / 2, (JT_WINDOW - JT_WINDOW / 2) * sizeof *s->raw);
+            s->n -= JT_WINDOW / 2;
+        }
+        len = rv_dis_decode(pc, sec->data + (pc - sec->addr), sec->size - (pc - sec->addr), &s->ir[s->n], &s->raw[s->n]);
+        if (len == 0)
+            return -1;
+        s->n++;
+        pc += len;
+    }
+    return s->n ? 0 : -1;
+}
+
+// the jump block is the fall through of the branch, so the index is bounded
+// when the branch is not taken.
+static rv_uint64_t find_bound(slice_t *s)
+{
+    val_t v;
+    int p;
+
+    for (p = s->n - 2; p >= 0; p--)
+    {
+        const inst_t *ir = &s->ir[p];
+        rv_uint8_t idx, lim;
+        rv_uint64_t extra;
+
+        if (ir->op == RV_BGEU) // idx < lim
+        {
+            idx = ir->rs1;
+            lim = ir->rs2;
+            extra = 0;
+        }
+        else if (ir->op == RV_BLTU) // lim >= idx
+        {
+            idx = ir->rs2;
+            lim = ir->rs1;
+            extra = 1;
+        }
+        else
+            continue;
+
+        if (idx == 0 || eval(s, lim, p, 0, &v) < 0 || v.kind != V_CONST)
+            return 0;
+        s->bpos = p;
+        s->idx = idx;
+        return (rv_uint64_t)v.off + extra;
+    }
+    return 0;
+}
+
+static rv_uint64_t entry(const rv_uint8_t *p, int size, int sign)
+{
+    rv_uint64_t v = 0;
+    int i;
+
+    for (i = size - 1; i >= 0; i--)
+        v = v << 8 | p[i];
+    if (sign && size < 8)
+        v = (rv_uint64_t)((rv_int64_t)(v << (64 - size * 8)) >> (64 - size * 8));
+    return v;
+}
+
+int rv_jtab_resolve(const rv_image_t *img, const rv_cfg_t *cfg, rv_uint32_t b, rv_jtab_t *jt)
+{
+    slice_t s;
+    const inst_t *jr;
+    rv_uint8_t *raw = 0;
+    rv_uint64_t n;
+    val_t v;
+    size_t i;
+
+    bzero(jt, sizeof *jt);
+    if (b >= cfg->nblocks || cfg->blocks[b].flow != RV_FLOW_IJUMP || build_slice(img, cfg, b, &s) < 0)
+        return -1;
+    jr = &s.ir[s.n - 1];
+    n = find_bound(&s);
+    if (n == 0 || n > RV_JTAB_MAX)
+        return -1;
+    if (eval_imm(&s, jr->rs1, s.n - 1, 0, jr->op == RV_JALR ? jr->imm.i : 0, &v) < 0)
+        return -1;
+    if (v.kind == V_CONST || v.shift > 16 || (v.kind == V_INDEX && v.shift == 0))
+        return -1;
+    if (v.kind == V_LOAD && (1 << v.shift) < v.size)
+        return -1;
+
+    jt->pc = jr->pc;
+    jt->count = n;
+    jt->stride = v.shift;
+    jt->targets = rv_malloc(n * sizeof *jt->targets);
+    if (jt->targets == 0)
+        return -1;
+
+    if (v.kind == V_LOAD)
+    {
+        jt->table = v.base;
+        jt->esize = v.size;
+        jt->rel = v.off != 0;
+        raw = rv_malloc(n << v.shift);
+        if (raw == 0 || rv_image_read(img, v.base, raw, ((n - 1) << v.shift) + v.size) < 0)
+            goto fail;
+    }
+    else
+        jt->table = v.off;
+
+    for (i = 0; i < n; i++)
+    {
+        rv_uint64_t t = raw ? entry(raw + (i << v.shift), v.size, v.sign) + v.off : v.off + (i << v.shift);
+        if ((t & 1) || rv_image_section(img, t) == 0)
+            goto fail;
+        jt->targets[i] = t;
+    }
+    rv_free(raw);
+    return 0;
+
+fail:
+    rv_free(raw);
+    rv_free(jt->targets);
+    bzero(jt, sizeof *jt);
+    return -1;
+}
+
+// ---------------------------------------------------------------- scan
+
+static void scan_task(void *arg, int id, int n)
+{
+    scan_t *s = arg;
+    size_t i;
+
+    for (i = id; i < s->count; i += n)
+        rv_jtab_resolve(s->img, s->cfg, s->jumps[i], &s->tabs[i]);
+}
+
+// resolves s->jumps into s->tabs and moves the resolved tables to the
+// front, returns how many there are.
+static size_t scan_jumps(scan_t *s, int nthreads)
+{
+    size_t i, n = 0;
+
+    rv_parallel(rv_nthreads(nthreads), scan_task, s);
+    for (i = 0; i < s->count; i++)
+    {
+        if (s->tabs[i].count)
+            s->tabs[n++] = s->tabs[i];
+    }
+    return n;
+}
+
+rv_jtab_t *rv_jtab_scan(const rv_image_t *img, const rv_cfg_t *cfg, int nthreads, size_t *count)
+{
+    scan_t s;
+    size_t i, n = 0;
+
+    *count = 0;
+    bzero(&s, sizeof s);
+    s.img = img;
+    s.cfg = cfg;
+    for (i = 0; i < cfg->nblocks; i++)
+        s.count += cfg->blocks[i].flow == RV_FLOW_IJUMP;
+    s.jumps = rv_malloc((s.count ? s.count : 1) * sizeof *s.jumps);
+    s.tabs = rv_calloc(s.count ? s.count : 1, sizeof *s.tabs);
+    if (s.jumps == 0 || s.tabs == 0)
+    {
+        rv_free(s.jumps);
+        rv_free(s.tabs);
+        return 0;
+    }
+    for (i = 0; i < cfg->nblocks; i++)
+    {
+        if (cfg->blocks[i].flow == RV_FLOW_IJUMP)
+            s.jumps[n++] = i;
+    }
+
+    *count = scan_jumps(&s, nthreads);
+    rv_free(s.jumps);
+    return s.tabs;
+}
+
+void rv_jtab_free(rv_jtab_t *tabs, size_t count)
+{
+    size_t i;
+
+    for (i = 0; tabs && i < count; i++)
+        rv_free(tabs[i].targets);
+    rv_free(tabs);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    rv_uint64_t x = *(const rv_uint64_t *)a, y = *(const rv_uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_pc(const void *a, const void *b)
+{
+    const rv_jtab_t *x = a, *y = b;
+    return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+// the jump blocks of cfg not scanned yet, by the address after the jump,
+// which a later split of the block does not move.
+static int new_jumps(const rv_cfg_t *cfg, scan_t *s, rv_uint64_t **tried, size_t *ntried)
+{
+    rv_uint32_t *jumps = rv_realloc(s->jumps, (cfg->nblocks ? cfg->nblocks : 1) * sizeof *jumps);
+    rv_uint64_t *t;
+    size_t i, n = *ntried;
+
+    if (jumps == 0)
+        return -1;
+    s->jumps = jumps;
+    s->count = 0;
+    for (i = 0; i < cfg->nblocks; i++)
+    {
+        rv_uint64_t end = cfg->blocks[i].start + cfg->blocks[i].size;
+        if (cfg->blocks[i].flow == RV_FLOW_IJUMP && (*ntried == 0 || bsearch(&end, *tried, *ntried, sizeof end, cmp_u64) == 0))
+            jumps[s->count++] = i;
+    }
+    if (s->count == 0)
+        return 0;
+    t = rv_realloc(*tried, (n + s->count) * sizeof *t);
+    if (t == 0)
+        return -1;
+    for (i = 0; i < s->count; i++)
+        t[n++] = cfg->blocks[jumps[i]].start + cfg->blocks[jumps[i]].size;
+    qsort(t, n, sizeof *t, cmp_u64);
+    *tried = t;
+    *ntried = n;
+    return 0;
+}
+
+rv_cfg_t *rv_jtab_cfg(const rv_image_t *img, int nthreads, rv_jtab_t **tabs, size_t *count)
+{
+    rv_walk_t *w = rv_walk_new(img, nthreads);
+    rv_cfg_t *cfg = rv_calloc(1, sizeof *cfg);
+    rv_uint64_t *tried = 0, *entries = 0;
+    size_t ntried = 0, i, j;
+    scan_t s;
+
+    *tabs = 0;
+    *count = 0;
+    bzero(&s, sizeof s);
+    s.img = img;
+    s.cfg = cfg;
+    if (w == 0 || cfg == 0 || rv_walk_add(w, 0, 0) < 0)
+        goto fail;
+
+    // each round scans only the jumps the last walk found and walks on
+    // only from the case targets they resolved
+    for (;;)
+    {
+        size_t found, ncases = 0, k = 0;
+        rv_jtab_t *t;
+        rv_uint64_t *e;
+
+        if (rv_walk_cfg(w, cfg) < 0 || new_jumps(cfg, &s, &tried, &ntried) < 0)
+            goto fail;
+        if (s.count == 0)
+            break;
+        s.tabs = rv_calloc(s.count, sizeof *s.tabs);
+        if (s.tabs == 0)
+            goto fail;
+        found = scan_jumps(&s, nthreads);
+        t = rv_realloc(*tabs, (*count + found ? *count + found : 1) * sizeof *t);
+        if (t == 0)
+        {
+            rv_jtab_free(s.tabs, found);
+            s.tabs = 0;
+            goto fail;
+        }
+        *tabs = t;
+        for (i = 0; i < found; i++)
+        {
+            t[(*count)++] = s.tabs[i];
+            ncases += s.tabs[i].count;
+        }
+        rv_free(s.tabs);
+        s.tabs = 0;
+        if (ncases == 0)
+            break;
+
+        e = rv_realloc(entries, ncases * sizeof *e);
+        if (e == 0)
+            goto fail;
+        entries = e;
+        for (i = *count - found; i < *count; i++)
+        {
+            for (j = 0; j < t[i].count; j++)
+                entries[k++] = t[i].targets[j];
+        }
+        if (rv_walk_add(w, entries, k) < 0)
+            goto fail;
+    }
+    if (*count)
+        qsort(*tabs, *count, sizeof **tabs, cmp_pc);
+    rv_free(s.jumps);
+    rv_free(tried);
+    rv_free(entries);
+    rv_walk_free(w);
+    return cfg;
+
+fail:
+    rv_jtab_free(*tabs, *count);
+    *tabs = 0;
+    *count = 0;
+    rv_free(s.jumps);
+    rv_free(tried);
+    rv_free(entries);
+    rv_walk_free(w);
+    rv_cfg_free(cfg);
+    return 0;
+}
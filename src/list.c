@@ -0,0 +1,293 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-list.h"
+#include "alloc.h"
+
+struct rv_listing
+{
+    rv_uint64_t base;
+    const rv_uint8_t *code;
+    size_t size;
+
+    rv_line_t *lines;
+    size_t count;
+    size_t cap;
+
+    rv_uint32_t gen;  // bumped by every patch
+    rv_uint32_t seen; // generation returned by the last rv_listing_changes()
+    rv_uint64_t dirty_lo;
+    rv_uint64_t dirty_hi;
+};
+
+static int render_line(rv_line_t *line, inst_t *ir)
+{
+    mnemonic_t m;
+    char tmp[RV_TEXT_MAX];
+    int n;
+
+    rv_disasm(ir, &m);
+    n = rv_format(&m, tmp, sizeof tmp);
+    rv_mnemonic_free(&m);
+    if (n >= (int)sizeof tmp)
+        n = sizeof tmp - 1;
+    line->text = rv_malloc(n + 1);
+    if (line->text == 0)
+        return -1;
+    memcpy(line->text, tmp, n);
+    line->text[n] = 0;
+    line->tlen = n;
+    return 0;
+}
+
+// decodes the instruction at pc into line, returns its length or 0 at end
+// of code. The text is left to render_line().
+static int decode_line(rv_listing_t *l, rv_uint64_t pc, rv_line_t *line, inst_t *ir)
+{
+    size_t off = pc - l->base;
+    int len;
+
+    len = rv_dis_decode(pc, l->code + off, l->size - off, ir, &line->raw);
+    if (len == 0)
+        return 0;
+    line->pc = pc;
+    line->len = len;
+    line->gen = l->gen;
+    line->text = 0;
+    return len;
+}
+
+static int push_line(rv_line_t **lines, size_t *count, size_t *cap, const rv_line_t *line)
+{
+    if (*count == *cap)
+    {
+        size_t ncap = *cap ? *cap * 2 : 64;
+        rv_line_t *n = rv_realloc(*lines, ncap * sizeof *n);
+        if (n == 0)
+            return -1;
+        *lines = n;
+        *cap = ncap;
+    }
+    (*lines)[(*count)++] = *line;
+    return 0;
+}
+
+// index of the line holding pc, or of the first line after it.
+static size_t find_index(const rv_listing_t *l, rv_uint64_t pc)
+{
+    size_t lo = 0, hi = l->count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        const rv_line_t *line = &l->lines[mid];
+        if (pc < line->pc)
+            hi = mid;
+        else if (pc >= line->pc + line->len)
+            lo = mid + 1;
+        else
+            return mid;
+    }
+    return lo;
+}
+
+rv_listing_t *rv_listing_new(rv_uint64_t base, const rv_uint8_t *code, size_t size)
+{
+    rv_listing_t *l = rv_calloc(1, sizeof *l);
+    rv_uint64_t pc = base;
+    rv_line_t line;
+    inst_t ir;
+    int len;
+
+    if (l == 0)
+        return 0;
+    l->base = base;
+    l->code = code;
+    l->size = size;
+
+    while ((len = decode_line(l, pc, &line, &ir)) > 0)
+    {
+        if (render_line(&line, &ir) < 0)
+        {
+            len = -1;
+            break;
+        }
+        if (push_line(&l->lines, &l->count, &l->cap, &line) < 0)
+        {
+            rv_free(line.text);
+            len = -1;
+            break;
+        }
+        pc += len;
+    }
+    if (len < 0)
+    {
+        rv_listing_free(l);
+        return 0;
+    }
+    return l;
+}
+
+void rv_listing_free(rv_listing_t *l)
+{
+    size_t i;
+
+    if (l == 0)
+        return;
+    for (i = 0; i < l->count; i++)
+        rv_free(l->lines[i].text);
+    rv_free(l->lines);
+    rv_free(l);
+}
+
+// re-decodes the lines touched by [pc, pc+size) and keeps going while
+// instruction boundaries differ from the old ones, so that a changed RVC
+// parcel re-synchronizes the rest of the stream. Only lines whose bytes
+// changed are rendered again. returns the number of re-rendered lines, or
+// -1 on error.
+int rv_listing_patch(rv_listing_t *l, rv_uint64_t pc, size_t size)
+{
+    rv_uint64_t end = pc + size;
+    rv_uint64_t cur;
+    rv_line_t *fresh = 0;
+    size_t nfresh = 0, cap = 0;
+    size_t first, j, i;
+    int rendered = 0;
+
+    if (pc < l->base)
+        pc = l->base;
+    if (end > l->base + l->size)
+        end = l->base + l->size;
+    if (pc >= end)
+        return 0;
+
+    l->gen++;
+    first = find_index(l, pc);
+    cur = first < l->count ? l->lines[first].pc : pc;
+    j = first;
+
+    for (;;)
+    {
+        rv_line_t line;
+        inst_t ir;
+        int len;
+
+        while (j < l->count && l->lines[j].pc < cur)
+            j++;
+        if (cur >= end && (j == l->count || l->lines[j].pc == cur))
+            break; // boundaries converged again
+
+        len = decode_line(l, cur, &line, &ir);
+        if (len == 0)
+        {
+            j = l->count;
+            break;
+        }
+
+        if (j < l->count && l->lines[j].pc == cur && l->lines[j].raw == line.raw && l->lines[j].len == line.len)
+        {
+            // same bytes at the same boundary: keep the old rendering
+            line = l->lines[j];
+            l->lines[j].text = 0;
+        }
+        else
+        {
+            if (render_line(&line, &ir) < 0)
+                goto fail;
+            rendered++;
+        }
+
+        if (push_line(&fresh, &nfresh, &cap, &line) < 0)
+        {
+            rv_free(line.text);
+            goto fail;
+        }
+        cur += len;
+    }
+
+    // splice fresh lines in place of [first, j)
+    if (l->count - (j - first) + nfresh > l->cap)
+    {
+        size_t ncap = l->count - (j - first) + nfresh;
+        rv_line_t *n = rv_realloc(l->lines, ncap * sizeof *n);
+        if (n == 0)
+            goto fail;
+        l->lines = n;
+        l->cap = ncap;
+    }
+    for (i = first; i < j; i++)
+        rv_free(l->lines[i].text);
+    memmove(&l->lines[first + nfresh], &l->lines[j], (l->count - j) * sizeof *l->lines);
+    if (nfresh)
+        memcpy(&l->lines[first], fresh, nfresh * sizeof *fresh);
+    l->count = l->count - (j - first) + nfresh;
+    rv_free(fresh);
+
+    if (rendered)
+    {
+        rv_uint64_t lo = nfresh ? l->lines[first].pc : pc;
+        if (l->dirty_lo == l->dirty_hi || lo < l->dirty_lo)
+            l->dirty_lo = lo;
+        if (cur > l->dirty_hi)
+            l->dirty_hi = cur;
+    }
+    return rendered;
+
+fail:
+    for (i = 0; i < nfresh; i++)
+    {
+        // give back the texts we borrowed from the old lines
+        size_t k = find_index(l, fresh[i].pc);
+        if (k < l->count && l->lines[k].pc == fresh[i].pc && l->lines[k].text == 0)
+            l->lines[k].text = fresh[i].text;
+        else
+            rv_free(fresh[i].text);
+    }
+    rv_free(fresh);
+    return -1;
+}
+
+const rv_line_t *rv_listing_lines(const rv_listing_t *l, size_t *count)
+{
+    *count = l->count;
+    return l->lines;
+}
+
+const rv_line_t *rv_listing_find(const rv_listing_t *l, rv_uint64_t pc)
+{
+    size_t i = find_index(l, pc);
+
+    if (i < l->count && pc >= l->lines[i].pc)
+        return &l->lines[i];
+    return 0;
+}
+
+// reports the address window patched since the last rv_listing_changes():
+// lines previously shown inside [lo, hi) must be dropped by the caller.
+int rv_listing_dirty(const rv_listing_t *l, rv_uint64_t *lo, rv_uint64_t *hi)
+{
+    *lo = l->dirty_lo;
+    *hi = l->dirty_hi;
+    return l->dirty_lo != l->dirty_hi;
+}
+
+// calls cb for every line rendered since the previous call, only walking the
+// dirty window.
+size_t rv_listing_changes(rv_listing_t *l, rv_line_cb cb, void *arg)
+{
+    size_t i, n = 0;
+
+    if (l->dirty_lo == l->dirty_hi)
+        return 0;
+    for (i = find_index(l, l->dirty_lo); i < l->count && l->lines[i].pc < l->dirty_hi; i++)
+    {
+        if (l->lines[i].gen <= l->seen)
+            continue;
+        if (cb)
+            cb(arg, &l->lines[i]);
+        n++;
+    }
+    l->seen = l->gen;
+    l->dirty_lo = l->dirty_hi = 0;
+    return n;
+}
@@ -0,0 +1,338 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-cfg.h"
+#include "rv-isa.h"
+#include "rv-mem.h"
+#include "alloc.h"
+
+typedef struct
+{
+    size_t head; // instruction indexes
+    size_t tail;
+} loop_t;
+
+static int set(rv_mem_t *m, int flags, int width, rv_uint8_t base, rv_uint8_t reg, rv_int64_t disp)
+{
+    m->flags = flags;
+    m->width = width;
+    m->base = base;
+    m->reg = reg;
+    m->disp = disp;
+    return 1;
+}
+
+int rv_mem_access(const inst_t *ir, rv_mem_t *m)
+{
+    const int L = RV_MEM_LOAD, S = RV_MEM_STORE, F = RV_MEM_FP, X = RV_MEM_SIGNED, A = RV_MEM_ATOMIC;
+
+    bzero(m, sizeof *m);
+    m->pc = ir->pc;
+    switch (ir->op)
+    {
+        // -------------- integer
+
+    case RV_LB:
+        return set(m, L | X, 1, ir->rs1, ir->rd, ir->imm.i);
+    case RV_LH:
+        return set(m, L | X, 2, ir->rs1, ir->rd, ir->imm.i);
+    case RV_LW:
+        return set(m, L | X, 4, ir->rs1, ir->rd, ir->imm.i);
+    case RV_LD:
+        return set(m, L | X, 8, ir->rs1, ir->rd, ir->imm.i);
+    case RV_LBU:
+        return set(m, L, 1, ir->rs1, ir->rd, ir->imm.i);
+    case RV_LHU:
+        return set(m, L, 2, ir->rs1, ir->rd, ir->imm.i);
+    case RV_LWU:
+        return set(m, L, 4, ir->rs1, ir->rd, ir->imm.i);
+    case RV_SB:
+        return set(m, S, 1, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_SH:
+        return set(m, S, 2, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_SW:
+        return set(m, S, 4, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_SD:
+        return set(m, S, 8, ir->rs1, ir->rs2, ir->imm.i);
+
+        // -------------- float
+
+    case RV_FLH:
+        return set(m, L | F, 2, ir->rs1, ir->rd, ir->imm.i);
+    case RV_FLW:
+        return set(m, L | F, 4, ir->rs1, ir->rd, ir->imm.i);
+    case RV_FLD:
+        return set(m, L | F, 8, ir->rs1, ir->rd, ir->imm.i);
+    case RV_FLQ:
+        return set(m, L | F, 16, ir->rs1, ir->rd, ir->imm.i);
+    case RV_FSH:
+        return set(m, S | F, 2, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_FSW:
+        return set(m, S | F, 4, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_FSD:
+        return set(m, S | F, 8, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_FSQ:
+        return set(m, S | F, 16, ir->rs1, ir->rs2, ir->imm.i);
+
+        // -------------- compressed
+
+    case RV_C_LW:
+        return set(m, L | X, 4, ir->rs1, ir->rd, ir->imm.i);
+    case RV_C_LD:
+        return set(m, L | X, 8, ir->rs1, ir->rd, ir->imm.i);
+    case RV_C_LQ:
+        return set(m, L, 16, ir->rs1, ir->rd, ir->imm.i);
+    case RV_C_FLW:
+        return set(m, L | F, 4, ir->rs1, ir->rd, ir->imm.i);
+    case RV_C_FLD:
+        return set(m, L | F, 8, ir->rs1, ir->rd, ir->imm.i);
+    case RV_C_SW:
+        return set(m, S, 4, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_C_SD:
+        return set(m, S, 8, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_C_SQ:
+        return set(m, S, 16, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_C_FSW:
+        return set(m, S | F, 4, ir->rs1, ir->rs2, ir->imm.i);
+    case RV_C_FSD:
+        return set(m, S | F, 8, ir->rs1, ir->rs2, ir->imm.i);
+
+    case RV_C_LWSP:
+        return set(m, L | X, 4, 2, ir->rd, ir->imm.i);
+    case RV_C_LDSP:
+        return set(m, L | X, 8, 2, ir->rd, ir->imm.i);
+    case RV_C_LQSP:
+        return set(m, L, 16, 2, ir->rd, ir->imm.i);
+    case RV_C_FLWSP:
+        return set(m, L | F, 4, 2, ir->rd, ir->imm.i);
+    case RV_C_FLDSP:
+        return set(m, L | F, 8, 2, ir->rd, ir->imm.i);
+    case RV_C_SWSP:
+        return set(m, S, 4, 2, ir->rs2, ir->imm.i);
+    case RV_C_SDSP:
+        return set(m, S, 8, 2, ir->rs2, ir->imm.i);
+    case RV_C_SQSP:
+        return set(m, S, 16, 2, ir->rs2, ir->imm.i);
+    case RV_C_FSWSP:
+        return set(m, S | F, 4, 2, ir->rs2, ir->imm.i);
+    case RV_C_FSDSP:
+        return set(m, S | F, 8, 2, ir->rs2, ir->imm.i);
+
+        // -------------- atomic
+
+    case RV_LR_W:
+        return set(m, L | X | A, 4, ir->rs1, ir->rd, 0);
+    case RV_LR_D:
+        return set(m, L | A, 8, ir->rs1, ir->rd, 0);
+    case RV_SC_W:
+        return set(m, S | A, 4, ir->rs1, ir->rs2, 0);
+    case RV_SC_D:
+        return set(m, S | A, 8, ir->rs1, ir->rs2, 0);
+
+    case RV_AMOADD_W:
+    case RV_AMOAND_W:
+    case RV_AMOMAXU_W:
+    case RV_AMOMAX_W:
+    case RV_AMOMINU_W:
+    case RV_AMOMIN_W:
+    case RV_AMOOR_W:
+    case RV_AMOSWAP_W:
+    case RV_AMOXOR_W:
+        return set(m, L | S | X | A, 4, ir->rs1, ir->rs2, 0);
+
+    case RV_AMOADD_D:
+    case RV_AMOAND_D:
+    case RV_AMOMAX_D:
+    case RV_AMOMAXU_D:
+    case RV_AMOMIN_D:
+    case RV_AMOMINU_D:
+    case RV_AMOOR_D:
+    case RV_AMOSWAP_D:
+    case RV_AMOXOR_D:
+        return set(m, L | S | A, 8, ir->rs1, ir->rs2, 0);
+    }
+    return 0;
+}
+
+// constant added to rd, when ir is rd += imm.
+static int step(const inst_t *ir, rv_int64_t *imm)
+{
+    switch (ir->op)
+    {
+    case RV_ADDI:
+    case RV_ADDIW:
+        *imm = ir->imm.i;
+        return ir->rs1 == ir->rd;
+
+    case RV_C_ADDI:
+    case RV_C_ADDIW:
+    case RV_C_ADDI16SP:
+        *imm = ir->imm.i;
+        return 1;
+    }
+    return 0;
+}
+
+static int cmp_loop(const void *a, const void *b)
+{
+    const loop_t *x = a, *y = b;
+    size_t nx = x->tail - x->head, ny = y->tail - y->head;
+    return nx > ny ? -1 : nx < ny;
+}
+
+static size_t find(const inst_t *ins, size_t n, rv_uint64_t pc)
+{
+    size_t lo = 0, hi = n;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ins[mid].pc < pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < n && ins[lo].pc == pc ? lo : n;
+}
+
+// a base register only ever moved by rd += imm in the body advances by
+// the sum of the steps per iteration; outer loops go first so that the
+// innermost loop has the last word.
+static void strides(const inst_t *ins, const rv_uint32_t *raws, const loop_t *loops, size_t nloops, rv_mem_t *acc, const size_t *at, size_t nacc)
+{
+    int xlen = rv_isa_xlen();
+    size_t l, i, k = 0;
+
+    for (l = 0; l < nloops; l++)
+    {
+        rv_int64_t sum[32];
+        int bad[32];
+
+        bzero(sum, sizeof sum);
+        bzero(bad, sizeof bad);
+        for (i = loops[l].head; i <= loops[l].tail; i++)
+        {
+            rv_int64_t imm;
+            int rd = rv_int_def(raws[i], xlen);
+            if (rd == 0)
+                continue;
+            if (step(&ins[i], &imm))
+                sum[rd] += imm;
+            else
+                bad[rd] = 1;
+        }
+
+        // accesses are sorted by instruction index
+        for (k = 0; k < nacc && at[k] < loops[l].head; k++)
+            ;
+        for (; k < nacc && at[k] <= loops[l].tail; k++)
+        {
+            rv_mem_t *m = &acc[k];
+            m->flags |= RV_MEM_LOOP;
+            m->flags &= ~RV_MEM_STRIDE;
+            m->loop = ins[loops[l].head].pc;
+            m->stride = 0;
+            if (!bad[m->base])
+            {
+                m->flags |= RV_MEM_STRIDE;
+                m->stride = sum[m->base];
+            }
+        }
+    }
+}
+
+rv_mem_t *rv_mem_extract(rv_uint64_t base, const rv_uint8_t *code, size_t size, rv_uint64_t lo, rv_uint64_t hi, size_t *count)
+{
+    inst_t *ins = 0;
+    rv_uint32_t *raws = 0;
+    loop_t *loops = 0;
+    rv_mem_t *acc = 0;
+    size_t *at = 0;
+    size_t n = 0, cap = 0, nloops = 0, nacc = 0, i;
+    rv_uint64_t pc;
+
+    *count = 0;
+    if (lo < base)
+        lo = base;
+    if (hi > base + size)
+        hi = base + size;
+    for (pc = lo; pc < hi;)
+    {
+        int len;
+        if (n == cap)
+        {
+            size_t ncap = cap ? cap * 2 : 1024;
+            inst_t *t = rv_realloc(ins, ncap * sizeof *t);
+            rv_uint32_t *r;
+
+            if (t == 0)
+                goto fail;
+            ins = t;
+            if ((r = rv_realloc(raws, ncap * sizeof *r)) == 0)
+                goto fail;
+            raws = r;
+            cap = ncap;
+        }
+        len = rv_dis_decode(pc, code + (pc - base), size - (pc - base), &ins[n], &raws[n]);
+        if (len == 0)
+            break;
+        n++;
+        pc += len;
+    }
+
+    loops = rv_malloc((n ? n : 1) * sizeof *loops);
+    acc = rv_malloc((n ? n : 1) * sizeof *acc);
+    at = rv_malloc((n ? n : 1) * sizeof *at);
+    if (loops == 0 || acc == 0 || at == 0)
+        goto fail;
+    for (i = 0; i < n; i++)
+    {
+        rv_uint64_t target;
+        int flow = rv_flow(&ins[i], &target);
+
+        if ((flow == RV_FLOW_BRANCH || flow == RV_FLOW_JUMP) && target <= ins[i].pc && target >= lo)
+        {
+            size_t h = find(ins, n, target);
+            if (h < n)
+            {
+                loops[nloops].head = h;
+                loops[nloops].tail = i;
+                nloops++;
+            }
+        }
+        if (rv_mem_access(&ins[i], &acc[nacc]))
+            at[nacc++] = i;
+    }
+    qsort(loops, nloops, sizeof *loops, cmp_loop);
+    strides(ins, raws, loops, nloops, acc, at, nacc);
+
+    rv_free(ins);
+    rv_free(raws);
+    rv_free(loops);
+    rv_free(at);
+    *count = nacc;
+    return acc;
+
+fail:
+    rv_free(ins);
+    rv_free(raws);
+    rv_free(loops);
+    rv_free(acc);
+    rv_free(at);
+    return 0;
+}
+
+int rv_mem_write(rv_sink_t *sink, const rv_mem_t *m, size_t count, rv_uint64_t lo, rv_uint64_t hi)
+{
+    rv_mem_hdr_t h;
+
+    bzero(&h, sizeof h);
+    memcpy(h.magic, RV_MEM_MAGIC, 4);
+    h.version = RV_MEM_VERSION;
+    h.count = count;
+    h.lo = lo;
+    h.hi = hi;
+    if (rv_sink_write(sink, &h, sizeof h) < 0)
+        return -1;
+    return rv_sink_write(sink, m, count * sizeof *m);
+}
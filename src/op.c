@@ -0,0 +1,91 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "rv-isa.h"
+#include "op.h"
+
+static const rv_op_t ops[RV_OP_COUNT] = {
+#define OP(id, name, match, mask, operands, xlen, form) [RV_OP_##id] = {name, match, mask, operands, RV_OPF_##xlen | RV_OPF_##form},
+#include "rv-op.def"
+#undef OP
+};
+
+// every op fixes its major opcode and funct3, so it has exactly one key.
+static rv_uint16_t slots[RV_OP_COUNT];     // ops by dispatch key, the most specific mask first
+static rv_uint16_t first[RV_ISA_KEYS + 1]; // slots of key k are [first[k], first[k + 1])
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static int cmp_slot(const void *a, const void *b)
+{
+    const rv_op_t *x = &ops[*(const rv_uint16_t *)a], *y = &ops[*(const rv_uint16_t *)b];
+    int kx = rv_isa_key(x->match), ky = rv_isa_key(y->match);
+
+    if (kx != ky)
+        return kx < ky ? -1 : 1;
+    if (__builtin_popcount(x->mask) != __builtin_popcount(y->mask))
+        return __builtin_popcount(x->mask) > __builtin_popcount(y->mask) ? -1 : 1;
+    if (x->mask != y->mask)
+        return x->mask < y->mask ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+static void build(void)
+{
+    size_t n = 0, i;
+    int k;
+
+    for (i = RV_OP_CUSTOM + 1; i < RV_OP_COUNT; i++)
+        slots[n++] = i;
+    qsort(slots, n, sizeof *slots, cmp_slot);
+    for (k = 0, i = 0; k <= RV_ISA_KEYS; k++)
+    {
+        while (i < n && rv_isa_key(ops[slots[i]].match) < k)
+            i++;
+        first[k] = i;
+    }
+}
+
+const rv_op_t *rv_op_info(int op)
+{
+    return op > RV_OP_CUSTOM && op < RV_OP_COUNT ? &ops[op] : 0;
+}
+
+// a table tag only counts when the encoding it travels with matches the
+// entry, so a stray uimm on another RV_UNDEF is not taken for one.
+int rv_dis_op(const inst_t *ir)
+{
+    const rv_op_t *o;
+
+    if (ir->op != RV_UNDEF)
+        return RV_OP_NONE;
+    if (ir->uimm == RV_OP_CUSTOM)
+        return RV_OP_CUSTOM;
+    o = rv_op_info(ir->uimm);
+    return o && (ir->imm.u & o->mask) == o->match ? (int)ir->uimm : RV_OP_NONE;
+}
+
+int rv_op_decode(rv_uint64_t pc, rv_uint32_t raw, int xlen, inst_t *ir)
+{
+    rv_uint8_t other = xlen == 32 ? RV_OPF_RV64 : RV_OPF_RV32;
+    int k = rv_isa_key(raw);
+    rv_uint32_t i;
+
+    pthread_once(&once, build);
+    for (i = first[k]; i < first[k + 1]; i++)
+    {
+        const rv_op_t *o = &ops[slots[i]];
+
+        if ((raw & o->mask) != o->match || (o->flags & other))
+            continue;
+        ir->pc = pc;
+        ir->op = RV_UNDEF;
+        ir->uimm = slots[i];
+        ir->imm.u = raw;
+        ir->rd = raw >> 7 & 31;
+        ir->rs1 = raw >> 15 & 31;
+        ir->rs2 = raw >> 20 & 31;
+        ir->rs3 = raw >> 27;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef __RV_OP_INT_H
+#define __RV_OP_INT_H
+
+#include "rv-op.h"
+
+// claims raw for the op table under xlen, filling ir as rv_dis_decode()
+// returns it; 0 leaves raw to the decoder.
+extern int rv_op_decode(rv_uint64_t pc, rv_uint32_t raw, int xlen, inst_t *ir);
+
+#endif // __RV_OP_INT_H
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-out.h"
+#include "alloc.h"
+#include "pool.h"
+
+#define OUT_LINE 512
+#define OUT_MAGIC "RVCL"
+
+typedef struct
+{
+    size_t count;
+    rv_uint64_t *pc;
+    rv_uint32_t *raw;
+    rv_uint16_t *opcode;
+    rv_uint32_t *name;
+    rv_uint8_t *len;
+    rv_uint8_t *nargs;
+    rv_uint8_t *kind;
+    rv_uint8_t *reg;
+    rv_int64_t *imm;
+    rv_uint32_t *text;
+} block_t;
+
+struct rv_out
+{
+    rv_sink_t *sink;
+    int format;
+    int error;
+    rv_uint64_t start; // sink offset of our first byte
+
+    // columns only
+    block_t blk;
+    rv_pool_t dict;
+    rv_uint64_t ninst;
+    rv_uint64_t nblocks;
+};
+
+static const char *kind_names[] = {
+    [RV_ARG_NONE] = "text",
+    [RV_ARG_REG] = "reg",
+    [RV_ARG_FREG] = "freg",
+    [RV_ARG_IMM] = "imm",
+    [RV_ARG_MEM] = "mem",
+    [RV_ARG_CSR] = "csr",
+    [RV_ARG_RND] = "rnd",
+    [RV_ARG_VREG] = "vreg",
+    [RV_ARG_VTYPE] = "vtype",
+};
+
+static int out_write(rv_out_t *o, const void *data, size_t n)
+{
+    if (rv_sink_write(o->sink, data, n) < 0)
+    {
+        o->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+static int out_pad(rv_out_t *o)
+{
+    static const char zero[8];
+    return out_write(o, zero, -(rv_sink_offset(o->sink) - o->start) & 7);
+}
+
+// ---------------------------------------------------------------- json
+
+static size_t json_str(char *p, const char *s)
+{
+    char *d = p;
+
+    *d++ = '"';
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            *d++ = '\\';
+        if ((unsigned char)*s < 0x20)
+            continue;
+        *d++ = *s;
+    }
+    *d++ = '"';
+    return d - p;
+}
+
+// bytes json_str() writes for s.
+static size_t json_len(const char *s)
+{
+    size_t n = 2;
+
+    for (; *s; s++)
+        n += *s == '"' || *s == '\\' ? 2 : (unsigned char)*s >= 0x20;
+    return n;
+}
+
+// the numbers take at most 128 bytes around the op and 96 per argument,
+// plug-in text is only bounded by its escaped length.
+static int put_json(rv_out_t *o, const inst_t *ir, rv_uint32_t raw, int len, const mnemonic_t *m)
+{
+    size_t size = 128 + json_len(m->op ? m->op : "undef");
+    char *p, *start;
+    int i;
+
+    for (i = 0; i < 5 && m->args[i]; i++)
+        size += 96 + json_len(m->args[i]);
+    p = start = rv_sink_reserve(o->sink, size);
+
+    if (p == 0)
+    {
+        o->error = 1;
+        return -1;
+    }
+    p += sprintf(p, "{\"pc\":%llu,\"raw\":%u,\"len\":%d,\"op\":", ir->pc, raw, len);
+    p += json_str(p, m->op ? m->op : "undef");
+    p += sprintf(p, ",\"opcode\":%d,\"args\":[", (int)ir->op);
+    for (i = 0; i < 5 && m->args[i]; i++)
+    {
+        const rv_arg_t *a = &m->arg[i];
+        p += sprintf(p, "%s{\"kind\":\"%s\"", i ? "," : "", kind_names[a->kind < sizeof kind_names / sizeof *kind_names ? a->kind : 0]);
+        switch (a->kind)
+        {
+        case RV_ARG_REG:
+        case RV_ARG_FREG:
+        case RV_ARG_VREG:
+            p += sprintf(p, ",\"reg\":%d", a->reg);
+            break;
+        case RV_ARG_IMM:
+        case RV_ARG_RND:
+        case RV_ARG_VTYPE:
+            p += sprintf(p, ",\"value\":%lld", a->imm);
+            break;
+        case RV_ARG_MEM:
+            p += sprintf(p, ",\"base\":%d,\"disp\":%lld", a->reg, a->imm);
+            break;
+        case RV_ARG_CSR:
+            p += sprintf(p, ",\"csr\":%lld", a->imm);
+            break;
+        }
+        p += sprintf(p, ",\"text\":");
+        p += json_str(p, m->args[i]);
+        *p++ = '}';
+    }
+    p += sprintf(p, "]}\n");
+    rv_sink_commit(o->sink, p - start);
+    return 0;
+}
+
+// ---------------------------------------------------------------- columns
+
+static int block_alloc(block_t *b)
+{
+    b->pc = rv_malloc(RV_OUT_BLOCK * sizeof *b->pc);
+    b->raw = rv_malloc(RV_OUT_BLOCK * sizeof *b->raw);
+    b->opcode = rv_malloc(RV_OUT_BLOCK * sizeof *b->opcode);
+    b->name = rv_malloc(RV_OUT_BLOCK * sizeof *b->name);
+    b->len = rv_malloc(RV_OUT_BLOCK * sizeof *b->len);
+    b->nargs = rv_malloc(RV_OUT_BLOCK * sizeof *b->nargs);
+    b->kind = rv_malloc(RV_OUT_BLOCK * 5 * sizeof *b->kind);
+    b->reg = rv_malloc(RV_OUT_BLOCK * 5 * sizeof *b->reg);
+    b->imm = rv_malloc(RV_OUT_BLOCK * 5 * sizeof *b->imm);
+    b->text = rv_malloc(RV_OUT_BLOCK * 5 * sizeof *b->text);
+    if (!b->pc || !b->raw || !b->opcode || !b->name || !b->len || !b->nargs || !b->kind || !b->reg || !b->imm || !b->text)
+        return -1;
+    return 0;
+}
+
+static void block_free(block_t *b)
+{
+    rv_free(b->pc);
+    rv_free(b->raw);
+    rv_free(b->opcode);
+    rv_free(b->name);
+    rv_free(b->len);
+    rv_free(b->nargs);
+    rv_free(b->kind);
+    rv_free(b->reg);
+    rv_free(b->imm);
+    rv_free(b->text);
+}
+
+static int put_column(rv_out_t *o, const void *data, size_t size)
+{
+    if (out_write(o, data, size) < 0)
+        return -1;
+    return out_pad(o);
+}
+
+static int block_flush(rv_out_t *o)
+{
+    block_t *b = &o->blk;
+    rv_uint32_t hdr[2] = {b->count, 0};
+    size_t n = b->count;
+
+    if (n == 0)
+        return 0;
+    if (out_write(o, hdr, sizeof hdr) < 0 ||
+        put_column(o, b->pc, n * sizeof *b->pc) < 0 ||
+        put_column(o, b->raw, n * sizeof *b->raw) < 0 ||
+        put_column(o, b->opcode, n * sizeof *b->opcode) < 0 ||
+        put_column(o, b->name, n * sizeof *b->name) < 0 ||
+        put_column(o, b->len, n * sizeof *b->len) < 0 ||
+        put_column(o, b->nargs, n * sizeof *b->nargs) < 0 ||
+        put_column(o, b->kind, n * 5 * sizeof *b->kind) < 0 ||
+        put_column(o, b->reg, n * 5 * sizeof *b->reg) < 0 ||
+        put_column(o, b->imm, n * 5 * sizeof *b->imm) < 0 ||
+        put_column(o, b->text, n * 5 * sizeof *b->text) < 0)
+        return -1;
+    o->nblocks++;
+    b->count = 0;
+    return 0;
+}
+
+static rv_uint32_t dict_id(rv_out_t *o, const char *s)
+{
+    rv_int64_t id;
+
+    if (s == 0)
+        return RV_OUT_NOSTR;
+    id = rv_pool_add(&o->dict, s, strlen(s));
+    if (id < 0)
+    {
+        o->error = 1;
+        return RV_OUT_NOSTR;
+    }
+    return id;
+}
+
+static int put_columns(rv_out_t *o, const inst_t *ir, rv_uint32_t raw, int len, const mnemonic_t *m)
+{
+    block_t *b = &o->blk;
+    size_t k = b->count;
+    int i;
+
+    b->pc[k] = ir->pc;
+    b->raw[k] = raw;
+    b->opcode[k] = ir->op;
+    b->name[k] = dict_id(o, m->op);
+    b->len[k] = len;
+    b->nargs[k] = 0;
+    for (i = 0; i < 5; i++)
+    {
+        b->kind[k * 5 + i] = m->arg[i].kind;
+        b->reg[k * 5 + i] = m->arg[i].reg;
+        b->imm[k * 5 + i] = m->arg[i].imm;
+        b->text[k * 5 + i] = dict_id(o, m->args[i]);
+        if (m->args[i])
+            b->nargs[k] = i + 1;
+    }
+    o->ninst++;
+    if (++b->count == RV_OUT_BLOCK)
+        return block_flush(o);
+    return o->error ? -1 : 0;
+}
+
+static int columns_end(rv_out_t *o)
+{
+    rv_uint32_t hdr[2] = {o->dict.count, 0};
+    rv_uint64_t dict_off;
+    rv_uint32_t version = RV_OUT_VERSION;
+
+    if (block_flush(o) < 0)
+        return -1;
+    dict_off = rv_sink_offset(o->sink) - o->start;
+    if (out_write(o, hdr, sizeof hdr) < 0 ||
+        put_column(o, o->dict.offs, o->dict.count * sizeof *o->dict.offs) < 0 ||
+        put_column(o, o->dict.data, o->dict.size) < 0)
+        return -1;
+    if (out_write(o, &dict_off, 8) < 0 || out_write(o, &o->ninst, 8) < 0 || out_write(o, &o->nblocks, 8) < 0 ||
+        out_write(o, OUT_MAGIC, 4) < 0 || out_write(o, &version, 4) < 0)
+        return -1;
+    return 0;
+}
+
+// ---------------------------------------------------------------- api
+
+rv_out_t *rv_out_new(rv_sink_t *sink, int format)
+{
+    rv_out_t *o = rv_calloc(1, sizeof *o);
+    rv_uint32_t version = RV_OUT_VERSION;
+
+    if (o == 0)
+        return 0;
+    o->sink = sink;
+    o->format = format;
+    o->start = rv_sink_offset(sink);
+    if (format == RV_OUT_COLUMNS && block_alloc(&o->blk) < 0)
+        goto fail;
+    if (format == RV_OUT_COLUMNS && (out_write(o, OUT_MAGIC, 4) < 0 || out_write(o, &version, 4) < 0))
+        goto fail;
+    return o;
+
+fail:
+    block_free(&o->blk);
+    rv_free(o);
+    return 0;
+}
+
+int rv_out_put(rv_out_t *o, const inst_t *ir, rv_uint32_t raw, int len, const mnemonic_t *m)
+{
+    char *p;
+    int n;
+
+    if (o->error)
+        return -1;
+    switch (o->format)
+    {
+    case RV_OUT_JSONL:
+        return put_json(o, ir, raw, len, m);
+
+    case RV_OUT_COLUMNS:
+        return put_columns(o, ir, raw, len, m);
+    }
+
+    p = rv_sink_reserve(o->sink, OUT_LINE);
+    if (p == 0)
+    {
+        o->error = 1;
+        return -1;
+    }
+    n = rv_format_line(ir->pc, raw, len, m, p, OUT_LINE);
+    if (n >= OUT_LINE)
+        n = OUT_LINE - 1;
+    rv_sink_commit(o->sink, n);
+    return 0;
+}
+
+// ends the stream and frees o; the sink stays open.
+int rv_out_close(rv_out_t *o)
+{
+    int ret = 0;
+
+    if (o->format == RV_OUT_COLUMNS && !o->error && columns_end(o) < 0)
+        ret = -1;
+    if (o->error)
+        ret = -1;
+    block_free(&o->blk);
+    rv_pool_free(&o->dict);
+    rv_free(o);
+    return ret;
+}
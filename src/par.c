@@ -0,0 +1,84 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "rv-isa.h"
+#include "par.h"
+#include "alloc.h"
+
+typedef struct
+{
+    rv_task_fn fn;
+    void *arg;
+    int id;
+    int n;
+    int started;
+    const rv_allocator_t *alloc; // the caller's, null for malloc
+    const rv_isa_t *isa;         // the caller's profile
+} task_t;
+
+// a worker allocates like the thread that started it, so memory can move
+// between the two and be freed by either, and decodes under its profile.
+static void *run_task(void *p)
+{
+    task_t *t = p;
+
+    rv_dis_set_thread_allocator(t->alloc);
+    rv_isa_select(t->isa);
+    t->fn(t->arg, t->id, t->n);
+    return 0;
+}
+
+int rv_nthreads(int n)
+{
+    if (n <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = cpus > 0 ? (int)cpus : 1;
+    }
+    return n;
+}
+
+int rv_parallel(int n, rv_task_fn fn, void *arg)
+{
+    rv_allocator_t alloc;
+    int has_alloc = rv_alloc_current(&alloc);
+    pthread_t *th;
+    task_t *tasks;
+    int i;
+
+    n = rv_nthreads(n);
+    if (n == 1)
+    {
+        fn(arg, 0, 1);
+        return 1;
+    }
+
+    th = rv_malloc(n * sizeof *th);
+    tasks = rv_malloc(n * sizeof *tasks);
+    if (th == 0 || tasks == 0)
+    {
+        rv_free(th);
+        rv_free(tasks);
+        fn(arg, 0, 1);
+        return 1;
+    }
+
+    // the calling thread runs task 0; a task that fails to start runs inline
+    for (i = 1; i < n; i++)
+    {
+        tasks[i] = (task_t){.fn = fn, .arg = arg, .id = i, .n = n, .alloc = has_alloc ? &alloc : 0, .isa = rv_isa_current()};
+        tasks[i].started = pthread_create(&th[i], 0, run_task, &tasks[i]) == 0;
+        if (!tasks[i].started)
+            fn(arg, i, n);
+    }
+    fn(arg, 0, n);
+    for (i = 1; i < n; i++)
+    {
+        if (tasks[i].started)
+            pthread_join(th[i], 0);
+    }
+    rv_free(th);
+    rv_free(tasks);
+    return n;
+}
@@ -0,0 +1,12 @@
+#ifndef __RV_PAR_H
+#define __RV_PAR_H
+
+// runs fn(arg, id, n) on n threads, id in [0, n). n <= 0 picks the number
+// of online cpus. Every thread allocates through the caller's allocator.
+// returns the thread count used.
+typedef void (*rv_task_fn)(void *arg, int id, int n);
+
+extern int rv_nthreads(int n);
+extern int rv_parallel(int n, rv_task_fn fn, void *arg);
+
+#endif // __RV_PAR_H
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "alloc.h"
+#include "hash.h"
+
+static int pool_grow(rv_pool_t *p)
+{
+    size_t nmask = p->mask ? p->mask * 2 + 1 : 4095;
+    rv_uint32_t *ns = rv_calloc(nmask + 1, sizeof *ns);
+    size_t i;
+
+    if (ns == 0)
+        return -1;
+    for (i = 0; i < p->count; i++)
+    {
+        const char *str = p->data + p->offs[i];
+        size_t j;
+        for (j = rv_hash64(str, strlen(str), 0) & nmask; ns[j]; j = (j + 1) & nmask)
+            ;
+        ns[j] = i + 1;
+    }
+    rv_free(p->slots);
+    p->slots = ns;
+    p->mask = nmask;
+    return 0;
+}
+
+// returns the id of s, adding it when new, or -1 on error.
+rv_int64_t rv_pool_add(rv_pool_t *p, const char *s, size_t n)
+{
+    size_t i;
+
+    if (p->count * 2 >= p->mask && pool_grow(p) < 0)
+        return -1;
+
+    for (i = rv_hash64(s, n, 0) & p->mask; p->slots[i]; i = (i + 1) & p->mask)
+    {
+        const char *str = p->data + p->offs[p->slots[i] - 1];
+        if (memcmp(str, s, n) == 0 && str[n] == 0)
+            return p->slots[i] - 1;
+    }
+
+    if (p->size + n + 1 >= 0xffffffffu)
+        return -1;
+    if (p->size + n + 1 > p->cap)
+    {
+        size_t ncap = p->cap ? p->cap * 2 : 65536;
+        char *d;
+        while (ncap < p->size + n + 1)
+            ncap *= 2;
+        d = rv_realloc(p->data, ncap);
+        if (d == 0)
+            return -1;
+        p->data = d;
+        p->cap = ncap;
+    }
+    if (p->count == p->ocap)
+    {
+        size_t ncap = p->ocap ? p->ocap * 2 : 1024;
+        rv_uint32_t *o = rv_realloc(p->offs, ncap * sizeof *o);
+        if (o == 0)
+            return -1;
+        p->offs = o;
+        p->ocap = ncap;
+    }
+
+    memcpy(p->data + p->size, s, n);
+    p->data[p->size + n] = 0;
+    p->offs[p->count] = p->size;
+    p->size += n + 1;
+    p->slots[i] = ++p->count;
+    return p->count - 1;
+}
+
+void rv_pool_free(rv_pool_t *p)
+{
+    rv_free(p->slots);
+    rv_free(p->offs);
+    rv_free(p->data);
+    bzero(p, sizeof *p);
+}
@@ -0,0 +1,25 @@
+#ifndef __RV_POOL_H
+#define __RV_POOL_H
+
+#include <stddef.h>
+
+#include "rv-dec.h"
+
+// deduplicating string table: each distinct string gets a dense id and is
+// stored once, NUL terminated, at data + offs[id].
+typedef struct
+{
+    rv_uint32_t *slots; // id + 1, 0 when empty
+    size_t mask;
+    rv_uint32_t *offs;
+    size_t count;
+    size_t ocap;
+    char *data;
+    size_t size;
+    size_t cap;
+} rv_pool_t;
+
+extern rv_int64_t rv_pool_add(rv_pool_t *p, const char *s, size_t n);
+extern void rv_pool_free(rv_pool_t *p);
+
+#endif // __RV_POOL_H
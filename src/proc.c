@@ -0,0 +1,266 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "rv-proc.h"
+#include "rv-isa.h"
+#include "alloc.h"
+
+struct rv_proc
+{
+    int pid;
+    size_t page;
+    rv_image_t img; // sections own their names and data
+};
+
+typedef struct
+{
+    struct iovec local[RV_PROC_IOV];
+    struct iovec remote[RV_PROC_IOV];
+    int count;
+} batch_t;
+
+static void free_sections(rv_section_t *s, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        rv_free((char *)s[i].name);
+        rv_free((rv_uint8_t *)s[i].data);
+    }
+    rv_free(s);
+}
+
+// the executable mappings in address order, data not yet read.
+static rv_section_t *read_maps(int pid, size_t *count)
+{
+    rv_section_t *s = 0, *t;
+    size_t n = 0, cap = 0;
+    char path[64], line[4096];
+    FILE *f;
+
+    snprintf(path, sizeof path, "/proc/%d/maps", pid);
+    if ((f = fopen(path, "r")) == 0)
+        return 0;
+    while (fgets(line, sizeof line, f))
+    {
+        unsigned long long lo, hi;
+        char perms[8], *name;
+        int off = 0;
+
+        line[strcspn(line, "\n")] = 0;
+        if (sscanf(line, "%llx-%llx %7s %*s %*s %*s %n", &lo, &hi, perms, &off) < 3 || perms[2] != 'x' || hi <= lo)
+            continue;
+        name = off ? line + off : "";
+        // the legacy vsyscall page is not readable through the vm calls
+        if (strcmp(name, "[vsyscall]") == 0)
+            continue;
+        if (n == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            if ((t = rv_realloc(s, cap * sizeof *s)) == 0)
+                goto fail;
+            s = t;
+        }
+        bzero(&s[n], sizeof s[n]);
+        s[n].addr = lo;
+        s[n].size = hi - lo;
+        s[n].exec = 1;
+        s[n].name = rv_strdup(*name ? name : "[anon]");
+        s[n].data = rv_malloc(hi - lo);
+        n++;
+        if (s[n - 1].name == 0 || s[n - 1].data == 0)
+            goto fail;
+    }
+    fclose(f);
+    *count = n;
+    return s ? s : rv_calloc(1, sizeof *s);
+
+fail:
+    fclose(f);
+    free_sections(s, n);
+    return 0;
+}
+
+// retries an element that faulted one page at a time, zeroing the pages
+// that stay unreadable.
+static int read_pages(int pid, size_t page, struct iovec *local, struct iovec *remote)
+{
+    size_t off = 0;
+
+    while (off < local->iov_len)
+    {
+        size_t len = page - (((rv_uint64_t)(size_t)remote->iov_base + off) & (page - 1));
+        struct iovec l, r;
+        ssize_t n;
+
+        if (len > local->iov_len - off)
+            len = local->iov_len - off;
+        l.iov_base = (char *)local->iov_base + off;
+        r.iov_base = (char *)remote->iov_base + off;
+        l.iov_len = r.iov_len = len;
+        n = process_vm_readv(pid, &l, 1, &r, 1, 0);
+        if (n < 0 && errno != EFAULT)
+            return -1;
+        if (n < (ssize_t)len)
+            memset((char *)l.iov_base + (n > 0 ? n : 0), 0, len - (n > 0 ? n : 0));
+        off += len;
+    }
+    return 0;
+}
+
+// transfers are all or nothing per element, so a short read ends on the
+// element that faulted.
+static int read_batch(int pid, size_t page, batch_t *b)
+{
+    struct iovec *local = b->local, *remote = b->remote;
+    int cnt = b->count;
+
+    b->count = 0;
+    while (cnt > 0)
+    {
+        ssize_t n = process_vm_readv(pid, local, cnt, remote, cnt, 0);
+
+        if (n < 0 && errno != EFAULT)
+            return -1;
+        if (n < 0)
+            n = 0;
+        while (cnt > 0 && (size_t)n >= local->iov_len)
+        {
+            n -= local->iov_len;
+            local++;
+            remote++;
+            cnt--;
+        }
+        if (cnt == 0)
+            break;
+        if (read_pages(pid, page, local, remote) < 0)
+            return -1;
+        local++;
+        remote++;
+        cnt--;
+    }
+    return 0;
+}
+
+static int read_sections(int pid, size_t page, rv_section_t *s, size_t n)
+{
+    batch_t b;
+    size_t i;
+
+    b.count = 0;
+    for (i = 0; i < n; i++)
+    {
+        rv_uint64_t off;
+
+        for (off = 0; off < s[i].size; off += RV_PROC_CHUNK)
+        {
+            size_t len = s[i].size - off < RV_PROC_CHUNK ? s[i].size - off : RV_PROC_CHUNK;
+
+            b.local[b.count].iov_base = (rv_uint8_t *)s[i].data + off;
+            b.remote[b.count].iov_base = (void *)(size_t)(s[i].addr + off);
+            b.local[b.count].iov_len = b.remote[b.count].iov_len = len;
+            if (++b.count == RV_PROC_IOV && read_batch(pid, page, &b) < 0)
+                return -1;
+        }
+    }
+    return b.count ? read_batch(pid, page, &b) : 0;
+}
+
+rv_proc_t *rv_proc_open(int pid)
+{
+    rv_proc_t *p = rv_calloc(1, sizeof *p);
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (p == 0)
+        return 0;
+    p->pid = pid;
+    p->page = page > 0 ? page : 4096;
+    p->img.xlen = rv_isa_xlen();
+    p->img.sections = read_maps(pid, &p->img.nsections);
+    if (p->img.sections == 0 || read_sections(pid, p->page, p->img.sections, p->img.nsections) < 0)
+    {
+        rv_proc_close(p);
+        return 0;
+    }
+    return p;
+}
+
+void rv_proc_close(rv_proc_t *p)
+{
+    if (p == 0)
+        return;
+    free_sections(p->img.sections, p->img.nsections);
+    rv_free(p);
+}
+
+const rv_image_t *rv_proc_image(const rv_proc_t *p)
+{
+    return &p->img;
+}
+
+static int add_range(rv_proc_range_t **r, size_t *n, size_t *cap, rv_uint64_t addr, rv_uint64_t size)
+{
+    rv_proc_range_t *t;
+
+    if (*n && (*r)[*n - 1].addr + (*r)[*n - 1].size == addr)
+    {
+        (*r)[*n - 1].size += size;
+        return 0;
+    }
+    if (*n == *cap)
+    {
+        *cap = *cap ? *cap * 2 : 16;
+        if ((t = rv_realloc(*r, *cap * sizeof *t)) == 0)
+            return -1;
+        *r = t;
+    }
+    (*r)[(*n)++] = (rv_proc_range_t){addr, size};
+    return 0;
+}
+
+rv_proc_range_t *rv_proc_refresh(rv_proc_t *p, size_t *count)
+{
+    rv_proc_range_t *r = 0;
+    rv_section_t *s;
+    size_t n, i, j = 0, nr = 0, cap = 0;
+
+    if ((s = read_maps(p->pid, &n)) == 0)
+        return 0;
+    if (read_sections(p->pid, p->page, s, n) < 0)
+        goto fail;
+    for (i = 0; i < n; i++)
+    {
+        rv_uint64_t addr;
+
+        // both lists are sorted, so the old mappings can be walked along
+        for (addr = s[i].addr; addr < s[i].addr + s[i].size; addr += p->page)
+        {
+            const rv_section_t *o;
+
+            while (j < p->img.nsections && p->img.sections[j].addr + p->img.sections[j].size <= addr)
+                j++;
+            o = j < p->img.nsections ? &p->img.sections[j] : 0;
+            if (o && o->addr <= addr && memcmp(o->data + (addr - o->addr), s[i].data + (addr - s[i].addr), p->page) == 0)
+                continue;
+            if (add_range(&r, &nr, &cap, addr, p->page) < 0)
+                goto fail;
+        }
+    }
+    if (r == 0 && (r = rv_calloc(1, sizeof *r)) == 0)
+        goto fail;
+    free_sections(p->img.sections, p->img.nsections);
+    p->img.sections = s;
+    p->img.nsections = n;
+    *count = nr;
+    return r;
+
+fail:
+    rv_free(r);
+    free_sections(s, n);
+    return 0;
+}
@@ -0,0 +1,442 @@
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rv-prof.h"
+#include "alloc.h"
+#include "par.h"
+
+#define PROF_BUCKETS 8    // sort buckets per thread
+#define PROF_INSERTION 32 // buckets below this are insertion sorted
+#define PROF_LINE 512
+
+typedef struct
+{
+    rv_profile_t *p;
+    rv_sample_t *tmp;
+    int nthreads;
+    size_t nbuckets;
+    rv_uint64_t min;
+    int shift;
+    size_t *hist;  // nthreads rows of nbuckets counts, then scatter offsets
+    size_t *start; // nbuckets + 1 bucket bounds in tmp
+    atomic_size_t next;
+} sort_t;
+
+// ---------------------------------------------------------------- samples
+
+rv_profile_t *rv_profile_new(void)
+{
+    return rv_calloc(1, sizeof(rv_profile_t));
+}
+
+void rv_profile_free(rv_profile_t *p)
+{
+    if (p == 0)
+        return;
+    rv_free(p->s);
+    rv_free(p);
+}
+
+int rv_profile_add(rv_profile_t *p, rv_uint64_t pc, rv_uint64_t count)
+{
+    if (p->count == p->cap)
+    {
+        size_t ncap = p->cap ? p->cap * 2 : 4096;
+        rv_sample_t *n = rv_realloc(p->s, ncap * sizeof *n);
+        if (n == 0)
+            return -1;
+        p->s = n;
+        p->cap = ncap;
+    }
+    p->s[p->count].pc = pc;
+    p->s[p->count].count = count;
+    p->count++;
+    p->total += count;
+    p->sorted = 0;
+    return 0;
+}
+
+static int hex(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static int parse_text(rv_profile_t *p, const char *s, const char *end)
+{
+    while (s < end)
+    {
+        rv_uint64_t pc = 0, count = 0;
+        int d, digits = 0;
+
+        while (s < end && (*s == ' ' || *s == '\t'))
+            s++;
+        if (s + 1 < end && s[0] == '0' && (s[1] | 0x20) == 'x')
+            s += 2;
+        for (; s < end && (d = hex(*s)) >= 0; s++, digits++)
+            pc = pc << 4 | d;
+        while (s < end && (*s == ' ' || *s == '\t'))
+            s++;
+        for (; s < end && *s >= '0' && *s <= '9'; s++)
+            count = count * 10 + (*s - '0');
+        while (s < end && *s != '\n')
+            s++;
+        s++;
+        if (digits && rv_profile_add(p, pc, count ? count : 1) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+rv_profile_t *rv_profile_load(const char *path)
+{
+    rv_profile_t *p = 0;
+    const char *map;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || (p = rv_profile_new()) == 0)
+        goto out;
+    if (st.st_size == 0)
+        goto out;
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        rv_profile_free(p);
+        p = 0;
+        goto out;
+    }
+
+    if (st.st_size >= 8 && memcmp(map, RV_PROF_MAGIC, 4) == 0)
+    {
+        rv_uint32_t version;
+        size_t i, n = (st.st_size - 8) / sizeof(rv_sample_t);
+
+        memcpy(&version, map + 4, 4);
+        p->s = rv_malloc((n ? n : 1) * sizeof *p->s);
+        if (version != RV_PROF_VERSION || p->s == 0)
+        {
+            rv_profile_free(p);
+            p = 0;
+        }
+        else
+        {
+            memcpy(p->s, map + 8, n * sizeof *p->s);
+            p->count = p->cap = n;
+            for (i = 0; i < n; i++)
+                p->total += p->s[i].count;
+        }
+    }
+    else if (parse_text(p, map, map + st.st_size) < 0)
+    {
+        rv_profile_free(p);
+        p = 0;
+    }
+    munmap((void *)map, st.st_size);
+
+out:
+    close(fd);
+    return p;
+}
+
+// ---------------------------------------------------------------- sort
+
+static size_t bucket(const sort_t *t, rv_uint64_t pc)
+{
+    return (pc - t->min) >> t->shift;
+}
+
+static void slice(const sort_t *t, int id, size_t *lo, size_t *hi)
+{
+    *lo = t->p->count * id / t->nthreads;
+    *hi = t->p->count * (id + 1) / t->nthreads;
+}
+
+static void hist_task(void *arg, int id, int n)
+{
+    sort_t *t = arg;
+    size_t *h = t->hist + id * t->nbuckets;
+    size_t i, lo, hi;
+
+    slice(t, id, &lo, &hi);
+    for (i = lo; i < hi; i++)
+        h[bucket(t, t->p->s[i].pc)]++;
+}
+
+static void scatter_task(void *arg, int id, int n)
+{
+    sort_t *t = arg;
+    size_t *off = t->hist + id * t->nbuckets;
+    size_t i, lo, hi;
+
+    slice(t, id, &lo, &hi);
+    for (i = lo; i < hi; i++)
+        t->tmp[off[bucket(t, t->p->s[i].pc)]++] = t->p->s[i];
+}
+
+// lsd radix sort of src into dst over the bytes that differ.
+static void radix(rv_sample_t *src, rv_sample_t *dst, size_t n)
+{
+    rv_uint64_t diff = 0;
+    rv_sample_t *a = src, *b = dst;
+    size_t i, j;
+    int byte;
+
+    if (n < PROF_INSERTION)
+    {
+        for (i = 0; i < n; i++)
+        {
+            rv_sample_t x = src[i];
+            for (j = i; j > 0 && dst[j - 1].pc > x.pc; j--)
+                dst[j] = dst[j - 1];
+            dst[j] = x;
+        }
+        return;
+    }
+    for (i = 1; i < n; i++)
+        diff |= src[i].pc ^ src[0].pc;
+    for (byte = 0; byte < 8; byte++)
+    {
+        size_t count[256], sum = 0;
+        rv_sample_t *t;
+
+        if (((diff >> (byte * 8)) & 0xff) == 0)
+            continue;
+        bzero(count, sizeof count);
+        for (i = 0; i < n; i++)
+            count[(a[i].pc >> (byte * 8)) & 0xff]++;
+        for (i = 0; i < 256; i++)
+        {
+            size_t c = count[i];
+            count[i] = sum;
+            sum += c;
+        }
+        for (i = 0; i < n; i++)
+            b[count[(a[i].pc >> (byte * 8)) & 0xff]++] = a[i];
+        t = a;
+        a = b;
+        b = t;
+    }
+    if (a != dst)
+        memcpy(dst, a, n * sizeof *dst);
+}
+
+static void bucket_task(void *arg, int id, int n)
+{
+    sort_t *t = arg;
+    size_t k;
+
+    while ((k = atomic_fetch_add(&t->next, 1)) < t->nbuckets)
+    {
+        size_t lo = t->start[k], hi = t->start[k + 1];
+        radix(t->tmp + lo, t->p->s + lo, hi - lo);
+    }
+}
+
+// buckets on the high bits of the pc range in parallel, then radix sorts the
+// buckets independently.
+int rv_profile_sort(rv_profile_t *p, int nthreads)
+{
+    sort_t t;
+    rv_uint64_t max = 0;
+    size_t i, j, sum = 0;
+
+    if (p->sorted || p->count == 0)
+    {
+        p->sorted = 1;
+        return 0;
+    }
+    bzero(&t, sizeof t);
+    t.p = p;
+    t.nthreads = rv_nthreads(nthreads);
+    t.nbuckets = t.nthreads * PROF_BUCKETS;
+    t.min = ~0ull;
+    for (i = 0; i < p->count; i++)
+    {
+        if (p->s[i].pc < t.min)
+            t.min = p->s[i].pc;
+        if (p->s[i].pc > max)
+            max = p->s[i].pc;
+    }
+    while (((max - t.min) >> t.shift) >= t.nbuckets)
+        t.shift++;
+
+    t.tmp = rv_malloc(p->count * sizeof *t.tmp);
+    t.hist = rv_calloc(t.nthreads * t.nbuckets, sizeof *t.hist);
+    t.start = rv_malloc((t.nbuckets + 1) * sizeof *t.start);
+    if (t.tmp == 0 || t.hist == 0 || t.start == 0)
+    {
+        rv_free(t.tmp);
+        rv_free(t.hist);
+        rv_free(t.start);
+        return -1;
+    }
+    rv_parallel(t.nthreads, hist_task, &t);
+
+    // bucket major, thread minor, so that the scatter is stable
+    for (j = 0; j < t.nbuckets; j++)
+    {
+        t.start[j] = sum;
+        for (i = 0; i < (size_t)t.nthreads; i++)
+        {
+            size_t c = t.hist[i * t.nbuckets + j];
+            t.hist[i * t.nbuckets + j] = sum;
+            sum += c;
+        }
+    }
+    t.start[t.nbuckets] = sum;
+    rv_parallel(t.nthreads, scatter_task, &t);
+    atomic_init(&t.next, 0);
+    rv_parallel(t.nthreads, bucket_task, &t);
+
+    for (i = 1, j = 0; i < p->count; i++)
+    {
+        if (p->s[i].pc == p->s[j].pc)
+            p->s[j].count += p->s[i].count;
+        else
+            p->s[++j] = p->s[i];
+    }
+    p->count = j + 1;
+    p->sorted = 1;
+    rv_free(t.tmp);
+    rv_free(t.hist);
+    rv_free(t.start);
+    return 0;
+}
+
+// ---------------------------------------------------------------- annotate
+
+// one merge of the samples against sorted, disjoint [start, start + size)
+// ranges.
+static rv_uint64_t sum_ranges(const rv_profile_t *p, const rv_func_t *funcs, const rv_block_t *blocks, size_t n, rv_uint64_t *totals)
+{
+    rv_uint64_t outside = 0;
+    size_t i, k = 0;
+
+    for (i = 0; i < p->count; i++)
+    {
+        rv_uint64_t pc = p->s[i].pc, lo = 0, hi;
+
+        for (;; k++)
+        {
+            if (k == n)
+                break;
+            lo = funcs ? funcs[k].start : blocks[k].start;
+            hi = funcs ? funcs[k].end : blocks[k].start + blocks[k].size;
+            if (pc < hi)
+                break;
+        }
+        if (k < n && pc >= lo)
+            totals[k] += p->s[i].count;
+        else
+            outside += p->s[i].count;
+    }
+    return outside;
+}
+
+static int put_share(char *buf, rv_uint64_t count, rv_uint64_t total)
+{
+    if (count == 0)
+        return sprintf(buf, "%19s", "");
+    return sprintf(buf, "%7.2f%% %10llu", 100.0 * count / total, count);
+}
+
+static int list_func(rv_sink_t *sink, const rv_profile_t *p, const rv_image_t *img, const rv_func_t *fn, rv_uint64_t ftotal,
+                     const rv_cfg_t *cfg, const rv_uint64_t *btotals, size_t *si, size_t *bi)
+{
+    const rv_section_t *s = rv_image_section(img, fn->start);
+    const rv_symbol_t *sym = rv_image_symbol(img, fn->start);
+    rv_uint64_t pc = fn->start, end = fn->end;
+    char *out;
+    int n;
+
+    out = rv_sink_reserve(sink, PROF_LINE);
+    if (out == 0)
+        return -1;
+    n = sprintf(out, "## %llx %.400s ", fn->start, sym && sym->addr == fn->start ? sym->name : "-");
+    n += put_share(out + n, ftotal, p->total);
+    out[n++] = '\n';
+    rv_sink_commit(sink, n);
+
+    while (*si < p->count && p->s[*si].pc < pc)
+        (*si)++;
+    while (s && pc < end && pc < s->addr + s->size)
+    {
+        rv_uint64_t count = 0;
+        rv_uint32_t raw;
+        mnemonic_t m;
+        inst_t ir;
+        int len = rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), &ir, &raw);
+
+        if (len == 0)
+            break;
+        while (cfg && *bi < cfg->nblocks && cfg->blocks[*bi].start < pc)
+            (*bi)++;
+        if (cfg && *bi < cfg->nblocks && cfg->blocks[*bi].start == pc)
+        {
+            if ((out = rv_sink_reserve(sink, PROF_LINE)) == 0)
+                return -1;
+            n = sprintf(out, "#  block %llx ", pc);
+            n += put_share(out + n, btotals[*bi], p->total);
+            out[n++] = '\n';
+            rv_sink_commit(sink, n);
+        }
+        for (; *si < p->count && p->s[*si].pc < pc + len; (*si)++)
+            count += p->s[*si].count;
+
+        if ((out = rv_sink_reserve(sink, PROF_LINE)) == 0)
+            return -1;
+        n = put_share(out, count, p->total);
+        out[n++] = ' ';
+        rv_disasm(&ir, &m);
+        n += rv_format_line(pc, raw, len, &m, out + n, PROF_LINE - n);
+        rv_mnemonic_free(&m);
+        rv_sink_commit(sink, n < PROF_LINE ? n : PROF_LINE - 1);
+        pc += len;
+    }
+    return 0;
+}
+
+int rv_profile_annotate(rv_sink_t *sink, const rv_profile_t *p, const rv_image_t *img, const rv_func_t *funcs, size_t nfuncs,
+                        const rv_cfg_t *cfg, double min)
+{
+    rv_uint64_t *ftotals = rv_calloc(nfuncs ? nfuncs : 1, sizeof *ftotals);
+    rv_uint64_t *btotals = rv_calloc(cfg && cfg->nblocks ? cfg->nblocks : 1, sizeof *btotals);
+    rv_uint64_t outside;
+    size_t f, si = 0, bi = 0;
+    char *out;
+    int ret = -1;
+
+    if (ftotals == 0 || btotals == 0 || !p->sorted)
+        goto out;
+    outside = sum_ranges(p, funcs, 0, nfuncs, ftotals);
+    if (cfg)
+        sum_ranges(p, 0, cfg->blocks, cfg->nblocks, btotals);
+
+    for (f = 0; f < nfuncs; f++)
+    {
+        if (ftotals[f] == 0 || 100.0 * ftotals[f] < min * p->total)
+            continue;
+        if (list_func(sink, p, img, &funcs[f], ftotals[f], cfg, btotals, &si, &bi) < 0)
+            goto out;
+    }
+    if ((out = rv_sink_reserve(sink, PROF_LINE)) == 0)
+        goto out;
+    rv_sink_commit(sink, sprintf(out, "## outside functions %.2f%% %llu of %llu\n", p->total ? 100.0 * outside / p->total : 0, outside, p->total));
+    ret = 0;
+
+out:
+    rv_free(ftotals);
+    rv_free(btotals);
+    return ret;
+}
@@ -0,0 +1,286 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "rv-sink.h"
+#include "alloc.h"
+
+// buffers form a ring: [head, head + full) wait to be written, the one
+// after them is being filled.
+struct rv_sink
+{
+    int fd;
+    int flags;
+    int error;
+    size_t bufsize;
+    char *bufs[RV_SINK_NBUF];
+    size_t used[RV_SINK_NBUF];
+    int head;
+    int full;
+    int fill;
+
+    rv_uint64_t offset; // bytes appended since open
+    rv_uint64_t start;  // file offset at open
+    rv_uint64_t prealloc;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int closing;
+};
+
+static int writev_all(int fd, struct iovec *iov, int cnt)
+{
+    while (cnt > 0)
+    {
+        ssize_t n = writev(fd, iov, cnt);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        while (cnt > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+// writes count full buffers starting at head with a single writev.
+static int write_bufs(rv_sink_t *s, int head, int count)
+{
+    struct iovec iov[RV_SINK_NBUF];
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        int k = (head + i) % RV_SINK_NBUF;
+        iov[i].iov_base = s->bufs[k];
+        iov[i].iov_len = s->used[k];
+    }
+    return writev_all(s->fd, iov, count);
+}
+
+static void *writer_main(void *arg)
+{
+    rv_sink_t *s = arg;
+
+    pthread_mutex_lock(&s->lock);
+    for (;;)
+    {
+        int head, count, err;
+
+        while (s->full == 0 && !s->closing)
+            pthread_cond_wait(&s->cond, &s->lock);
+        if (s->full == 0)
+            break;
+        head = s->head;
+        count = s->full;
+        pthread_mutex_unlock(&s->lock);
+
+        err = write_bufs(s, head, count);
+
+        pthread_mutex_lock(&s->lock);
+        if (err < 0)
+            s->error = 1;
+        s->head = (s->head + count) % RV_SINK_NBUF;
+        s->full -= count;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return 0;
+}
+
+// hands the current buffer over and moves to the next free one.
+static int sink_rotate(rv_sink_t *s)
+{
+    if (s->used[s->fill] == 0)
+        return s->error ? -1 : 0;
+
+    if (s->flags & RV_SINK_ASYNC)
+    {
+        pthread_mutex_lock(&s->lock);
+        s->full++;
+        pthread_cond_broadcast(&s->cond);
+        while (s->full == RV_SINK_NBUF)
+            pthread_cond_wait(&s->cond, &s->lock);
+        pthread_mutex_unlock(&s->lock);
+    }
+    else
+    {
+        s->full++;
+        if (s->full == RV_SINK_NBUF)
+        {
+            if (write_bufs(s, s->head, s->full) < 0)
+                s->error = 1;
+            s->full = 0;
+        }
+    }
+    // head + full never changes under the writer, so fill + 1 is free
+    s->fill = (s->fill + 1) % RV_SINK_NBUF;
+    s->used[s->fill] = 0;
+    return s->error ? -1 : 0;
+}
+
+rv_sink_t *rv_sink_open(int fd, size_t bufsize, int flags, rv_uint64_t expect)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    rv_sink_t *s = rv_calloc(1, sizeof *s);
+    struct stat st;
+    off_t pos;
+    int i;
+
+    if (s == 0)
+        return 0;
+    if (page <= 0)
+        page = 4096;
+    if (bufsize == 0)
+        bufsize = RV_SINK_BUFSIZE;
+    bufsize = (bufsize + page - 1) & ~(size_t)(page - 1);
+
+    s->fd = fd;
+    s->flags = flags;
+    s->bufsize = bufsize;
+    for (i = 0; i < RV_SINK_NBUF; i++)
+    {
+        if (posix_memalign((void **)&s->bufs[i], page, bufsize) != 0)
+        {
+            s->bufs[i] = 0;
+            goto fail;
+        }
+    }
+
+    pos = lseek(fd, 0, SEEK_CUR);
+    s->start = pos > 0 ? pos : 0;
+    if ((flags & RV_SINK_PREALLOC) && expect && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && !(fcntl(fd, F_GETFL) & O_APPEND))
+    {
+        // best effort: a failing fallocate only costs speed
+        if (posix_fallocate(fd, s->start, expect) == 0)
+            s->prealloc = expect;
+    }
+
+    if (flags & RV_SINK_ASYNC)
+    {
+        pthread_mutex_init(&s->lock, 0);
+        pthread_cond_init(&s->cond, 0);
+        if (pthread_create(&s->writer, 0, writer_main, s) != 0)
+        {
+            pthread_mutex_destroy(&s->lock);
+            pthread_cond_destroy(&s->cond);
+            s->flags &= ~RV_SINK_ASYNC;
+        }
+    }
+    return s;
+
+fail:
+    for (i = 0; i < RV_SINK_NBUF; i++)
+        free(s->bufs[i]); // page aligned for direct i/o, from libc
+    rv_free(s);
+    return 0;
+}
+
+char *rv_sink_reserve(rv_sink_t *s, size_t n)
+{
+    if (n > s->bufsize)
+        return 0;
+    if (s->used[s->fill] + n > s->bufsize && sink_rotate(s) < 0)
+        return 0;
+    return s->bufs[s->fill] + s->used[s->fill];
+}
+
+void rv_sink_commit(rv_sink_t *s, size_t n)
+{
+    s->used[s->fill] += n;
+    s->offset += n;
+}
+
+int rv_sink_write(rv_sink_t *s, const void *data, size_t n)
+{
+    const char *p = data;
+
+    while (n)
+    {
+        size_t room = s->bufsize - s->used[s->fill];
+        if (room == 0)
+        {
+            if (sink_rotate(s) < 0)
+                return -1;
+            continue;
+        }
+        if (room > n)
+            room = n;
+        memcpy(s->bufs[s->fill] + s->used[s->fill], p, room);
+        rv_sink_commit(s, room);
+        p += room;
+        n -= room;
+    }
+    return s->error ? -1 : 0;
+}
+
+// hands what was appended so far to the writer, or writes it when there is
+// none, for output that has to show up before the sink is closed.
+int rv_sink_flush(rv_sink_t *s)
+{
+    if (sink_rotate(s) < 0)
+        return -1;
+    if (!(s->flags & RV_SINK_ASYNC) && s->full)
+    {
+        if (write_bufs(s, s->head, s->full) < 0)
+            s->error = 1;
+        s->head = (s->head + s->full) % RV_SINK_NBUF;
+        s->full = 0;
+    }
+    return s->error ? -1 : 0;
+}
+
+rv_uint64_t rv_sink_offset(const rv_sink_t *s)
+{
+    return s->offset;
+}
+
+// flushes everything and frees s; the fd is left open.
+int rv_sink_close(rv_sink_t *s)
+{
+    int ret, i;
+
+    if (s->flags & RV_SINK_ASYNC)
+    {
+        pthread_mutex_lock(&s->lock);
+        if (s->used[s->fill])
+            s->full++;
+        s->closing = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        pthread_join(s->writer, 0);
+        pthread_mutex_destroy(&s->lock);
+        pthread_cond_destroy(&s->cond);
+    }
+    else
+    {
+        if (s->used[s->fill])
+            s->full++;
+        if (s->full && write_bufs(s, s->head, s->full) < 0)
+            s->error = 1;
+    }
+
+    if (s->prealloc > s->offset && ftruncate(s->fd, s->start + s->offset) < 0)
+        s->error = 1;
+
+    ret = s->error ? -1 : 0;
+    for (i = 0; i < RV_SINK_NBUF; i++)
+        free(s->bufs[i]); // page aligned for direct i/o, from libc
+    rv_free(s);
+    return ret;
+}
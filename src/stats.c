@@ -0,0 +1,159 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-stats.h"
+#include "alloc.h"
+#include "par.h"
+
+typedef struct
+{
+    rv_uint64_t lo;
+    rv_uint64_t hi;
+    const rv_section_t *sec;
+    size_t func; // nfuncs when outside any function
+} unit_t;
+
+typedef struct
+{
+    const rv_func_t *funcs;
+    size_t nfuncs;
+    unit_t *units;
+    size_t nunits;
+    rv_stats_t *out;
+    rv_stats_t *local; // one per thread
+    atomic_size_t next;
+} job_t;
+
+static void sweep(job_t *j, rv_stats_t *s, const unit_t *u)
+{
+    const rv_section_t *sec = u->sec;
+    rv_uint64_t *ext = u->func < j->nfuncs ? j->out->func + u->func * RV_EXT_COUNT : 0;
+    rv_uint64_t pc = u->lo;
+
+    while (pc < u->hi)
+    {
+        size_t off = pc - sec->addr;
+        rv_uint32_t raw;
+        inst_t ir;
+        int len = rv_dis_decode(pc, sec->data + off, sec->size - off, &ir, &raw);
+        unsigned op;
+        int e;
+
+        if (len == 0)
+            break;
+        if ((op = rv_dis_op(&ir)) != RV_OP_NONE)
+            op += RV_STATS_DEC;
+        else
+            op = ir.op < RV_STATS_DEC ? (unsigned)ir.op : RV_STATS_DEC - 1;
+        if (s->ops[op]++ == 0)
+            s->raw[op] = raw;
+        e = rv_ext_class(raw);
+        s->ext[e]++;
+        if (ext)
+            ext[e]++;
+        s->insns++;
+        s->bytes += len;
+        pc += len;
+    }
+}
+
+static void task(void *arg, int id, int n)
+{
+    job_t *j = arg;
+    rv_stats_t *s = &j->local[id];
+    size_t k;
+
+    while ((k = atomic_fetch_add(&j->next, 1)) < j->nunits)
+        sweep(j, s, &j->units[k]);
+}
+
+// the gap before the first function of each section, then one unit per
+// function; function starts are instruction boundaries, so the units decode
+// exactly like a single linear sweep would.
+static unit_t *split(const rv_image_t *img, const rv_func_t *funcs, size_t nfuncs, size_t *count)
+{
+    unit_t *u = rv_malloc((img->nsections + 2 * nfuncs) * sizeof *u);
+    size_t i, f = 0, n = 0;
+
+    if (u == 0)
+        return 0;
+    for (i = 0; i < img->nsections; i++)
+    {
+        const rv_section_t *sec = &img->sections[i];
+        rv_uint64_t lo = sec->addr, end = sec->addr + sec->size;
+
+        if (!sec->exec || sec->data == 0)
+            continue;
+        while (f < nfuncs && funcs[f].start < lo)
+            f++;
+        for (; lo < end; f++)
+        {
+            rv_uint64_t hi = f < nfuncs && funcs[f].start < end ? funcs[f].start : end;
+            if (lo < hi)
+                u[n++] = (unit_t){lo, hi, sec, nfuncs};
+            if (hi == end)
+                break;
+            hi = funcs[f].end < end ? funcs[f].end : end;
+            if (f + 1 < nfuncs && funcs[f + 1].start < hi)
+                hi = funcs[f + 1].start;
+            u[n++] = (unit_t){funcs[f].start, hi, sec, f};
+            lo = hi;
+        }
+    }
+    *count = n;
+    return u;
+}
+
+rv_stats_t *rv_stats_image(const rv_image_t *img, const rv_func_t *funcs, size_t nfuncs, int nthreads)
+{
+    rv_stats_t *s = rv_calloc(1, sizeof *s);
+    job_t j;
+    int t, k, i;
+
+    if (s == 0)
+        return 0;
+    bzero(&j, sizeof j);
+    j.funcs = funcs;
+    j.nfuncs = funcs ? nfuncs : 0;
+    j.out = s;
+    s->nfuncs = j.nfuncs;
+    s->func = rv_calloc((j.nfuncs ? j.nfuncs : 1) * RV_EXT_COUNT, sizeof *s->func);
+    j.units = split(img, funcs, j.nfuncs, &j.nunits);
+    t = rv_nthreads(nthreads);
+    j.local = rv_calloc(t, sizeof *j.local);
+    if (s->func == 0 || j.units == 0 || j.local == 0)
+    {
+        rv_free(j.units);
+        rv_free(j.local);
+        rv_stats_free(s);
+        return 0;
+    }
+    rv_parallel(t, task, &j);
+
+    for (i = 0; i < t; i++)
+    {
+        const rv_stats_t *l = &j.local[i];
+        for (k = 0; k < RV_STATS_OPS; k++)
+        {
+            if (l->ops[k] && s->ops[k] == 0)
+                s->raw[k] = l->raw[k];
+            s->ops[k] += l->ops[k];
+        }
+        for (k = 0; k < RV_EXT_COUNT; k++)
+            s->ext[k] += l->ext[k];
+        s->insns += l->insns;
+        s->bytes += l->bytes;
+    }
+    rv_free(j.units);
+    rv_free(j.local);
+    return s;
+}
+
+void rv_stats_free(rv_stats_t *s)
+{
+    if (s == 0)
+        return;
+    rv_free(s->func);
+    rv_free(s);
+}
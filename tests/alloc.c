@@ -0,0 +1,143 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rv-alloc.h"
+#include "rv-cache.h"
+#include "test.h"
+
+#define BASE 0x10000
+#define REPEAT 50000
+#define MAGIC 0x7261766c6c6f6361ull
+
+static const rv_uint8_t ADD[4] = {0x33, 0x05, 0xb5, 0x00};  // add a0,a0,a1
+static const rv_uint8_t ADDI[4] = {0x13, 0x01, 0x01, 0xff}; // addi sp,sp,-16
+static const rv_uint8_t CNOP[2] = {0x01, 0x00};             // c.nop
+
+static rv_uint8_t code[REPEAT * 10];
+static char path[64];
+
+// tags its blocks so that a release of anything it did not hand out shows.
+static atomic_long live, foreign;
+
+static void *tag_alloc(void *ctx, size_t size)
+{
+    rv_uint64_t *p = malloc(size + 16);
+
+    if (p == 0)
+        return 0;
+    p[0] = MAGIC;
+    atomic_fetch_add(&live, 1);
+    return p + 2;
+}
+
+static int tagged(void *p)
+{
+    if (((rv_uint64_t *)p)[-2] == MAGIC)
+        return 1;
+    atomic_fetch_add(&foreign, 1);
+    return 0;
+}
+
+static void *tag_resize(void *ctx, void *p, size_t size)
+{
+    rv_uint64_t *q;
+
+    if (p == 0)
+        return tag_alloc(ctx, size);
+    if (!tagged(p))
+        return 0;
+    q = realloc((rv_uint64_t *)p - 2, size + 16);
+    return q ? q + 2 : 0;
+}
+
+static void tag_release(void *ctx, void *p)
+{
+    if (!tagged(p))
+        return;
+    ((rv_uint64_t *)p)[-2] = 0;
+    free((rv_uint64_t *)p - 2);
+    atomic_fetch_sub(&live, 1);
+}
+
+static size_t fill(void)
+{
+    size_t n = 0;
+    int i;
+
+    for (i = 0; i < REPEAT; i++)
+    {
+        memcpy(code + n, ADD, 4), n += 4;
+        memcpy(code + n, CNOP, 2), n += 2;
+        memcpy(code + n, ADDI, 4), n += 4;
+    }
+    return n;
+}
+
+static char *slurp(size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *data = 0;
+    long n;
+
+    if (f == 0)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    rewind(f);
+    if ((data = malloc(n)) && fread(data, 1, n, f) != (size_t)n)
+    {
+        free(data);
+        data = 0;
+    }
+    fclose(f);
+    *size = n;
+    return data;
+}
+
+// the cache build passes record arrays between its workers and the caller,
+// so every one of them has to allocate from the caller's allocator.
+static void test_workers_inherit(size_t size)
+{
+    rv_allocator_t tag = {tag_alloc, tag_resize, tag_release, 0};
+
+    rv_dis_set_thread_allocator(&tag);
+    CHECK(rv_cache_build(path, BASE, code, size, 8) == 0);
+    rv_dis_set_thread_allocator(0);
+    CHECK(atomic_load(&foreign) == 0);
+    CHECK(atomic_load(&live) == 0);
+}
+
+// one arena shared by all workers gives the same file as malloc.
+static void test_shared_arena(size_t size)
+{
+    rv_arena_t *arena = rv_arena_new(4096, 0);
+    rv_allocator_t a = rv_arena_allocator(arena);
+    size_t na, nb;
+    char *x, *y;
+
+    CHECK(rv_cache_build(path, BASE, code, size, 1) == 0);
+    x = slurp(&na);
+    rv_dis_set_thread_allocator(&a);
+    CHECK(rv_cache_build(path, BASE, code, size, 8) == 0);
+    rv_dis_set_thread_allocator(0);
+    y = slurp(&nb);
+    CHECK(x && y && na == nb && memcmp(x, y, na) == 0);
+    CHECK(rv_arena_used(arena) > 0);
+    free(x);
+    free(y);
+    rv_arena_free(arena);
+}
+
+int main(void)
+{
+    size_t size = fill();
+
+    snprintf(path, sizeof path, "test-alloc-%d.rvdc", (int)getpid());
+    test_workers_inherit(size);
+    test_shared_arena(size);
+    unlink(path);
+    return test_failures != 0;
+}
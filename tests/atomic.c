@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "rv-alloc.h"
+#include "rv-atomic.h"
+#include "test.h"
+
+#define BASE 0x10000
+
+static const rv_uint8_t CODE[] = {
+    // cas: 0x0
+    0xaf, 0x26, 0x05, 0x16, // lr.w.aqrl a3,(a0)
+    0x63, 0x96, 0xb6, 0x00, // bne a3,a1,out
+    0x2f, 0x27, 0xc5, 0x1a, // sc.w.rl a4,a2,(a0)
+    0xe3, 0x1a, 0x07, 0xfe, // bnez a4,cas
+    // out: 0x10
+    0x0f, 0x00, 0x30, 0x03, // fence rw,rw
+    0xaf, 0x37, 0xb5, 0x04, // amoadd.d.aq a5,a1,(a0)
+    0x0f, 0x00, 0x30, 0x83, // fence.tso
+    0x0f, 0x00, 0x10, 0x02, // fence r,w
+    0x0f, 0x10, 0x00, 0x00, // fence.i
+    0x67, 0x80, 0x00, 0x00, // ret
+    // spin: 0x28
+    0x13, 0x05, 0xf5, 0xff, // addi a0,a0,-1
+    // head: 0x2c
+    0x0f, 0x00, 0x30, 0x03, // fence rw,rw
+    0xaf, 0x27, 0xb6, 0x40, // amoor.w a5,a1,(a2)
+    0x13, 0x05, 0xf5, 0xff, // addi a0,a0,-1
+    0xe3, 0x1a, 0x05, 0xfe, // bnez a0,head
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+static const rv_func_t FUNCS[2] = {{BASE, BASE + 0x28, RV_FUNC_SYMBOL, 0}, {BASE + 0x28, BASE + sizeof CODE, RV_FUNC_SYMBOL, 0}};
+
+typedef struct
+{
+    rv_uint64_t off;
+    int kind;
+    const char *order;
+    int width;
+    rv_uint64_t loop; // offset of the loop head, or -1
+    int flags;
+} want_t;
+
+// the lr.aqrl of the retry loop and the fence of the spin loop are hot; the
+// fence rw,rw after the loop is heavy only, and fence.tso is not heavy.
+static const want_t WANT[] = {
+    {0x00, RV_ATOMIC_LR, "seq_cst", 4, 0x00, RV_ATOMIC_LOOP | RV_ATOMIC_HEAVY | RV_ATOMIC_HOT},
+    {0x08, RV_ATOMIC_SC, "release", 4, 0x00, RV_ATOMIC_LOOP},
+    {0x10, RV_ATOMIC_FENCE, "rw,rw", 0, -1, RV_ATOMIC_HEAVY},
+    {0x14, RV_ATOMIC_AMO, "acquire", 8, -1, 0},
+    {0x18, RV_ATOMIC_FENCE_TSO, "tso", 0, -1, 0},
+    {0x1c, RV_ATOMIC_FENCE, "r,w", 0, -1, 0},
+    {0x20, RV_ATOMIC_FENCE_I, "fetch", 0, -1, 0},
+    {0x2c, RV_ATOMIC_FENCE, "rw,rw", 0, 0x2c, RV_ATOMIC_LOOP | RV_ATOMIC_HEAVY | RV_ATOMIC_HOT},
+    {0x30, RV_ATOMIC_AMO, "relaxed", 4, 0x2c, RV_ATOMIC_LOOP},
+};
+
+static void test_scan(int nthreads)
+{
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    size_t n = sizeof WANT / sizeof *WANT, count, i;
+    rv_atomic_t *a = rv_atomic_scan(img, FUNCS, 2, nthreads, &count), *p;
+    char buf[16];
+
+    CHECK(a != 0 && count == n);
+    if (a == 0 || count != n)
+    {
+        rv_dis_free(a);
+        rv_image_close(img);
+        return;
+    }
+    for (i = 0; i < n; i++)
+    {
+        const want_t *w = &WANT[i];
+
+        p = &a[i];
+        CHECK(p->pc == BASE + w->off && p->func == (w->off < 0x28 ? BASE : BASE + 0x28));
+        CHECK(p->kind == w->kind && p->width == w->width && p->flags == w->flags);
+        CHECK(strcmp(rv_atomic_order(p, buf, sizeof buf), w->order) == 0);
+        CHECK(w->loop == (rv_uint64_t)-1 ? p->loop == 0 : p->loop == BASE + w->loop);
+    }
+    rv_dis_free(a);
+    rv_image_close(img);
+}
+
+int main(void)
+{
+    test_scan(1);
+    test_scan(2);
+    return test_failures != 0;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rv-cache.h"
+#include "test.h"
+
+#define BASE 0x10000
+#define REPEAT 4096
+
+static const rv_uint8_t ADD[4] = {0x33, 0x05, 0xb5, 0x00};  // add a0,a0,a1
+static const rv_uint8_t ADDI[4] = {0x13, 0x01, 0x01, 0xff}; // addi sp,sp,-16
+static const rv_uint8_t CNOP[2] = {0x01, 0x00};             // c.nop
+
+static rv_uint8_t code[REPEAT * 10];
+static char path[64], bad[64];
+
+static size_t fill(void)
+{
+    size_t n = 0;
+    int i;
+
+    for (i = 0; i < REPEAT; i++)
+    {
+        memcpy(code + n, ADD, 4), n += 4;
+        memcpy(code + n, CNOP, 2), n += 2;
+        memcpy(code + n, ADDI, 4), n += 4;
+    }
+    return n;
+}
+
+static char *slurp(const char *p, size_t *size)
+{
+    FILE *f = fopen(p, "rb");
+    char *data;
+    long n;
+
+    if (f == 0)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    rewind(f);
+    data = malloc(n);
+    if (data && fread(data, 1, n, f) != (size_t)n)
+    {
+        free(data);
+        data = 0;
+    }
+    fclose(f);
+    *size = n;
+    return data;
+}
+
+static void spill(const char *p, const void *data, size_t size)
+{
+    FILE *f = fopen(p, "wb");
+
+    CHECK(f && fwrite(data, 1, size, f) == size);
+    if (f)
+        fclose(f);
+}
+
+// a rejected file still gives correct lines, rendered live.
+static void check_stale(size_t size)
+{
+    rv_cache_t *c = rv_cache_open(bad, BASE, code, size);
+    rv_line_t line;
+    char buf[RV_TEXT_MAX];
+
+    CHECK(c && !rv_cache_valid(c));
+    if (c == 0)
+        return;
+    CHECK(rv_cache_line(c, BASE + 4, &line, buf, sizeof buf) == 2);
+    CHECK(line.pc == BASE + 4 && line.text == buf);
+    rv_cache_close(c);
+}
+
+static void test_roundtrip(size_t size)
+{
+    rv_cache_t *c;
+    rv_line_t line;
+    char buf[RV_TEXT_MAX];
+
+    CHECK(rv_cache_build(path, BASE, code, size, 4) == 0);
+    c = rv_cache_open(path, BASE, code, size);
+    CHECK(c && rv_cache_valid(c));
+    if (c == 0)
+        return;
+    CHECK(rv_cache_line(c, BASE + 12, &line, buf, sizeof buf) == 4);
+    CHECK(line.pc == BASE + 10 && line.text != buf);
+    CHECK(rv_cache_line(c, BASE + size - 1, &line, buf, sizeof buf) == 4);
+    CHECK(rv_cache_line(c, BASE + size, &line, buf, sizeof buf) == 0);
+    rv_cache_close(c);
+}
+
+// headers that lie about the layout, each of which used to pass the checks
+// or get past them to out of bounds reads.
+static void test_crafted(size_t size)
+{
+    size_t fsize, n;
+    char *data = slurp(path, &fsize);
+    rv_cache_hdr_t h;
+    rv_cache_cp_t cp;
+
+    CHECK(data != 0);
+    if (data == 0)
+        return;
+    memcpy(&h, data, sizeof h);
+    CHECK(h.order == RV_CACHE_ORDER && h.ncp > 2 && h.nrec > 0);
+
+    for (n = 0; n < fsize; n += fsize / 7 + 1)
+    {
+        spill(bad, data, n);
+        check_stale(size);
+    }
+
+    // byte order of the other kind of host
+    h.order = __builtin_bswap32(RV_CACHE_ORDER);
+    memcpy(data, &h, sizeof h);
+    spill(bad, data, fsize);
+    check_stale(size);
+    h.order = RV_CACHE_ORDER;
+
+    // nrec * sizeof wrapping back to the real pool offset
+    h.nrec += 1ull << 61;
+    memcpy(data, &h, sizeof h);
+    spill(bad, data, fsize);
+    check_stale(size);
+    h.nrec -= 1ull << 61;
+    memcpy(data, &h, sizeof h);
+
+    // the last checkpoint past the records
+    n = h.cp_off + (h.ncp - 1) * sizeof cp;
+    memcpy(&cp, data + n, sizeof cp);
+    cp.rec = h.nrec + 1000;
+    memcpy(data + n, &cp, sizeof cp);
+    spill(bad, data, fsize);
+    check_stale(size);
+
+    free(data);
+}
+
+int main(void)
+{
+    size_t size = fill();
+
+    snprintf(path, sizeof path, "test-cache-%d.rvdc", (int)getpid());
+    snprintf(bad, sizeof bad, "test-cache-%d.bad", (int)getpid());
+    test_roundtrip(size);
+    test_crafted(size);
+    unlink(path);
+    unlink(bad);
+    return test_failures != 0;
+}
@@ -0,0 +1,70 @@
+#include "rv-cfg.h"
+#include "test.h"
+
+#define BASE 0x10000
+
+static const rv_uint8_t CODE[] = {
+    0x13, 0x05, 0x15, 0x00, // addi a0,a0,1
+    0x63, 0x06, 0x05, 0x00, // beq a0,zero,out
+    0x0b, 0x00, 0x00, 0x00, // .word 0x0000000b
+    0x33, 0x05, 0xa5, 0x00, // add a0,a0,a0
+    // out: 0x10
+    0x67, 0x80, 0x00, 0x00, // ret
+    0x01, 0x00,             // c.nop
+    0x13, 0x05, 0x05, 0x45, // addi a0,a0,1104
+    0x13, 0x05, 0x15, 0x00, // addi a0,a0,1
+    0x67, 0x80, 0x00, 0x00, // ret
+    0x05, 0x45,             // c.li a0,1 (inside the addi above)
+};
+
+static const rv_block_t *block(const rv_cfg_t *cfg, rv_uint64_t start)
+{
+    size_t i;
+
+    for (i = 0; i < cfg->nblocks; i++)
+        if (cfg->blocks[i].start == start)
+            return &cfg->blocks[i];
+    return 0;
+}
+
+// a word that decodes to nothing ends its block, and two decode streams
+// meeting mid-block split it where they join.
+static void test_blocks(void)
+{
+    rv_uint64_t entries[3] = {BASE, BASE + 0x16, BASE + 0x18};
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    rv_cfg_t *cfg = rv_cfg_build(img, entries, 3, 2);
+    const rv_block_t *b;
+    size_t i;
+
+    CHECK(cfg != 0 && cfg->nblocks == 6);
+    if (cfg == 0)
+        return;
+
+    b = block(cfg, BASE);
+    CHECK(b && b->size == 8 && b->flow == RV_FLOW_BRANCH && b->nedges == 2);
+    b = block(cfg, BASE + 0x8);
+    CHECK(b && b->size == 4 && b->ninsn == 1 && b->flow == RV_FLOW_STOP && b->nedges == 0);
+    CHECK(rv_cfg_find(cfg, BASE + 0xc) == RV_CFG_NONE);
+    b = block(cfg, BASE + 0x10);
+    CHECK(b && b->size == 4 && b->flow == RV_FLOW_RET);
+
+    b = block(cfg, BASE + 0x16);
+    CHECK(b && b->size == 4 && b->nedges == 1 && cfg->edges[b->edge].target == BASE + 0x1a);
+    b = block(cfg, BASE + 0x18);
+    CHECK(b && b->size == 2 && b->nedges == 1 && cfg->edges[b->edge].target == BASE + 0x1a);
+    b = block(cfg, BASE + 0x1a);
+    CHECK(b && b->size == 8 && b->ninsn == 2 && b->flow == RV_FLOW_RET);
+
+    for (i = 0; i < cfg->nedges; i++)
+        CHECK(cfg->edges[i].to != RV_CFG_NONE);
+
+    rv_cfg_free(cfg);
+    rv_image_close(img);
+}
+
+int main(void)
+{
+    test_blocks();
+    return test_failures != 0;
+}
@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "rv-cost.h"
+#include "test.h"
+
+#define BASE 0x1000
+
+static const rv_uint8_t CODE[] = {
+    // loop: 0x0
+    0x83, 0x35, 0x05, 0x00, // ld a1,0(a0)
+    0x33, 0x06, 0xb6, 0x00, // add a2,a2,a1
+    0x13, 0x05, 0x85, 0x00, // addi a0,a0,8
+    0xe3, 0x1a, 0xd5, 0xfe, // bne a0,a3,loop
+    // chain: 0x10
+    0x33, 0x05, 0xb5, 0x02, // mul a0,a0,a1
+    // muls: 0x14
+    0x33, 0x85, 0xb5, 0x02, // mul a0,a1,a1
+    0x33, 0x86, 0xd6, 0x02, // mul a2,a3,a3
+    0x33, 0x87, 0xf7, 0x02, // mul a4,a5,a5
+    // retry: 0x20
+    0xaf, 0x25, 0x05, 0x10, // lr.w a1,(a0)
+    0x2f, 0x26, 0xb5, 0x18, // sc.w a2,a1,(a0)
+    0xe3, 0x1c, 0x06, 0xfe, // bnez a2,retry
+    // copy: 0x2c
+    0x87, 0x60, 0x05, 0x02, // vle32.v v1,(a0)
+    0xa7, 0xe0, 0x05, 0x02, // vse32.v v1,(a1)
+};
+
+static int cost(const rv_model_t *model, rv_uint64_t lo, rv_uint64_t hi, rv_cost_t *c)
+{
+    return rv_cost_range(model, BASE, CODE, sizeof CODE, BASE + lo, BASE + hi, c);
+}
+
+// single issue: ld feeds add 3 cycles later, addi feeds bne.
+static void test_default(void)
+{
+    rv_model_t *model = rv_model_default();
+    rv_cost_t c;
+
+    CHECK(model != 0);
+    if (model == 0)
+        return;
+    CHECK(cost(model, 0x0, 0x10, &c) == 0);
+    CHECK(c.ninsn == 4 && c.cycles == 6 && c.latency == 6 && c.bound == RV_COST_DEPS);
+    CHECK(cost(model, 0x10, 0x14, &c) == 0);
+    CHECK(c.ninsn == 1 && c.cycles == 3 && c.latency == 3 && c.bound == RV_COST_DEPS);
+    rv_model_free(model);
+}
+
+// the dual issue model of models/.
+static void test_model(const char *path)
+{
+    rv_model_t *model = rv_model_load(path);
+    rv_cost_t c;
+
+    CHECK(model != 0);
+    if (model == 0)
+        return;
+
+    // addi pairs with add, bne issues next cycle with the next ld
+    CHECK(cost(model, 0x0, 0x10, &c) == 0);
+    CHECK(c.cycles == 4 && c.ipc == 1 && c.latency == 5 && c.bound == RV_COST_DEPS);
+
+    // independent muls queue on the one muldiv unit
+    CHECK(cost(model, 0x14, 0x20, &c) == 0);
+    CHECK(c.cycles == 3 && c.latency == 5 && c.bound == RV_COST_PORT);
+    CHECK(rv_model_port(model, c.port) && strcmp(rv_model_port(model, c.port), "muldiv") == 0);
+
+    // bnez waits for the status sc writes
+    CHECK(cost(model, 0x20, 0x2c, &c) == 0);
+    CHECK(c.cycles == 4 && c.latency == 5);
+
+    // the vector store reads v1 from the load and writes nothing
+    CHECK(cost(model, 0x2c, 0x34, &c) == 0);
+    CHECK(c.ninsn == 2 && c.cycles == 4 && c.latency == 4 && c.bound == RV_COST_DEPS);
+    CHECK(rv_model_port(model, c.port) && strcmp(rv_model_port(model, c.port), "mem") == 0);
+
+    rv_model_free(model);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s model\n", argv[0]);
+        return 2;
+    }
+    test_default();
+    test_model(argv[1]);
+    return test_failures != 0;
+}
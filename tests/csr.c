@@ -0,0 +1,89 @@
+#include <string.h>
+
+#include "rv-csr.h"
+#include "rv-isa.h"
+#include "test.h"
+
+// csrr a0,csr rendered under isa, the tab written as a space.
+static const char *csrr(const char *isa_name, rv_uint32_t csr, char *buf, size_t size)
+{
+    rv_uint32_t w = csr << 20 | 0x2573;
+    rv_uint8_t code[4] = {w, w >> 8, w >> 16, w >> 24};
+    mnemonic_t m;
+    rv_isa_t isa;
+    inst_t ir;
+    char *tab;
+
+    buf[0] = 0;
+    if (rv_isa_parse(isa_name, &isa) < 0 || rv_dis_decode_isa(&isa, 0, code, 4, &ir, 0) != 4)
+        return buf;
+    rv_disasm_isa(&isa, &ir, &m);
+    rv_format(&m, buf, size);
+    rv_mnemonic_free(&m);
+    if ((tab = strchr(buf, '\t')) != 0)
+        *tab = ' ';
+    return buf;
+}
+
+// the upper halves are named on rv32 only; rv64 prints the number.
+static void test_xlen(void)
+{
+    char buf[RV_TEXT_MAX];
+
+    CHECK(strcmp(csrr("rv32i_zicsr", 0xc80, buf, sizeof buf), "csrr a0,cycleh") == 0);
+    CHECK(strcmp(csrr("rv64i_zicsr", 0xc80, buf, sizeof buf), "csrr a0,0xc80") == 0);
+    CHECK(strcmp(csrr("rv32i_zicsr", 0xc00, buf, sizeof buf), "csrr a0,cycle") == 0);
+    CHECK(strcmp(csrr("rv64i_zicsr", 0xc00, buf, sizeof buf), "csrr a0,cycle") == 0);
+    CHECK(strcmp(csrr("rv32i_zicsr", 0x723, buf, sizeof buf), "csrr a0,mhpmevent3h") == 0);
+    CHECK(strcmp(csrr("rv64i_zicsr", 0x723, buf, sizeof buf), "csrr a0,0x723") == 0);
+
+    CHECK(rv_csr_info_xlen(0xc80, 32) && rv_csr_info_xlen(0xc80, 64) == 0);
+    CHECK(rv_csr_info_xlen(0x31c, 32) && strcmp(rv_csr_info_xlen(0x31c, 32)->name, "mstateen0h") == 0);
+    CHECK(rv_csr_info_xlen(0x31c, 64) == 0 && rv_csr_info_xlen(0x30c, 64) != 0);
+}
+
+// names and metadata out of the newer sets, and numbers nobody defines: the
+// custom ranges and past the 12 bit space.
+static void test_names(void)
+{
+    static const struct
+    {
+        rv_uint32_t csr;
+        const char *name;
+        int priv;
+        int flags;
+    } named[] = {
+        {0x600, "hstatus", RV_PRIV_H, RV_CSR_RW},
+        {0xc22, "vlenb", RV_PRIV_U, RV_CSR_RO},
+        {0x7b0, "dcsr", RV_PRIV_D, RV_CSR_RW},
+        {0xda0, "scountovf", RV_PRIV_S, RV_CSR_RO},
+        {0xc03, "hpmcounter3", RV_PRIV_U, RV_CSR_RO},
+    };
+    static const rv_uint32_t unknown[] = {0x7c0, 0x800, 0x5c0, 0xfff};
+    char buf[RV_TEXT_MAX], want[32];
+    const rv_csr_t *c;
+    size_t i;
+
+    for (i = 0; i < sizeof named / sizeof *named; i++)
+    {
+        c = rv_csr_info_xlen(named[i].csr, 64);
+        CHECK(c && strcmp(c->name, named[i].name) == 0 && c->priv == named[i].priv && c->flags == named[i].flags);
+        snprintf(want, sizeof want, "csrr a0,%s", named[i].name);
+        CHECK(strcmp(csrr("rv64i_zicsr", named[i].csr, buf, sizeof buf), want) == 0);
+    }
+    for (i = 0; i < sizeof unknown / sizeof *unknown; i++)
+    {
+        CHECK(rv_csr_info_xlen(unknown[i], 32) == 0 && rv_csr_info_xlen(unknown[i], 64) == 0);
+        snprintf(want, sizeof want, "csrr a0,0x%x", unknown[i]);
+        CHECK(strcmp(csrr("rv64i_zicsr", unknown[i], buf, sizeof buf), want) == 0);
+    }
+    CHECK(rv_csr_info_xlen(4096, 64) == 0 && rv_csr_info_xlen(~0ull, 32) == 0);
+    CHECK(strcmp(rv_priv_name(RV_PRIV_H), "h") == 0 && strcmp(rv_priv_name(9), "?") == 0);
+}
+
+int main(void)
+{
+    test_xlen();
+    test_names();
+    return test_failures != 0;
+}
@@ -0,0 +1,64 @@
+#include <string.h>
+
+#include "rv-custom.h"
+#include "rv-isa.h"
+#include "test.h"
+
+static const rv_uint8_t CUSTOM0[4] = {0x0b, 0x85, 0xc5, 0x00}; // custom-0 a0,a1,a2
+static const rv_uint8_t ANDN[4] = {0x33, 0xf5, 0xc5, 0x40};    // andn a0,a1,a2
+static const rv_uint8_t MUL[4] = {0x33, 0x85, 0xc5, 0x02};     // mul a0,a1,a2
+
+static int render(const rv_uint8_t *code, char *buf, size_t size, inst_t *ir)
+{
+    mnemonic_t m;
+    int n;
+
+    if (rv_dis_decode(0, code, 4, ir, 0) != 4)
+        return -1;
+    rv_disasm(ir, &m);
+    n = rv_format(&m, buf, size);
+    rv_mnemonic_free(&m);
+    return n;
+}
+
+// a claimed encoding is tagged and escapes the profile, but the decoder and
+// the op table keep theirs.
+static void test_tags(void)
+{
+    rv_custom_t c = {0x0000000b, 0x0000007f, "mac", "rd,rs1,rs2", 0, 0};
+    rv_custom_t a = {0x40007033, 0xfe00707f, "myandn", "rd,rs2,rs1", 0, 0};
+    rv_custom_t x = {0x02000033, 0xfe00707f, "mymul", "rd,rs1,rs2", 0, 0};
+    char buf[RV_TEXT_MAX];
+    rv_isa_t base;
+    inst_t ir;
+
+    CHECK(render(ANDN, buf, sizeof buf, &ir) > 0 && rv_dis_op(&ir) == RV_OP_ANDN && strcmp(buf, "andn\ta0,a1,a2") == 0);
+    CHECK(render(CUSTOM0, buf, sizeof buf, &ir) > 0 && rv_dis_op(&ir) == RV_OP_NONE);
+
+    // a table tag on an encoding the entry does not match is ignored
+    ir.uimm = RV_OP_ANDN;
+    CHECK(rv_dis_op(&ir) == RV_OP_NONE);
+
+    CHECK(rv_custom_register(&c) == 0 && rv_custom_register(&a) == 0 && rv_custom_register(&x) == 0);
+    CHECK(render(CUSTOM0, buf, sizeof buf, &ir) > 0 && strcmp(buf, "mac\ta0,a1,a2") == 0);
+    CHECK(ir.op == RV_UNDEF && rv_dis_op(&ir) == RV_OP_CUSTOM && ir.imm.u == 0x00c5850b);
+    CHECK(rv_op_info(rv_dis_op(&ir)) == 0);
+    CHECK(render(ANDN, buf, sizeof buf, &ir) > 0 && rv_dis_op(&ir) == RV_OP_ANDN && strcmp(buf, "andn\ta0,a1,a2") == 0);
+    CHECK(render(MUL, buf, sizeof buf, &ir) > 0 && ir.op == RV_MUL && strcmp(buf, "mul\ta0,a1,a2") == 0);
+
+    rv_isa_parse("rv64i", &base);
+    rv_isa_select(&base);
+    CHECK(render(CUSTOM0, buf, sizeof buf, &ir) > 0 && rv_dis_op(&ir) == RV_OP_CUSTOM);
+    // outside the profile andn is undef, still not the plug-in's
+    CHECK(render(ANDN, buf, sizeof buf, &ir) > 0 && rv_dis_op(&ir) == RV_OP_NONE && strcmp(buf, "undef") == 0);
+    rv_custom_clear();
+    CHECK(render(ANDN, buf, sizeof buf, &ir) > 0 && ir.op == RV_UNDEF && rv_dis_op(&ir) == RV_OP_NONE);
+    CHECK(strcmp(buf, "undef") == 0);
+    rv_isa_select(0);
+}
+
+int main(void)
+{
+    test_tags();
+    return test_failures != 0;
+}
@@ -0,0 +1,178 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rv-alloc.h"
+#include "rv-diff.h"
+#include "test.h"
+
+#define BASE_A 0x10000
+#define BASE_B 0x20000
+
+static const rv_uint8_t CODE_A[] = {
+    // f: 0x0
+    0x13, 0x05, 0x15, 0x00, // addi a0,a0,1
+    0x13, 0x05, 0x25, 0x00, // addi a0,a0,2
+    0x13, 0x05, 0x35, 0x00, // addi a0,a0,3
+    0x13, 0x05, 0x45, 0x00, // addi a0,a0,4
+    0x13, 0x05, 0x55, 0x00, // addi a0,a0,5
+    0x13, 0x05, 0x65, 0x00, // addi a0,a0,6
+    0x13, 0x05, 0x75, 0x00, // addi a0,a0,7
+    0x67, 0x80, 0x00, 0x00, // ret
+    // g: 0x20
+    0xef, 0xf0, 0x1f, 0xfe, // jal ra,f
+    0x97, 0x00, 0x00, 0x00, // auipc ra,%pcrel_hi(f)
+    0xe7, 0x80, 0xc0, 0xfd, // jalr ra,%pcrel_lo(f)(ra)
+    0x67, 0x80, 0x00, 0x00, // ret
+    // h: 0x30
+    0x13, 0x05, 0xb5, 0x00, // addi a0,a0,11
+    0x13, 0x05, 0xc5, 0x00, // addi a0,a0,12
+    0x67, 0x80, 0x00, 0x00, // ret
+    // r1: 0x3c
+    0x13, 0x05, 0xa5, 0x02, // addi a0,a0,42
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+// relinked: g and a renamed r1 first, h gone, k new, and f edited.
+static const rv_uint8_t CODE_B[] = {
+    // g: 0x0
+    0xef, 0x00, 0x00, 0x02, // jal ra,f
+    0x97, 0x00, 0x00, 0x00, // auipc ra,%pcrel_hi(f)
+    0xe7, 0x80, 0xc0, 0x01, // jalr ra,%pcrel_lo(f)(ra)
+    0x67, 0x80, 0x00, 0x00, // ret
+    // k: 0x10
+    0x13, 0x05, 0xd5, 0x00, // addi a0,a0,13
+    0x67, 0x80, 0x00, 0x00, // ret
+    // r2: 0x18
+    0x13, 0x05, 0xa5, 0x02, // addi a0,a0,42
+    0x67, 0x80, 0x00, 0x00, // ret
+    // f: 0x20
+    0x13, 0x05, 0x15, 0x00, // addi a0,a0,1
+    0x13, 0x05, 0x95, 0x00, // addi a0,a0,9
+    0x13, 0x05, 0x35, 0x00, // addi a0,a0,3
+    0x13, 0x05, 0x45, 0x00, // addi a0,a0,4
+    0x13, 0x05, 0x85, 0x00, // addi a0,a0,8
+    0x13, 0x05, 0x55, 0x00, // addi a0,a0,5
+    0x13, 0x05, 0x75, 0x00, // addi a0,a0,7
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+static rv_symbol_t syms_a[4] = {{"f", BASE_A, 0x20}, {"g", BASE_A + 0x20, 16}, {"h", BASE_A + 0x30, 12}, {"r1", BASE_A + 0x3c, 8}};
+static rv_symbol_t syms_b[4] = {{"g", BASE_B, 16}, {"k", BASE_B + 0x10, 8}, {"r2", BASE_B + 0x18, 8}, {"f", BASE_B + 0x20, 0x20}};
+
+static char path[64];
+
+typedef struct
+{
+    rv_image_t *img;
+    rv_func_t *funcs;
+    size_t n;
+    rv_uint64_t *hash;
+} side_t;
+
+static int side(side_t *s, rv_uint64_t base, const rv_uint8_t *code, size_t size, rv_symbol_t *syms)
+{
+    s->img = rv_image_raw(base, code, size);
+    if (s->img == 0)
+        return -1;
+    s->img->symbols = syms;
+    s->img->nsymbols = 4;
+    s->funcs = rv_func_detect(s->img, 2, &s->n);
+    s->hash = s->funcs ? rv_diff_hash(s->img, s->funcs, s->n, 2) : 0;
+    return s->hash && s->n == 4 ? 0 : -1;
+}
+
+static void side_free(side_t *s)
+{
+    rv_dis_free(s->funcs);
+    rv_dis_free(s->hash);
+    if (s->img)
+    {
+        s->img->symbols = 0;
+        s->img->nsymbols = 0;
+    }
+    rv_image_close(s->img);
+}
+
+// the "-" and "+" lines rv_diff_func writes for a and b.
+static char *diff_text(const side_t *a, size_t fa, const side_t *b, size_t fb)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    rv_sink_t *sink = fd < 0 ? 0 : rv_sink_open(fd, 0, 0, 0);
+    char *buf = calloc(1, 4096);
+    ssize_t n = -1;
+
+    if (sink && buf)
+    {
+        CHECK(rv_diff_func(sink, a->img, &a->funcs[fa], b->img, &b->funcs[fb]) == 0);
+        CHECK(rv_sink_close(sink) == 0);
+        n = pread(fd, buf, 4095, 0);
+    }
+    CHECK(n >= 0);
+    if (fd >= 0)
+        close(fd);
+    if (n < 0)
+    {
+        free(buf);
+        return 0;
+    }
+    return buf;
+}
+
+static void test_match(const side_t *a, const side_t *b)
+{
+    rv_match_t *m;
+    size_t n;
+
+    m = rv_diff_match(a->img, a->funcs, a->hash, a->n, b->img, b->funcs, b->hash, b->n, &n);
+    CHECK(m != 0 && n == 5);
+    if (m == 0 || n != 5)
+    {
+        rv_dis_free(m);
+        return;
+    }
+    CHECK(m[0].a == 0 && m[0].b == 3 && m[0].kind == RV_DIFF_CHANGED);
+    // the calls to f are symbolized, so moving both leaves g the same
+    CHECK(m[1].a == 1 && m[1].b == 0 && m[1].kind == RV_DIFF_SAME);
+    CHECK(m[2].a == 2 && m[2].b == RV_DIFF_NONE && m[2].kind == RV_DIFF_REMOVED);
+    CHECK(m[3].a == 3 && m[3].b == 2 && m[3].kind == RV_DIFF_MOVED);
+    CHECK(m[4].a == RV_DIFF_NONE && m[4].b == 1 && m[4].kind == RV_DIFF_ADDED);
+    rv_dis_free(m);
+}
+
+// 2 modified into 9, 8 inserted after 4, 6 deleted.
+static void test_lines(const side_t *a, const side_t *b)
+{
+    static const char EXPECT[] = "-\t10004\taddi\ta0,a0,2\n"
+                                 "+\t20024\taddi\ta0,a0,9\n"
+                                 "+\t20030\taddi\ta0,a0,8\n"
+                                 "-\t10014\taddi\ta0,a0,6\n";
+    char *text;
+
+    text = diff_text(a, 0, b, 3);
+    CHECK(text && strcmp(text, EXPECT) == 0);
+    free(text);
+
+    text = diff_text(a, 1, b, 0);
+    CHECK(text && text[0] == 0);
+    free(text);
+}
+
+int main(void)
+{
+    side_t a = {0}, b = {0};
+
+    snprintf(path, sizeof path, "test-diff-%d.out", (int)getpid());
+    CHECK(side(&a, BASE_A, CODE_A, sizeof CODE_A, syms_a) == 0);
+    CHECK(side(&b, BASE_B, CODE_B, sizeof CODE_B, syms_b) == 0);
+    if (a.hash && a.n == 4 && b.hash && b.n == 4)
+    {
+        test_match(&a, &b);
+        test_lines(&a, &b);
+    }
+    side_free(&a);
+    side_free(&b);
+    unlink(path);
+    return test_failures != 0;
+}
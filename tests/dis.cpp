@@ -0,0 +1,139 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "rv-dis.hpp"
+
+extern "C"
+{
+#include "test.h"
+}
+
+static constexpr rv_uint64_t MAGIC = 0x7261766c6c6f6361ull;
+
+// tags its blocks, so freeing anything of its through malloc, or anything
+// else through it, shows up.
+static std::atomic<long> live, allocs, foreign;
+
+static void *tag_alloc(void *, size_t size)
+{
+    auto *p = static_cast<rv_uint64_t *>(std::malloc(size + 16));
+
+    if (p == nullptr)
+        return nullptr;
+    p[0] = MAGIC;
+    live++;
+    allocs++;
+    return p + 2;
+}
+
+static bool tagged(void *p)
+{
+    if (static_cast<rv_uint64_t *>(p)[-2] == MAGIC)
+        return true;
+    foreign++;
+    return false;
+}
+
+static void *tag_resize(void *ctx, void *p, size_t size)
+{
+    if (p == nullptr)
+        return tag_alloc(ctx, size);
+    if (!tagged(p))
+        return nullptr;
+    auto *q = static_cast<rv_uint64_t *>(std::realloc(static_cast<rv_uint64_t *>(p) - 2, size + 16));
+    return q ? q + 2 : nullptr;
+}
+
+static void tag_release(void *, void *p)
+{
+    if (!tagged(p))
+        return;
+    static_cast<rv_uint64_t *>(p)[-2] = 0;
+    std::free(static_cast<rv_uint64_t *>(p) - 2);
+    live--;
+}
+
+static const rv_allocator_t tag = {tag_alloc, tag_resize, tag_release, nullptr};
+static const rv_uint8_t code[] = {0x33, 0x05, 0xb5, 0x00, 0x01, 0x00, 0x13, 0x01, 0x01, 0xff};
+
+static std::vector<inst_t> decode_all()
+{
+    std::vector<inst_t> insts;
+    std::span<const rv_uint8_t> rest(code);
+
+    while (!rest.empty())
+    {
+        rv::decoded d = rv::decode(0, rest);
+        if (d.len == 0)
+            break;
+        insts.push_back(d.ir);
+        rest = rest.subspan(d.len);
+    }
+    return insts;
+}
+
+// made under one allocator, destroyed and overwritten under another.
+static void test_owner_allocator(const std::vector<inst_t> &insts)
+{
+    std::optional<rv::mnemonic> a, b;
+
+    {
+        rv::allocator_scope s(tag);
+        a = rv::disasm(insts[0]);
+    }
+    b = rv::disasm(insts[1]);
+    CHECK(live > 0);
+    {
+        rv::allocator_scope s(tag);
+        *b = std::move(*a); // b's own strings go back to malloc
+    }
+    CHECK(live > 0);
+    a.reset();
+    b.reset(); // a's old strings go back to tag
+    CHECK(live == 0);
+    CHECK(foreign == 0);
+}
+
+// the mnemonics come from the arena, fn runs on the caller's allocator.
+static void test_batch_scopes(const std::vector<inst_t> &insts)
+{
+    rv::arena ar;
+    rv::allocator_scope s(tag);
+    long mark = allocs;
+    int calls = 0;
+
+    rv::disasm(
+        std::span<const inst_t>(insts), ar,
+        [&](const inst_t &ir, rv::mnemonic_view v) {
+            const rv_allocator_t *cur = rv_dis_thread_allocator();
+            CHECK(cur && cur->alloc == tag_alloc);
+            CHECK(allocs == mark);
+            CHECK(!v.op().empty());
+            {
+                rv::mnemonic own = rv::disasm(ir);
+                CHECK(allocs > mark);
+            }
+            mark = allocs;
+            calls++;
+        },
+        2);
+    CHECK(calls == static_cast<int>(insts.size()));
+    CHECK(ar.used() > 0);
+    const rv_allocator_t *cur = rv_dis_thread_allocator();
+    CHECK(cur && cur->alloc == tag_alloc);
+    CHECK(live == 0 && foreign == 0);
+}
+
+int main()
+{
+    std::vector<inst_t> insts = decode_all();
+
+    CHECK(insts.size() == 3);
+    if (insts.size() < 3)
+        return 1;
+    test_owner_allocator(insts);
+    test_batch_scopes(insts);
+    return test_failures != 0;
+}
@@ -0,0 +1,77 @@
+#include <string.h>
+
+#include "rv-dis.h"
+#include "test.h"
+
+#define PC 0x1000
+
+typedef struct
+{
+    rv_uint8_t code[4];
+    int len;
+    const char *text;
+} case_t;
+
+// compressed forms keep their own names and print assembler operands;
+// fsqrt has no rs2.
+static const case_t CASES[] = {
+    {{0x75, 0x35}, 2, "c.addiw\ta0,-3"}, // c.addiw a0,-3
+    {{0xfd, 0x45}, 2, "c.li\ta1,31"}, // c.li a1,31
+    {{0x39, 0x71}, 2, "c.addi16sp\tsp,-64"}, // c.addi16sp sp,-64
+    {{0x05, 0x75}, 2, "c.lui\ta0,0xfffffffffffe1000"}, // c.lui a0,0xfffe1
+    {{0x0d, 0x80}, 2, "c.srli\ts0,3"}, // c.srli s0,3
+    {{0xfd, 0x97}, 2, "c.srai\ta5,63"}, // c.srai a5,63
+    {{0x7d, 0x9b}, 2, "c.andi\ta4,-1"}, // c.andi a4,-1
+    {{0x05, 0x8c}, 2, "c.sub\ts0,s1"}, // c.sub s0,s1
+    {{0x2d, 0x8d}, 2, "c.xor\ta0,a1"}, // c.xor a0,a1
+    {{0x55, 0x8e}, 2, "c.or\ta2,a3"}, // c.or a2,a3
+    {{0x7d, 0x8f}, 2, "c.and\ta4,a5"}, // c.and a4,a5
+    {{0x09, 0x9c}, 2, "c.subw\ts0,a0"}, // c.subw s0,a0
+    {{0xad, 0x9c}, 2, "c.addw\ts1,a1"}, // c.addw s1,a1
+    {{0xf5, 0xb7}, 2, "c.j\t0xfec"}, // c.j -20
+    {{0x01, 0xc5}, 2, "c.beqz\ta0,0x1008"}, // c.beqz a0,8
+    {{0xf5, 0xfc}, 2, "c.bnez\ts1,0xffc"}, // c.bnez s1,-4
+    {{0x96, 0x02}, 2, "c.slli\tt0,5"}, // c.slli t0,5
+    {{0x62, 0x24}, 2, "c.fldsp\tfs0,24(sp)"}, // c.fldsp fs0,24(sp)
+    {{0x92, 0x40}, 2, "c.lwsp\tra,4(sp)"}, // c.lwsp ra,4(sp)
+    {{0x7e, 0x79}, 2, "c.ldsp\ts2,504(sp)"}, // c.ldsp s2,504(sp)
+    {{0x02, 0x83}, 2, "c.jr\tt1"}, // c.jr t1
+    {{0x22, 0x85}, 2, "c.mv\ta0,s0"}, // c.mv a0,s0
+    {{0x02, 0x90}, 2, "c.ebreak"}, // c.ebreak
+    {{0x82, 0x97}, 2, "c.jalr\ta5"}, // c.jalr a5
+    {{0xf2, 0x93}, 2, "c.add\tt2,t3"}, // c.add t2,t3
+    {{0x2a, 0xa4}, 2, "c.fsdsp\tfa0,8(sp)"}, // c.fsdsp fa0,8(sp)
+    {{0x4e, 0xc6}, 2, "c.swsp\ts3,12(sp)"}, // c.swsp s3,12(sp)
+    {{0x06, 0xe8}, 2, "c.sdsp\tra,16(sp)"}, // c.sdsp ra,16(sp)
+    {{0x53, 0x95, 0x05, 0x5a}, 4, "fsqrt.d\tfa0,fa1,rtz"}, // fsqrt.d fa0,fa1,rtz
+    {{0x53, 0xf0, 0x00, 0x58}, 4, "fsqrt.s\tft0,ft1"}, // fsqrt.s ft0,ft1
+};
+
+static void test_text(void)
+{
+    char buf[RV_TEXT_MAX];
+    size_t i;
+
+    for (i = 0; i < sizeof CASES / sizeof *CASES; i++)
+    {
+        const case_t *c = &CASES[i];
+        mnemonic_t m;
+        inst_t ir;
+
+        CHECK(rv_dis_decode(PC, c->code, c->len, &ir, 0) == c->len);
+        rv_disasm(&ir, &m);
+        rv_format(&m, buf, sizeof buf);
+        rv_mnemonic_free(&m);
+        if (strcmp(buf, c->text) != 0)
+        {
+            fprintf(stderr, "%s: got %s\n", c->text, buf);
+            test_failures++;
+        }
+    }
+}
+
+int main(void)
+{
+    test_text();
+    return test_failures != 0;
+}
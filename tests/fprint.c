@@ -0,0 +1,177 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "rv-alloc.h"
+#include "rv-fprint.h"
+#include "test.h"
+
+#define BASE_A 0x10000
+#define BASE_B 0x80000
+
+static const rv_uint8_t CODE_A[] = {
+    // f: 0x0
+    0x13, 0x01, 0x01, 0xfe, // addi sp,sp,-32
+    0x23, 0x3c, 0x11, 0x00, // sd ra,24(sp)
+    0x23, 0x38, 0x81, 0x00, // sd s0,16(sp)
+    0x13, 0x04, 0x05, 0x00, // mv s0,a0
+    // floop: 0x10
+    0x83, 0xa2, 0x05, 0x00, // lw t0,0(a1)
+    0x93, 0x92, 0x22, 0x00, // slli t0,t0,2
+    0xb3, 0x82, 0xc2, 0x00, // add t0,t0,a2
+    0x23, 0x20, 0x54, 0x00, // sw t0,0(s0)
+    0x93, 0x85, 0x45, 0x00, // addi a1,a1,4
+    0x13, 0x04, 0x44, 0x00, // addi s0,s0,4
+    0xe3, 0xe4, 0xd5, 0xfe, // bltu a1,a3,floop
+    0xef, 0x00, 0x40, 0x01, // jal ra,g
+    0x03, 0x34, 0x01, 0x01, // ld s0,16(sp)
+    0x83, 0x30, 0x81, 0x01, // ld ra,24(sp)
+    0x13, 0x01, 0x01, 0x02, // addi sp,sp,32
+    0x67, 0x80, 0x00, 0x00, // ret
+    // g: 0x40
+    0x33, 0x45, 0xb5, 0x00, // xor a0,a0,a1
+    0x93, 0x55, 0x75, 0x00, // srli a1,a0,7
+    0x33, 0x05, 0xb5, 0x02, // mul a0,a0,a1
+    0x13, 0x75, 0xf5, 0x0f, // andi a0,a0,255
+    0x33, 0x65, 0xc5, 0x00, // or a0,a0,a2
+    0x33, 0x05, 0xd5, 0x40, // sub a0,a0,a3
+    0x63, 0x04, 0x05, 0x00, // beqz a0,gout
+    0x33, 0x35, 0xb5, 0x00, // sltu a0,a0,a1
+    // gout: 0x60
+    0x67, 0x80, 0x00, 0x00, // ret
+    // s: 0x64
+    0x13, 0x05, 0x00, 0x00, // li a0,0
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+// f relinked elsewhere behind another function, with other registers and a
+// call to another target.
+static const rv_uint8_t CODE_B[] = {
+    // s2: 0x0
+    0x13, 0x05, 0x10, 0x00, // li a0,1
+    0x67, 0x80, 0x00, 0x00, // ret
+    // f2: 0x8
+    0x13, 0x01, 0x01, 0xfe, // addi sp,sp,-32
+    0x23, 0x3c, 0x11, 0x00, // sd ra,24(sp)
+    0x23, 0x38, 0x91, 0x00, // sd s1,16(sp)
+    0x93, 0x84, 0x07, 0x00, // mv s1,a5
+    // f2loop: 0x18
+    0x03, 0x23, 0x07, 0x00, // lw t1,0(a4)
+    0x13, 0x13, 0x23, 0x00, // slli t1,t1,2
+    0x33, 0x03, 0x03, 0x01, // add t1,t1,a6
+    0x23, 0xa0, 0x64, 0x00, // sw t1,0(s1)
+    0x13, 0x07, 0x47, 0x00, // addi a4,a4,4
+    0x93, 0x84, 0x44, 0x00, // addi s1,s1,4
+    0xe3, 0x64, 0x17, 0xff, // bltu a4,a7,f2loop
+    0xef, 0xf0, 0xdf, 0xfc, // jal ra,s2
+    0x83, 0x34, 0x01, 0x01, // ld s1,16(sp)
+    0x83, 0x30, 0x81, 0x01, // ld ra,24(sp)
+    0x13, 0x01, 0x01, 0x02, // addi sp,sp,32
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+static const rv_func_t FUNCS_A[3] = {
+    {BASE_A, BASE_A + 0x40, RV_FUNC_SYMBOL, 0},
+    {BASE_A + 0x40, BASE_A + 0x64, RV_FUNC_SYMBOL, 0},
+    {BASE_A + 0x64, BASE_A + sizeof CODE_A, RV_FUNC_SYMBOL, 0},
+};
+static const rv_func_t FUNCS_B[2] = {
+    {BASE_B, BASE_B + 0x8, RV_FUNC_SYMBOL, 0},
+    {BASE_B + 0x8, BASE_B + sizeof CODE_B, RV_FUNC_SYMBOL, 0},
+};
+
+static char path[64];
+
+static rv_fprint_t *sketch(rv_uint64_t base, const rv_uint8_t *code, size_t size, const rv_func_t *funcs, size_t n)
+{
+    rv_image_t *img = rv_image_raw(base, code, size);
+    rv_fprint_t *fps = img ? rv_fprint_image(img, funcs, n, 2) : 0;
+
+    CHECK(fps != 0);
+    rv_image_close(img);
+    return fps;
+}
+
+// registers, immediates and targets are abstracted, so only the shape counts;
+// s is shorter than a window.
+static void test_sketch(const rv_fprint_t *a, const rv_fprint_t *b)
+{
+    CHECK(a[0].start == BASE_A && a[0].ninsn == 16 && a[0].nwin == 9);
+    CHECK(a[1].start == BASE_A + 0x40 && a[1].ninsn == 9 && a[1].nwin == 2);
+    CHECK(a[2].ninsn == 2 && a[2].nwin == 0);
+    CHECK(b[1].start == BASE_B + 0x8 && b[1].ninsn == 16);
+    CHECK(memcmp(a[0].min, b[1].min, sizeof a[0].min) == 0);
+    CHECK(rv_fprint_similarity(&a[0], &b[1]) == 1);
+    CHECK(rv_fprint_similarity(&a[0], &a[1]) < 0.5);
+}
+
+// f2 finds f of image a and nothing else.
+static void test_query(rv_fpdb_t *db, const rv_fprint_t *a, const rv_fprint_t *b)
+{
+    rv_fpdb_hit_t hits[4];
+    const rv_fpdb_func_t *f;
+    size_t n;
+
+    n = rv_fpdb_query(db, &b[1], 0.9, hits, 4);
+    CHECK(n == 1 && hits[0].similarity == 1);
+    if (n == 0)
+        return;
+    f = rv_fpdb_func(db, hits[0].func);
+    CHECK(f && f->start == BASE_A && f->ninsn == 16 && memcmp(f->min, a[0].min, sizeof f->min) == 0);
+    CHECK(rv_fpdb_image(db, hits[0].func) && strcmp(rv_fpdb_image(db, hits[0].func), "a") == 0);
+    CHECK(rv_fpdb_query(db, &b[0], 0, hits, 4) == 0);
+}
+
+// the short function is left out, and a saved index opens to the same tables.
+static void test_db(const rv_fprint_t *a, const rv_fprint_t *b)
+{
+    rv_fpdb_t *db = rv_fpdb_new(), *back;
+    rv_fpdb_hit_t hits[4];
+    size_t i;
+
+    CHECK(db != 0);
+    if (db == 0)
+        return;
+    CHECK(rv_fpdb_add(db, "a", a, 3) == 0);
+    CHECK(rv_fpdb_func(db, 1) != 0 && rv_fpdb_func(db, 2) == 0);
+    test_query(db, a, b);
+    CHECK(rv_fpdb_save(db, path) == 0);
+
+    back = rv_fpdb_open(path);
+    CHECK(back != 0);
+    if (back)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            const rv_fpdb_func_t *x = rv_fpdb_func(db, i), *y = rv_fpdb_func(back, i);
+            CHECK((x == 0) == (y == 0));
+            CHECK(x == 0 || (y && memcmp(x, y, sizeof *x) == 0));
+        }
+        test_query(back, a, b);
+
+        // adding to an opened index copies it out of the file first
+        CHECK(rv_fpdb_add(back, "b", b, 2) == 0);
+        CHECK(rv_fpdb_query(back, &a[0], 0.9, hits, 4) == 2);
+        CHECK(rv_fpdb_image(back, hits[1].func) && strcmp(rv_fpdb_image(back, hits[1].func), "b") == 0);
+        CHECK(rv_fpdb_func(back, hits[1].func) && rv_fpdb_func(back, hits[1].func)->start == BASE_B + 0x8);
+        rv_fpdb_close(back);
+    }
+    rv_fpdb_close(db);
+}
+
+int main(void)
+{
+    rv_fprint_t *a, *b;
+
+    snprintf(path, sizeof path, "test-fprint-%d.db", (int)getpid());
+    a = sketch(BASE_A, CODE_A, sizeof CODE_A, FUNCS_A, 3);
+    b = sketch(BASE_B, CODE_B, sizeof CODE_B, FUNCS_B, 2);
+    if (a && b)
+    {
+        test_sketch(a, b);
+        test_db(a, b);
+    }
+    rv_dis_free(a);
+    rv_dis_free(b);
+    unlink(path);
+    return test_failures != 0;
+}
@@ -0,0 +1,56 @@
+#include "rv-alloc.h"
+#include "rv-frame.h"
+#include "test.h"
+
+#define BASE 0x10000
+
+static const rv_uint8_t CODE[] = {
+    // f: 0x0
+    0x13, 0x01, 0x01, 0xfe, // addi sp,sp,-32
+    0x23, 0x3c, 0x11, 0x00, // sd ra,24(sp)
+    0x23, 0x38, 0x81, 0x00, // sd s0,16(sp)
+    0x08, 0x18,             // c.addi4spn a0,sp,48
+    0xef, 0x00, 0x40, 0x01, // jal ra,g
+    0x83, 0x30, 0x81, 0x01, // ld ra,24(sp)
+    0x03, 0x34, 0x01, 0x01, // ld s0,16(sp)
+    0x13, 0x01, 0x01, 0x02, // addi sp,sp,32
+    0x67, 0x80, 0x00, 0x00, // ret
+    // g: 0x22
+    0x39, 0x71,             // c.addi16sp sp,-64
+    0x26, 0xe4,             // c.sdsp s1,8(sp)
+    0x2a, 0xe0,             // c.sdsp a0,0(sp)
+    0xa2, 0x64,             // c.ldsp s1,8(sp)
+    0x21, 0x61,             // c.addi16sp sp,64
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+// prologue sizes, callee-saved spills and reloads, and a pointer into the
+// caller's frame that must not grow f's own.
+static void test_frames(void)
+{
+    rv_func_t funcs[2] = {{BASE, BASE + 0x22, 0, 0}, {BASE + 0x22, BASE + sizeof CODE, 0, 0}};
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    rv_frames_t *fr;
+
+    CHECK(img != 0);
+    fr = rv_frame_analyze(img, funcs, 2, 2);
+    CHECK(fr != 0 && fr->count == 2);
+    if (fr && fr->count == 2)
+    {
+        const rv_frame_t *f = &fr->frames[0], *g = &fr->frames[1];
+
+        CHECK(f->start == BASE && f->frame == 32 && f->spills == 2 && f->reloads == 2);
+        CHECK(f->ncallees == 1 && fr->callees[f->callee] == 1);
+        CHECK(f->depth == 96 && f->flags == 0);
+        CHECK(g->start == BASE + 0x22 && g->frame == 64 && g->spills == 1 && g->reloads == 1);
+        CHECK(g->ncallees == 0 && g->depth == 64 && g->flags == 0);
+    }
+    rv_frames_free(fr);
+    rv_image_close(img);
+}
+
+int main(void)
+{
+    test_frames();
+    return test_failures != 0;
+}
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-alloc.h"
+#include "rv-func.h"
+#include "test.h"
+
+#define BASE 0x10000
+
+static const rv_uint8_t CODE[] = {
+    // main: 0x0
+    0x13, 0x01, 0x01, 0xff, // addi sp,sp,-16
+    0x23, 0x34, 0x11, 0x00, // sd ra,8(sp)
+    0xef, 0x00, 0x80, 0x01, // jal ra,leaf
+    0x97, 0x00, 0x00, 0x00, // auipc ra,%pcrel_hi(far)
+    0xe7, 0x80, 0xc0, 0x03, // jalr ra,%pcrel_lo(far)(ra)
+    0x83, 0x30, 0x81, 0x00, // ld ra,8(sp)
+    0x13, 0x01, 0x01, 0x01, // addi sp,sp,16
+    0x67, 0x80, 0x00, 0x00, // ret
+    // leaf: 0x20
+    0x13, 0x05, 0x15, 0x00, // addi a0,a0,1
+    0x67, 0x80, 0x00, 0x00, // ret
+    0x13, 0x00, 0x00, 0x00, // nop
+    // padded: 0x2c
+    0x13, 0x05, 0x25, 0x00, // addi a0,a0,2
+    0x67, 0x80, 0x00, 0x00, // ret
+    // framed: 0x34
+    0x13, 0x01, 0x01, 0xfe, // addi sp,sp,-32
+    0x23, 0x30, 0x81, 0x00, // sd s0,0(sp)
+    0x03, 0x34, 0x01, 0x00, // ld s0,0(sp)
+    0x13, 0x01, 0x01, 0x02, // addi sp,sp,32
+    0x67, 0x80, 0x00, 0x00, // ret
+    // far: 0x48
+    0x17, 0x03, 0x00, 0x00, // auipc t1,%pcrel_hi(leaf)
+    0x67, 0x00, 0x83, 0xfd, // jr %pcrel_lo(leaf)(t1)
+    // dead: 0x50
+    0x13, 0x05, 0x35, 0x00, // addi a0,a0,3
+    0x67, 0x80, 0x00, 0x00, // ret
+    // named: 0x58
+    0x13, 0x05, 0x45, 0x00, // addi a0,a0,4
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+static const rv_func_t *func(const rv_func_t *f, size_t n, rv_uint64_t start)
+{
+    const rv_func_t *p = rv_func_find(f, n, start);
+    return p && p->start == start ? p : 0;
+}
+
+// without symbols a start needs the entry, a call, or a boundary backed by a
+// prologue or padding.
+static void test_stripped(void)
+{
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    const rv_func_t *p;
+    rv_func_t *f;
+    size_t n;
+
+    f = rv_func_detect(img, 2, &n);
+    CHECK(f != 0 && n == 5);
+    if (f == 0)
+        return;
+
+    p = func(f, n, BASE);
+    CHECK(p && p->end == BASE + 0x20 && p->flags == (RV_FUNC_ENTRY | RV_FUNC_BOUNDARY | RV_FUNC_PROLOGUE));
+    // jal ra and the auipc+jr tail call both reach it
+    p = func(f, n, BASE + 0x20);
+    CHECK(p && p->end == BASE + 0x2c && p->flags == (RV_FUNC_CALLED | RV_FUNC_BOUNDARY));
+    p = func(f, n, BASE + 0x2c);
+    CHECK(p && p->end == BASE + 0x34 && p->flags == (RV_FUNC_BOUNDARY | RV_FUNC_PADDED));
+    p = func(f, n, BASE + 0x34);
+    CHECK(p && p->end == BASE + 0x48 && p->flags == (RV_FUNC_BOUNDARY | RV_FUNC_PROLOGUE));
+    // reached by auipc ra+jalr ra; what follows it has no evidence
+    p = func(f, n, BASE + 0x48);
+    CHECK(p && p->end == BASE + sizeof CODE && p->flags == (RV_FUNC_CALLED | RV_FUNC_BOUNDARY));
+    CHECK(rv_func_find(f, n, BASE + 0x52) == p);
+    CHECK(rv_func_find(f, n, BASE + 0x5c) == p);
+    CHECK(rv_func_find(f, n, BASE + sizeof CODE) == 0);
+    CHECK(rv_func_find(f, n, BASE - 4) == 0);
+
+    rv_dis_free(f);
+    rv_image_close(img);
+}
+
+// a symbol alone is enough.
+static void test_symbol(void)
+{
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    rv_symbol_t sym = {"named", BASE + 0x58, 8};
+    const rv_func_t *p;
+    rv_func_t *f;
+    size_t n;
+
+    img->symbols = &sym;
+    img->nsymbols = 1;
+    f = rv_func_detect(img, 1, &n);
+    CHECK(f != 0 && n == 6);
+    if (f)
+    {
+        p = func(f, n, BASE + 0x48);
+        CHECK(p && p->end == BASE + 0x58);
+        p = func(f, n, BASE + 0x58);
+        CHECK(p && p->end == BASE + sizeof CODE && p->flags == (RV_FUNC_SYMBOL | RV_FUNC_BOUNDARY));
+        CHECK(func(f, n, BASE + 0x50) == 0);
+    }
+    rv_dis_free(f);
+    img->symbols = 0;
+    img->nsymbols = 0;
+    rv_image_close(img);
+}
+
+// the sweep chunk after 0x10000 starts inside the lui and decodes a jal ra to
+// 0x352 before it falls in step; the chunk before sweeps that stretch in step
+// and only its view counts. The call back to 0x100 is seen in step.
+static void test_chunks(void)
+{
+    static const rv_uint8_t TAIL[] = {
+        0x01, 0x00,             // c.nop
+        0x37, 0x05, 0xef, 0x00, // lui a0,0xef0 (ef 00 2f b5: jal ra,0x352 from 0x10000)
+        0x2f, 0xb5, 0xc5, 0x00, // amoadd.d a0,a2,(a1)
+        0xef, 0x00, 0xaf, 0x8f, // jal ra,0x100
+        0x67, 0x80, 0x00, 0x00, // ret
+    };
+    static const rv_uint8_t RET[4] = {0x67, 0x80, 0x00, 0x00};
+    static const rv_uint8_t NOP[4] = {0x13, 0x00, 0x00, 0x00};
+    size_t size = 0xfffc + sizeof TAIL, off, n;
+    rv_uint8_t *code = malloc(size);
+    const rv_func_t *p;
+    rv_image_t *img;
+    rv_func_t *f;
+
+    if (code == 0)
+        return;
+    memcpy(code, RET, 4);
+    for (off = 4; off < 0xfffc; off += 4)
+        memcpy(code + off, NOP, 4);
+    memcpy(code + 0xfffc, TAIL, sizeof TAIL);
+    img = rv_image_raw(BASE, code, size);
+
+    f = rv_func_detect(img, 2, &n);
+    CHECK(f != 0 && n == 3);
+    if (f)
+    {
+        CHECK(func(f, n, BASE + 0x352) == 0);
+        p = func(f, n, BASE);
+        CHECK(p && p->end == BASE + 0x100);
+        p = func(f, n, BASE + 0x100);
+        CHECK(p && p->end == BASE + 0xfffe && p->flags == RV_FUNC_CALLED);
+        p = func(f, n, BASE + 0xfffe);
+        CHECK(p && p->end == BASE + size && p->flags == (RV_FUNC_BOUNDARY | RV_FUNC_PADDED));
+    }
+    rv_dis_free(f);
+    rv_image_close(img);
+    free(code);
+}
+
+int main(void)
+{
+    test_stripped();
+    test_symbol();
+    test_chunks();
+    return test_failures != 0;
+}
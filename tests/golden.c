@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-isa.h"
+#include "rv-op.h"
+#include "test.h"
+
+// test-golden isa file: every "hex text" line of file has to render as text
+// under isa, and as undef under the base integer profile of the same xlen.
+// -1 when w is undef or a plug-in's op.
+static int render(const rv_isa_t *isa, rv_uint32_t w, char *buf, size_t size)
+{
+    rv_uint8_t code[4] = {w, w >> 8, w >> 16, w >> 24};
+    mnemonic_t m;
+    inst_t ir;
+    char *tab;
+    int op;
+
+    if (rv_dis_decode_isa(isa, 0, code, 4, &ir, 0) != 4)
+        return -1;
+    rv_disasm_isa(isa, &ir, &m);
+    rv_format(&m, buf, size);
+    rv_mnemonic_free(&m);
+    if ((tab = strchr(buf, '\t')) != 0)
+        *tab = ' ';
+    op = rv_dis_op(&ir);
+    return (ir.op == RV_UNDEF && op == RV_OP_NONE) || op == RV_OP_CUSTOM ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    char line[256], text[RV_TEXT_MAX], base_name[8];
+    rv_isa_t isa, base;
+    size_t lines = 0;
+    FILE *f;
+
+    if (argc != 3 || rv_isa_parse(argv[1], &isa) < 0 || (f = fopen(argv[2], "r")) == 0)
+    {
+        fprintf(stderr, "usage: %s isa file\n", argv[0]);
+        return 2;
+    }
+    snprintf(base_name, sizeof base_name, "rv%di", isa.xlen);
+    rv_isa_parse(base_name, &base);
+    while (fgets(line, sizeof line, f))
+    {
+        char *want, *end;
+        rv_uint32_t w;
+
+        line[strcspn(line, "\n")] = 0;
+        if (line[0] == '#' || line[0] == 0)
+            continue;
+        w = strtoul(line, &want, 16);
+        if (*want++ != ' ')
+            continue;
+        lines++;
+        if (render(&isa, w, text, sizeof text) < 0 || strcmp(text, want) != 0)
+        {
+            fprintf(stderr, "%08x: got \"%s\", want \"%s\"\n", w, text, want);
+            test_failures++;
+        }
+        render(&base, w, text, sizeof text);
+        if ((end = strchr(text, ' ')) != 0)
+            *end = 0;
+        CHECK(strcmp(text, "undef") == 0);
+    }
+    fclose(f);
+    CHECK(lines > 0);
+    return test_failures != 0;
+}
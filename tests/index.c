@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include "rv-custom.h"
+#include "rv-index.h"
+#include "test.h"
+
+#define BASE 0x1000
+#define REPEAT 64
+
+static const rv_uint8_t ADD[4] = {0x33, 0x05, 0xb5, 0x00};  // add a0,a0,a1
+static const rv_uint8_t LONG[4] = {0x0b, 0x05, 0x05, 0x00}; // custom-0, named below
+static const rv_uint8_t ADDI[4] = {0x13, 0x01, 0x01, 0xff}; // addi sp,sp,-16
+static const rv_uint8_t CNOP[2] = {0x01, 0x00};             // c.nop
+
+static rv_uint8_t code[REPEAT * 14];
+static char name[RV_LINE_MAX * 2];
+
+typedef struct
+{
+    rv_uint64_t pc[REPEAT * 4 + 1];
+    rv_uint64_t off[REPEAT * 4 + 1];
+    int tlen[REPEAT * 4];
+    size_t count;
+    size_t seen;
+    int bad;
+} listing_t;
+
+static size_t fill(void)
+{
+    size_t n = 0;
+    int i;
+
+    for (i = 0; i < REPEAT; i++)
+    {
+        memcpy(code + n, ADD, 4), n += 4;
+        memcpy(code + n, LONG, 4), n += 4;
+        memcpy(code + n, CNOP, 2), n += 2;
+        memcpy(code + n, ADDI, 4), n += 4;
+    }
+    return n;
+}
+
+// the reference listing, measured without any buffer bound.
+static void measure(listing_t *r, size_t size)
+{
+    rv_uint64_t pc = BASE, off = 0;
+
+    r->count = 0;
+    while (pc < BASE + size)
+    {
+        inst_t ir;
+        mnemonic_t m;
+        rv_uint32_t raw;
+        int len = rv_dis_decode(pc, code + (pc - BASE), size - (pc - BASE), &ir, &raw);
+
+        if (len == 0)
+            break;
+        rv_disasm(&ir, &m);
+        r->pc[r->count] = pc;
+        r->off[r->count] = off;
+        r->tlen[r->count] = rv_format(&m, 0, 0);
+        off += rv_format_line(pc, raw, len, &m, 0, 0);
+        rv_mnemonic_free(&m);
+        r->count++;
+        pc += len;
+    }
+    r->pc[r->count] = pc;
+    r->off[r->count] = off;
+}
+
+static void window_cb(void *arg, const rv_line_t *line)
+{
+    listing_t *r = arg;
+
+    while (r->seen < r->count && r->pc[r->seen] < line->pc)
+        r->seen++;
+    if (r->seen == r->count || r->pc[r->seen] != line->pc || line->tlen != r->tlen[r->seen] ||
+        strlen(line->text) != line->tlen)
+        r->bad++;
+}
+
+// checkpoint offsets have to match the full listing even where a line does
+// not fit in RV_LINE_MAX.
+static void test_long_lines(int nthreads)
+{
+    size_t size = fill(), i, j = 0;
+    rv_index_t *idx = rv_index_build(BASE, code, size, 16, nthreads);
+    static listing_t r;
+
+    measure(&r, size);
+    CHECK(r.tlen[1] >= RV_LINE_MAX);
+    CHECK(idx != 0);
+    if (idx == 0)
+        return;
+    CHECK(idx->bytes == r.off[r.count]);
+    for (i = 0; i < idx->count; i++)
+    {
+        while (r.pc[j] < BASE + i * idx->step)
+            j++;
+        CHECK(idx->cp[i].pc == r.pc[j]);
+        CHECK(idx->cp[i].offset == r.off[j]);
+    }
+
+    r.seen = 0;
+    r.bad = 0;
+    CHECK(rv_index_window(idx, code, BASE + 100, BASE + 300, window_cb, &r) > 0);
+    CHECK(r.bad == 0);
+    rv_index_free(idx);
+}
+
+int main(void)
+{
+    rv_custom_t c = {0x0000000b, 0x0000007f, name, "rd,rs1", 0, 0};
+
+    memset(name, 'x', sizeof name - 1);
+    CHECK(rv_custom_register(&c) == 0);
+    test_long_lines(1);
+    test_long_lines(4);
+    return test_failures != 0;
+}
@@ -0,0 +1,121 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "rv-index.h"
+#include "rv-isa.h"
+#include "test.h"
+
+#define BASE 0x1000
+#define REPEAT 4096
+#define ROUNDS 20000
+
+static const rv_uint8_t LD[4] = {0x03, 0xb5, 0x05, 0x00};  // ld a0,0(a1), rv64 only
+static const rv_uint8_t LUI[4] = {0x37, 0xf5, 0xff, 0xff}; // lui a0,0xfffff
+
+static rv_uint8_t code[REPEAT * 8];
+static rv_isa_t rv32, rv64;
+
+static int render(const rv_isa_t *isa, const rv_uint8_t *p, char *buf, size_t size)
+{
+    inst_t ir;
+    mnemonic_t m;
+    int n;
+
+    if (rv_dis_decode_isa(isa, 0, p, 4, &ir, 0) != 4)
+        return -1;
+    rv_disasm_isa(isa, &ir, &m);
+    n = rv_format(&m, buf, size);
+    rv_mnemonic_free(&m);
+    return n;
+}
+
+// the same bytes under two profiles on one thread, without selecting either.
+static void test_explicit(void)
+{
+    char a[RV_TEXT_MAX], b[RV_TEXT_MAX];
+    inst_t ir;
+
+    CHECK(rv_dis_decode_isa(&rv32, 0, LD, 4, &ir, 0) == 4 && ir.op == RV_UNDEF);
+    CHECK(rv_dis_decode_isa(&rv64, 0, LD, 4, &ir, 0) == 4 && ir.op != RV_UNDEF);
+    CHECK(render(&rv32, LUI, a, sizeof a) > 0 && render(&rv64, LUI, b, sizeof b) > 0);
+    CHECK(strcmp(a, b) != 0); // the upper immediate wraps at 32 bits only on rv32
+    CHECK(rv_isa_current() == 0);
+}
+
+typedef struct
+{
+    const rv_isa_t *isa;
+    char expect[RV_TEXT_MAX];
+    int bad;
+} worker_t;
+
+static void *work(void *arg)
+{
+    worker_t *w = arg;
+    char buf[RV_TEXT_MAX];
+    inst_t ir;
+    mnemonic_t m;
+    int i;
+
+    rv_isa_select(w->isa);
+    for (i = 0; i < ROUNDS; i++)
+    {
+        rv_dis_decode(0, LUI, 4, &ir, 0);
+        rv_disasm(&ir, &m);
+        rv_format(&m, buf, sizeof buf);
+        rv_mnemonic_free(&m);
+        w->bad += strcmp(buf, w->expect) != 0 || rv_isa_current() != w->isa;
+    }
+    return 0;
+}
+
+// threads running under different profiles at the same time.
+static void test_threads(void)
+{
+    worker_t w[2] = {{.isa = &rv32}, {.isa = &rv64}};
+    pthread_t th[2];
+    int i;
+
+    for (i = 0; i < 2; i++)
+        render(w[i].isa, LUI, w[i].expect, sizeof w[i].expect);
+    for (i = 0; i < 2; i++)
+        CHECK(pthread_create(&th[i], 0, work, &w[i]) == 0);
+    for (i = 0; i < 2; i++)
+    {
+        pthread_join(th[i], 0);
+        CHECK(w[i].bad == 0);
+    }
+    CHECK(rv_isa_current() == 0);
+}
+
+// index workers decode under the caller's profile, so the listing size does
+// not depend on the thread count.
+static void test_workers(void)
+{
+    size_t n = 0;
+    rv_index_t *one, *many;
+    int i;
+
+    for (i = 0; i < REPEAT; i++)
+    {
+        memcpy(code + n, LD, 4), n += 4;
+        memcpy(code + n, LUI, 4), n += 4;
+    }
+    rv_isa_select(&rv32);
+    one = rv_index_build(BASE, code, n, 64, 1);
+    many = rv_index_build(BASE, code, n, 64, 8);
+    rv_isa_select(0);
+    CHECK(one && many && one->bytes == many->bytes);
+    rv_index_free(one);
+    rv_index_free(many);
+}
+
+int main(void)
+{
+    CHECK(rv_isa_parse("rv32i", &rv32) == 0);
+    CHECK(rv_isa_parse("rv64i", &rv64) == 0);
+    test_explicit();
+    test_threads();
+    test_workers();
+    return test_failures != 0;
+}
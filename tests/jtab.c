@@ -0,0 +1,103 @@
+#include <string.h>
+
+#include "rv-jtab.h"
+#include "test.h"
+
+#define BASE 0x10000
+
+// a relative table whose third case holds a second, inline table reached
+// only through the first; its first case ends in an unbounded jump.
+static const rv_uint8_t CODE[] = {
+    // f: 0x0
+    0x93, 0x02, 0x30, 0x00, // addi t0,zero,3
+    0x63, 0x78, 0x55, 0x06, // bgeu a0,t0,dflt
+    0x17, 0x03, 0x00, 0x00, // auipc t1,%pcrel_hi(table)
+    0x13, 0x03, 0x43, 0x07, // addi t1,t1,%pcrel_lo(hi1)
+    0x13, 0x15, 0x25, 0x00, // slli a0,a0,2
+    0x33, 0x05, 0x65, 0x00, // add a0,a0,t1
+    0x53, 0x85, 0x05, 0xf2, // fmv.d.x fa0,a1
+    0x03, 0x25, 0x05, 0x00, // lw a0,0(a0)
+    0x33, 0x05, 0x65, 0x00, // add a0,a0,t1
+    0x67, 0x00, 0x05, 0x00, // jr a0
+    // case0: 0x28
+    0x13, 0x05, 0xa0, 0x00, // addi a0,zero,10
+    0x67, 0x80, 0x00, 0x00, // ret
+    // case1: 0x30
+    0x13, 0x05, 0xb0, 0x00, // addi a0,zero,11
+    0x67, 0x80, 0x00, 0x00, // ret
+    // case2: 0x38
+    0x93, 0x02, 0x20, 0x00, // addi t0,zero,2
+    0x63, 0xec, 0xb2, 0x02, // bltu t0,a1,dflt
+    0x17, 0x03, 0x00, 0x00, // auipc t1,%pcrel_hi(tbl2)
+    0x13, 0x03, 0x43, 0x01, // addi t1,t1,%pcrel_lo(hi2)
+    0x93, 0x95, 0x25, 0x00, // slli a1,a1,2
+    0x33, 0x03, 0xb3, 0x00, // add t1,t1,a1
+    0x67, 0x00, 0x03, 0x00, // jr t1
+    // tbl2: 0x54
+    0x6f, 0x00, 0xc0, 0x00, // j c20
+    0x6f, 0x00, 0xc0, 0x00, // j c21
+    0x6f, 0x00, 0x00, 0x01, // j c22
+    // c20: 0x60
+    0x67, 0x00, 0x06, 0x00, // jr a2
+    // c21: 0x64
+    0x13, 0x05, 0x50, 0x01, // addi a0,zero,21
+    0x67, 0x80, 0x00, 0x00, // ret
+    // c22: 0x6c
+    0x13, 0x05, 0x60, 0x01, // addi a0,zero,22
+    0x67, 0x80, 0x00, 0x00, // ret
+    // dflt: 0x74
+    0x13, 0x05, 0x00, 0x00, // addi a0,zero,0
+    0x67, 0x80, 0x00, 0x00, // ret
+    // table: 0x7c
+    0xac, 0xff, 0xff, 0xff, // .word case0-table
+    0xb4, 0xff, 0xff, 0xff, // .word case1-table
+    0xbc, 0xff, 0xff, 0xff, // .word case2-table
+};
+
+static void test_tables(void)
+{
+    rv_uint64_t entries[7] = {BASE, BASE + 0x28, BASE + 0x30, BASE + 0x38, BASE + 0x54, BASE + 0x58, BASE + 0x5c};
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    rv_cfg_t *cfg, *once;
+    rv_jtab_t *tabs;
+    size_t n, i;
+
+    cfg = rv_jtab_cfg(img, 2, &tabs, &n);
+    CHECK(cfg != 0 && n == 2);
+    if (cfg == 0 || n != 2)
+        return;
+
+    // loaded relative entries, bounded by idx < 3 past an fp write to fa0
+    CHECK(tabs[0].pc == BASE + 0x24 && tabs[0].table == BASE + 0x7c && tabs[0].count == 3);
+    CHECK(tabs[0].esize == 4 && tabs[0].stride == 2 && tabs[0].rel);
+    CHECK(tabs[0].targets[0] == BASE + 0x28 && tabs[0].targets[1] == BASE + 0x30 && tabs[0].targets[2] == BASE + 0x38);
+
+    // jumps into the table itself, bounded by 2 >= idx
+    CHECK(tabs[1].pc == BASE + 0x50 && tabs[1].table == BASE + 0x54 && tabs[1].count == 3);
+    CHECK(tabs[1].esize == 0 && tabs[1].stride == 2 && !tabs[1].rel);
+    CHECK(tabs[1].targets[0] == BASE + 0x54 && tabs[1].targets[1] == BASE + 0x58 && tabs[1].targets[2] == BASE + 0x5c);
+
+    // the unbounded jump is reached but not resolved
+    i = rv_cfg_find(cfg, BASE + 0x60);
+    CHECK(i != RV_CFG_NONE && cfg->blocks[i].flow == RV_FLOW_IJUMP);
+
+    // extending the cfg round by round gives what one walk from every
+    // case target gives
+    once = rv_cfg_build(img, entries, 7, 2);
+    CHECK(once != 0 && once->nblocks == cfg->nblocks && once->nedges == cfg->nedges);
+    for (i = 0; once && i < once->nblocks && i < cfg->nblocks; i++)
+        CHECK(memcmp(&once->blocks[i], &cfg->blocks[i], sizeof *once->blocks) == 0);
+    for (i = 0; once && i < once->nedges && i < cfg->nedges; i++)
+        CHECK(memcmp(&once->edges[i], &cfg->edges[i], sizeof *once->edges) == 0);
+
+    rv_cfg_free(once);
+    rv_jtab_free(tabs, n);
+    rv_cfg_free(cfg);
+    rv_image_close(img);
+}
+
+int main(void)
+{
+    test_tables();
+    return test_failures != 0;
+}
@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv-alloc.h"
+#include "rv-list.h"
+#include "test.h"
+
+#define BASE 0x1000
+
+static const rv_uint8_t ADD[4] = {0x33, 0x05, 0xb5, 0x00};  // add a0,a0,a1
+static const rv_uint8_t ADDI[4] = {0x13, 0x01, 0x01, 0xff}; // addi sp,sp,-16
+static const rv_uint8_t CNOP[2] = {0x01, 0x00};             // c.nop
+static const rv_uint8_t CADDI[2] = {0x05, 0x05};            // c.addi a0,1
+
+static rv_uint8_t code[64];
+static size_t nallocs;
+
+static void *count_alloc(void *ctx, size_t size)
+{
+    nallocs++;
+    return malloc(size);
+}
+
+static void *count_resize(void *ctx, void *p, size_t size)
+{
+    nallocs++;
+    return realloc(p, size);
+}
+
+static void count_release(void *ctx, void *p)
+{
+    free(p);
+}
+
+static const rv_allocator_t counting = {count_alloc, count_resize, count_release, 0};
+
+// the patched listing has to match one built from scratch over the same bytes.
+static void check_fresh(const rv_listing_t *l, size_t size)
+{
+    rv_listing_t *f = rv_listing_new(BASE, code, size);
+    const rv_line_t *a, *b;
+    size_t na, nb, i;
+
+    CHECK(f != 0);
+    if (f == 0)
+        return;
+    a = rv_listing_lines(l, &na);
+    b = rv_listing_lines(f, &nb);
+    CHECK(na == nb);
+    for (i = 0; i < na && i < nb; i++)
+    {
+        CHECK(a[i].pc == b[i].pc);
+        CHECK(a[i].raw == b[i].raw);
+        CHECK(a[i].len == b[i].len);
+        CHECK(a[i].tlen == b[i].tlen);
+        CHECK(a[i].text && b[i].text && strcmp(a[i].text, b[i].text) == 0);
+    }
+    rv_listing_free(f);
+}
+
+static size_t fill(void)
+{
+    size_t n = 0;
+
+    memcpy(code + n, ADD, 4), n += 4;
+    memcpy(code + n, CNOP, 2), n += 2;
+    memcpy(code + n, CNOP, 2), n += 2;
+    memcpy(code + n, ADDI, 4), n += 4;
+    memcpy(code + n, CADDI, 2), n += 2;
+    memcpy(code + n, ADD, 4), n += 4;
+    memcpy(code + n, CNOP, 2), n += 2;
+    memcpy(code + n, ADDI, 4), n += 4;
+    return n; // 24
+}
+
+static const char *text_at(const rv_listing_t *l, rv_uint64_t pc)
+{
+    const rv_line_t *line = rv_listing_find(l, pc);
+    return line && line->pc == pc ? line->text : 0;
+}
+
+// unchanged bytes must not be rendered again: the patch only allocates
+// its own line array, no mnemonic or text
+static void test_same_bytes(void)
+{
+    size_t size = fill();
+    rv_listing_t *l = rv_listing_new(BASE, code, size);
+    const char *before = text_at(l, BASE + 8);
+
+    nallocs = 0;
+    CHECK(rv_listing_patch(l, BASE, size) == 0);
+    CHECK(nallocs <= 1);
+    CHECK(text_at(l, BASE + 8) == before);
+    check_fresh(l, size);
+    rv_listing_free(l);
+}
+
+// two c.nop become one add, then the add two c.addi again
+static void test_length_change(void)
+{
+    size_t size = fill();
+    rv_listing_t *l = rv_listing_new(BASE, code, size);
+    const char *after = text_at(l, BASE + 12), *before = text_at(l, BASE);
+    rv_uint64_t lo, hi;
+
+    memcpy(code + 4, ADD, 4);
+    CHECK(rv_listing_patch(l, BASE + 4, 4) == 1);
+    CHECK(text_at(l, BASE + 6) == 0);
+    CHECK(text_at(l, BASE + 12) == after);
+    CHECK(text_at(l, BASE) == before);
+    CHECK(rv_listing_dirty(l, &lo, &hi) && lo == BASE + 4 && hi == BASE + 8);
+    check_fresh(l, size);
+
+    memcpy(code + 4, CADDI, 2);
+    memcpy(code + 6, CADDI, 2);
+    CHECK(rv_listing_patch(l, BASE + 4, 4) == 2);
+    CHECK(text_at(l, BASE + 12) == after);
+    check_fresh(l, size);
+    rv_listing_free(l);
+}
+
+// a c.nop turned into the low half of a 32 bit instruction shifts every
+// boundary after it until the stream lines up again
+static void test_resync(void)
+{
+    size_t size = fill();
+    rv_listing_t *l = rv_listing_new(BASE, code, size);
+
+    code[4] = 0x13; // c.nop c.nop -> addi
+    CHECK(rv_listing_patch(l, BASE + 4, 1) >= 1);
+    check_fresh(l, size);
+
+    code[12] = 0x33; // c.addi -> the low half of an instruction eating the add
+    CHECK(rv_listing_patch(l, BASE + 12, 1) >= 1);
+    check_fresh(l, size);
+    rv_listing_free(l);
+}
+
+// patches touching the last bytes, including one that leaves a truncated
+// 32 bit instruction behind
+static void test_section_end(void)
+{
+    size_t size = fill();
+    rv_listing_t *l = rv_listing_new(BASE, code, size);
+    size_t n;
+
+    memcpy(code + size - 4, CNOP, 2);
+    memcpy(code + size - 2, CADDI, 2);
+    CHECK(rv_listing_patch(l, BASE + size - 4, 4) == 2);
+    check_fresh(l, size);
+
+    memcpy(code + size - 2, ADD, 2);
+    CHECK(rv_listing_patch(l, BASE + size - 2, 8) >= 0);
+    check_fresh(l, size);
+    rv_listing_lines(l, &n);
+    CHECK(n > 0 && rv_listing_find(l, BASE + size - 2) == 0);
+
+    CHECK(rv_listing_patch(l, BASE + size, 4) == 0);
+    rv_listing_free(l);
+}
+
+// a second patch over part of the first one's window
+static void test_overlap(void)
+{
+    size_t size = fill();
+    rv_listing_t *l = rv_listing_new(BASE, code, size);
+
+    memcpy(code + 4, ADDI, 4);
+    memcpy(code + 8, CADDI, 2);
+    memcpy(code + 10, CNOP, 2);
+    CHECK(rv_listing_patch(l, BASE + 4, 8) >= 1);
+    check_fresh(l, size);
+
+    memcpy(code + 8, ADD, 4);
+    memcpy(code + 12, CNOP, 2);
+    CHECK(rv_listing_patch(l, BASE + 6, 10) >= 1);
+    check_fresh(l, size);
+    CHECK(rv_listing_changes(l, 0, 0) > 0);
+    CHECK(rv_listing_changes(l, 0, 0) == 0);
+    rv_listing_free(l);
+}
+
+int main(void)
+{
+    rv_dis_set_allocator(&counting);
+    test_same_bytes();
+    test_length_change();
+    test_resync();
+    test_section_end();
+    test_overlap();
+    return test_failures != 0;
+}
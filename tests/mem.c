@@ -0,0 +1,68 @@
+#include "rv-alloc.h"
+#include "rv-mem.h"
+#include "test.h"
+
+#define BASE 0x10000
+
+static const rv_uint8_t LOOP[] = {
+    0x03, 0x38, 0x01, 0x00, // ld a6,0(sp)
+    // loop: 0x4
+    0x87, 0xb7, 0x07, 0x00, // fld fa5,0(a5)
+    0xd3, 0xf7, 0xe7, 0x02, // fadd.d fa5,fa5,fa4
+    0x27, 0x34, 0xf7, 0x00, // fsd fa5,8(a4)
+    0xd3, 0x96, 0x07, 0xc2, // fcvt.w.d a3,fa5,rtz
+    0x83, 0xa2, 0x06, 0x00, // lw t0,0(a3)
+    0x87, 0xa6, 0x44, 0x00, // flw fa3,4(s1)
+    0x93, 0x87, 0x87, 0x00, // addi a5,a5,8
+    0x41, 0x07,             // c.addi a4,16
+    0xe3, 0x91, 0x07, 0xff, // bne a5,a6,loop
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+static const rv_mem_t *at(const rv_mem_t *m, size_t n, rv_uint64_t pc)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        if (m[i].pc == pc)
+            return &m[i];
+    return 0;
+}
+
+// an fp destination that shares its number with a base register leaves the
+// base alone; an integer one kills it.
+static void test_strides(void)
+{
+    size_t n;
+    rv_mem_t *m = rv_mem_extract(BASE, LOOP, sizeof LOOP, BASE, BASE + sizeof LOOP, &n);
+    const rv_mem_t *a;
+
+    CHECK(m != 0 && n == 5);
+    if (m == 0)
+        return;
+
+    a = at(m, n, BASE);
+    CHECK(a && a->base == 2 && !(a->flags & (RV_MEM_LOOP | RV_MEM_STRIDE)));
+
+    a = at(m, n, BASE + 0x4);
+    CHECK(a && a->base == 15 && a->reg == 15 && a->width == 8);
+    CHECK(a && (a->flags & (RV_MEM_LOAD | RV_MEM_FP | RV_MEM_LOOP | RV_MEM_STRIDE)) == (RV_MEM_LOAD | RV_MEM_FP | RV_MEM_LOOP | RV_MEM_STRIDE));
+    CHECK(a && a->loop == BASE + 0x4 && a->stride == 8);
+
+    a = at(m, n, BASE + 0xc);
+    CHECK(a && a->base == 14 && a->disp == 8 && (a->flags & RV_MEM_STORE) && (a->flags & RV_MEM_STRIDE) && a->stride == 16);
+
+    a = at(m, n, BASE + 0x14);
+    CHECK(a && a->base == 13 && (a->flags & RV_MEM_LOOP) && !(a->flags & RV_MEM_STRIDE));
+
+    a = at(m, n, BASE + 0x18);
+    CHECK(a && a->base == 9 && (a->flags & RV_MEM_STRIDE) && a->stride == 0);
+
+    rv_dis_free(m);
+}
+
+int main(void)
+{
+    test_strides();
+    return test_failures != 0;
+}
@@ -0,0 +1,152 @@
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "rv-alloc.h"
+#include "rv-list.h"
+#include "rv-proc.h"
+#include "test.h"
+
+#define PAGES 3
+#define SKIP 77 // the ctest skip code, for sandboxes without process_vm_readv
+
+static const rv_uint8_t ADDI[4] = {0x13, 0x01, 0x01, 0xff}; // addi sp,sp,-16
+static const rv_uint8_t ADD[4] = {0x33, 0x05, 0xb5, 0x00};  // add a0,a0,a1
+static const rv_uint8_t CNOP[2] = {0x01, 0x00};             // c.nop
+static const rv_uint8_t CADDI[2] = {0x05, 0x05};            // c.addi a0,1
+
+static void fill(rv_uint8_t *p, size_t size, int patched)
+{
+    size_t off;
+
+    for (off = 0; off + 8 <= size; off += 8)
+    {
+        if (patched)
+        {
+            memcpy(p + off, CADDI, 2);
+            memcpy(p + off + 2, ADD, 4);
+            memcpy(p + off + 6, CNOP, 2);
+        }
+        else
+        {
+            memcpy(p + off, ADDI, 4);
+            memcpy(p + off + 4, ADD, 4);
+        }
+    }
+}
+
+// maps known code executable, sends its address and then patches the middle
+// page for every byte it reads, acknowledging each.
+static void child(int in, int out, size_t page)
+{
+    rv_uint8_t *code = mmap(0, PAGES * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char c;
+
+    if (code == MAP_FAILED)
+        _exit(1);
+    fill(code, PAGES * page, 0);
+    mprotect(code, PAGES * page, PROT_READ | PROT_EXEC);
+    write(out, &code, sizeof code);
+    while (read(in, &c, 1) == 1)
+    {
+        mprotect(code + page, page, PROT_READ | PROT_WRITE);
+        fill(code + page, page, 1);
+        mprotect(code + page, page, PROT_READ | PROT_EXEC);
+        write(out, &c, 1);
+    }
+    _exit(0);
+}
+
+// the listing of the snapshot has to match one of the local bytes.
+static void check_listing(const rv_image_t *img, rv_uint64_t addr, const rv_uint8_t *want, size_t size)
+{
+    const rv_section_t *s = rv_image_section(img, addr);
+    rv_listing_t *a, *b;
+    const rv_line_t *la, *lb;
+    size_t na, nb, i;
+
+    CHECK(s != 0 && s->exec && s->addr <= addr && s->addr + s->size >= addr + size);
+    if (s == 0 || s->addr + s->size < addr + size)
+        return;
+    CHECK(strcmp(s->name, "[anon]") == 0);
+    CHECK(memcmp(s->data + (addr - s->addr), want, size) == 0);
+    a = rv_listing_new(addr, s->data + (addr - s->addr), size);
+    b = rv_listing_new(addr, want, size);
+    CHECK(a != 0 && b != 0);
+    if (a && b)
+    {
+        la = rv_listing_lines(a, &na);
+        lb = rv_listing_lines(b, &nb);
+        CHECK(na == nb && na > 0);
+        for (i = 0; i < na && i < nb; i++)
+        {
+            CHECK(la[i].pc == lb[i].pc && la[i].raw == lb[i].raw && la[i].len == lb[i].len);
+            CHECK(la[i].text && lb[i].text && strcmp(la[i].text, lb[i].text) == 0);
+        }
+    }
+    rv_listing_free(a);
+    rv_listing_free(b);
+}
+
+int main(void)
+{
+    size_t page = sysconf(_SC_PAGESIZE), n;
+    rv_uint8_t *want = malloc(PAGES * page);
+    int to[2], from[2], pid, status;
+    rv_proc_range_t *r;
+    rv_uint64_t addr;
+    rv_proc_t *p;
+    void *remote;
+    char c = 'w';
+
+    if (want == 0 || pipe(to) < 0 || pipe(from) < 0)
+        return 1;
+    if ((pid = fork()) == 0)
+    {
+        close(to[1]);
+        close(from[0]);
+        child(to[0], from[1], page);
+    }
+    close(to[0]);
+    close(from[1]);
+    CHECK(pid > 0 && read(from[0], &remote, sizeof remote) == sizeof remote);
+    addr = (rv_uint64_t)(size_t)remote;
+
+    if ((p = rv_proc_open(pid)) == 0)
+    {
+        fprintf(stderr, "cannot read process %d, skipped\n", pid);
+        kill(pid, SIGKILL);
+        waitpid(pid, 0, 0);
+        return SKIP;
+    }
+    fill(want, PAGES * page, 0);
+    check_listing(rv_proc_image(p), addr, want, PAGES * page);
+
+    // nothing changed yet
+    r = rv_proc_refresh(p, &n);
+    CHECK(r != 0 && n == 0);
+    rv_dis_free(r);
+
+    // the watch mode path: exactly the patched page comes back
+    CHECK(write(to[1], &c, 1) == 1 && read(from[0], &c, 1) == 1);
+    r = rv_proc_refresh(p, &n);
+    CHECK(r != 0 && n == 1);
+    if (r && n == 1)
+        CHECK(r[0].addr == addr + page && r[0].size == page);
+    rv_dis_free(r);
+    fill(want + page, page, 1);
+    check_listing(rv_proc_image(p), addr, want, PAGES * page);
+
+    // a process that is gone ends the watch
+    close(to[1]);
+    CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(rv_proc_refresh(p, &n) == 0);
+
+    rv_proc_close(p);
+    close(from[0]);
+    free(want);
+    return test_failures != 0;
+}
@@ -0,0 +1,159 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rv-alloc.h"
+#include "rv-prof.h"
+#include "test.h"
+
+#define BASE 0x10000
+#define SPREAD 1000 // distinct pcs of the sort test
+
+static const rv_uint8_t CODE[] = {
+    // f: 0x0
+    0x13, 0x05, 0x15, 0x00, // addi a0,a0,1
+    0x67, 0x80, 0x00, 0x00, // ret
+    // g: 0x8
+    0x13, 0x05, 0x25, 0x00, // addi a0,a0,2
+    0x63, 0x04, 0x05, 0x00, // beqz a0,out
+    0x13, 0x05, 0x35, 0x00, // addi a0,a0,3
+    // out: 0x14
+    0x67, 0x80, 0x00, 0x00, // ret
+};
+
+// a count of 1 when none is given, and repeated pcs merge once sorted.
+static const char SAMPLES[] = "0x10000 3\n"
+                              "10014 4\n"
+                              "10008 5\n"
+                              "20000 4\n"
+                              "10004\n"
+                              "10010 2\n"
+                              "10008 1\n";
+
+// f and g by symbol, their blocks, then the samples outside both; a 50%
+// threshold keeps g alone.
+#define LIST_F \
+    "## 10000 f   20.00%          4\n" \
+    "#  block 10000   20.00%          4\n" \
+    "  15.00%          3    10000:\t00150513\taddi\ta0,a0,1\n" \
+    "   5.00%          1    10004:\t00008067\tret\n"
+#define LIST_G \
+    "## 10008 g   60.00%         12\n" \
+    "#  block 10008   30.00%          6\n" \
+    "  30.00%          6    10008:\t00250513\taddi\ta0,a0,2\n" \
+    "                       1000c:\t00050463\tbeqz\ta0,0x10014\n" \
+    "#  block 10010   10.00%          2\n" \
+    "  10.00%          2    10010:\t00350513\taddi\ta0,a0,3\n" \
+    "#  block 10014   20.00%          4\n" \
+    "  20.00%          4    10014:\t00008067\tret\n"
+#define OUTSIDE "## outside functions 20.00% 4 of 20\n"
+
+static const char EXPECT[] = LIST_F LIST_G OUTSIDE LIST_G OUTSIDE;
+
+static char path[64];
+
+static void write_file(const char *data, size_t size)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+    CHECK(fd >= 0 && write(fd, data, size) == (ssize_t)size);
+    if (fd >= 0)
+        close(fd);
+}
+
+// the whole file, nul terminated.
+static char *read_file(void)
+{
+    char *buf = calloc(1, 1 << 16);
+    int fd = open(path, O_RDONLY);
+    ssize_t n = fd < 0 || buf == 0 ? -1 : read(fd, buf, (1 << 16) - 1);
+
+    if (fd >= 0)
+        close(fd);
+    CHECK(n > 0);
+    if (n <= 0)
+    {
+        free(buf);
+        return 0;
+    }
+    return buf;
+}
+
+// many samples over SPREAD pcs in scrambled order, on the radix path
+static void test_sort(void)
+{
+    rv_profile_t *p = rv_profile_new();
+    size_t i;
+
+    CHECK(p != 0);
+    if (p == 0)
+        return;
+    for (i = 0; i < 20 * SPREAD; i++)
+        CHECK(rv_profile_add(p, BASE + 4 * (i * 7919 % SPREAD), i / SPREAD % 2 + 1) == 0);
+    CHECK(p->total == 30 * SPREAD && !p->sorted);
+    CHECK(rv_profile_sort(p, 4) == 0);
+    CHECK(p->sorted && p->count == SPREAD && p->total == 30 * SPREAD);
+    for (i = 0; i < p->count; i++)
+        CHECK(p->s[i].pc == BASE + 4 * i && p->s[i].count == 30);
+    rv_profile_free(p);
+}
+
+static void test_annotate(void)
+{
+    rv_symbol_t syms[2] = {{"f", BASE, 8}, {"g", BASE + 8, 16}};
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    rv_profile_t *p;
+    rv_func_t *funcs;
+    rv_cfg_t *cfg;
+    rv_sink_t *sink;
+    size_t nfuncs;
+    char *text;
+    int fd;
+
+    write_file(SAMPLES, sizeof SAMPLES - 1);
+    p = rv_profile_load(path);
+    CHECK(p != 0 && p->count == 7 && p->total == 20);
+    if (p == 0)
+        return;
+    CHECK(rv_profile_sort(p, 2) == 0 && p->count == 6);
+    CHECK(p->s[2].pc == BASE + 8 && p->s[2].count == 6);
+
+    img->symbols = syms;
+    img->nsymbols = 2;
+    funcs = rv_func_detect(img, 1, &nfuncs);
+    cfg = rv_cfg_build(img, 0, 0, 1);
+    CHECK(funcs != 0 && nfuncs == 2 && cfg != 0);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    sink = fd < 0 ? 0 : rv_sink_open(fd, 0, 0, 0);
+    CHECK(sink != 0);
+    if (sink && funcs && cfg)
+    {
+        CHECK(rv_profile_annotate(sink, p, img, funcs, nfuncs, cfg, 0) == 0);
+        CHECK(rv_profile_annotate(sink, p, img, funcs, nfuncs, cfg, 50) == 0);
+    }
+    CHECK(sink == 0 || rv_sink_close(sink) == 0);
+    if (fd >= 0)
+        close(fd);
+
+    text = read_file();
+    CHECK(text && strcmp(text, EXPECT) == 0);
+    free(text);
+
+    img->symbols = 0;
+    img->nsymbols = 0;
+    rv_dis_free(funcs);
+    rv_cfg_free(cfg);
+    rv_image_close(img);
+    rv_profile_free(p);
+}
+
+int main(void)
+{
+    snprintf(path, sizeof path, "test-prof-%d.out", (int)getpid());
+    test_sort();
+    test_annotate();
+    unlink(path);
+    return test_failures != 0;
+}
@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rv-sink.h"
+#include "test.h"
+
+#define TOTAL (3 << 20) // bytes of synthetic listing per run
+#define BENCH (64 << 20)
+
+static int short_writes;
+static size_t ncalls;                 // writev calls made while cutting
+static unsigned seed = 1, wseed = 7; // the writer thread only touches wseed
+static char *expect;
+static char path[64];
+
+static unsigned next(unsigned *s)
+{
+    *s = *s * 1103515245 + 12345;
+    return *s >> 8;
+}
+
+static unsigned rnd(void)
+{
+    return next(&seed);
+}
+
+// the sink's writev, replaced so that every call transfers a random prefix
+// cut anywhere inside the vector, and some fail with EINTR first.
+ssize_t writev(int fd, const struct iovec *iov, int cnt)
+{
+    size_t limit = short_writes ? next(&wseed) % 20000 + 1 : (size_t)-1;
+    ssize_t done = 0;
+    int i;
+
+    ncalls += short_writes;
+    if (short_writes && next(&wseed) % 8 == 0)
+    {
+        errno = EINTR;
+        return -1;
+    }
+    for (i = 0; i < cnt && limit; i++)
+    {
+        size_t n = iov[i].iov_len < limit ? iov[i].iov_len : limit;
+        ssize_t w = write(fd, iov[i].iov_base, n);
+
+        if (w < 0)
+            return done ? done : -1;
+        done += w;
+        limit -= w;
+        if ((size_t)w < iov[i].iov_len)
+            break;
+    }
+    return done;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// listing-like lines of varying length into expect.
+static size_t lines(char *buf, size_t size)
+{
+    size_t n = 0;
+    rv_uint64_t pc = 0x10000;
+
+    while (n + 64 < size)
+    {
+        n += sprintf(buf + n, "%8llx:\t%08x\taddi\ta%u,sp,%u\n", pc, (unsigned)(pc * 2654435761u), (unsigned)(pc % 8),
+                     (unsigned)(pc % 2048));
+        pc += 4;
+    }
+    return n;
+}
+
+// mixes rv_sink_write, reserve and commit and the odd flush.
+static void drive(rv_sink_t *s, size_t total)
+{
+    size_t off = 0;
+
+    while (off < total)
+    {
+        size_t n = rnd() % 300 + 1;
+        char *p;
+
+        if (n > total - off)
+            n = total - off;
+        switch (rnd() % 3)
+        {
+        case 0:
+            CHECK(rv_sink_write(s, expect + off, n) == 0);
+            break;
+        case 1:
+            p = rv_sink_reserve(s, n + 64);
+            CHECK(p != 0);
+            if (p == 0)
+                return;
+            memcpy(p, expect + off, n);
+            rv_sink_commit(s, n);
+            break;
+        default:
+            CHECK(rv_sink_write(s, expect + off, n) == 0);
+            if (rnd() % 256 == 0)
+                CHECK(rv_sink_flush(s) == 0);
+        }
+        off += n;
+    }
+    CHECK(rv_sink_offset(s) == total);
+}
+
+static void test_short_writes(int flags, rv_uint64_t prealloc)
+{
+    size_t total = lines(expect, TOTAL);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    rv_sink_t *s;
+    struct stat st;
+    char *got;
+
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+    short_writes = 1;
+    ncalls = 0;
+    s = rv_sink_open(fd, 4096, flags, prealloc);
+    CHECK(s != 0);
+    if (s)
+    {
+        drive(s, total);
+        CHECK(rv_sink_close(s) == 0);
+    }
+    short_writes = 0;
+    CHECK(ncalls > total / 20000);
+
+    CHECK(fstat(fd, &st) == 0 && (size_t)st.st_size == total);
+    got = malloc(total);
+    CHECK(got && pread(fd, got, total, 0) == (ssize_t)total && memcmp(got, expect, total) == 0);
+    free(got);
+    close(fd);
+    unlink(path);
+}
+
+// not a check, a rate to compare builds by: real writes to /dev/null.
+static void bench(int flags)
+{
+    size_t total = lines(expect, TOTAL), done = 0;
+    int fd = open("/dev/null", O_WRONLY);
+    rv_sink_t *s = fd < 0 ? 0 : rv_sink_open(fd, 0, flags, 0);
+    double t0 = now();
+
+    if (s == 0)
+        return;
+    for (done = 0; done < BENCH; done += total)
+        rv_sink_write(s, expect, total);
+    rv_sink_close(s);
+    close(fd);
+    printf("%s: %.0f MB/s\n", flags & RV_SINK_ASYNC ? "async" : "sync", done / (now() - t0) / 1e6);
+}
+
+int main(void)
+{
+    expect = malloc(TOTAL);
+    if (expect == 0)
+        return 1;
+    snprintf(path, sizeof path, "test-sink-%d.out", (int)getpid());
+    test_short_writes(0, 0);
+    test_short_writes(RV_SINK_ASYNC, 0);
+    test_short_writes(RV_SINK_PREALLOC, TOTAL * 2);
+    test_short_writes(RV_SINK_ASYNC | RV_SINK_PREALLOC, TOTAL * 2);
+    bench(0);
+    bench(RV_SINK_ASYNC);
+    free(expect);
+    return test_failures != 0;
+}
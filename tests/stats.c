@@ -0,0 +1,72 @@
+#include "rv-stats.h"
+#include "test.h"
+
+#define BASE 0x10000
+
+static const rv_uint8_t CODE[] = {
+    0x13, 0x05, 0x15, 0x00, // addi a0,a0,1
+    // f: 0x4
+    0x33, 0x05, 0xb5, 0x00, // add a0,a0,a1
+    0x33, 0x05, 0xb5, 0x02, // mul a0,a0,a1
+    0x05, 0x05,             // c.addi a0,1
+    0x2f, 0x25, 0xb6, 0x00, // amoadd.w a0,a1,(a2)
+    0x53, 0x75, 0xb5, 0x02, // fadd.d fa0,fa0,fa1
+    0x67, 0x80, 0x00, 0x00, // ret
+    // g: 0x1a
+    0x13, 0x05, 0x25, 0x00, // addi a0,a0,2
+    0x33, 0x75, 0xb5, 0x40, // andn a0,a0,a1
+    0x33, 0x05, 0xb5, 0x32, // aes64es a0,a0,a1
+    0xd7, 0x80, 0x21, 0x02, // vadd.vv v1,v2,v3
+    0x73, 0x25, 0x00, 0xc0, // csrr a0,cycle
+    0x0b, 0x00, 0x00, 0x00, // .word 0x0000000b
+    0x82, 0x80,             // c.jr ra
+};
+
+static const rv_func_t FUNCS[2] = {{BASE + 0x4, BASE + 0x1a, RV_FUNC_SYMBOL, 0}, {BASE + 0x1a, BASE + sizeof CODE, RV_FUNC_SYMBOL, 0}};
+
+// totals per extension and op, and a row per function; the addi before f
+// counts in the totals only.
+static void test_classes(const rv_func_t *funcs, size_t nfuncs, int nthreads)
+{
+    static const rv_uint64_t EXT[RV_EXT_COUNT] = {
+        [RV_EXT_I] = 4, [RV_EXT_M] = 1, [RV_EXT_A] = 1, [RV_EXT_D] = 1, [RV_EXT_C] = 2, [RV_EXT_B] = 1,
+        [RV_EXT_K] = 1, [RV_EXT_V] = 1, [RV_EXT_ZICSR] = 1, [RV_EXT_CUSTOM] = 1,
+    };
+    static const rv_uint64_t ROWS[2][RV_EXT_COUNT] = {
+        {[RV_EXT_I] = 2, [RV_EXT_M] = 1, [RV_EXT_A] = 1, [RV_EXT_D] = 1, [RV_EXT_C] = 1},
+        {[RV_EXT_I] = 1, [RV_EXT_C] = 1, [RV_EXT_B] = 1, [RV_EXT_K] = 1, [RV_EXT_V] = 1, [RV_EXT_ZICSR] = 1, [RV_EXT_CUSTOM] = 1},
+    };
+    rv_image_t *img = rv_image_raw(BASE, CODE, sizeof CODE);
+    rv_stats_t *s = rv_stats_image(img, funcs, nfuncs, nthreads);
+    size_t f;
+    int e;
+
+    CHECK(s != 0);
+    if (s == 0)
+        return;
+    CHECK(s->insns == 14 && s->bytes == sizeof CODE && s->nfuncs == nfuncs);
+    for (e = 0; e < RV_EXT_COUNT; e++)
+        CHECK(s->ext[e] == EXT[e]);
+    for (f = 0; f < nfuncs; f++)
+    {
+        for (e = 0; e < RV_EXT_COUNT; e++)
+            CHECK(s->func[f * RV_EXT_COUNT + e] == ROWS[f][e]);
+    }
+
+    CHECK(s->ops[RV_ADDI] == 2 && s->raw[RV_ADDI] == 0x00150513);
+    CHECK(s->ops[RV_C_ADDI] == 1 && s->raw[RV_C_ADDI] == 0x0505);
+    CHECK(s->ops[RV_MUL] == 1 && s->ops[RV_AMOADD_W] == 1 && s->ops[RV_FADD_D] == 1);
+    CHECK(s->ops[RV_STATS_DEC + RV_OP_ANDN] == 1 && s->raw[RV_STATS_DEC + RV_OP_ANDN] == 0x40b57533);
+    CHECK(s->ops[RV_STATS_DEC + RV_OP_AES64ES] == 1);
+    CHECK(s->ops[RV_STATS_DEC + RV_OP_VADD_VV] == 1 && s->raw[RV_STATS_DEC + RV_OP_VADD_VV] == 0x022180d7);
+
+    rv_stats_free(s);
+    rv_image_close(img);
+}
+
+int main(void)
+{
+    test_classes(FUNCS, 2, 3);
+    test_classes(0, 0, 1);
+    return test_failures != 0;
+}
@@ -0,0 +1,10 @@
+#ifndef __RV_TEST_H
+#define __RV_TEST_H
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond) ((cond) ? (void)0 : (void)(fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond), test_failures++))
+
+#endif // __RV_TEST_H
@@ -0,0 +1,1084 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rv-alloc.h"
+#include "rv-atomic.h"
+#include "rv-cache.h"
+#include "rv-cost.h"
+#include "rv-csr.h"
+#include "rv-custom.h"
+#include "rv-diff.h"
+#include "rv-fprint.h"
+#include "rv-frame.h"
+#include "rv-isa.h"
+#include "rv-mem.h"
+#include "rv-proc.h"
+#include "rv-prof.h"
+#include "rv-stats.h"
+#include "rv-jtab.h"
+#include "rv-out.h"
+
+#define DIS_BATCH 4096 // instructions rendered between arena resets
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-b base] [-i isa] [-x match:mask:name:operands]... [-t threads] [-c cache [-C]] [-f format] [-o output] [-g | -F | -S | -M lo:hi | -E model | -P samples | -X | -A | -R priv | -D old | -K db | -Q db | -L [-w ms]] [-v] image | pid | cmd...\n", prog);
+    fprintf(stderr, "  -b base     load address of the raw image (default 0)\n");
+    fprintf(stderr, "  -i isa      target profile, e.g. rv32imac_zicsr; anything else decodes as undef\n");
+    fprintf(stderr, "  -x custom   decode match:mask as name with the operands, e.g. 0x0b:0x707f:vx.mac:rd,rs1,rs2\n");
+    fprintf(stderr, "  -t threads  worker threads, 0 for all cpus (default 0)\n");
+    fprintf(stderr, "  -c cache    serve lines from this cache file when it matches the image\n");
+    fprintf(stderr, "  -C          (re)build the cache file and exit\n");
+    fprintf(stderr, "  -f format   text, jsonl or columns (default text)\n");
+    fprintf(stderr, "  -o output   write to this file instead of stdout\n");
+    fprintf(stderr, "  -g          recover and print the control flow graph (elf or raw image)\n");
+    fprintf(stderr, "  -F          detect and print function starts (elf or raw image)\n");
+    fprintf(stderr, "  -S          print frame size, spills and static stack depth per function\n");
+    fprintf(stderr, "  -M lo:hi    table of memory accesses in [lo, hi), binary with -f columns\n");
+    fprintf(stderr, "  -E model    estimate cycles per iteration of every block, '-' for the built-in model\n");
+    fprintf(stderr, "  -P samples  annotate the functions holding pc samples (binary or \"pc [count]\" lines)\n");
+    fprintf(stderr, "  -X          opcode and extension counts, per image and per function\n");
+    fprintf(stderr, "  -A          list atomics and fences per function, flagging full barriers inside loops\n");
+    fprintf(stderr, "  -R priv     csr accesses needing at least u, s, h, m or d privilege\n");
+    fprintf(stderr, "  -D old      diff functions against an older build, instruction level for changed ones\n");
+    fprintf(stderr, "  -K db       add the function fingerprints to a similarity index\n");
+    fprintf(stderr, "  -Q db       list indexed functions similar to those of the image\n");
+    fprintf(stderr, "  -L          disassemble the executable mappings of a running pid, or of cmd started and then killed\n");
+    fprintf(stderr, "  -w ms       with -L, poll every ms and disassemble the pages that changed until the process exits\n");
+    fprintf(stderr, "  -v          report output throughput on stderr\n");
+    exit(2);
+}
+
+static int put_line(rv_sink_t *sink, const rv_line_t *line)
+{
+    char *p = rv_sink_reserve(sink, 512);
+    int n;
+
+    if (p == 0)
+        return -1;
+    if (line->len == 2)
+        n = snprintf(p, 512, "%8llx:\t%04x    \t%s\n", line->pc, line->raw & 0xffff, line->text);
+    else
+        n = snprintf(p, 512, "%8llx:\t%08x\t%s\n", line->pc, line->raw, line->text);
+    rv_sink_commit(sink, n < 512 ? n : 511);
+    return 0;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int parse_format(const char *s)
+{
+    if (strcmp(s, "text") == 0)
+        return RV_OUT_TEXT;
+    if (strcmp(s, "jsonl") == 0)
+        return RV_OUT_JSONL;
+    if (strcmp(s, "columns") == 0)
+        return RV_OUT_COLUMNS;
+    return -1;
+}
+
+// decodes the whole image straight into an output writer.
+// mnemonics come from an arena reset every DIS_BATCH instructions rather
+// than being freed one by one.
+static int dump_live(rv_sink_t *sink, int format, rv_uint64_t base, const rv_uint8_t *code, size_t size)
+{
+    rv_out_t *o = rv_out_new(sink, format);
+    rv_arena_t *arena = rv_arena_new(0, 0);
+    rv_allocator_t a;
+    rv_uint64_t pc;
+    size_t n = 0;
+    int ret = 0;
+
+    if (o == 0)
+    {
+        rv_arena_free(arena);
+        return -1;
+    }
+    if (arena)
+        a = rv_arena_allocator(arena);
+    for (pc = base; pc < base + size;)
+    {
+        inst_t ir;
+        mnemonic_t m;
+        rv_uint32_t raw;
+        int len = rv_dis_decode(pc, code + (pc - base), size - (pc - base), &ir, &raw);
+        if (len == 0)
+            break;
+        if (arena)
+        {
+            if (n++ % DIS_BATCH == 0)
+                rv_arena_reset(arena);
+            rv_dis_set_thread_allocator(&a);
+        }
+        rv_disasm(&ir, &m);
+        rv_dis_set_thread_allocator(0);
+        ret = rv_out_put(o, &ir, raw, len, &m);
+        if (arena == 0)
+            rv_mnemonic_free(&m);
+        if (ret < 0)
+            break;
+        pc += len;
+    }
+    if (rv_out_close(o) < 0)
+        ret = -1;
+    rv_arena_free(arena);
+    return ret;
+}
+
+static const char *flow_names[] = {"none", "branch", "jump", "call", "ijump", "icall", "ret", "stop"};
+static const char *edge_names[] = {"fall", "branch", "jump", "call"};
+
+static int cmp_jtab(const void *a, const void *b)
+{
+    rv_uint64_t x = *(const rv_uint64_t *)a;
+    const rv_jtab_t *y = b;
+    return x < y->pc ? -1 : x > y->pc;
+}
+
+static int dump_cfg(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads)
+{
+    rv_image_t *img = rv_image_open(path, base);
+    rv_cfg_t *cfg;
+    rv_jtab_t *tabs;
+    size_t i, j, ntabs;
+    int ret = 0;
+
+    if (img == 0)
+        return -1;
+    cfg = rv_jtab_cfg(img, threads, &tabs, &ntabs);
+    if (cfg == 0)
+    {
+        rv_image_close(img);
+        return -1;
+    }
+    for (i = 0; i < cfg->nblocks; i++)
+    {
+        const rv_block_t *b = &cfg->blocks[i];
+        rv_uint64_t last = b->start + b->size - 2;
+        const rv_jtab_t *jt = 0;
+        char *p;
+        int n;
+
+        // the jump is the last 2 or 4 bytes of the block
+        if (b->flow == RV_FLOW_IJUMP)
+        {
+            jt = bsearch(&last, tabs, ntabs, sizeof *tabs, cmp_jtab);
+            last -= 2;
+            if (jt == 0)
+                jt = bsearch(&last, tabs, ntabs, sizeof *tabs, cmp_jtab);
+        }
+        p = rv_sink_reserve(sink, 256 + 64 * b->nedges + (jt ? 32 * jt->count : 0));
+        if (p == 0)
+        {
+            ret = -1;
+            break;
+        }
+        n = sprintf(p, "%llx\t%u\t%u\t%s", b->start, b->size, b->ninsn, flow_names[b->flow]);
+        for (j = 0; j < b->nedges; j++)
+        {
+            const rv_edge_t *e = &cfg->edges[b->edge + j];
+            n += sprintf(p + n, "\t%s:%llx", edge_names[e->kind], e->target);
+        }
+        for (j = 0; jt && j < jt->count; j++)
+            n += sprintf(p + n, "\tcase:%llx", jt->targets[j]);
+        p[n++] = '\n';
+        rv_sink_commit(sink, n);
+    }
+    fprintf(stderr, "%zu blocks, %zu edges, %zu jump tables\n", cfg->nblocks, cfg->nedges, ntabs);
+    rv_jtab_free(tabs, ntabs);
+    rv_cfg_free(cfg);
+    rv_image_close(img);
+    return ret;
+}
+
+static int dump_funcs(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads)
+{
+    static const char letters[] = "secbpa"; // symbol entry called boundary prologue aligned
+    rv_image_t *img = rv_image_open(path, base);
+    rv_func_t *f;
+    size_t i, n;
+    int ret = 0;
+
+    if (img == 0)
+        return -1;
+    f = rv_func_detect(img, threads, &n);
+    if (f == 0)
+    {
+        rv_image_close(img);
+        return -1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        const rv_symbol_t *sym = rv_image_symbol(img, f[i].start);
+        char flags[sizeof letters];
+        char *p = rv_sink_reserve(sink, 512);
+        int k;
+
+        if (p == 0)
+        {
+            ret = -1;
+            break;
+        }
+        for (k = 0; letters[k]; k++)
+            flags[k] = f[i].flags & (1 << k) ? letters[k] : '-';
+        flags[k] = 0;
+        if (sym && sym->addr == f[i].start)
+            rv_sink_commit(sink, snprintf(p, 512, "%llx\t%llx\t%s\t%.400s\n", f[i].start, f[i].end, flags, sym->name));
+        else
+            rv_sink_commit(sink, snprintf(p, 512, "%llx\t%llx\t%s\n", f[i].start, f[i].end, flags));
+    }
+    fprintf(stderr, "%zu functions\n", n);
+    free(f);
+    rv_image_close(img);
+    return ret;
+}
+
+static int dump_frames(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads)
+{
+    rv_image_t *img = rv_image_open(path, base);
+    rv_func_t *funcs = 0;
+    rv_frames_t *fr = 0;
+    size_t i, n;
+    int ret = -1;
+
+    if (img == 0)
+        return -1;
+    funcs = rv_func_detect(img, threads, &n);
+    if (funcs)
+        fr = rv_frame_analyze(img, funcs, n, threads);
+    for (i = 0; fr && i < fr->count; i++)
+    {
+        const rv_frame_t *f = &fr->frames[i];
+        const rv_symbol_t *sym = rv_image_symbol(img, f->start);
+        char *p = rv_sink_reserve(sink, 512);
+
+        if (p == 0)
+            break;
+        rv_sink_commit(sink, snprintf(p, 512, "%llx\t%u\t%u\t%u\t%llu%s\t%c%c%c\t%.400s\n", f->start, f->frame, f->spills, f->reloads, f->depth,
+                                      f->flags & (RV_FRAME_ICALL | RV_FRAME_RECURSIVE) ? "+" : "",
+                                      f->flags & RV_FRAME_DYNAMIC ? 'd' : '-', f->flags & RV_FRAME_ICALL ? 'i' : '-', f->flags & RV_FRAME_RECURSIVE ? 'r' : '-',
+                                      sym && sym->addr == f->start ? sym->name : ""));
+    }
+    if (fr && i == fr->count)
+        ret = 0;
+    rv_frames_free(fr);
+    free(funcs);
+    rv_image_close(img);
+    return ret;
+}
+
+static int dump_mem(rv_sink_t *sink, const char *path, rv_uint64_t base, rv_uint64_t lo, rv_uint64_t hi, int binary)
+{
+    rv_image_t *img = rv_image_open(path, base);
+    const rv_section_t *s;
+    rv_mem_t *m = 0;
+    size_t i, n = 0;
+    int ret = -1;
+
+    if (img == 0)
+        return -1;
+    s = rv_image_section(img, lo);
+    if (s)
+        m = rv_mem_extract(s->addr, s->data, s->size, lo, hi, &n);
+    if (m && binary)
+        ret = rv_mem_write(sink, m, n, lo, hi);
+    for (i = 0; m && !binary && i < n; i++)
+    {
+        char *p = rv_sink_reserve(sink, 256);
+        int k;
+
+        if (p == 0)
+            break;
+        k = sprintf(p, "%llx\t%s%s\t%u\t%c\t%s\t%lld", m[i].pc, m[i].flags & RV_MEM_LOAD ? "r" : "", m[i].flags & RV_MEM_STORE ? "w" : "",
+                    m[i].width, m[i].flags & RV_MEM_SIGNED ? 's' : 'u', rv_reg2name(m[i].base), m[i].disp);
+        k += m[i].flags & RV_MEM_STRIDE ? sprintf(p + k, "\t%lld", m[i].stride) : sprintf(p + k, "\t-");
+        k += m[i].flags & RV_MEM_LOOP ? sprintf(p + k, "\t%llx\n", m[i].loop) : sprintf(p + k, "\t-\n");
+        rv_sink_commit(sink, k);
+    }
+    if (m && !binary && i == n)
+        ret = 0;
+    free(m);
+    rv_image_close(img);
+    return ret;
+}
+
+static int dump_cost(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads, const char *model_path, int verbose)
+{
+    static const char *bound_names[] = {"deps", "width", "port"};
+    rv_model_t *model = strcmp(model_path, "-") == 0 ? rv_model_default() : rv_model_load(model_path);
+    rv_image_t *img = 0;
+    rv_cfg_t *cfg = 0;
+    inst_t *ins = 0;
+    size_t i, cap = 0;
+    double t0;
+    int ret = -1;
+
+    if (model == 0)
+    {
+        fprintf(stderr, "%s: invalid model\n", model_path);
+        return -1;
+    }
+    img = rv_image_open(path, base);
+    if (img)
+        cfg = rv_cfg_build(img, 0, 0, threads);
+    t0 = now();
+    for (i = 0; cfg && i < cfg->nblocks; i++)
+    {
+        const rv_block_t *b = &cfg->blocks[i];
+        const rv_section_t *s = rv_image_section(img, b->start);
+        rv_uint64_t pc = b->start;
+        rv_cost_t c;
+        size_t n;
+        char *p;
+
+        if (s == 0)
+            continue;
+        if (b->ninsn > cap)
+        {
+            inst_t *t = realloc(ins, b->ninsn * sizeof *t);
+            if (t == 0)
+                break;
+            ins = t;
+            cap = b->ninsn;
+        }
+        for (n = 0; n < b->ninsn; n++)
+            pc += rv_dis_decode(pc, s->data + (pc - s->addr), s->size - (pc - s->addr), &ins[n], 0);
+        if (rv_cost_block(model, ins, n, &c) < 0 || (p = rv_sink_reserve(sink, 256)) == 0)
+            break;
+        if (c.bound == RV_COST_PORT)
+            rv_sink_commit(sink, sprintf(p, "%llx\t%u\t%.2f\t%.2f\t%u\tport:%s\n", b->start, c.ninsn, c.cycles, c.ipc, c.latency, rv_model_port(model, c.port)));
+        else
+            rv_sink_commit(sink, sprintf(p, "%llx\t%u\t%.2f\t%.2f\t%u\t%s\n", b->start, c.ninsn, c.cycles, c.ipc, c.latency, bound_names[c.bound]));
+    }
+    if (cfg && i == cfg->nblocks)
+    {
+        ret = 0;
+        if (verbose)
+            fprintf(stderr, "%zu blocks estimated in %.3fs\n", cfg->nblocks, now() - t0);
+    }
+    free(ins);
+    rv_cfg_free(cfg);
+    rv_image_close(img);
+    rv_model_free(model);
+    return ret;
+}
+
+static int dump_prof(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads, const char *samples, int verbose)
+{
+    rv_profile_t *p = rv_profile_load(samples);
+    rv_image_t *img = 0;
+    rv_func_t *funcs = 0;
+    rv_cfg_t *cfg = 0;
+    size_t nfuncs = 0;
+    double t0 = now();
+    int ret = -1;
+
+    if (p == 0)
+    {
+        perror(samples);
+        return -1;
+    }
+    if (verbose)
+        fprintf(stderr, "%zu samples loaded in %.3fs\n", p->count, now() - t0);
+    t0 = now();
+    if (rv_profile_sort(p, threads) == 0 && (img = rv_image_open(path, base)) != 0)
+    {
+        if (verbose)
+            fprintf(stderr, "%zu distinct pcs sorted in %.3fs\n", p->count, now() - t0);
+        funcs = rv_func_detect(img, threads, &nfuncs);
+        cfg = rv_cfg_build(img, 0, 0, threads);
+        if (funcs && cfg)
+            ret = rv_profile_annotate(sink, p, img, funcs, nfuncs, cfg, 0);
+    }
+    rv_cfg_free(cfg);
+    free(funcs);
+    rv_image_close(img);
+    rv_profile_free(p);
+    return ret;
+}
+
+static int put_text(rv_sink_t *sink, const char *fmt, ...)
+{
+    char *p = rv_sink_reserve(sink, 512);
+    va_list ap;
+    int n;
+
+    if (p == 0)
+        return -1;
+    va_start(ap, fmt);
+    n = vsnprintf(p, 512, fmt, ap);
+    va_end(ap);
+    rv_sink_commit(sink, n < 512 ? n : 511);
+    return 0;
+}
+
+typedef struct
+{
+    rv_uint64_t count;
+    int op;
+} op_count_t;
+
+static int cmp_op(const void *a, const void *b)
+{
+    const op_count_t *x = a, *y = b;
+    return x->count > y->count ? -1 : x->count < y->count ? 1 : x->op - y->op;
+}
+
+static int dump_stats(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads, int verbose)
+{
+    rv_image_t *img = rv_image_open(path, base);
+    rv_func_t *funcs = 0;
+    rv_stats_t *s = 0;
+    size_t i, nfuncs = 0, nops = 0;
+    op_count_t order[RV_STATS_OPS];
+    int k, ret = -1;
+    double t0;
+
+    if (img == 0)
+        return -1;
+    funcs = rv_func_detect(img, threads, &nfuncs);
+    t0 = now();
+    if (funcs)
+        s = rv_stats_image(img, funcs, nfuncs, threads);
+    if (s == 0)
+        goto out;
+    if (verbose)
+    {
+        double t = now() - t0;
+        fprintf(stderr, "%llu instructions, %llu bytes in %.3fs: %.1f MB/s\n", s->insns, s->bytes, t, s->bytes / t / 1e6);
+    }
+
+    for (k = 0; k < RV_STATS_OPS; k++)
+        if (s->ops[k])
+            order[nops++] = (op_count_t){s->ops[k], k};
+    qsort(order, nops, sizeof *order, cmp_op);
+
+    ret = 0;
+    put_text(sink, "## %llu instructions, %llu bytes\n", s->insns, s->bytes);
+    put_text(sink, "## extensions\n");
+    for (k = 0; k < RV_EXT_COUNT; k++)
+        if (s->ext[k])
+            put_text(sink, "%s\t%llu\t%.2f%%\n", rv_ext_name(k), s->ext[k], 100.0 * s->ext[k] / s->insns);
+    put_text(sink, "## ops\n");
+    for (i = 0; i < nops; i++)
+    {
+        rv_uint32_t raw = s->raw[order[i].op];
+        rv_uint8_t b[4] = {raw, raw >> 8, raw >> 16, raw >> 24};
+        mnemonic_t m;
+        inst_t ir;
+
+        rv_dis_decode(0, b, sizeof b, &ir, 0);
+        rv_disasm(&ir, &m);
+        put_text(sink, "%s\t%s\t%llu\t%.2f%%\n", rv_ext_name(rv_ext_class(raw)), m.op, order[i].count,
+                 100.0 * order[i].count / s->insns);
+        rv_mnemonic_free(&m);
+    }
+    put_text(sink, "## functions\n");
+    for (i = 0; i < nfuncs; i++)
+    {
+        const rv_uint64_t *ext = s->func + i * RV_EXT_COUNT;
+        const rv_symbol_t *sym = rv_image_symbol(img, funcs[i].start);
+        char *p = rv_sink_reserve(sink, 1024);
+        int len;
+
+        if (p == 0)
+        {
+            ret = -1;
+            break;
+        }
+        len = snprintf(p, 1024, "%llx\t%.400s", funcs[i].start, sym && sym->addr == funcs[i].start ? sym->name : "-");
+        for (k = 0; k < RV_EXT_COUNT; k++)
+            if (ext[k])
+                len += snprintf(p + len, 1024 - len, "\t%s=%llu", rv_ext_name(k), ext[k]);
+        p[len++] = '\n';
+        rv_sink_commit(sink, len);
+    }
+
+out:
+    rv_stats_free(s);
+    free(funcs);
+    rv_image_close(img);
+    return ret;
+}
+
+static int dump_atomics(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads)
+{
+    static const char *kind_names[] = {"lr", "sc", "amo", "fence", "fence.tso", "fence.i"};
+    rv_image_t *img = rv_image_open(path, base);
+    rv_func_t *funcs = 0;
+    rv_atomic_t *a = 0;
+    size_t i, k, n = 0, nfuncs = 0;
+    int ret = -1;
+
+    if (img == 0)
+        return -1;
+    funcs = rv_func_detect(img, threads, &nfuncs);
+    if (funcs)
+        a = rv_atomic_scan(img, funcs, nfuncs, threads, &n);
+    if (a == 0)
+        goto out;
+
+    ret = 0;
+    for (i = 0; i < n; i = k)
+    {
+        const rv_symbol_t *sym = rv_image_symbol(img, a[i].func);
+        size_t hot = 0;
+
+        for (k = i; k < n && a[k].func == a[i].func; k++)
+            hot += (a[k].flags & RV_ATOMIC_HOT) != 0;
+        put_text(sink, "## %llx %.400s %zu atomics, %zu hot\n", a[i].func, sym && sym->addr == a[i].func ? sym->name : "-", k - i, hot);
+        for (k = i; k < n && a[k].func == a[i].func; k++)
+        {
+            const rv_section_t *s = rv_image_section(img, a[k].pc);
+            char text[128] = "?", order[16], *p;
+            mnemonic_t m;
+            inst_t ir;
+
+            if (s && s->data && rv_dis_decode(a[k].pc, s->data + (a[k].pc - s->addr), s->size - (a[k].pc - s->addr), &ir, 0))
+            {
+                rv_disasm(&ir, &m);
+                rv_format(&m, text, sizeof text);
+                rv_mnemonic_free(&m);
+                if ((p = strchr(text, '\t')) != 0)
+                    *p = ' '; // keep one column per field
+            }
+            put_text(sink, "%llx\t%s\t%s\t%s\t", a[k].pc, kind_names[a[k].kind], text, rv_atomic_order(&a[k], order, sizeof order));
+            if (a[k].flags & RV_ATOMIC_LOOP)
+                put_text(sink, "%llx\t", a[k].loop);
+            else
+                put_text(sink, "-\t");
+            put_text(sink, "%s\n", a[k].flags & RV_ATOMIC_HOT ? "hot" : a[k].flags & RV_ATOMIC_HEAVY ? "heavy" : "-");
+        }
+    }
+
+out:
+    free(a);
+    free(funcs);
+    rv_image_close(img);
+    return ret;
+}
+
+static int dump_csrs(rv_sink_t *sink, const char *path, rv_uint64_t base, int min)
+{
+    rv_image_t *img = rv_image_open(path, base);
+    size_t i, count[RV_PRIV_D + 1] = {0};
+    int k;
+
+    if (img == 0)
+        return -1;
+    for (i = 0; i < img->nsections; i++)
+    {
+        const rv_section_t *s = &img->sections[i];
+        rv_uint64_t off = 0;
+
+        while (s->exec && s->data && off < s->size)
+        {
+            rv_uint32_t raw, f3, csr;
+            const rv_csr_t *c;
+            char text[128], *p;
+            mnemonic_t m;
+            inst_t ir;
+            int len = rv_dis_decode(s->addr + off, s->data + off, s->size - off, &ir, &raw), priv, rd, wr;
+
+            if (len == 0)
+                break;
+            off += len;
+            f3 = raw >> 12 & 7;
+            if ((raw & 0x7f) != 0x73 || (f3 & 3) == 0 || ir.op == RV_UNDEF)
+                continue;
+            csr = raw >> 20;
+            c = rv_csr_info(csr);
+            priv = c ? c->priv : (int)(csr >> 8 & 3);
+            if (priv < min)
+                continue;
+            // csrrw reads unless rd is zero, csrrs and csrrc write unless rs1 is
+            rd = (f3 & 3) != 1 || (raw >> 7 & 31) != 0;
+            wr = (f3 & 3) == 1 || (raw >> 15 & 31) != 0;
+            rv_disasm(&ir, &m);
+            rv_format(&m, text, sizeof text);
+            rv_mnemonic_free(&m);
+            if ((p = strchr(text, '\t')) != 0)
+                *p = ' ';
+            put_text(sink, "%llx\t%s\t%s\t%s\t%s%s\t%s\n", ir.pc, text, rv_csr2name(csr), rv_priv_name(priv), rd ? "r" : "", wr ? "w" : "",
+                     c == 0 ? "unknown" : wr && (c->flags & RV_CSR_RO) ? "read-only" : "-");
+            count[priv]++;
+        }
+    }
+    for (k = min; k <= RV_PRIV_D; k++)
+        put_text(sink, "## %s %zu\n", rv_priv_name(k), count[k]);
+    rv_image_close(img);
+    return 0;
+}
+
+// starts cmd and returns once it has exec'd: the close-on-exec pipe then
+// reads eof, or the errno of a failed exec.
+static int spawn(char **cmd)
+{
+    int fds[2], pid, err;
+
+    if (pipe(fds) < 0)
+        return -1;
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        execvp(cmd[0], cmd);
+        err = errno;
+        write(fds[1], &err, sizeof err);
+        _exit(127);
+    }
+    close(fds[1]);
+    if (pid > 0 && read(fds[0], &err, sizeof err) == sizeof err)
+    {
+        waitpid(pid, 0, 0);
+        errno = err;
+        pid = -1;
+    }
+    close(fds[0]);
+    return pid;
+}
+
+static int dump_range(rv_sink_t *sink, int format, const rv_image_t *img, rv_uint64_t addr, rv_uint64_t size)
+{
+    const rv_section_t *s = rv_image_section(img, addr);
+
+    if (s == 0)
+        return 0;
+    if (format == RV_OUT_TEXT)
+        put_text(sink, "## %llx-%llx %s\n", addr, addr + size, s->name);
+    return dump_live(sink, format, addr, s->data + (addr - s->addr), size);
+}
+
+// a running process given by pid, or one started from cmd. With interval
+// the pages that change are disassembled again as they do; the process is
+// watched until it exits, a started one is otherwise killed when done.
+static int dump_proc(rv_sink_t *sink, int format, char **cmd, int interval)
+{
+    rv_proc_t *p = 0;
+    rv_proc_range_t *r;
+    const rv_image_t *img;
+    size_t i, n;
+    int pid, child = cmd[1] || strspn(cmd[0], "0123456789") != strlen(cmd[0]), ret = 0;
+
+    pid = child ? spawn(cmd) : atoi(cmd[0]);
+    if (pid <= 0 || (p = rv_proc_open(pid)) == 0)
+    {
+        perror(cmd[0]);
+        ret = -1;
+        goto out;
+    }
+    img = rv_proc_image(p);
+    for (i = 0; i < img->nsections && ret == 0; i++)
+        ret = dump_range(sink, format, img, img->sections[i].addr, img->sections[i].size);
+    while (ret == 0 && interval > 0 && rv_sink_flush(sink) == 0)
+    {
+        usleep(interval * 1000);
+        if (child && waitpid(pid, 0, WNOHANG) == pid)
+        {
+            child = 0;
+            break;
+        }
+        // a process that is gone, or a zombie without mappings, ends the watch
+        if ((r = rv_proc_refresh(p, &n)) == 0)
+            break;
+        for (i = 0; i < n && ret == 0; i++)
+            ret = dump_range(sink, format, img, r[i].addr, r[i].size);
+        rv_dis_free(r);
+        if (img->nsections == 0)
+            break;
+    }
+
+out:
+    if (child && pid > 0)
+    {
+        kill(pid, SIGKILL);
+        waitpid(pid, 0, 0);
+    }
+    rv_proc_close(p);
+    return ret;
+}
+
+static int dump_diff(rv_sink_t *sink, const char *path, const char *old_path, rv_uint64_t base, int threads, int verbose)
+{
+    static const char *kind_names[] = {"same", "changed", "moved", "removed", "added"};
+    rv_image_t *img[2] = {rv_image_open(old_path, base), rv_image_open(path, base)};
+    rv_func_t *funcs[2] = {0, 0};
+    rv_uint64_t *hash[2] = {0, 0};
+    size_t nfuncs[2] = {0, 0}, total[5] = {0, 0, 0, 0, 0};
+    rv_match_t *m = 0;
+    size_t i, n = 0;
+    double t0 = now();
+    int k, ret = -1;
+
+    for (k = 0; k < 2; k++)
+    {
+        if (img[k] == 0)
+        {
+            perror(k ? path : old_path);
+            goto out;
+        }
+        funcs[k] = rv_func_detect(img[k], threads, &nfuncs[k]);
+        hash[k] = funcs[k] ? rv_diff_hash(img[k], funcs[k], nfuncs[k], threads) : 0;
+        if (hash[k] == 0)
+            goto out;
+    }
+    m = rv_diff_match(img[0], funcs[0], hash[0], nfuncs[0], img[1], funcs[1], hash[1], nfuncs[1], &n);
+    if (m == 0)
+        goto out;
+    if (verbose)
+        fprintf(stderr, "%zu and %zu functions hashed and matched in %.3fs\n", nfuncs[0], nfuncs[1], now() - t0);
+
+    ret = 0;
+    for (i = 0; i < n && ret == 0; i++)
+    {
+        const rv_func_t *a = m[i].a != RV_DIFF_NONE ? &funcs[0][m[i].a] : 0;
+        const rv_func_t *b = m[i].b != RV_DIFF_NONE ? &funcs[1][m[i].b] : 0;
+        const rv_symbol_t *sym = rv_image_symbol(b ? img[1] : img[0], b ? b->start : a->start);
+
+        total[m[i].kind]++;
+        if (m[i].kind == RV_DIFF_SAME || m[i].kind == RV_DIFF_MOVED)
+            continue;
+        ret = put_text(sink, "## %s\t%llx\t%llx\t%.400s\n", kind_names[m[i].kind], a ? a->start : 0ull, b ? b->start : 0ull,
+                       sym ? sym->name : "-");
+        if (ret == 0 && m[i].kind == RV_DIFF_CHANGED)
+            ret = rv_diff_func(sink, img[0], a, img[1], b);
+    }
+    fprintf(stderr, "%zu same, %zu changed, %zu moved, %zu removed, %zu added\n", total[0], total[1], total[2], total[3], total[4]);
+
+out:
+    free(m);
+    for (k = 0; k < 2; k++)
+    {
+        free(hash[k]);
+        free(funcs[k]);
+        rv_image_close(img[k]);
+    }
+    return ret;
+}
+
+static int dump_fprint(rv_sink_t *sink, const char *path, rv_uint64_t base, int threads, const char *db_path, int query, int verbose)
+{
+    rv_image_t *img = rv_image_open(path, base);
+    rv_fpdb_t *db = rv_fpdb_open(db_path);
+    rv_func_t *funcs = 0;
+    rv_fprint_t *fps = 0;
+    size_t i, k, nfuncs = 0, nhits = 0;
+    double t0 = now();
+    int ret = -1;
+
+    if (db == 0 && !query)
+        db = rv_fpdb_new();
+    if (img == 0 || db == 0)
+    {
+        perror(img ? db_path : path);
+        goto out;
+    }
+    funcs = rv_func_detect(img, threads, &nfuncs);
+    fps = funcs ? rv_fprint_image(img, funcs, nfuncs, threads) : 0;
+    if (fps == 0)
+        goto out;
+    if (verbose)
+        fprintf(stderr, "%zu functions fingerprinted in %.3fs\n", nfuncs, now() - t0);
+    if (!query)
+    {
+        ret = rv_fpdb_add(db, path, fps, nfuncs) == 0 ? rv_fpdb_save(db, db_path) : -1;
+        goto out;
+    }
+
+    ret = 0;
+    for (i = 0; i < nfuncs && ret == 0; i++)
+    {
+        const rv_symbol_t *sym = rv_image_symbol(img, fps[i].start);
+        rv_fpdb_hit_t hits[16];
+        size_t n = rv_fpdb_query(db, &fps[i], 0.5, hits, 16);
+
+        for (k = 0; k < n && ret == 0; k++)
+        {
+            const rv_fpdb_func_t *f = rv_fpdb_func(db, hits[k].func);
+            const char *image = rv_fpdb_image(db, hits[k].func);
+
+            if (f->start == fps[i].start && strcmp(image, path) == 0)
+                continue;
+            ret = put_text(sink, "%llx\t%.200s\t%.2f\t%.200s\t%llx\n", fps[i].start, sym && sym->addr == fps[i].start ? sym->name : "-",
+                           hits[k].similarity, image, f->start);
+            nhits++;
+        }
+    }
+    if (verbose)
+        fprintf(stderr, "%zu matches in %.3fs\n", nhits, now() - t0);
+
+out:
+    free(fps);
+    free(funcs);
+    rv_fpdb_close(db);
+    rv_image_close(img);
+    return ret;
+}
+
+// serves the text listing from the cache, or live when it is stale.
+static int dump_cache(rv_sink_t *sink, const rv_cache_t *c, rv_uint64_t base, size_t size)
+{
+    rv_uint64_t pc;
+
+    for (pc = base; pc < base + size;)
+    {
+        rv_line_t line;
+        char buf[128];
+        int len = rv_cache_line(c, pc, &line, buf, sizeof buf);
+        if (len == 0)
+            break;
+        if (put_line(sink, &line) < 0)
+            return -1;
+        pc += len;
+    }
+    return 0;
+}
+
+// match:mask:name:operands
+static int add_custom(const char *spec)
+{
+    rv_custom_t c;
+    char *end, *name;
+    const char *p;
+
+    bzero(&c, sizeof c);
+    c.match = strtoul(spec, &end, 0);
+    if (*end != ':')
+        return -1;
+    c.mask = strtoul(end + 1, &end, 0);
+    if (*end != ':' || (p = strchr(end + 1, ':')) == 0 || (name = strndup(end + 1, p - end - 1)) == 0)
+        return -1;
+    c.name = name;
+    c.layout = p + 1;
+    if (rv_custom_register(&c) < 0)
+    {
+        free(name);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int expand[] = {[RV_OUT_TEXT] = 10, [RV_OUT_JSONL] = 60, [RV_OUT_COLUMNS] = 32};
+    rv_uint64_t base = 0, lo = 0, hi = 0;
+    const char *cache_path = 0, *out_path = 0, *model_path = 0, *samples = 0, *old_path = 0, *db_path = 0;
+    int threads = 0, build = 0, verbose = 0, mode = 0, format = RV_OUT_TEXT, opt, fd, out_fd = 1, ret, min_priv = 0, interval = 0;
+    const char *privs = "ushmd", *p;
+    rv_isa_t isa;
+    const rv_uint8_t *code;
+    struct stat st;
+    rv_cache_t *c = 0;
+    rv_sink_t *sink;
+    rv_uint64_t bytes;
+    double t0, t;
+
+    while ((opt = getopt(argc, argv, "b:i:x:t:c:Cf:o:gFSM:E:P:XAR:D:K:Q:Lw:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            base = strtoull(optarg, 0, 0);
+            break;
+        case 'i':
+            if (rv_isa_parse(optarg, &isa) < 0)
+                usage(argv[0]);
+            rv_isa_select(&isa);
+            break;
+        case 'x':
+            if (add_custom(optarg) < 0)
+                usage(argv[0]);
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'c':
+            cache_path = optarg;
+            break;
+        case 'C':
+            build = 1;
+            break;
+        case 'f':
+            format = parse_format(optarg);
+            if (format < 0)
+                usage(argv[0]);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'M':
+            if (mode || sscanf(optarg, "%llx:%llx", &lo, &hi) != 2 || lo >= hi)
+                usage(argv[0]);
+            mode = opt;
+            break;
+        case 'E':
+            if (mode)
+                usage(argv[0]);
+            model_path = optarg;
+            mode = opt;
+            break;
+        case 'P':
+            if (mode)
+                usage(argv[0]);
+            samples = optarg;
+            mode = opt;
+            break;
+        case 'R':
+            if (mode || optarg[0] == 0 || optarg[1] || (p = strchr(privs, optarg[0])) == 0)
+                usage(argv[0]);
+            min_priv = p - privs;
+            mode = opt;
+            break;
+        case 'D':
+            if (mode)
+                usage(argv[0]);
+            old_path = optarg;
+            mode = opt;
+            break;
+        case 'K':
+        case 'Q':
+            if (mode)
+                usage(argv[0]);
+            db_path = optarg;
+            mode = opt;
+            break;
+        case 'g':
+        case 'F':
+        case 'S':
+        case 'X':
+        case 'A':
+            if (mode)
+                usage(argv[0]);
+            mode = opt;
+            break;
+        case 'L':
+            if (mode)
+                usage(argv[0]);
+            mode = opt;
+            break;
+        case 'w':
+            if ((interval = atoi(optarg)) <= 0)
+                usage(argv[0]);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (mode == 'L' ? optind >= argc || build || format == RV_OUT_COLUMNS : optind + 1 != argc || interval)
+        usage(argv[0]);
+    if (build && cache_path == 0)
+        usage(argv[0]);
+
+    bzero(&st, sizeof st);
+    code = 0;
+    if (mode != 'L')
+    {
+        fd = open(argv[optind], O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) < 0)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+        code = st.st_size ? mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : 0;
+        if (code == MAP_FAILED)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+        close(fd);
+    }
+
+    if (build)
+    {
+        if (rv_cache_build(cache_path, base, code, st.st_size, threads) < 0)
+        {
+            perror(cache_path);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (out_path)
+    {
+        out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd < 0)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+    sink = rv_sink_open(out_fd, 0, RV_SINK_ASYNC | (out_path ? RV_SINK_PREALLOC : 0), (rv_uint64_t)st.st_size * expand[format]);
+    if (sink == 0)
+    {
+        perror("sink");
+        return 1;
+    }
+
+    t0 = now();
+    if (mode == 'F')
+        ret = dump_funcs(sink, argv[optind], base, threads);
+    else if (mode == 'M')
+        ret = dump_mem(sink, argv[optind], base, lo, hi, format == RV_OUT_COLUMNS);
+    else if (mode == 'E')
+        ret = dump_cost(sink, argv[optind], base, threads, model_path, verbose);
+    else if (mode == 'P')
+        ret = dump_prof(sink, argv[optind], base, threads, samples, verbose);
+    else if (mode == 'D')
+        ret = dump_diff(sink, argv[optind], old_path, base, threads, verbose);
+    else if (mode == 'K' || mode == 'Q')
+        ret = dump_fprint(sink, argv[optind], base, threads, db_path, mode == 'Q', verbose);
+    else if (mode == 'X')
+        ret = dump_stats(sink, argv[optind], base, threads, verbose);
+    else if (mode == 'A')
+        ret = dump_atomics(sink, argv[optind], base, threads);
+    else if (mode == 'R')
+        ret = dump_csrs(sink, argv[optind], base, min_priv);
+    else if (mode == 'S')
+        ret = dump_frames(sink, argv[optind], base, threads);
+    else if (mode == 'g')
+        ret = dump_cfg(sink, argv[optind], base, threads);
+    else if (mode == 'L')
+        ret = dump_proc(sink, format, argv + optind, interval);
+    else if (format == RV_OUT_TEXT && cache_path)
+    {
+        c = rv_cache_open(cache_path, base, code, st.st_size);
+        if (c && !rv_cache_valid(c))
+            fprintf(stderr, "%s: stale or invalid, disassembling live\n", cache_path);
+        ret = c ? dump_cache(sink, c, base, st.st_size) : -1;
+        rv_cache_close(c);
+    }
+    else
+        ret = dump_live(sink, format, base, code, st.st_size);
+
+    bytes = rv_sink_offset(sink);
+    if (rv_sink_close(sink) < 0)
+        ret = -1;
+    t = now() - t0;
+    if (ret < 0)
+    {
+        perror(out_path ? out_path : "stdout");
+        return 1;
+    }
+    if (verbose)
+        fprintf(stderr, "%zu bytes in, %llu bytes out in %.3fs: %.1f MB/s\n", (size_t)st.st_size, bytes, t, bytes / t / 1e6);
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rv-alloc.h"
+#include "rv-dis.h"
+#include "rv-isa.h"
+
+#define SWEEP_CHUNK (1u << 20) // words per work item
+#define SWEEP_BATCH 4096       // words rendered between arena resets
+#define SWEEP_ARG 64           // operand text the formatter's buffers hold
+#define SWEEP_REPORT 100       // failures printed before going quiet
+
+typedef struct
+{
+    rv_uint64_t lo, hi;  // 32 bit words, hi exclusive
+    int all;             // also words whose low bits make them compressed
+    const rv_isa_t *isa; // profile, selected by each worker
+    rv_uint64_t nchunks;
+    int reverse;         // hand out the items last to first
+    atomic_ullong next;
+    atomic_ullong fails;
+} job_t;
+
+typedef struct
+{
+    pthread_t thread;
+    job_t *job;
+    rv_uint64_t words;
+    rv_uint64_t fails;
+    rv_uint64_t digest; // sum of per-word hashes, the same for any sharding
+    double secs;
+} worker_t;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-i isa] [-t threads] [-r lo:hi] [-d digest] [-a] [-v]\n", prog);
+    fprintf(stderr, "  -i isa      target profile, e.g. rv32imac_zicsr (default rv64 with everything)\n");
+    fprintf(stderr, "  -t threads  worker threads, 0 for all cpus (default 0)\n");
+    fprintf(stderr, "  -r lo:hi    sweep 32 bit words in [lo, hi) only (default all)\n");
+    fprintf(stderr, "  -d digest   also require this digest, e.g. one recorded from another build\n");
+    fprintf(stderr, "  -a          also the 3/4 of words that are compressed, not only those ending in 11\n");
+    fprintf(stderr, "  -v          report the rate of every thread\n");
+    exit(2);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static rv_uint64_t fnv(rv_uint64_t h, const void *p, size_t n)
+{
+    const unsigned char *s = p;
+
+    while (n--)
+        h = (h ^ *s++) * 0x100000001b3ull;
+    return h;
+}
+
+static void fail(worker_t *w, rv_uint32_t word, int size, const char *why)
+{
+    w->fails++;
+    if (atomic_fetch_add(&w->job->fails, 1) < SWEEP_REPORT)
+        fprintf(stderr, size == 2 ? "%04x: %s\n" : "%08x: %s\n", word, why);
+}
+
+// renders ir into buf, checking the mnemonic against the bounds the
+// formatter's consumers assume. Returns the text length or -1.
+static int render(worker_t *w, rv_uint32_t word, int size, inst_t *ir, char *buf)
+{
+    mnemonic_t m;
+    int i, n, ret = -1;
+
+    rv_disasm(ir, &m);
+    for (i = 0; i < 5; i++)
+    {
+        if (m.args[i] == 0)
+            continue;
+        if (i && m.args[i - 1] == 0)
+        {
+            fail(w, word, size, "operand after a missing one");
+            goto out;
+        }
+        if (strlen(m.args[i]) >= SWEEP_ARG)
+        {
+            fail(w, word, size, "operand text too long");
+            goto out;
+        }
+        if (m.arg[i].kind > RV_ARG_VTYPE)
+        {
+            fail(w, word, size, "bad operand kind");
+            goto out;
+        }
+    }
+    n = rv_format(&m, buf, RV_TEXT_MAX);
+    if (n < 0 || n >= RV_TEXT_MAX)
+    {
+        fail(w, word, size, "text too long");
+        goto out;
+    }
+    ret = n;
+
+out:
+    rv_mnemonic_free(&m);
+    return ret;
+}
+
+// decodes and renders word twice, the second time from a fresh decode, and
+// requires the same text.
+static void check(worker_t *w, rv_uint32_t word, int size)
+{
+    rv_uint8_t code[4] = {word, word >> 8, word >> 16, word >> 24};
+    char a[RV_TEXT_MAX], b[RV_TEXT_MAX];
+    inst_t ir;
+    int n;
+
+    w->words++;
+    if (rv_dis_decode(0, code, size, &ir, 0) != ((word & 3) == 3 ? 4 : 2))
+    {
+        fail(w, word, size, "bad length");
+        return;
+    }
+    if ((n = render(w, word, size, &ir, a)) < 0)
+        return;
+    rv_dis_decode(0, code, size, &ir, 0);
+    if (render(w, word, size, &ir, b) != n || memcmp(a, b, n) != 0)
+    {
+        fail(w, word, size, "output differs between runs");
+        return;
+    }
+    w->digest += fnv(fnv(0xcbf29ce484222325ull, &word, sizeof word), a, n);
+}
+
+static void *sweep(void *arg)
+{
+    worker_t *w = arg;
+    job_t *j = w->job;
+    rv_arena_t *arena = rv_arena_new(0, 0);
+    rv_allocator_t a;
+    rv_uint64_t k, word, n = 0;
+    double t0 = now();
+
+    rv_isa_select(j->isa);
+    if (arena)
+    {
+        a = rv_arena_allocator(arena);
+        rv_dis_set_thread_allocator(&a);
+    }
+    // the item past the last chunk is the 16 bit space
+    while ((k = atomic_fetch_add(&j->next, 1)) <= j->nchunks)
+    {
+        rv_uint64_t lo, hi;
+
+        if (j->reverse)
+            k = j->nchunks - k;
+        lo = j->lo + k * SWEEP_CHUNK;
+        hi = lo + SWEEP_CHUNK;
+        if (k == j->nchunks)
+        {
+            lo = 0;
+            hi = 1u << 16;
+        }
+        else if (hi > j->hi)
+            hi = j->hi;
+        for (word = lo; word < hi; word++)
+        {
+            if (k == j->nchunks ? (word & 3) == 3 : (word & 3) != 3 && !j->all)
+                continue;
+            check(w, word, k == j->nchunks ? 2 : 4);
+            if (arena && ++n % SWEEP_BATCH == 0)
+                rv_arena_reset(arena);
+        }
+    }
+    rv_dis_set_thread_allocator(0);
+    rv_arena_free(arena);
+    w->secs = now() - t0;
+    return 0;
+}
+
+// sweeps j on threads workers, adding to the totals. Returns -1 when a
+// worker cannot start.
+static int run(job_t *j, int threads, int verbose, rv_uint64_t *words, rv_uint64_t *fails, rv_uint64_t *digest)
+{
+    worker_t *workers = calloc(threads, sizeof *workers);
+    int i, ret = 0;
+
+    if (workers == 0)
+        return -1;
+    atomic_store(&j->next, 0);
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].job = j;
+        if (pthread_create(&workers[i].thread, 0, sweep, &workers[i]) != 0)
+        {
+            fprintf(stderr, "cannot start thread %d\n", i);
+            threads = i;
+            ret = -1;
+        }
+    }
+    for (i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, 0);
+        *words += workers[i].words;
+        *fails += workers[i].fails;
+        *digest += workers[i].digest;
+        if (verbose)
+            fprintf(stderr, "thread %d: %llu words in %.3fs: %.2f M/s\n", i, workers[i].words, workers[i].secs,
+                    workers[i].words / workers[i].secs / 1e6);
+    }
+    free(workers);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    rv_uint64_t words = 0, fails = 0, digest = 0, again = 0, want = 0, n = 0;
+    int threads = 0, verbose = 0, check_digest = 0, opt;
+    rv_isa_t isa;
+    job_t j;
+    char *end;
+    double t0, t;
+
+    bzero(&j, sizeof j);
+    j.hi = 1ull << 32;
+    while ((opt = getopt(argc, argv, "i:t:r:d:av")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            // rv_isa_parse() also compiles the dispatch table, so the
+            // workers can select isa as it is.
+            if (rv_isa_parse(optarg, &isa) < 0)
+                usage(argv[0]);
+            j.isa = &isa;
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'r':
+            j.lo = strtoull(optarg, &end, 0);
+            if (*end != ':')
+                usage(argv[0]);
+            j.hi = strtoull(end + 1, &end, 0);
+            if (*end || j.lo >= j.hi || j.hi > 1ull << 32)
+                usage(argv[0]);
+            break;
+        case 'd':
+            want = strtoull(optarg, &end, 16);
+            if (*end)
+                usage(argv[0]);
+            check_digest = 1;
+            break;
+        case 'a':
+            j.all = 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc)
+        usage(argv[0]);
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0)
+        threads = 1;
+
+    j.nchunks = (j.hi - j.lo + SWEEP_CHUNK - 1) / SWEEP_CHUNK;
+    t0 = now();
+    if (run(&j, threads, verbose, &words, &fails, &digest) < 0)
+        return 1;
+    t = now() - t0;
+
+    // the second pass hands the chunks out backwards, to one thread fewer when
+    // there are several, so words land on other threads and arenas than the
+    // first time. Its failures repeat the first pass's; only the digest counts.
+    j.reverse = 1;
+    if (run(&j, threads > 1 ? threads - 1 : 1, 0, &n, &n, &again) < 0)
+        return 1;
+    if (again != digest)
+    {
+        fprintf(stderr, "digest differs between passes: %016llx, %016llx\n", digest, again);
+        fails++;
+    }
+    if (check_digest && digest != want)
+    {
+        fprintf(stderr, "digest %016llx, want %016llx\n", digest, want);
+        fails++;
+    }
+
+    printf("%llu words, %llu failed, digest %016llx\n", words, fails, digest);
+    printf("%d threads, %.3fs: %.2f M/s, %.2f M/s per thread\n", threads, t, words / t / 1e6, words / t / 1e6 / threads);
+    return fails != 0;
+}